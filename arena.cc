@@ -0,0 +1,171 @@
+#include "arena.h"
+
+// std
+#include <cstdlib>
+
+#ifdef L3DPP_OPENMP
+#include <omp.h>
+#endif //L3DPP_OPENMP
+
+namespace L3DPP
+{
+    //------------------------------------------------------------------------------
+    Arena::Arena(const size_t chunk_size, const L3DPP::NumaTopology* numa,
+                 const unsigned int node)
+    {
+        chunk_size_ = chunk_size;
+        numa_ = numa;
+        node_ = node;
+
+        int num_threads = 1;
+#ifdef L3DPP_OPENMP
+        num_threads = omp_get_max_threads();
+#endif //L3DPP_OPENMP
+
+        threads_.resize(num_threads+1);
+        for(size_t t=0; t<threads_.size(); ++t)
+        {
+            ThreadChunks* tc = (t < num_threads) ? new ThreadChunks() : &shared_;
+            tc->current_ = NULL;
+            tc->used_ = 0;
+            tc->size_ = 0;
+            tc->reserved_ = 0;
+            threads_[t] = tc;
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    Arena::~Arena()
+    {
+        release();
+
+        for(size_t t=0; t+1<threads_.size(); ++t)
+            delete threads_[t];
+    }
+
+    //------------------------------------------------------------------------------
+    void* Arena::allocate(const size_t bytes)
+    {
+        size_t aligned = ((bytes+L3D_ARENA_ALIGNMENT-1)/L3D_ARENA_ALIGNMENT)*L3D_ARENA_ALIGNMENT;
+
+        bool shared;
+        ThreadChunks* tc = chunksForThread(shared);
+
+        if(shared)
+            shared_mutex_.lock();
+
+        void* ptr = NULL;
+        if(aligned > chunk_size_/4)
+        {
+            // large block -> chunk of its own
+            ptr = newChunk(tc,aligned);
+        }
+        else
+        {
+            if(tc->current_ == NULL || tc->used_+aligned > tc->size_)
+            {
+                // new chunk (first touched by the allocating thread,
+                // or placed on the node of the arena)
+                char* chunk = newChunk(tc,chunk_size_);
+                if(chunk != NULL)
+                {
+                    tc->current_ = chunk;
+                    tc->used_ = 0;
+                    tc->size_ = chunk_size_;
+                }
+            }
+
+            if(tc->current_ != NULL && tc->used_+aligned <= tc->size_)
+            {
+                ptr = tc->current_+tc->used_;
+                tc->used_ += aligned;
+            }
+        }
+
+        if(shared)
+            shared_mutex_.unlock();
+
+        if(ptr == NULL)
+            throw std::bad_alloc();
+
+        return ptr;
+    }
+
+    //------------------------------------------------------------------------------
+    void Arena::release()
+    {
+        for(size_t t=0; t<threads_.size(); ++t)
+        {
+            ThreadChunks* tc = threads_[t];
+            for(size_t i=0; i<tc->chunks_.size(); ++i)
+            {
+                if(numa_ != NULL)
+                    numa_->free(tc->chunks_[i],tc->chunk_sizes_[i]);
+                else
+                    free(tc->chunks_[i]);
+            }
+
+            // give the bookkeeping memory back as well
+            std::vector<char*>().swap(tc->chunks_);
+            std::vector<size_t>().swap(tc->chunk_sizes_);
+            tc->current_ = NULL;
+            tc->used_ = 0;
+            tc->size_ = 0;
+            tc->reserved_ = 0;
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    size_t Arena::capacity()
+    {
+        size_t bytes = 0;
+        for(size_t t=0; t<threads_.size(); ++t)
+            bytes += threads_[t]->reserved_;
+
+        return bytes;
+    }
+
+    //------------------------------------------------------------------------------
+    char* Arena::newChunk(ThreadChunks* tc, const size_t bytes)
+    {
+        char* chunk = NULL;
+        if(numa_ != NULL)
+            chunk = static_cast<char*>(numa_->allocate(bytes,node_));
+        else
+            chunk = static_cast<char*>(malloc(bytes));
+
+        if(chunk != NULL)
+        {
+            tc->chunks_.push_back(chunk);
+            tc->chunk_sizes_.push_back(bytes);
+            tc->reserved_ += bytes;
+        }
+        return chunk;
+    }
+
+    //------------------------------------------------------------------------------
+    Arena::ThreadChunks* Arena::chunksForThread(bool& shared)
+    {
+        shared = true;
+#ifdef L3DPP_OPENMP
+        // only threads of the single active team own chunks,
+        // outside of a parallel region every thread would be
+        // thread 0 -> locked shared chunks
+        if(omp_get_active_level() == 1)
+        {
+            // inactive nested regions (team of one) -> thread of the active team
+            int level = omp_get_level();
+            while(level > 1 && omp_get_team_size(level) == 1)
+                --level;
+
+            int t = omp_get_ancestor_thread_num(level);
+            if(t >= 0 && t < int(threads_.size())-1)
+            {
+                shared = false;
+                return threads_[t];
+            }
+        }
+#endif //L3DPP_OPENMP
+        return &shared_;
+    }
+}
@@ -0,0 +1,159 @@
+#ifndef I3D_LINE3D_PP_ARENA_H_
+#define I3D_LINE3D_PP_ARENA_H_
+
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <vector>
+#include <cstddef>
+#include <new>
+
+// external
+#include "boost/thread/mutex.hpp"
+
+// internal
+#include "numatopology.h"
+
+/**
+ * Line3D++ - Arena
+ * ====================
+ * Monotonic memory arena for transient
+ * objects of one pipeline stage (matches,
+ * affinity edges, ...). Every thread
+ * allocates from its own chunks, freeing
+ * single objects is a no-op and the whole
+ * stage is released at once. Optionally,
+ * all chunks are placed on a NUMA node.
+ * ====================
+ */
+
+namespace L3DPP
+{
+    // arena parameters
+    const size_t L3D_ARENA_CHUNK_SIZE = 4194304;
+    const size_t L3D_ARENA_ALIGNMENT = 16;
+
+    class Arena
+    {
+    public:
+        // numa != NULL -> chunks are placed on the given node
+        Arena(const size_t chunk_size=L3D_ARENA_CHUNK_SIZE,
+              const L3DPP::NumaTopology* numa=NULL, const unsigned int node=0);
+        ~Arena();
+
+        // allocate memory (thread-safe)
+        void* allocate(const size_t bytes);
+
+        // free all memory at once (not thread-safe!
+        // objects in the arena must not be used afterwards)
+        void release();
+
+        // reserved memory
+        size_t capacity();
+
+    private:
+        // chunks of one thread
+        struct ThreadChunks
+        {
+            std::vector<char*> chunks_;
+            std::vector<size_t> chunk_sizes_;
+            char* current_;
+            size_t used_;
+            size_t size_;
+            size_t reserved_;
+
+            // avoid false sharing between threads
+            char padding_[64];
+        };
+
+        // chunks for the calling thread
+        ThreadChunks* chunksForThread(bool& shared);
+
+        // new chunk (on the node, if any)
+        char* newChunk(ThreadChunks* tc, const size_t bytes);
+
+        size_t chunk_size_;
+        const L3DPP::NumaTopology* numa_;
+        unsigned int node_;
+        std::vector<ThreadChunks*> threads_;
+        // for threads outside of a parallel region (or nested active teams)
+        ThreadChunks shared_;
+        boost::mutex shared_mutex_;
+    };
+
+    //------------------------------------------------------------------------------
+    // STL allocator for an arena (falls back to the
+    // global heap when default constructed)
+    template <class T>
+    class ArenaAllocator
+    {
+    public:
+        typedef T value_type;
+        typedef T* pointer;
+        typedef const T* const_pointer;
+        typedef T& reference;
+        typedef const T& const_reference;
+        typedef size_t size_type;
+        typedef ptrdiff_t difference_type;
+
+        template <class U>
+        struct rebind {typedef ArenaAllocator<U> other;};
+
+        ArenaAllocator() : arena_(NULL){}
+        explicit ArenaAllocator(L3DPP::Arena* arena) : arena_(arena){}
+        template <class U>
+        ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()){}
+
+        pointer address(reference x) const {return &x;}
+        const_pointer address(const_reference x) const {return &x;}
+
+        pointer allocate(size_type n, const void* =0)
+        {
+            if(arena_ == NULL)
+                return static_cast<pointer>(::operator new(n*sizeof(T)));
+            else
+                return static_cast<pointer>(arena_->allocate(n*sizeof(T)));
+        }
+
+        void deallocate(pointer p, size_type n)
+        {
+            // arena memory is released per stage
+            if(arena_ == NULL)
+                ::operator delete(p);
+        }
+
+        size_type max_size() const {return size_t(-1)/sizeof(T);}
+
+        void construct(pointer p, const T& val){new(static_cast<void*>(p)) T(val);}
+        void destroy(pointer p){p->~T();}
+
+        L3DPP::Arena* arena() const {return arena_;}
+
+    private:
+        L3DPP::Arena* arena_;
+    };
+
+    template <class T, class U>
+    inline bool operator== (const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs)
+    {
+        return (lhs.arena() == rhs.arena());
+    }
+
+    template <class T, class U>
+    inline bool operator!= (const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs)
+    {
+        return (lhs.arena() != rhs.arena());
+    }
+}
+
+#endif //I3D_LINE3D_PP_ARENA_H_
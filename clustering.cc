@@ -3,7 +3,7 @@
 namespace L3DPP
 {
     //------------------------------------------------------------------------------
-    CLUniverse* performClustering(std::list<CLEdge>& edges, int numNodes,
+    CLUniverse* performClustering(CLEdgeList& edges, int numNodes,
                                   float c)
     {
         if(edges.size() == 0)
@@ -21,7 +21,7 @@ namespace L3DPP
             threshold[i] = c;
 
         // perform clustering
-        std::list<CLEdge>::const_iterator it = edges.begin();
+        CLEdgeList::const_iterator it = edges.begin();
         for(; it!=edges.end(); ++it)
         {
             CLEdge e = *it;
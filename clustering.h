@@ -28,6 +28,7 @@
 #include <algorithm>
 
 #include "universe.h"
+#include "arena.h"
 
 /**
  * Clustering
@@ -50,6 +51,9 @@ namespace L3DPP
         float w_;
     } CLEdge;
 
+    // edge list (allocated in a stage arena)
+    typedef std::list<CLEdge,L3DPP::ArenaAllocator<CLEdge> > CLEdgeList;
+
     // sorting function for edges
     static bool sortCLEdgesByWeight(const CLEdge& a, const CLEdge& b)
     {
@@ -69,7 +73,7 @@ namespace L3DPP
 
     // perform graph clustering
     // NOTE: edges are sorted during the process!
-    CLUniverse* performClustering(std::list<CLEdge>& edges, int numNodes,
+    CLUniverse* performClustering(CLEdgeList& edges, int numNodes,
                                   float c);
 
 }
@@ -15,9 +15,12 @@
 
 // internal
 #include "serialization.h"
+#include "arena.h"
 
 // external
 #include <queue>
+#include <algorithm>
+#include <list>
 #include <stdlib.h>
 
 // windows fix
@@ -43,6 +46,10 @@ namespace L3DPP
     #define L3D_DEF_MIN_LINE_LENGTH_FACTOR 0.005f
     #define L3D_DEF_MAX_NUM_SEGMENTS 3000
     #define L3D_DEF_LOAD_AND_STORE_SEGMENTS true
+    #define L3D_DEF_QUANTIZE_SEGMENTS false
+    #define L3D_DEF_SPATIAL_SEGMENT_ORDER false
+    #define L3D_DEF_FLOAT_PRECISION false
+    #define L3D_DEF_PIN_THREADS false
 
     // collinearity
     #define L3D_DEF_COLLINEARITY_T -1.0f
@@ -54,15 +61,24 @@ namespace L3DPP
     #define L3D_DEF_SCORING_POS_REGULARIZER 2.5f
     #define L3D_DEF_SCORING_ANG_REGULARIZER 10.0f
     #define L3D_DEF_CHECK_MATCH_ORIENTATION true
+    #define L3D_DEF_USE_LINE_DESCRIPTORS false
+    #define L3D_DEF_LINE_DESC_MAX_HAMMING 0.35f
+    #define L3D_DEF_USE_KEYPOINT_ANCHORS false
+    #define L3D_DEF_KEYPOINT_RADIUS_FACTOR 0.02f
+    #define L3D_DEF_KEYPOINT_MIN_SHARED 16
 
     // scoring
     #define L3D_DEF_MIN_SIMILARITY_3D 0.50f
     #define L3D_DEF_MIN_BEST_SCORE_3D 0.75f
     #define L3D_DEF_MIN_BEST_SCORE_PERC 0.10f
+    #define L3D_DEF_SCORING_HASH_MIN_HYPOTHESES 64
+    #define L3D_DEF_MAX_TRACK_SIZE 256
 
     // replicator dynamics diffusion
     #define L3D_DEF_PERFORM_RDD false
     #define L3D_DEF_RDD_MAX_ITER 10
+    #define L3D_DEF_RDD_TOLERANCE 1e-4f
+    #define L3D_DEF_RDD_PRUNE_T 0.0f // 0 -> no pruning (CPU only)
 
     // clustering
     #define L3D_DEF_MIN_AFFINITY 0.50f
@@ -87,6 +103,9 @@ namespace L3DPP
 #endif //L3DPP_CERES
     #define L3D_DEF_CERES_MAX_ITER 250
 
+    // progressive reconstruction
+    #define L3D_DEF_PROGRESSIVE_STAGES 3
+
     // display
     #define L3D_DISP_CAMS 4
     #define L3D_DISP_LINES 5
@@ -99,6 +118,9 @@ namespace L3DPP
     #define L3D_PI_1_32 0.098174771f
     #define L3D_PI_31_32 3.043417886f
 
+    // prefetching (bytes per cache line)
+    #define L3D_CACHE_LINE_SIZE 64
+
     //------------------------------------------------------------------------------
     // 2D segment (sortable)
     class Segment2D
@@ -181,6 +203,21 @@ namespace L3DPP
         return lhs.distance_score_ > rhs.distance_score_;
     }
 
+    //------------------------------------------------------------------------------
+    // 2D segment in 16-bit fixed point (coordinates relative to the range of all
+    // endpoints of the image, which includes the image itself and endpoints outside):
+    // x = min_x + x_q/65535*range -> rounding error <= range/131070 px (< 0.035 px for
+    // images up to 4500 px, < 0.08 px for 10000 px). This is well below the
+    // endpoint accuracy of LSD (sub-pixel perpendicular to the segment,
+    // around a pixel or more along it).
+    struct QuantizedSegment2D
+    {
+        unsigned short x1_;
+        unsigned short y1_;
+        unsigned short x2_;
+        unsigned short y2_;
+    };
+
     //------------------------------------------------------------------------------
     // potential match
     struct Match
@@ -202,6 +239,9 @@ namespace L3DPP
         float depth_q2_;
     };
 
+    // list of matches (for one segment, allocated in a stage arena)
+    typedef std::list<L3DPP::Match,L3DPP::ArenaAllocator<L3DPP::Match> > MatchList;
+
     // sorting functions
     static bool sortMatchesByIDs(const Match m1, const Match m2)
     {
@@ -224,8 +264,65 @@ namespace L3DPP
         }
     };
 
-    // queue
-    typedef std::priority_queue<L3DPP::Match,std::vector<L3DPP::Match>,L3DPP::Match_kNN> pairwise_matches;
+    //------------------------------------------------------------------------------
+    // fixed-capacity heap of the k best matches (by overlap score or a given
+    // rank), the worst kept match is on top and gets replaced by better ones
+    class KNNMatches
+    {
+    public:
+        KNNMatches(const unsigned int k) : k_(k)
+        {
+            matches_.reserve(k_);
+        }
+
+        void push(const L3DPP::Match& M)
+        {
+            push(M,M.overlap_score_);
+        }
+
+        void push(const L3DPP::Match& M, const float rank)
+        {
+            if(matches_.size() < k_)
+            {
+                matches_.push_back(RankedMatch(rank,M));
+                std::push_heap(matches_.begin(),matches_.end(),worse);
+            }
+            else if(k_ > 0 && rank > matches_.front().first)
+            {
+                std::pop_heap(matches_.begin(),matches_.end(),worse);
+                matches_.back() = RankedMatch(rank,M);
+                std::push_heap(matches_.begin(),matches_.end(),worse);
+            }
+        }
+
+        // best match first (invalidates the heap)
+        const std::vector<L3DPP::Match>& sorted()
+        {
+            std::sort_heap(matches_.begin(),matches_.end(),worse);
+
+            sorted_.resize(matches_.size());
+            for(size_t i=0; i<matches_.size(); ++i)
+                sorted_[i] = matches_[i].second;
+
+            return sorted_;
+        }
+
+        size_t size() const {return matches_.size();}
+        bool empty() const {return matches_.empty();}
+
+    private:
+        typedef std::pair<float,L3DPP::Match> RankedMatch;
+
+        // min-heap on the rank
+        static bool worse(const RankedMatch& lhs, const RankedMatch& rhs)
+        {
+            return lhs.first > rhs.first;
+        }
+
+        unsigned int k_;
+        std::vector<RankedMatch> matches_;
+        std::vector<L3DPP::Match> sorted_;
+    };
 
     //------------------------------------------------------------------------------
     // poinr on clustered 3D line
@@ -237,6 +334,8 @@ namespace L3DPP
         float distToBorder_;
     };
 
+    typedef std::list<L3DPP::PointOn3DLine,L3DPP::ArenaAllocator<L3DPP::PointOn3DLine> > PointOn3DLineList;
+
     static bool sortPointsOn3DLine(const L3DPP::PointOn3DLine p1, const L3DPP::PointOn3DLine p2)
     {
         return p1.distToBorder_ < p2.distToBorder_;
@@ -429,117 +429,141 @@ __global__ void K_collinearity(const float4* lines, char* C, const int stride,
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-__global__ void K_sparseMat_row_normalization(float4* data, const int* start_indices,
-                                              const int num_rows, const int num_entries)
+__global__ void K_sparseMat_row_normalization(float* values, const L3DPP::SparseOffset* row_offsets,
+                                              const int num_rows)
 {
     int x = blockIdx.x*blockDim.x + threadIdx.x;
     int y = blockIdx.y*blockDim.y + threadIdx.y;
 
     if(x == 0 && y < num_rows)
     {
-        int start = start_indices[y];
+        L3DPP::SparseOffset start = row_offsets[y];
+        L3DPP::SparseOffset end = row_offsets[y+1];
 
-        if(y >= 0)
-        {
-            // compute sum
-            float sum = 0.0f;
-            int i = start;
-            while(i < num_entries)
-            {
-                float4 e = data[i];
-                int row = e.x;
-
-                if(row != y)
-                    break;
-
-                sum += e.z;
-                ++i;
-            }
-
-            // check for precision errors
-            if(sum < L3D_EPS_GPU)
-                sum = L3D_EPS_GPU;
+        // compute sum
+        float sum = 0.0f;
+        for(L3DPP::SparseOffset i=start; i<end; ++i)
+            sum += values[i];
 
-            // normalize
-            i = start;
-            while(i < num_entries)
-            {
-                int row = data[i].x;
+        // check for precision errors
+        if(sum < L3D_EPS_GPU)
+            sum = L3D_EPS_GPU;
 
-                if(row != y)
-                    break;
+        // normalize
+        for(L3DPP::SparseOffset i=start; i<end; ++i)
+            values[i] /= sum;
+    }
+}
 
-                data[i].z /= sum;
-                ++i;
-            }
-        }
+////////////////////////////////////////////////////////////////////////////////
+__device__ float D_sparseMat_entry(const float* values, const L3DPP::SparseOffset* row_offsets,
+                                   const L3DPP::SparseIndex* col_indices,
+                                   const L3DPP::SparseIndex r, const L3DPP::SparseIndex c)
+{
+    // binary search in row r
+    L3DPP::SparseOffset lo = row_offsets[r];
+    L3DPP::SparseOffset hi = row_offsets[r+1];
+    while(lo < hi)
+    {
+        L3DPP::SparseOffset mid = lo+(hi-lo)/2;
+        if(col_indices[mid] < c)
+            lo = mid+1;
+        else
+            hi = mid;
     }
+
+    if(lo < row_offsets[r+1] && col_indices[lo] == c)
+        return values[lo];
+    else
+        return 0.0f;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-__global__ void K_sparseMat_diffusion_step(const float4* P, const float4* W,
-                                           const int* P_rows, const int* W_cols,
-                                           float4* P_prime, const int* P_prime_rows,
-                                           const int num_entries)
+__global__ void K_sparseMat_diffusion_step(const float* P, const float* W,
+                                           const L3DPP::SparseOffset* row_offsets,
+                                           const L3DPP::SparseIndex* col_indices,
+                                           const L3DPP::SparseOffset* col_offsets,
+                                           const L3DPP::SparseIndex* row_indices,
+                                           const L3DPP::SparseOffset* csc_entries,
+                                           float* P_prime, const int num_rows)
 {
     int x = blockIdx.x*blockDim.x + threadIdx.x;
     int y = blockIdx.y*blockDim.y + threadIdx.y;
 
-    if(x == 0 && y < num_entries)
+    if(x == 0 && y < num_rows)
     {
-        // get data
-        float4 data = P[y];
-
-        // transpose
-        int r = data.y;
-        int c = data.x;
-
-        // row[P]*col[W]
-        float mul = 0.0f;
-        int start_P = P_rows[r];
-        int start_W = W_cols[c];
-        while(start_P < num_entries && start_W < num_entries)
+        // P, W and P_prime share the same structure
+        L3DPP::SparseIndex r = y;
+        L3DPP::SparseOffset start = row_offsets[r];
+        L3DPP::SparseOffset end = row_offsets[r+1];
+
+        for(L3DPP::SparseOffset e=start; e<end; ++e)
         {
-            float4 d1 = P[start_P];
-            float4 d2 = W[start_W];
+            L3DPP::SparseIndex c = col_indices[e];
+
+            // row[P]*col[W] (merge over the common indices)
+            float mul = 0.0f;
+            L3DPP::SparseOffset i = start;
+            L3DPP::SparseOffset j = col_offsets[c];
+            L3DPP::SparseOffset j_end = col_offsets[c+1];
+            while(i < end && j < j_end)
+            {
+                L3DPP::SparseIndex k1 = col_indices[i];
+                L3DPP::SparseIndex k2 = row_indices[j];
 
-            int row1 = d1.x;
-            int col2 = d2.y;
+                if(k1 == k2)
+                {
+                    mul += P[i]*W[csc_entries[j]];
+                    ++i;
+                    ++j;
+                }
+                else if(k1 < k2)
+                {
+                    ++i;
+                }
+                else
+                {
+                    ++j;
+                }
+            }
 
-            if(row1 != r || col2 != c)
-                break;
+            // multiply with transposed
+            mul *= D_sparseMat_entry(P,row_offsets,col_indices,c,r);
 
-            mul += (d1.z*d2.z);
-            ++start_P;
-            ++start_W;
-        }
+            if(mul < L3D_EPS_GPU)
+                mul = L3D_EPS_GPU;
 
-        // multiply with transposed
-        mul *= data.z;
+            // store
+            P_prime[e] = mul;
+        }
+    }
+}
 
-        if(mul < L3D_EPS_GPU)
-            mul = L3D_EPS_GPU;
+////////////////////////////////////////////////////////////////////////////////
+__global__ void K_sparseMat_residual(const float* values, const float* values_prev,
+                                     const L3DPP::SparseOffset* row_offsets,
+                                     float* residuals, const int num_rows)
+{
+    int x = blockIdx.x*blockDim.x + threadIdx.x;
+    int y = blockIdx.y*blockDim.y + threadIdx.y;
 
-        // store
-        int s = P_prime_rows[r];
-        bool found = false;
-        while(s < num_entries && !found)
-        {
-            float4 dat = P_prime[s];
-            int row = dat.x;
-            int col = dat.y;
+    if(x == 0 && y < num_rows)
+    {
+        // row sum (values are not yet normalized)
+        float sum = 0.0f;
+        for(L3DPP::SparseOffset i=row_offsets[y]; i<row_offsets[y+1]; ++i)
+            sum += values[i];
 
-            if(row != r)
-                break;
+        // check for precision errors
+        if(sum < L3D_EPS_GPU)
+            sum = L3D_EPS_GPU;
 
-            if(col == c)
-            {
-                P_prime[s].z = mul;
-                found = true;
-            }
+        // max. change within the (normalized) row
+        float res = 0.0f;
+        for(L3DPP::SparseOffset i=row_offsets[y]; i<row_offsets[y+1]; ++i)
+            res = fmax(res,fabs(values[i]/sum-values_prev[i]));
 
-            ++s;
-        }
+        residuals[y] = res;
     }
 }
 
@@ -552,9 +576,10 @@ unsigned int match_lines_GPU(L3DPP::DataArray<float4>* lines_src,
                              L3DPP::DataArray<float>* RtKinv_src,
                              L3DPP::DataArray<float>* RtKinv_tgt,
                              const float3 C_src, const float3 C_tgt,
-                             std::vector<std::list<L3DPP::Match> >* matches,
+                             std::vector<L3DPP::MatchList>* matches,
                              const unsigned int srcCamID, const unsigned int tgtCamID,
-                             const float epi_overlap, const int kNN)
+                             const float epi_overlap, const int kNN,
+                             L3DPP::BufferPool* pool)
 {
     // init
     unsigned int block_size = L3D_BLOCK_SIZE;
@@ -568,8 +593,8 @@ unsigned int match_lines_GPU(L3DPP::DataArray<float4>* lines_src,
 
     // matching data
     int buffer_h = std::min(height,std::max(int(L3D_GPU_BUFFER_SIZE/width),1));
-    L3DPP::DataArray<float4>* buffer = new L3DPP::DataArray<float4>(width,buffer_h,true);
-    L3DPP::DataArray<float>* overlaps = new L3DPP::DataArray<float>(width,buffer_h,true);
+    L3DPP::DataArray<float4> buffer(width,buffer_h,pool,true);
+    L3DPP::DataArray<float> overlaps(width,buffer_h,pool,true);
 
     for(int offset_h = 0; offset_h < height; offset_h += buffer_h)
     {
@@ -577,17 +602,17 @@ unsigned int match_lines_GPU(L3DPP::DataArray<float4>* lines_src,
         dim3 dimGrid = dim3(divUp(width, dimBlock.x),
                             divUp(current_height, dimBlock.y));
 
-        L3DPP::K_match_lines <<< dimGrid, dimBlock >>> (width,current_height,offset_h,buffer->dataGPU(),
-                                                        buffer->strideGPU(),overlaps->dataGPU(),
-                                                        overlaps->strideGPU(),lines_src->dataGPU(),
+        L3DPP::K_match_lines <<< dimGrid, dimBlock >>> (width,current_height,offset_h,buffer.dataGPU(),
+                                                        buffer.strideGPU(),overlaps.dataGPU(),
+                                                        overlaps.strideGPU(),lines_src->dataGPU(),
                                                         lines_tgt->dataGPU(),
                                                         F->dataGPU(),RtKinv_src->dataGPU(),
                                                         RtKinv_tgt->dataGPU(),F->strideGPU(),
                                                         C_src,C_tgt,epi_overlap);
 
         // store results
-        buffer->download();
-        overlaps->download();
+        buffer.download();
+        overlaps.download();
 
 #ifdef L3DPP_OPENMP
         #pragma omp parallel for
@@ -595,16 +620,16 @@ unsigned int match_lines_GPU(L3DPP::DataArray<float4>* lines_src,
         for(size_t r=0; r<current_height; ++r)
         {
             unsigned int srcID = r+offset_h;
-            L3DPP::pairwise_matches scored_matches;
+            L3DPP::KNNMatches scored_matches(kNN > 0 ? kNN : 0);
             int new_matches = 0;
 
             for(size_t c=0; c<width; ++c)
             {
                 // check depths -> must be bigger 0 (in front of cameras)
-                float4 depths = buffer->dataCPU(c,r)[0];
+                float4 depths = buffer.dataCPU(c,r)[0];
                 if(depths.x > 0.0f && depths.y > 0.0f && depths.z > 0.0f && depths.w > 0.0f)
                 {
-                    float overlap = overlaps->dataCPU(c,r)[0];
+                    float overlap = overlaps.dataCPU(c,r)[0];
 
                     // potential match
                     L3DPP::Match M;
@@ -636,10 +661,10 @@ unsigned int match_lines_GPU(L3DPP::DataArray<float4>* lines_src,
             // push kNN matches into list
             if(kNN > 0)
             {
-                while(new_matches < kNN && !scored_matches.empty())
+                const std::vector<L3DPP::Match>& best = scored_matches.sorted();
+                for(size_t i=0; i<best.size(); ++i)
                 {
-                    matches->at(r).push_back(scored_matches.top());
-                    scored_matches.pop();
+                    matches->at(srcID).push_back(best[i]);
                     ++new_matches;
                 }
             }
@@ -650,10 +675,6 @@ unsigned int match_lines_GPU(L3DPP::DataArray<float4>* lines_src,
         }
     }
 
-    // cleanup
-    delete buffer;
-    delete overlaps;
-
     return num_matches;
 }
 
@@ -705,55 +726,81 @@ void find_collinear_segments_GPU(L3DPP::DataArray<char>* C,
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void replicator_dynamics_diffusion_GPU(L3DPP::SparseMatrix* &W, const std::string prefix)
+unsigned int replicator_dynamics_diffusion_GPU(L3DPP::SparseMatrix* &W, const unsigned int max_iter,
+                                               const float tolerance)
 {
     // init
     unsigned int block_size = L3D_BLOCK_SIZE;
     unsigned int num_rows_cols = W->num_rows_cols();
-    unsigned int num_entries = W->num_entries();
     dim3 dimBlock = dim3(1,block_size*block_size);
     dim3 dimGrid_RC = dim3(divUp(1, dimBlock.x),
                            divUp(num_rows_cols, dimBlock.y));
-    dim3 dimGrid = dim3(divUp(1, dimBlock.x),
-                        divUp(num_entries, dimBlock.y));
 
-    // create P matrix
-    L3DPP::SparseMatrix* P = new L3DPP::SparseMatrix(W,true);
+    if(W->num_entries() == 0)
+        return 0;
+
+    W->upload();
+
+    // create P matrix (same structure as W)
+    L3DPP::SparseMatrix* P = new L3DPP::SparseMatrix(W);
+    P->upload();
 
     // make copy of P
     L3DPP::SparseMatrix* P_prime = new L3DPP::SparseMatrix(P);
+    P_prime->upload();
+
+    // residual per row
+    L3DPP::DataArray<float>* residuals = new L3DPP::DataArray<float>(num_rows_cols,1,true);
 
     // row normalize
-    L3DPP::K_sparseMat_row_normalization <<< dimGrid_RC, dimBlock >>> (P->entries()->dataGPU(),
-                                                                       P->start_indices()->dataGPU(),
-                                                                       num_rows_cols,num_entries);
+    L3DPP::K_sparseMat_row_normalization <<< dimGrid_RC, dimBlock >>> (P->values_array()->dataGPU(),
+                                                                       P->row_offsets_array()->dataGPU(),
+                                                                       num_rows_cols);
 
     cudaDeviceSynchronize();
 
-    for(int i=0; i<L3D_DEF_RDD_MAX_ITER; ++i)
+    unsigned int iter = 0;
+    while(iter < max_iter)
     {
-        // diffusion
-        std::cout << prefix << "iteration: " << i << std::endl;
+        ++iter;
 
         // update
-        L3DPP::K_sparseMat_diffusion_step <<< dimGrid, dimBlock >>> (P->entries()->dataGPU(),W->entries()->dataGPU(),
-                                                                     P->start_indices()->dataGPU(),W->start_indices()->dataGPU(),
-                                                                     P_prime->entries()->dataGPU(),P_prime->start_indices()->dataGPU(),
-                                                                     num_entries);
+        L3DPP::K_sparseMat_diffusion_step <<< dimGrid_RC, dimBlock >>> (P->values_array()->dataGPU(),W->values_array()->dataGPU(),
+                                                                        W->row_offsets_array()->dataGPU(),W->col_indices_array()->dataGPU(),
+                                                                        W->col_offsets_array()->dataGPU(),W->row_indices_array()->dataGPU(),
+                                                                        W->csc_entries_array()->dataGPU(),
+                                                                        P_prime->values_array()->dataGPU(),num_rows_cols);
 
         cudaDeviceSynchronize();
 
-        // row normalize
+        // swap
         L3DPP::SparseMatrix* tmp = P;
         P = P_prime;
         P_prime = tmp;
 
-        if(i < L3D_DEF_RDD_MAX_ITER-1)
-        {
-            L3DPP::K_sparseMat_row_normalization <<< dimGrid_RC, dimBlock >>> (P->entries()->dataGPU(),
-                                                                               P->start_indices()->dataGPU(),
-                                                                               num_rows_cols,num_entries);
-        }
+        if(iter == max_iter)
+            break;
+
+        // check convergence
+        L3DPP::K_sparseMat_residual <<< dimGrid_RC, dimBlock >>> (P->values_array()->dataGPU(),
+                                                                  P_prime->values_array()->dataGPU(),
+                                                                  P->row_offsets_array()->dataGPU(),
+                                                                  residuals->dataGPU(),num_rows_cols);
+
+        cudaDeviceSynchronize();
+        residuals->download();
+
+        float residual = 0.0f;
+        for(unsigned int r=0; r<num_rows_cols; ++r)
+            residual = fmax(residual,residuals->dataCPU(r,0)[0]);
+
+        if(residual < tolerance)
+            break;
+
+        // row normalize
+        L3DPP::K_sparseMat_row_normalization <<< dimGrid_RC, dimBlock >>> (P->values_array()->dataGPU(),
+                                                                           P->row_offsets_array()->dataGPU(),
+                                                                           num_rows_cols);
 
         cudaDeviceSynchronize();
     }
@@ -763,6 +810,9 @@ void replicator_dynamics_diffusion_GPU(L3DPP::SparseMatrix* &W, const std::strin
     W = P;
 
     delete P_prime;
+    delete residuals;
+
+    return iter;
 }
 
 }
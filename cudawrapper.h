@@ -57,9 +57,10 @@ namespace L3DPP
                                         L3DPP::DataArray<float>* RtKinv_src,
                                         L3DPP::DataArray<float>* RtKinv_tgt,
                                         const float3 C_src, const float3 C_tgt,
-                                        std::vector<std::list<L3DPP::Match> >* matches,
+                                        std::vector<L3DPP::MatchList>* matches,
                                         const unsigned int srcCamID, const unsigned int tgtCamID,
-                                        const float epi_overlap, const int kNN);
+                                        const float epi_overlap, const int kNN,
+                                        L3DPP::BufferPool* pool=NULL);
 
     // scoring of matches
     extern void score_matches_GPU(L3DPP::DataArray<float4>* lines,
@@ -77,7 +78,9 @@ namespace L3DPP
                                             const float dist_t);
 
     // replicator dynamics diffusion [M.Donoser, BMVC'13]
-    extern void replicator_dynamics_diffusion_GPU(L3DPP::SparseMatrix* &W, const std::string prefix);
+    // (no pruning: the kernels update all entries of the fixed CSR structure)
+    extern unsigned int replicator_dynamics_diffusion_GPU(L3DPP::SparseMatrix* &W, const unsigned int max_iter,
+                                                          const float tolerance);
 }
 
 #endif //L3DPP_CUDA
@@ -22,10 +22,16 @@
 #include <boost/serialization/nvp.hpp>
 #include <boost/serialization/version.hpp>
 #include <boost/serialization/array.hpp>
+#include <boost/move/core.hpp>
+#include <boost/move/utility_core.hpp>
+#include <boost/thread/mutex.hpp>
 
 // std
 #include <vector>
+#include <list>
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
 
 /**
  * Line3D++ - DataArray CPU/GPU
@@ -33,6 +39,11 @@
  * DataArray that can be moved from CPU to GPU
  * and vice versa. Adapted from the ImageUtilities lib
  * by Manuel Werlberger.
+ *
+ * CPU rows are aligned for SIMD access, arrays
+ * are move-only (Boost.Move) and temporaries can
+ * take their memory from a BufferPool.
+ * Only for POD types (float, float4, int2, ...)!
  * ====================
  * Author: M.Hofer, 2015
  */
@@ -80,18 +91,215 @@ namespace boost
 
 namespace L3DPP
 {
+    // alignment of CPU rows [bytes]
+    const size_t L3D_DATAARRAY_ALIGNMENT = 32;
+    // max. number of idle buffers kept by a pool (per device)
+    const size_t L3D_BUFFERPOOL_MAX_IDLE = 16;
+
+    //------------------------------------------------------------------------------
+    // aligned CPU memory (original pointer is stored in front of the block)
+    inline void* alignedMalloc(const size_t bytes)
+    {
+        void* raw = malloc(bytes+L3D_DATAARRAY_ALIGNMENT+sizeof(void*));
+        if(raw == NULL)
+            return NULL;
+
+        size_t addr = reinterpret_cast<size_t>(raw)+sizeof(void*);
+        addr = (addr+L3D_DATAARRAY_ALIGNMENT-1) & ~(L3D_DATAARRAY_ALIGNMENT-1);
+        void* aligned = reinterpret_cast<void*>(addr);
+        reinterpret_cast<void**>(aligned)[-1] = raw;
+        return aligned;
+    }
+
+    inline void alignedFree(void* ptr)
+    {
+        if(ptr != NULL)
+            free(reinterpret_cast<void**>(ptr)[-1]);
+    }
+
+    //------------------------------------------------------------------------------
+    // pool for temporary CPU/GPU buffers (thread-safe), reuses
+    // buffers that are at least as big as requested (and at most twice)
+    class BufferPool
+    {
+    public:
+        BufferPool(){}
+        ~BufferPool(){clear();}
+
+        // CPU buffers (aligned)
+        void* acquireCPU(const size_t bytes, size_t& capacity)
+        {
+            mutex_.lock();
+            std::list<Buffer>::iterator it = cpu_.begin();
+            for(; it!=cpu_.end(); ++it)
+            {
+                if(it->bytes_ >= bytes && it->bytes_ <= 2*bytes)
+                {
+                    void* ptr = it->ptr_;
+                    capacity = it->bytes_;
+                    cpu_.erase(it);
+                    mutex_.unlock();
+                    return ptr;
+                }
+            }
+            mutex_.unlock();
+
+            capacity = bytes;
+            return alignedMalloc(bytes);
+        }
+
+        void releaseCPU(void* ptr, const size_t capacity)
+        {
+            if(ptr == NULL)
+                return;
+
+            mutex_.lock();
+            cpu_.push_front(Buffer(ptr,capacity,0,0));
+            if(cpu_.size() > L3D_BUFFERPOOL_MAX_IDLE)
+            {
+                alignedFree(cpu_.back().ptr_);
+                cpu_.pop_back();
+            }
+            mutex_.unlock();
+        }
+
+#ifdef L3DPP_CUDA
+        // GPU buffers (pitched)
+        void* acquireGPU(const size_t width_bytes, const size_t height,
+                         size_t& pitch, size_t& rows)
+        {
+            mutex_.lock();
+            std::list<Buffer>::iterator it = gpu_.begin();
+            for(; it!=gpu_.end(); ++it)
+            {
+                if(it->pitch_ >= width_bytes && it->rows_ >= height &&
+                        it->bytes_ <= 2*width_bytes*height)
+                {
+                    void* ptr = it->ptr_;
+                    pitch = it->pitch_;
+                    rows = it->rows_;
+                    gpu_.erase(it);
+                    mutex_.unlock();
+                    return ptr;
+                }
+            }
+            mutex_.unlock();
+
+            void* ptr = NULL;
+            if(cudaMallocPitch(&ptr,&pitch,width_bytes,height) != cudaSuccess)
+            {
+                // free idle buffers and try again
+                clear();
+                if(cudaMallocPitch(&ptr,&pitch,width_bytes,height) != cudaSuccess)
+                    return NULL;
+            }
+
+            rows = height;
+            return ptr;
+        }
+
+        void releaseGPU(void* ptr, const size_t pitch, const size_t rows)
+        {
+            if(ptr == NULL)
+                return;
+
+            mutex_.lock();
+            gpu_.push_front(Buffer(ptr,pitch*rows,pitch,rows));
+            if(gpu_.size() > L3D_BUFFERPOOL_MAX_IDLE)
+            {
+                cudaFree(gpu_.back().ptr_);
+                gpu_.pop_back();
+            }
+            mutex_.unlock();
+        }
+#endif //L3DPP_CUDA
+
+        // free all idle buffers
+        void clear()
+        {
+            mutex_.lock();
+            std::list<Buffer>::iterator it = cpu_.begin();
+            for(; it!=cpu_.end(); ++it)
+                alignedFree(it->ptr_);
+            cpu_.clear();
+#ifdef L3DPP_CUDA
+            for(it=gpu_.begin(); it!=gpu_.end(); ++it)
+                cudaFree(it->ptr_);
+            gpu_.clear();
+#endif //L3DPP_CUDA
+            mutex_.unlock();
+        }
+
+    private:
+        struct Buffer
+        {
+            Buffer(void* ptr, size_t bytes, size_t pitch, size_t rows) :
+                ptr_(ptr), bytes_(bytes), pitch_(pitch), rows_(rows){}
+
+            void* ptr_;
+            size_t bytes_;
+            size_t pitch_;
+            size_t rows_;
+        };
+
+        boost::mutex mutex_;
+        // most recently released first
+        std::list<Buffer> cpu_;
+        std::list<Buffer> gpu_;
+
+        // no copies
+        BufferPool(const BufferPool&);
+        BufferPool& operator=(const BufferPool&);
+    };
+
+    //------------------------------------------------------------------------------
+    // non-owning 2D view on CPU memory (e.g. a DataArray or
+    // memory-mapped data), no bounds checks!
+    template <class PixelType>
+    class DataSpan
+    {
+    public:
+        DataSpan() : data_(NULL), width_(0), height_(0), stride_(0){}
+        DataSpan(PixelType* data, const unsigned int width,
+                 const unsigned int height=1, const size_t stride=0) :
+            data_(data), width_(width), height_(height),
+            stride_((stride > 0) ? stride : width){}
+
+        // data access
+        PixelType* data(unsigned int x=0,
+                        unsigned int y=0) const {return data_+y*stride_+x;}
+
+        // basics
+        unsigned int width() const {return width_;}
+        unsigned int height() const {return height_;}
+        size_t stride() const {return stride_;}
+        bool empty() const {return (data_ == NULL || width_ == 0 || height_ == 0);}
+
+    private:
+        PixelType* data_;
+        unsigned int width_;
+        unsigned int height_;
+        size_t stride_;
+    };
+
+    //------------------------------------------------------------------------------
     // floatN array (2D)
     template <class PixelType>
     class DataArray
     {
+        BOOST_MOVABLE_BUT_NOT_COPYABLE(DataArray)
+
     public:
         DataArray()
         {
             width_ = 0;
             height_ = 0;
             real_width_ = 0;
+            pool_ = NULL;
 
             // CPU
+            dataCPU_ = NULL;
+            capacityCPU_ = 0;
             pitchCPU_ = 0;
             strideCPU_ = 0;
 
@@ -99,72 +307,66 @@ namespace L3DPP
             dataGPU_ = NULL;
             pitchGPU_ = 0;
             strideGPU_ = 0;
+            rowsGPU_ = 0;
         }
 
         DataArray(unsigned int width,
                   unsigned int height,
                   const bool allocate_GPU_memory=false,
                   const std::vector<PixelType>& data=std::vector<PixelType>()) :
-            width_(width), height_(height)
+            width_(width), height_(height), pool_(NULL)
         {
-            // pitch (CPU)
-            pitchCPU_ = width_*sizeof(PixelType);
-
-            unsigned int elements2pitch;
-            if(pitchCPU_ % 32 == 0)
-                elements2pitch = 0;
-            else
-                elements2pitch = (32-(pitchCPU_ % 32))/sizeof(PixelType);
-
-            width += elements2pitch;
-            pitchCPU_ = width*sizeof(PixelType);
-            strideCPU_ = pitchCPU_/sizeof(PixelType);
-            real_width_ = width;
+            init(allocate_GPU_memory,data);
+        }
 
-            // CPU --> stored line by line
-            dataCPU_ = std::vector<PixelType>(width*height_);
-            if(data.size() == width_*height_)
-            {
-                for(unsigned int h=0; h<height_; ++h)
-                    for(unsigned int w=0; w<width_; ++w)
-                        dataCPU(w,h)[0] = data[h*width_+w];
-            }
+        // temporary array, memory from a buffer pool
+        DataArray(unsigned int width,
+                  unsigned int height,
+                  L3DPP::BufferPool* pool,
+                  const bool allocate_GPU_memory=false) :
+            width_(width), height_(height), pool_(pool)
+        {
+            init(allocate_GPU_memory,std::vector<PixelType>());
+        }
 
-            // GPU
-            dataGPU_ = NULL;
-            pitchGPU_ = 0;
-            strideGPU_ = 0;
+        // move
+        DataArray(BOOST_RV_REF(DataArray) other)
+        {
+            steal(other);
+        }
 
-#ifdef L3DPP_CUDA
-            if(allocate_GPU_memory)
+        DataArray& operator=(BOOST_RV_REF(DataArray) other)
+        {
+            if(this != &other)
             {
-                allocateGPU();
-
-                if(data.size() == width_*height_)
-                {
-                    upload();
-                }
+                release();
+                steal(other);
             }
-#endif //L3DPP_CUDA
+            return *this;
         }
 
         ~DataArray()
         {
-#ifdef L3DPP_CUDA
-            // delete GPU data
-            removeFromGPU();
-#endif //L3DPP_CUDA
+            release();
         }
 
         // data access
         PixelType* dataCPU(unsigned int x=0,
                            unsigned int y=0){
-            if(dataCPU_.size() > 0 && x < width_ && y < height_)
+            if(dataCPU_ != NULL && x < width_ && y < height_)
                 return &dataCPU_[y*strideCPU_+x];
             else
                 return NULL;
         }
 
+        // view on the CPU data (unchecked access, rows are aligned)
+        L3DPP::DataSpan<PixelType> span(){
+            return L3DPP::DataSpan<PixelType>(dataCPU_,width_,height_,strideCPU_);
+        }
+        L3DPP::DataSpan<const PixelType> span() const {
+            return L3DPP::DataSpan<const PixelType>(dataCPU_,width_,height_,strideCPU_);
+        }
+
 #ifdef L3DPP_CUDA
         PixelType* dataGPU(unsigned int x=0,
                            unsigned int y=0)
@@ -191,7 +393,7 @@ namespace L3DPP
             if(dataGPU_ != NULL)
             {
                 cudaError_t status = cudaMemcpy2D(dataGPU_,pitchGPU_,
-                                                  &dataCPU_[0],pitchCPU_,
+                                                  dataCPU_,pitchCPU_,
                                                   width_*sizeof(PixelType),height_,
                                                   cudaMemcpyHostToDevice);
 
@@ -213,7 +415,7 @@ namespace L3DPP
             // device -> host
             if(dataGPU_ != NULL)
             {
-                cudaError_t status = cudaMemcpy2D(&dataCPU_[0],pitchCPU_,
+                cudaError_t status = cudaMemcpy2D(dataCPU_,pitchCPU_,
                                                   dataGPU_,pitchGPU_,
                                                   width_*sizeof(PixelType),height_,
                                                   cudaMemcpyDeviceToHost);
@@ -229,16 +431,24 @@ namespace L3DPP
         {
             if(dataGPU_ != NULL)
             {
-                cudaError_t status = cudaFree((void *)dataGPU_);
-
-                if(status != cudaSuccess)
+                if(pool_ != NULL)
                 {
-                    std::cerr << "DataArray::removeFromGPU(): could not remove data from GPU...[" << cudaGetErrorString(status) << "]" << std::endl;
+                    pool_->releaseGPU(dataGPU_,pitchGPU_,rowsGPU_);
+                }
+                else
+                {
+                    cudaError_t status = cudaFree((void *)dataGPU_);
+
+                    if(status != cudaSuccess)
+                    {
+                        std::cerr << "DataArray::removeFromGPU(): could not remove data from GPU...[" << cudaGetErrorString(status) << "]" << std::endl;
+                    }
                 }
 
                 dataGPU_ = NULL;
                 pitchGPU_ = 0;
                 strideGPU_ = 0;
+                rowsGPU_ = 0;
             }
         }
 #endif //L3DPP_CUDA
@@ -246,7 +456,8 @@ namespace L3DPP
         // set constant value (CPU only!)
         void setValue(const PixelType p, const bool uploadToGPU=false)
         {
-            for(unsigned int i=0; i<dataCPU_.size(); ++i)
+            size_t num = size_t(real_width_)*size_t(height_);
+            for(size_t i=0; i<num; ++i)
                 dataCPU_[i] = p;
 
 #ifdef L3DPP_CUDA
@@ -300,6 +511,130 @@ namespace L3DPP
         size_t bytes() const {return height_*pitchCPU_;}
 
     private:
+        // pitch and CPU memory
+        void init(const bool allocate_GPU_memory,
+                  const std::vector<PixelType>& data)
+        {
+            // pitch (CPU) -> rows start aligned
+            pitchCPU_ = width_*sizeof(PixelType);
+
+            unsigned int elements2pitch;
+            if(pitchCPU_ % L3D_DATAARRAY_ALIGNMENT == 0)
+                elements2pitch = 0;
+            else
+                elements2pitch = (L3D_DATAARRAY_ALIGNMENT-(pitchCPU_ % L3D_DATAARRAY_ALIGNMENT))/sizeof(PixelType);
+
+            unsigned int width = width_+elements2pitch;
+            pitchCPU_ = width*sizeof(PixelType);
+            strideCPU_ = pitchCPU_/sizeof(PixelType);
+            real_width_ = width;
+
+            // CPU --> stored line by line
+            allocateCPU();
+            if(data.size() == width_*height_)
+            {
+                for(unsigned int h=0; h<height_; ++h)
+                    for(unsigned int w=0; w<width_; ++w)
+                        dataCPU(w,h)[0] = data[h*width_+w];
+            }
+
+            // GPU
+            dataGPU_ = NULL;
+            pitchGPU_ = 0;
+            strideGPU_ = 0;
+            rowsGPU_ = 0;
+
+#ifdef L3DPP_CUDA
+            if(allocate_GPU_memory)
+            {
+                allocateGPU();
+
+                if(data.size() == width_*height_)
+                {
+                    upload();
+                }
+            }
+#endif //L3DPP_CUDA
+        }
+
+        // allocate (zero initialized) CPU memory
+        void allocateCPU()
+        {
+            dataCPU_ = NULL;
+            capacityCPU_ = 0;
+
+            size_t bytes = size_t(height_)*pitchCPU_;
+            if(bytes == 0)
+                return;
+
+            if(pool_ != NULL)
+                dataCPU_ = static_cast<PixelType*>(pool_->acquireCPU(bytes,capacityCPU_));
+            else
+            {
+                dataCPU_ = static_cast<PixelType*>(L3DPP::alignedMalloc(bytes));
+                capacityCPU_ = bytes;
+            }
+
+            if(dataCPU_ == NULL)
+            {
+                std::cerr << "DataArray::allocateCPU(): CPU memory could not be allocated..." << std::endl;
+                capacityCPU_ = 0;
+                return;
+            }
+
+            memset(dataCPU_,0,bytes);
+        }
+
+        // free all memory
+        void release()
+        {
+#ifdef L3DPP_CUDA
+            // delete GPU data
+            removeFromGPU();
+#endif //L3DPP_CUDA
+
+            if(dataCPU_ != NULL)
+            {
+                if(pool_ != NULL)
+                    pool_->releaseCPU(dataCPU_,capacityCPU_);
+                else
+                    L3DPP::alignedFree(dataCPU_);
+
+                dataCPU_ = NULL;
+                capacityCPU_ = 0;
+            }
+        }
+
+        // take over memory (other is empty afterwards)
+        void steal(DataArray& other)
+        {
+            width_ = other.width_;
+            height_ = other.height_;
+            real_width_ = other.real_width_;
+            pool_ = other.pool_;
+
+            dataCPU_ = other.dataCPU_;
+            capacityCPU_ = other.capacityCPU_;
+            pitchCPU_ = other.pitchCPU_;
+            strideCPU_ = other.strideCPU_;
+
+            dataGPU_ = other.dataGPU_;
+            pitchGPU_ = other.pitchGPU_;
+            strideGPU_ = other.strideGPU_;
+            rowsGPU_ = other.rowsGPU_;
+
+            other.width_ = 0;
+            other.height_ = 0;
+            other.real_width_ = 0;
+            other.dataCPU_ = NULL;
+            other.capacityCPU_ = 0;
+            other.pitchCPU_ = 0;
+            other.strideCPU_ = 0;
+            other.dataGPU_ = NULL;
+            other.pitchGPU_ = 0;
+            other.strideGPU_ = 0;
+            other.rowsGPU_ = 0;
+        }
 
 #ifdef L3DPP_CUDA
         // allocate GPU memory
@@ -311,8 +646,21 @@ namespace L3DPP
             if(width_ > 0 && height_ > 0)
             {
                 dataGPU_ = 0;
-                cudaError_t status = cudaMallocPitch((void **)&dataGPU_, &pitchGPU_,
-                                                     width_*sizeof(PixelType), height_);
+                cudaError_t status = cudaSuccess;
+
+                if(pool_ != NULL)
+                {
+                    dataGPU_ = static_cast<PixelType*>(pool_->acquireGPU(width_*sizeof(PixelType),height_,
+                                                                         pitchGPU_,rowsGPU_));
+                    if(dataGPU_ == NULL)
+                        status = cudaErrorMemoryAllocation;
+                }
+                else
+                {
+                    status = cudaMallocPitch((void **)&dataGPU_, &pitchGPU_,
+                                             width_*sizeof(PixelType), height_);
+                    rowsGPU_ = height_;
+                }
 
                 if(status != cudaSuccess)
                 {
@@ -320,6 +668,7 @@ namespace L3DPP
                     dataGPU_ = NULL;
                     pitchGPU_ = 0;
                     strideGPU_ = 0;
+                    rowsGPU_ = 0;
                     return;
                 }
 
@@ -338,9 +687,11 @@ namespace L3DPP
         unsigned int width_;
         unsigned int height_;
         unsigned int real_width_;
+        L3DPP::BufferPool* pool_;
 
         // CPU
-        std::vector<PixelType> dataCPU_;
+        PixelType* dataCPU_;
+        size_t capacityCPU_;
         size_t pitchCPU_;
         size_t strideCPU_;
 
@@ -348,6 +699,7 @@ namespace L3DPP
         PixelType* dataGPU_;
         size_t pitchGPU_;
         size_t strideGPU_;
+        size_t rowsGPU_;
 
         // serialization
         friend class boost::serialization::access;
@@ -364,13 +716,15 @@ namespace L3DPP
 
             if(Archive::is_loading::value)
             {
+                release();
                 dataGPU_ = NULL;
                 pitchGPU_ = 0;
                 strideGPU_ = 0;
-                dataCPU_ = std::vector<PixelType>(real_width_*height_);
+                rowsGPU_ = 0;
+                allocateCPU();
             }
 
-            ar & boost::serialization::make_array<PixelType>(&dataCPU_[0],dataCPU_.size());
+            ar & boost::serialization::make_array<PixelType>(dataCPU_,size_t(real_width_)*size_t(height_));
         }
     };
 }
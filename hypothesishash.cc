@@ -0,0 +1,111 @@
+#include "hypothesishash.h"
+
+namespace L3DPP
+{
+    //------------------------------------------------------------------------------
+    void HypothesisHash::build(const std::vector<float>& depths_p1,
+                               const std::vector<float>& depths_p2,
+                               const float cell_size)
+    {
+        build(depths_p1,depths_p2,std::vector<float>(),cell_size,180.0f);
+    }
+
+    //------------------------------------------------------------------------------
+    void HypothesisHash::build(const std::vector<float>& depths_p1,
+                               const std::vector<float>& depths_p2,
+                               const std::vector<float>& angles,
+                               const float cell_size, const float angle_cell_size)
+    {
+        clear();
+        cell_size_ = cell_size;
+
+        // angle cells of equal size (at most one per degree)
+        num_angle_cells_ = 1;
+        if(angles.size() == depths_p1.size() && angle_cell_size > 0.0f && angle_cell_size < 180.0f)
+            num_angle_cells_ = std::min(std::max(int(180.0f/angle_cell_size),1),180);
+
+        angle_cell_size_ = 180.0f/float(num_angle_cells_);
+
+        entries_.resize(depths_p1.size());
+        for(size_t i=0; i<depths_p1.size(); ++i)
+        {
+            entries_[i].c1_ = cell(depths_p1[i]);
+            entries_[i].c2_ = cell(depths_p2[i]);
+            entries_[i].ca_ = (num_angle_cells_ > 1) ? angleCell(angles[i]) : 0;
+            entries_[i].id_ = i;
+        }
+
+        std::sort(entries_.begin(),entries_.end());
+    }
+
+    //------------------------------------------------------------------------------
+    void HypothesisHash::clear()
+    {
+        entries_.clear();
+    }
+
+    //------------------------------------------------------------------------------
+    void HypothesisHash::query(const float d1, const float d2,
+                               const float r1, const float r2,
+                               std::vector<unsigned int>& result) const
+    {
+        query(d1,d2,r1,r2,0.0f,180.0f,result);
+    }
+
+    //------------------------------------------------------------------------------
+    void HypothesisHash::query(const float d1, const float d2,
+                               const float r1, const float r2,
+                               const float angle, const float r_angle,
+                               std::vector<unsigned int>& result) const
+    {
+        result.clear();
+        if(entries_.size() == 0)
+            return;
+
+        int c1_min = cell(d1-r1);
+        int c1_max = cell(d1+r1);
+        int c2_min = cell(d2-r2);
+        int c2_max = cell(d2+r2);
+
+        // clamp to the occupied cells
+        c1_min = std::max(c1_min,entries_.front().c1_);
+        c1_max = std::min(c1_max,entries_.back().c1_);
+
+        // angle cells [ca_min,ca_min+ca_range] (modulo the number of cells)
+        int ca_min = 0;
+        int ca_range = num_angle_cells_;
+        if(num_angle_cells_ > 1 && r_angle < 90.0f)
+        {
+            ca_min = angleCell(angle-r_angle);
+            ca_range = int(floor((angle+r_angle)/angle_cell_size_))-int(floor((angle-r_angle)/angle_cell_size_));
+        }
+        bool all_angles = (ca_range >= int(num_angle_cells_)-1);
+
+        Entry key;
+        key.ca_ = 0;
+        key.id_ = 0;
+        for(int c1=c1_min; c1<=c1_max; ++c1)
+        {
+            key.c1_ = c1;
+            key.c2_ = c2_min;
+            std::vector<Entry>::const_iterator it = std::lower_bound(entries_.begin(),entries_.end(),key);
+            if(it == entries_.end())
+                break;
+
+            if(it->c1_ > c1)
+            {
+                // skip empty cells
+                c1 = it->c1_-1;
+                continue;
+            }
+
+            for(; it!=entries_.end() && it->c1_ == c1 && it->c2_ <= c2_max; ++it)
+            {
+                if(all_angles || (it->ca_-ca_min+int(num_angle_cells_))%int(num_angle_cells_) <= ca_range)
+                    result.push_back(it->id_);
+            }
+        }
+
+        std::sort(result.begin(),result.end());
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef I3D_LINE3D_PP_HYPOTHESISHASH_H_
+#define I3D_LINE3D_PP_HYPOTHESISHASH_H_
+
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * Line3D++ - HypothesisHash
+ * ====================
+ * Grid hash over the 3D hypotheses of one
+ * 2D segment, quantized by their endpoint
+ * depths and (optionally) by their direction.
+ * All hypotheses of a segment lie in its
+ * viewing plane, i.e. the direction is a
+ * single (undirected) angle in this plane.
+ * Used for scoring (only nearby and almost
+ * parallel hypotheses can be similar).
+ * ====================
+ */
+
+namespace L3DPP
+{
+    //------------------------------------------------------------------------------
+    class HypothesisHash
+    {
+    public:
+        HypothesisHash() : cell_size_(1.0f), num_angle_cells_(1),
+            angle_cell_size_(180.0f){}
+
+        // hashes all hypotheses (ID = position in the depth vectors),
+        // cell_size > 0 (in depth units)
+        void build(const std::vector<float>& depths_p1,
+                   const std::vector<float>& depths_p2,
+                   const float cell_size);
+        // with direction: angles in [0,180) (degrees, within the
+        // viewing plane), angle_cell_size > 0 (>= 180 -> depths only)
+        void build(const std::vector<float>& depths_p1,
+                   const std::vector<float>& depths_p2,
+                   const std::vector<float>& angles,
+                   const float cell_size, const float angle_cell_size);
+        void clear();
+
+        // all hypotheses in the cells overlapping
+        // [d1-r1,d1+r1] x [d2-r2,d2+r2] (superset, sorted by ID)
+        void query(const float d1, const float d2,
+                   const float r1, const float r2,
+                   std::vector<unsigned int>& result) const;
+        // ... and [angle-r_angle,angle+r_angle] (modulo 180 degrees)
+        void query(const float d1, const float d2,
+                   const float r1, const float r2,
+                   const float angle, const float r_angle,
+                   std::vector<unsigned int>& result) const;
+
+        // data access
+        size_t size() const {return entries_.size();}
+        float cell_size() const {return cell_size_;}
+        unsigned int num_angle_cells() const {return num_angle_cells_;}
+
+    private:
+        struct Entry
+        {
+            int c1_;
+            int c2_;
+            int ca_;
+            unsigned int id_;
+
+            bool operator<(const Entry& rhs) const
+            {
+                if(c1_ != rhs.c1_)
+                    return (c1_ < rhs.c1_);
+                if(c2_ != rhs.c2_)
+                    return (c2_ < rhs.c2_);
+                return (id_ < rhs.id_);
+            }
+        };
+
+        int cell(const float d) const
+        {
+            return int(floor(d/cell_size_));
+        }
+
+        int angleCell(const float angle) const
+        {
+            int c = int(floor(angle/angle_cell_size_))%int(num_angle_cells_);
+            return (c < 0) ? c+int(num_angle_cells_) : c;
+        }
+
+        float cell_size_;
+        unsigned int num_angle_cells_;
+        float angle_cell_size_;
+
+        // sorted by cell (row major)
+        std::vector<Entry> entries_;
+    };
+}
+
+#endif //I3D_LINE3D_PP_HYPOTHESISHASH_H_
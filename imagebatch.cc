@@ -0,0 +1,114 @@
+#include "imagebatch.h"
+
+namespace L3DPP
+{
+    //------------------------------------------------------------------------------
+    ImageBatch::ImageBatch(L3DPP::ImageProvider* provider) : provider_(provider)
+    {
+        wps_offsets_.push_back(0);
+        segment_offsets_.push_back(0);
+    }
+
+    //------------------------------------------------------------------------------
+    void ImageBatch::reserve(const size_t num_images, const size_t num_wps_or_neighbors)
+    {
+        camIDs_.reserve(num_images);
+        images_.reserve(num_images);
+        K_.reserve(num_images);
+        R_.reserve(num_images);
+        t_.reserve(num_images);
+        median_depths_.reserve(num_images);
+        dist_coeffs_.reserve(num_images);
+        has_keypoints_.reserve(num_images);
+        wps_offsets_.reserve(num_images+1);
+        segment_offsets_.reserve(num_images+1);
+        wps_.reserve(num_wps_or_neighbors);
+    }
+
+    //------------------------------------------------------------------------------
+    void ImageBatch::add(const unsigned int camID, const cv::Mat& image,
+                         const Eigen::Matrix3d& K, const Eigen::Matrix3d& R,
+                         const Eigen::Vector3d& t, const float median_depth,
+                         const unsigned int* wps_or_neighbors, const size_t num_wps_or_neighbors,
+                         const cv::Vec4f* line_segments, const size_t num_line_segments,
+                         const Eigen::Vector3d& radial_coeffs,
+                         const Eigen::Vector2d& tangential_coeffs)
+    {
+        camIDs_.push_back(camID);
+        images_.push_back(image);
+        K_.push_back(K);
+        R_.push_back(R);
+        t_.push_back(t);
+        median_depths_.push_back(median_depth);
+        dist_coeffs_.push_back(L3DPP::distortionCoeffs(radial_coeffs,tangential_coeffs));
+        has_keypoints_.push_back(false);
+
+        if(wps_or_neighbors != NULL)
+            wps_.insert(wps_.end(),wps_or_neighbors,wps_or_neighbors+num_wps_or_neighbors);
+        wps_offsets_.push_back(wps_.size());
+
+        if(line_segments != NULL)
+            segments_.insert(segments_.end(),line_segments,line_segments+num_line_segments);
+        segment_offsets_.push_back(segments_.size());
+    }
+
+    //------------------------------------------------------------------------------
+    void ImageBatch::setKeypoints(const Eigen::Vector2f* positions)
+    {
+        if(camIDs_.size() == 0 || positions == NULL)
+            return;
+
+        const size_t i = camIDs_.size()-1;
+        keypoints_.resize(wps_.size(),Eigen::Vector2f(0.0f,0.0f));
+        std::copy(positions,positions+(wps_offsets_[i+1]-wps_offsets_[i]),
+                  keypoints_.begin()+wps_offsets_[i]);
+        has_keypoints_[i] = true;
+    }
+
+    //------------------------------------------------------------------------------
+    void ImageBatch::clear()
+    {
+        camIDs_.clear();
+        images_.clear();
+        K_.clear();
+        R_.clear();
+        t_.clear();
+        median_depths_.clear();
+        dist_coeffs_.clear();
+        has_keypoints_.clear();
+        keypoints_.clear();
+        wps_offsets_ = std::vector<size_t>(1,0);
+        wps_.clear();
+        segment_offsets_ = std::vector<size_t>(1,0);
+        segments_.clear();
+    }
+
+    //------------------------------------------------------------------------------
+    const unsigned int* ImageBatch::wps_or_neighbors(const size_t i, size_t& num) const
+    {
+        num = wps_offsets_[i+1]-wps_offsets_[i];
+        if(num == 0)
+            return NULL;
+
+        return &wps_[wps_offsets_[i]];
+    }
+
+    //------------------------------------------------------------------------------
+    const Eigen::Vector2f* ImageBatch::keypoints(const size_t i) const
+    {
+        if(!has_keypoints_[i] || wps_offsets_[i+1] == wps_offsets_[i])
+            return NULL;
+
+        return &keypoints_[wps_offsets_[i]];
+    }
+
+    //------------------------------------------------------------------------------
+    const cv::Vec4f* ImageBatch::line_segments(const size_t i, size_t& num) const
+    {
+        num = segment_offsets_[i+1]-segment_offsets_[i];
+        if(num == 0)
+            return NULL;
+
+        return &segments_[segment_offsets_[i]];
+    }
+}
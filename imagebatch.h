@@ -0,0 +1,149 @@
+#ifndef I3D_LINE3D_PP_IMAGEBATCH_H_
+#define I3D_LINE3D_PP_IMAGEBATCH_H_
+
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+// external
+#include "eigen3/Eigen/Eigen"
+
+// opencv
+#ifndef L3DPP_OPENCV3
+#include "opencv/cv.h"
+#else
+#include "opencv2/core.hpp"
+#endif //L3DPP_OPENCV3
+
+// internal
+#include "commons.h"
+
+/**
+ * Line3D++ - ImageBatch
+ * ====================
+ * Images (camera parameters, worldpoints
+ * or neighbors, optional 2D segments) for
+ * Line3D::addImages(...), optionally with
+ * the 2D positions of the worldpoints. All
+ * lists are stored in compact arrays, images
+ * can be loaded on demand by an ImageProvider.
+ * ====================
+ */
+
+namespace L3DPP
+{
+    //------------------------------------------------------------------------------
+    // loads images on demand (during Line3D::addImages(...))
+    class ImageProvider
+    {
+    public:
+        virtual ~ImageProvider(){}
+
+        // loads the image of a camera (CV_8U or CV_8UC3), returns false on failure
+        // [called from multiple threads at once!]
+        virtual bool load(const unsigned int camID, cv::Mat& image) = 0;
+    };
+
+    // distortion coefficients in OpenCV order (empty if there is no distortion)
+    inline Eigen::VectorXd distortionCoeffs(const Eigen::Vector3d& radial_coeffs,
+                                            const Eigen::Vector2d& tangential_coeffs)
+    {
+        Eigen::VectorXd dist_coeffs;
+        if(radial_coeffs.cwiseAbs().maxCoeff() > L3D_EPS ||
+                tangential_coeffs.cwiseAbs().maxCoeff() > L3D_EPS)
+        {
+            dist_coeffs = Eigen::VectorXd(5);
+            dist_coeffs << radial_coeffs.x(),radial_coeffs.y(),
+                    tangential_coeffs.x(),tangential_coeffs.y(),
+                    radial_coeffs.z();
+        }
+        return dist_coeffs;
+    }
+
+    //------------------------------------------------------------------------------
+    class ImageBatch
+    {
+    public:
+        // provider - loads all images that are added without image data (not owned!)
+        ImageBatch(L3DPP::ImageProvider* provider=NULL);
+
+        // preallocation
+        void reserve(const size_t num_images, const size_t num_wps_or_neighbors=0);
+
+        // adds an image (same parameters as Line3D::addImage(...))
+        // image            - the image itself (empty -> loaded by the provider)
+        // wps_or_neighbors - worldpoint IDs (or neighbor IDs) as an array
+        // line_segments    - given 2D line segments (NULL -> LSD)
+        // radial_coeffs/tangential_coeffs - distortion (zero -> undistorted image)
+        void add(const unsigned int camID, const cv::Mat& image,
+                 const Eigen::Matrix3d& K, const Eigen::Matrix3d& R,
+                 const Eigen::Vector3d& t, const float median_depth,
+                 const unsigned int* wps_or_neighbors, const size_t num_wps_or_neighbors,
+                 const cv::Vec4f* line_segments=NULL, const size_t num_line_segments=0,
+                 const Eigen::Vector3d& radial_coeffs=Eigen::Vector3d::Zero(),
+                 const Eigen::Vector2d& tangential_coeffs=Eigen::Vector2d::Zero());
+
+        // 2D positions of the worldpoints of the last added image
+        // (one per entry of wps_or_neighbors, only for neighbors_by_worldpoints=true)
+        void setKeypoints(const Eigen::Vector2f* positions);
+
+        void clear();
+
+        // data access
+        size_t size() const {return camIDs_.size();}
+        L3DPP::ImageProvider* provider() const {return provider_;}
+        const std::vector<unsigned int>& camIDs() const {return camIDs_;}
+        unsigned int camID(const size_t i) const {return camIDs_[i];}
+        const cv::Mat& image(const size_t i) const {return images_[i];}
+        const Eigen::Matrix3d& K(const size_t i) const {return K_[i];}
+        const Eigen::Matrix3d& R(const size_t i) const {return R_[i];}
+        const Eigen::Vector3d& t(const size_t i) const {return t_[i];}
+        float median_depth(const size_t i) const {return median_depths_[i];}
+        const Eigen::VectorXd& dist_coeffs(const size_t i) const {return dist_coeffs_[i];}
+
+        // lists (NULL if empty)
+        const unsigned int* wps_or_neighbors(const size_t i, size_t& num) const;
+        const cv::Vec4f* line_segments(const size_t i, size_t& num) const;
+        // (same size as wps_or_neighbors(...))
+        const Eigen::Vector2f* keypoints(const size_t i) const;
+
+    private:
+        L3DPP::ImageProvider* provider_;
+
+        // per image
+        std::vector<unsigned int> camIDs_;
+        std::vector<cv::Mat> images_;
+        std::vector<Eigen::Matrix3d> K_;
+        std::vector<Eigen::Matrix3d> R_;
+        std::vector<Eigen::Vector3d> t_;
+        std::vector<float> median_depths_;
+        std::vector<Eigen::VectorXd> dist_coeffs_;
+
+        // image i -> wps_[wps_offsets_[i]] .. wps_[wps_offsets_[i+1]-1]
+        std::vector<size_t> wps_offsets_;
+        std::vector<unsigned int> wps_;
+
+        // keypoints (same layout as wps_, only valid if has_keypoints_)
+        std::vector<Eigen::Vector2f> keypoints_;
+        std::vector<bool> has_keypoints_;
+
+        // image i -> segments_[segment_offsets_[i]] .. segments_[segment_offsets_[i+1]-1]
+        std::vector<size_t> segment_offsets_;
+        std::vector<cv::Vec4f> segments_;
+    };
+}
+
+#endif //I3D_LINE3D_PP_IMAGEBATCH_H_
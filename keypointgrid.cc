@@ -0,0 +1,288 @@
+#include "keypointgrid.h"
+
+namespace L3DPP
+{
+    //------------------------------------------------------------------------------
+    KeypointGrid::KeypointGrid(const unsigned int width, const unsigned int height,
+                               const float cell_size) :
+        cell_size_(std::max(cell_size,1.0f))
+    {
+        cols_ = std::max(int(ceil(float(width)/cell_size_)),1);
+        rows_ = std::max(int(ceil(float(height)/cell_size_)),1);
+        cell_offsets_ = std::vector<unsigned int>(cols_*rows_+1,0);
+    }
+
+    //------------------------------------------------------------------------------
+    void KeypointGrid::build(const std::vector<unsigned int>& wpIDs,
+                             const std::vector<Eigen::Vector2f>& positions)
+    {
+        const size_t num = std::min(wpIDs.size(),positions.size());
+
+        // count per cell
+        cell_offsets_ = std::vector<unsigned int>(cols_*rows_+1,0);
+        std::vector<unsigned int> cells(num);
+        for(size_t i=0; i<num; ++i)
+        {
+            cells[i] = cellY(positions[i].y())*cols_+cellX(positions[i].x());
+            ++cell_offsets_[cells[i]+1];
+        }
+
+        for(size_t c=0; c<cols_*rows_; ++c)
+            cell_offsets_[c+1] += cell_offsets_[c];
+
+        // bucket sort
+        wpIDs_.resize(num);
+        positions_.resize(num);
+        std::vector<unsigned int> pos(cell_offsets_.begin(),cell_offsets_.end()-1);
+        for(size_t i=0; i<num; ++i)
+        {
+            unsigned int p = pos[cells[i]]++;
+            wpIDs_[p] = wpIDs[i];
+            positions_[p] = positions[i];
+        }
+
+        // lookup by worldpoint
+        by_wpID_.resize(num);
+        for(size_t i=0; i<num; ++i)
+            by_wpID_[i] = std::pair<unsigned int,unsigned int>(wpIDs_[i],i);
+
+        std::sort(by_wpID_.begin(),by_wpID_.end());
+    }
+
+    //------------------------------------------------------------------------------
+    bool KeypointGrid::find(const unsigned int wpID, Eigen::Vector2f& pos) const
+    {
+        std::vector<std::pair<unsigned int,unsigned int> >::const_iterator it;
+        it = std::lower_bound(by_wpID_.begin(),by_wpID_.end(),
+                              std::pair<unsigned int,unsigned int>(wpID,0));
+
+        if(it == by_wpID_.end() || it->first != wpID)
+            return false;
+
+        pos = positions_[it->second];
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+    void KeypointGrid::querySegment(const float4& seg, const float radius,
+                                    std::vector<unsigned int>& result) const
+    {
+        result.clear();
+        if(wpIDs_.size() == 0)
+            return;
+
+        Eigen::Vector2f a(seg.x,seg.y);
+        Eigen::Vector2f b(seg.z,seg.w);
+        Eigen::Vector2f d = b-a;
+        float len_sqr = d.squaredNorm();
+
+        // cells overlapping the (enlarged) bounding box
+        int x_min = cellX(std::min(a.x(),b.x())-radius);
+        int x_max = cellX(std::max(a.x(),b.x())+radius);
+        int y_min = cellY(std::min(a.y(),b.y())-radius);
+        int y_max = cellY(std::max(a.y(),b.y())+radius);
+
+        float r_sqr = radius*radius;
+        for(int y=y_min; y<=y_max; ++y)
+        {
+            for(int x=x_min; x<=x_max; ++x)
+            {
+                unsigned int c = y*cols_+x;
+                for(unsigned int i=cell_offsets_[c]; i<cell_offsets_[c+1]; ++i)
+                {
+                    // distance to segment
+                    Eigen::Vector2f ap = positions_[i]-a;
+                    float t = 0.0f;
+                    if(len_sqr > L3D_EPS)
+                        t = std::max(0.0f,std::min(1.0f,ap.dot(d)/len_sqr));
+
+                    if((ap-t*d).squaredNorm() <= r_sqr)
+                        result.push_back(i);
+                }
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    unsigned int KeypointGrid::numShared(const L3DPP::KeypointGrid* other) const
+    {
+        // merge (both sorted by wpID)
+        unsigned int shared = 0;
+        size_t i = 0;
+        size_t j = 0;
+        while(i < by_wpID_.size() && j < other->by_wpID_.size())
+        {
+            if(by_wpID_[i].first == other->by_wpID_[j].first)
+            {
+                ++shared;
+                ++i;
+                ++j;
+            }
+            else if(by_wpID_[i].first < other->by_wpID_[j].first)
+            {
+                ++i;
+            }
+            else
+            {
+                ++j;
+            }
+        }
+        return shared;
+    }
+
+    //------------------------------------------------------------------------------
+    bool SegmentAnchors::init(const L3DPP::KeypointGrid* src, const L3DPP::KeypointGrid* tgt,
+                              const float4& seg, const float radius_src, const float radius_tgt)
+    {
+        anchors_tgt_.clear();
+        has_H_ = false;
+        radius_tgt_ = radius_tgt;
+
+        std::vector<unsigned int> near;
+        src->querySegment(seg,radius_src,near);
+
+        std::vector<Eigen::Vector2f> anchors_src;
+        for(size_t i=0; i<near.size() && anchors_tgt_.size() < L3D_KEYPOINT_MAX_ANCHORS; ++i)
+        {
+            Eigen::Vector2f pos_tgt;
+            if(tgt->find(src->wpID(near[i]),pos_tgt))
+            {
+                anchors_src.push_back(src->position(near[i]));
+                anchors_tgt_.push_back(pos_tgt);
+            }
+        }
+
+        if(anchors_tgt_.size() == 0)
+            return false;
+
+        // local homography
+        Eigen::Matrix3d H;
+        if(anchors_tgt_.size() >= L3D_KEYPOINT_MIN_HOMOGRAPHY && fitHomography(anchors_src,anchors_tgt_,H))
+        {
+            Eigen::Vector3d p1 = H*Eigen::Vector3d(seg.x,seg.y,1.0);
+            Eigen::Vector3d p2 = H*Eigen::Vector3d(seg.z,seg.w,1.0);
+
+            if(p1.z() > L3D_EPS && p2.z() > L3D_EPS)
+            {
+                pred_p1_ = Eigen::Vector2f(p1.x()/p1.z(),p1.y()/p1.z());
+                pred_p2_ = Eigen::Vector2f(p2.x()/p2.z(),p2.y()/p2.z());
+                has_H_ = true;
+            }
+        }
+
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+    float SegmentAnchors::support(const float4& tgt_seg) const
+    {
+        Eigen::Vector2f a(tgt_seg.x,tgt_seg.y);
+        Eigen::Vector2f b(tgt_seg.z,tgt_seg.w);
+
+        float dist = radius_tgt_;
+        if(has_H_)
+        {
+            // distance to the predicted segment (closest point of the target segment)
+            Eigen::Vector2f m = 0.5f*(a+b);
+            dist = std::min(pointSegmentDistance(a,pred_p1_,pred_p2_),
+                            std::min(pointSegmentDistance(b,pred_p1_,pred_p2_),
+                                     pointSegmentDistance(m,pred_p1_,pred_p2_)));
+            dist = std::min(dist,std::min(pointSegmentDistance(pred_p1_,a,b),
+                                          pointSegmentDistance(pred_p2_,a,b)));
+        }
+        else
+        {
+            // distance to the closest anchor
+            for(size_t i=0; i<anchors_tgt_.size(); ++i)
+                dist = std::min(dist,pointSegmentDistance(anchors_tgt_[i],a,b));
+        }
+
+        if(dist >= radius_tgt_)
+            return 0.0f;
+
+        return 1.0f-dist/radius_tgt_;
+    }
+
+    //------------------------------------------------------------------------------
+    bool SegmentAnchors::fitHomography(const std::vector<Eigen::Vector2f>& src,
+                                       const std::vector<Eigen::Vector2f>& tgt,
+                                       Eigen::Matrix3d& H)
+    {
+        const size_t n = src.size();
+
+        // normalization (centroid at origin, mean distance sqrt(2))
+        Eigen::Matrix3d T[2];
+        const std::vector<Eigen::Vector2f>* pts[2] = {&src,&tgt};
+        for(size_t k=0; k<2; ++k)
+        {
+            Eigen::Vector2d c(0.0,0.0);
+            for(size_t i=0; i<n; ++i)
+                c += (*pts[k])[i].cast<double>();
+            c /= double(n);
+
+            // anchors (almost) on a line -> no homography
+            Eigen::Matrix2d cov = Eigen::Matrix2d::Zero();
+            double dist = 0.0;
+            for(size_t i=0; i<n; ++i)
+            {
+                Eigen::Vector2d d = (*pts[k])[i].cast<double>()-c;
+                cov += d*d.transpose();
+                dist += d.norm();
+            }
+            dist /= double(n);
+
+            Eigen::SelfAdjointEigenSolver<Eigen::Matrix2d> es(cov/double(n));
+            if(dist < L3D_EPS || es.eigenvalues()(0) < 0.01*dist*dist)
+                return false;
+
+            double s = sqrt(2.0)/dist;
+            T[k] << s,0.0,-s*c.x(),
+                    0.0,s,-s*c.y(),
+                    0.0,0.0,1.0;
+        }
+
+        // DLT (normal equations, smallest eigenvector)
+        Eigen::Matrix<double,9,9> AtA = Eigen::Matrix<double,9,9>::Zero();
+        for(size_t i=0; i<n; ++i)
+        {
+            Eigen::Vector3d p = T[0]*Eigen::Vector3d(src[i].x(),src[i].y(),1.0);
+            Eigen::Vector3d q = T[1]*Eigen::Vector3d(tgt[i].x(),tgt[i].y(),1.0);
+
+            Eigen::Matrix<double,9,1> r1,r2;
+            r1 << 0.0,0.0,0.0,-p.x(),-p.y(),-1.0,q.y()*p.x(),q.y()*p.y(),q.y();
+            r2 << p.x(),p.y(),1.0,0.0,0.0,0.0,-q.x()*p.x(),-q.x()*p.y(),-q.x();
+
+            AtA += r1*r1.transpose();
+            AtA += r2*r2.transpose();
+        }
+
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double,9,9> > es(AtA);
+        Eigen::Matrix<double,9,1> h = es.eigenvectors().col(0);
+
+        Eigen::Matrix3d Hn;
+        Hn << h(0),h(1),h(2),
+              h(3),h(4),h(5),
+              h(6),h(7),h(8);
+
+        H = T[1].inverse()*Hn*T[0];
+        if(fabs(H(2,2)) < L3D_EPS || fabs(H.determinant()) < L3D_EPS)
+            return false;
+
+        H /= H(2,2);
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+    float SegmentAnchors::pointSegmentDistance(const Eigen::Vector2f& p,
+                                               const Eigen::Vector2f& a,
+                                               const Eigen::Vector2f& b)
+    {
+        Eigen::Vector2f d = b-a;
+        float len_sqr = d.squaredNorm();
+        float t = 0.0f;
+        if(len_sqr > L3D_EPS)
+            t = std::max(0.0f,std::min(1.0f,(p-a).dot(d)/len_sqr));
+
+        return (p-a-t*d).norm();
+    }
+}
@@ -0,0 +1,139 @@
+#ifndef I3D_LINE3D_PP_KEYPOINTGRID_H_
+#define I3D_LINE3D_PP_KEYPOINTGRID_H_
+
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+// external
+#include "eigen3/Eigen/Eigen"
+
+// internal
+#include "commons.h"
+#include "dataArray.h"
+
+/**
+ * Line3D++ - KeypointGrid
+ * ====================
+ * 2D observations of the SfM worldpoints
+ * in one image, stored in a compact grid
+ * (CSR over the cells) with a lookup by
+ * worldpoint ID. SegmentAnchors uses the
+ * observations that two images share to
+ * predict where a segment lies in the
+ * other image (local homography), so that
+ * matching can skip candidates that are
+ * far from any shared structure.
+ * ====================
+ */
+
+namespace L3DPP
+{
+    // min. number of anchors for a local homography
+    const unsigned int L3D_KEYPOINT_MIN_HOMOGRAPHY = 6;
+    // max. number of anchors per segment
+    const unsigned int L3D_KEYPOINT_MAX_ANCHORS = 32;
+
+    //------------------------------------------------------------------------------
+    class KeypointGrid
+    {
+    public:
+        // width/height - image size, cell_size - in pixels
+        KeypointGrid(const unsigned int width, const unsigned int height,
+                     const float cell_size);
+
+        // replaces all keypoints (one position per worldpoint ID)
+        void build(const std::vector<unsigned int>& wpIDs,
+                   const std::vector<Eigen::Vector2f>& positions);
+
+        // position of a worldpoint observation (false if not observed)
+        bool find(const unsigned int wpID, Eigen::Vector2f& pos) const;
+
+        // keypoints within 'radius' of a segment (x1,y1,x2,y2),
+        // indices for wpID(...) and position(...)
+        void querySegment(const float4& seg, const float radius,
+                          std::vector<unsigned int>& result) const;
+
+        // number of worldpoints observed in both images
+        unsigned int numShared(const L3DPP::KeypointGrid* other) const;
+
+        // data access
+        size_t size() const {return wpIDs_.size();}
+        unsigned int wpID(const unsigned int i) const {return wpIDs_[i];}
+        const Eigen::Vector2f& position(const unsigned int i) const {return positions_[i];}
+
+    private:
+        int cellX(const float x) const
+        {
+            return std::max(std::min(int(x/cell_size_),int(cols_)-1),0);
+        }
+        int cellY(const float y) const
+        {
+            return std::max(std::min(int(y/cell_size_),int(rows_)-1),0);
+        }
+
+        float cell_size_;
+        unsigned int cols_;
+        unsigned int rows_;
+
+        // cell c -> keypoints cell_offsets_[c] .. cell_offsets_[c+1]-1
+        std::vector<unsigned int> cell_offsets_;
+        std::vector<unsigned int> wpIDs_;
+        std::vector<Eigen::Vector2f> positions_;
+
+        // (wpID, index) sorted by wpID
+        std::vector<std::pair<unsigned int,unsigned int> > by_wpID_;
+    };
+
+    //------------------------------------------------------------------------------
+    // shared structure around one source segment
+    class SegmentAnchors
+    {
+    public:
+        SegmentAnchors() : has_H_(false), radius_tgt_(0.0f){}
+
+        // collects the keypoints near the segment (radius_src) that are observed in the
+        // target image as well, fits a local homography if possible.
+        // returns false if there is no shared structure around the segment
+        bool init(const L3DPP::KeypointGrid* src, const L3DPP::KeypointGrid* tgt,
+                  const float4& seg, const float radius_src, const float radius_tgt);
+
+        // support of a target segment in [0,1] (0 -> far from the predicted
+        // position/the shared structure, 1 -> exactly there)
+        float support(const float4& tgt_seg) const;
+
+        bool has_homography() const {return has_H_;}
+        size_t num_anchors() const {return anchors_tgt_.size();}
+
+    private:
+        // DLT (normalized), false if degenerate
+        static bool fitHomography(const std::vector<Eigen::Vector2f>& src,
+                                  const std::vector<Eigen::Vector2f>& tgt,
+                                  Eigen::Matrix3d& H);
+
+        static float pointSegmentDistance(const Eigen::Vector2f& p,
+                                          const Eigen::Vector2f& a,
+                                          const Eigen::Vector2f& b);
+
+        std::vector<Eigen::Vector2f> anchors_tgt_;
+        bool has_H_;
+        Eigen::Vector2f pred_p1_;
+        Eigen::Vector2f pred_p2_;
+        float radius_tgt_;
+    };
+}
+
+#endif //I3D_LINE3D_PP_KEYPOINTGRID_H_
@@ -1,5 +1,8 @@
 #include "line3D.h"
 
+// std
+#include <limits>
+
 namespace L3DPP
 {
     //------------------------------------------------------------------------------
@@ -7,17 +10,29 @@ namespace L3DPP
                    const int max_img_width,
                    const unsigned int max_line_segments,
                    const bool neighbors_by_worldpoints,
-                   const bool use_GPU) :
-        data_folder_(output_folder+"/L3D++_data/"), load_segments_(load_segments),
-        max_image_width_(max_img_width), max_line_segments_(max_line_segments),
-        neighbors_by_worldpoints_(neighbors_by_worldpoints)
-
+                   const bool use_GPU,
+                   const L3DPP::Line3DOptions& options) :
+        data_folder_(output_folder+"/L3D++_data/"),
+        max_line_segments_(max_line_segments), max_image_width_(max_img_width),
+        load_segments_(load_segments),
+        quantize_segments_(options.quantize_segments_),
+        spatial_segment_order_(options.spatial_segment_order_),
+        float_precision_(options.float_precision_),
+        use_descriptors_(options.use_descriptors_),
+        pin_threads_(options.pin_threads_),
+        neighbors_by_worldpoints_(neighbors_by_worldpoints),
+        A_(L3DPP::ArenaAllocator<L3DPP::CLEdge>(&affinity_arena_))
     {
         // set params
         num_lines_total_ = 0;
         med_scene_depth_ = L3D_EPS;
         med_scene_depth_lines_ = 0.0f;
         translation_ = Eigen::Vector3d(0,0,0);
+        snapshot_ = NULL;
+
+        // matches are allocated on the NUMA node of their view
+        for(unsigned int n=0; n<numa_.num_nodes(); ++n)
+            match_arenas_.push_back(new L3DPP::Arena(L3DPP::L3D_ARENA_CHUNK_SIZE,numa_.enabled() ? &numa_ : NULL,n));
 
         // default
         collinearity_t_ = L3D_DEF_COLLINEARITY_T;
@@ -29,6 +44,7 @@ namespace L3DPP
         const_regularization_depth_ = -1.0f;
         two_sigA_sqr_ = 2.0f*sigma_a_*sigma_a_;
         perform_RDD_ = false;
+        rdd_prune_t_ = L3D_DEF_RDD_PRUNE_T;
         use_CERES_ = false;
         max_iter_CERES_ = L3D_DEF_CERES_MAX_ITER;
         visibility_t_ = 3;
@@ -77,6 +93,17 @@ namespace L3DPP
         {
             delete it->second;
         }
+
+        if(snapshot_ != NULL)
+            snapshot_->release();
+
+        for(size_t i=0; i<progressive_lines3D_.size(); ++i)
+            progressive_lines3D_[i]->release();
+
+        // matches live in the arenas
+        matches_.clear();
+        for(size_t i=0; i<match_arenas_.size(); ++i)
+            delete match_arenas_[i];
     }
 
     //------------------------------------------------------------------------------
@@ -115,43 +142,306 @@ namespace L3DPP
                           const std::list<unsigned int>& wps_or_neighbors,
                           const std::vector<cv::Vec4f>& line_segments)
     {
-        // check size
-        if(std::max(image.cols,image.rows) < L3D_DEF_MIN_IMG_WIDTH)
+        insertImage(camID,image,K,R,t,median_depth,wps_or_neighbors,
+                    line_segments,Eigen::VectorXd());
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::addImage(const unsigned int camID, cv::Mat& image,
+                          const Eigen::Matrix3d& K, const Eigen::Matrix3d& R,
+                          const Eigen::Vector3d& t, const float median_depth,
+                          const std::list<unsigned int>& wps_or_neighbors,
+                          const Eigen::Vector3d& radial_coeffs,
+                          const Eigen::Vector2d& tangential_coeffs)
+    {
+        insertImage(camID,image,K,R,t,median_depth,wps_or_neighbors,std::vector<cv::Vec4f>(),
+                    L3DPP::distortionCoeffs(radial_coeffs,tangential_coeffs));
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::addImages(const L3DPP::ImageBatch& batch)
+    {
+        const int num = batch.size();
+        if(num == 0)
+            return;
+
+        // check IDs (one lock for all views)
+        std::vector<bool> reserved;
+        reserveViews(batch.camIDs(),reserved);
+
+        // load images and create views (parallel)
+        std::vector<L3DPP::View*> views(num,NULL);
+        std::vector<std::list<unsigned int> > wps_or_neighbors(num);
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for schedule(dynamic)
+#endif //L3DPP_OPENMP
+        for(int i=0; i<num; ++i)
         {
+            if(!reserved[i])
+                continue;
+
+            const unsigned int camID = batch.camID(i);
+
+            // load image (if necessary)
+            cv::Mat image = batch.image(i);
+            if(image.empty() && batch.provider() != NULL)
+                batch.provider()->load(camID,image);
+
+            if(image.empty())
+            {
+                display_text_mutex_.lock();
+                std::cout << prefix_err_ << "could not load image [" << camID << "]!" << std::endl;
+                display_text_mutex_.unlock();
+                continue;
+            }
+
+            if(!checkImageSize(image))
+                continue;
+
+            size_t num_wps,num_segments;
+            const unsigned int* wps = batch.wps_or_neighbors(i,num_wps);
+            const cv::Vec4f* segments = batch.line_segments(i,num_segments);
+
+            views[i] = createView(camID,image,batch.K(i),batch.R(i),batch.t(i),
+                                  batch.median_depth(i),num_wps,segments,num_segments,
+                                  batch.dist_coeffs(i));
+
+            if(views[i] != NULL)
+            {
+                wps_or_neighbors[i] = std::list<unsigned int>(wps,wps+num_wps);
+
+                // keypoints (optional)
+                const Eigen::Vector2f* keypoints = batch.keypoints(i);
+                if(keypoints != NULL && neighbors_by_worldpoints_)
+                    views[i]->setKeypoints(createKeypointGrid(views[i],wps,keypoints,num_wps,
+                                                              batch.dist_coeffs(i)));
+            }
+        }
+
+        // IDs of views that could not be created can be used again
+        std::vector<unsigned int> failed;
+        for(int i=0; i<num; ++i)
+        {
+            if(reserved[i] && views[i] == NULL)
+                failed.push_back(batch.camID(i));
+        }
+        releaseViews(failed);
+
+        // register views (in batch order)
+        view_mutex_.lock();
+        view_order_.reserve(view_order_.size()+num);
+        views_avg_depths_.reserve(views_avg_depths_.size()+num);
+        for(int i=0; i<num; ++i)
+        {
+            if(views[i] != NULL)
+                registerView(views[i],batch.median_depth(i),wps_or_neighbors[i]);
+        }
+        view_mutex_.unlock();
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::addKeypoints(const unsigned int camID,
+                              const std::list<unsigned int>& wpIDs,
+                              const std::vector<Eigen::Vector2f>& positions,
+                              const Eigen::Vector3d& radial_coeffs,
+                              const Eigen::Vector2d& tangential_coeffs)
+    {
+        if(!neighbors_by_worldpoints_ || wpIDs.size() != positions.size() || positions.size() == 0)
+            return;
+
+        std::vector<unsigned int> wps(wpIDs.begin(),wpIDs.end());
+
+        view_mutex_.lock();
+        if(views_.find(camID) == views_.end())
+        {
+            view_mutex_.unlock();
             display_text_mutex_.lock();
-            std::cout << prefix_err_ << "image is too small for reliable results: " << std::max(image.cols,image.rows);
-            std::cout << "px (larger side should be >= " << L3D_DEF_MIN_IMG_WIDTH << "px)" << std::endl;
+            std::cout << prefix_err_ << "cannot add keypoints, view [" << camID << "] does not exist!" << std::endl;
             display_text_mutex_.unlock();
             return;
         }
 
-        // check ID
-        view_reserve_mutex_.lock();
-        if(views_reserved_.find(camID) != views_reserved_.end())
+        L3DPP::View* v = views_[camID];
+        v->setKeypoints(createKeypointGrid(v,&wps[0],&positions[0],wps.size(),
+                                           L3DPP::distortionCoeffs(radial_coeffs,tangential_coeffs)));
+        view_mutex_.unlock();
+    }
+
+    //------------------------------------------------------------------------------
+    L3DPP::KeypointGrid* Line3D::createKeypointGrid(const L3DPP::View* v,
+                                                    const unsigned int* wpIDs,
+                                                    const Eigen::Vector2f* positions,
+                                                    const size_t num,
+                                                    const Eigen::VectorXd& dist_coeffs)
+    {
+        std::vector<unsigned int> wps(wpIDs,wpIDs+num);
+        std::vector<Eigen::Vector2f> pos(positions,positions+num);
+
+        if(dist_coeffs.size() == 5)
         {
-            display_text_mutex_.lock();
-            std::cout << prefix_err_ << "camera ID [" << camID << "] already in use!" << std::endl;
-            display_text_mutex_.unlock();
+            // undistort (same model as undistortResizeGray(...), fixed point iteration)
+            const Eigen::Matrix3d K = v->K();
+            const double fx = K(0,0); const double fy = K(1,1);
+            const double cx = K(0,2); const double cy = K(1,2);
+            const double k1 = dist_coeffs(0); const double k2 = dist_coeffs(1);
+            const double p1 = dist_coeffs(2); const double p2 = dist_coeffs(3);
+            const double k3 = dist_coeffs(4);
+
+            for(size_t i=0; i<num; ++i)
+            {
+                const double xd = (pos[i].x()-cx)/fx;
+                const double yd = (pos[i].y()-cy)/fy;
+                double xn = xd;
+                double yn = yd;
+                for(unsigned int it=0; it<5; ++it)
+                {
+                    double r2 = xn*xn + yn*yn;
+                    double radial = 1.0 + r2*(k1 + r2*(k2 + r2*k3));
+                    double dx = 2.0*p1*xn*yn + p2*(r2 + 2.0*xn*xn);
+                    double dy = p1*(r2 + 2.0*yn*yn) + 2.0*p2*xn*yn;
+                    xn = (xd-dx)/radial;
+                    yn = (yd-dy)/radial;
+                }
+                pos[i] = Eigen::Vector2f(fx*xn+cx,fy*yn+cy);
+            }
+        }
 
-            view_reserve_mutex_.unlock();
+        L3DPP::KeypointGrid* grid = new L3DPP::KeypointGrid(v->width(),v->height(),
+                                                            L3D_DEF_KEYPOINT_RADIUS_FACTOR*v->diagonal());
+        grid->build(wps,pos);
+        return grid;
+    }
+
+    //------------------------------------------------------------------------------
+    bool Line3D::useKeypointAnchors(const L3DPP::View* v1, const L3DPP::View* v2)
+    {
+        if(v1->keypoints() == NULL || v2->keypoints() == NULL)
+            return false;
+
+        // symmetric -> one entry per unordered pair
+        std::pair<unsigned int,unsigned int> key(std::min(v1->id(),v2->id()),
+                                                 std::max(v1->id(),v2->id()));
+
+        anchor_mutex_.lock();
+        std::map<std::pair<unsigned int,unsigned int>,bool>::const_iterator it = anchor_pairs_.find(key);
+        bool found = (it != anchor_pairs_.end());
+        bool use_anchors = found ? it->second : false;
+        anchor_mutex_.unlock();
+
+        if(found)
+            return use_anchors;
+
+        use_anchors = (v1->keypoints()->numShared(v2->keypoints()) >= L3D_DEF_KEYPOINT_MIN_SHARED);
+
+        anchor_mutex_.lock();
+        anchor_pairs_[key] = use_anchors;
+        anchor_mutex_.unlock();
+
+        return use_anchors;
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::insertImage(const unsigned int camID, cv::Mat& image,
+                             const Eigen::Matrix3d& K, const Eigen::Matrix3d& R,
+                             const Eigen::Vector3d& t, const float median_depth,
+                             const std::list<unsigned int>& wps_or_neighbors,
+                             const std::vector<cv::Vec4f>& line_segments,
+                             const Eigen::VectorXd& dist_coeffs)
+    {
+        // check size
+        if(!checkImageSize(image))
+            return;
+
+        // check ID
+        std::vector<bool> reserved;
+        reserveViews(std::vector<unsigned int>(1,camID),reserved);
+        if(!reserved[0])
+            return;
+
+        // create view
+        const cv::Vec4f* segments = (line_segments.size() > 0) ? &line_segments[0] : NULL;
+        L3DPP::View* v = createView(camID,image,K,R,t,median_depth,wps_or_neighbors.size(),
+                                    segments,line_segments.size(),dist_coeffs);
+        if(v == NULL)
+        {
+            releaseViews(std::vector<unsigned int>(1,camID));
             return;
         }
-        else
+
+        view_mutex_.lock();
+        registerView(v,median_depth,wps_or_neighbors);
+        view_mutex_.unlock();
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::reserveViews(const std::vector<unsigned int>& camIDs,
+                              std::vector<bool>& reserved)
+    {
+        reserved = std::vector<bool>(camIDs.size(),false);
+
+        view_reserve_mutex_.lock();
+        bool first = (views_reserved_.size() == 0);
+        for(size_t i=0; i<camIDs.size(); ++i)
         {
-            // reserve
-            views_reserved_.insert(camID);
+            if(views_reserved_.find(camIDs[i]) != views_reserved_.end())
+            {
+                display_text_mutex_.lock();
+                std::cout << prefix_err_ << "camera ID [" << camIDs[i] << "] already in use!" << std::endl;
+                display_text_mutex_.unlock();
+            }
+            else
+            {
+                // reserve
+                views_reserved_.insert(camIDs[i]);
+                reserved[i] = true;
+            }
         }
 
-        if(views_reserved_.size() == 1)
+        if(first && views_reserved_.size() > 0)
         {
             display_text_mutex_.lock();
             std::cout << std::endl << prefix_ << "[1] ADDING IMAGES ================================" << std::endl;
             display_text_mutex_.unlock();
         }
         view_reserve_mutex_.unlock();
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::releaseViews(const std::vector<unsigned int>& camIDs)
+    {
+        if(camIDs.size() == 0)
+            return;
+
+        view_reserve_mutex_.lock();
+        for(size_t i=0; i<camIDs.size(); ++i)
+            views_reserved_.erase(camIDs[i]);
+        view_reserve_mutex_.unlock();
+    }
+
+    //------------------------------------------------------------------------------
+    bool Line3D::checkImageSize(const cv::Mat& image)
+    {
+        if(std::max(image.cols,image.rows) < L3D_DEF_MIN_IMG_WIDTH)
+        {
+            display_text_mutex_.lock();
+            std::cout << prefix_err_ << "image is too small for reliable results: " << std::max(image.cols,image.rows);
+            std::cout << "px (larger side should be >= " << L3D_DEF_MIN_IMG_WIDTH << "px)" << std::endl;
+            display_text_mutex_.unlock();
+            return false;
+        }
+        return true;
+    }
 
+    //------------------------------------------------------------------------------
+    L3DPP::View* Line3D::createView(const unsigned int camID, const cv::Mat& image,
+                                    const Eigen::Matrix3d& K, const Eigen::Matrix3d& R,
+                                    const Eigen::Vector3d& t, const float median_depth,
+                                    const size_t num_wps_or_neighbors,
+                                    const cv::Vec4f* line_segments, const size_t num_line_segments,
+                                    const Eigen::VectorXd& dist_coeffs)
+    {
         // check worldpoints
-        if(wps_or_neighbors.size() == 0)
+        if(num_wps_or_neighbors == 0)
         {
             display_text_mutex_.lock();
             if(neighbors_by_worldpoints_)
@@ -161,21 +451,23 @@ namespace L3DPP
 
             display_text_mutex_.unlock();
 
-            return;
+            return NULL;
         }
 
         // detect segments
         L3DPP::DataArray<float4>* lines = NULL;
-        if(line_segments.size() == 0)
+        std::vector<L3DPP::LineDescriptor> descriptors;
+        if(num_line_segments == 0)
         {
             // detect segments using LSD algorithm
-            lines = detectLineSegments(camID,image);
+            lines = detectLineSegments(camID,image,K,dist_coeffs,
+                                       use_descriptors_ ? &descriptors : NULL);
         }
         else
         {
             // use given segments
-            lines = new L3DPP::DataArray<float4>(line_segments.size(),1);
-            for(size_t i=0; i<line_segments.size(); ++i)
+            lines = new L3DPP::DataArray<float4>(num_line_segments,1);
+            for(size_t i=0; i<num_line_segments; ++i)
             {
                 cv::Vec4f coords = line_segments[i];
                 float4 coordsf4;
@@ -191,26 +483,39 @@ namespace L3DPP
             std::cout << prefix_wng_ << "no line segments found in image [" << camID << "]!" << std::endl;
             display_text_mutex_.unlock();
 
-            return;
+            return NULL;
         }
 
         // create view
         L3DPP::View* v = new L3DPP::View(camID,lines,K,R,t,image.cols,image.rows,median_depth);
-        view_mutex_.lock();
+        v->setDescriptors(descriptors);
+        if(spatial_segment_order_)
+            v->orderSpatially();
+        if(quantize_segments_)
+            v->quantize();
+
+        return v;
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::registerView(L3DPP::View* v, const float median_depth,
+                              const std::list<unsigned int>& wps_or_neighbors)
+    {
+        const unsigned int camID = v->id();
 
         display_text_mutex_.lock();
         std::cout << prefix_ << "adding view [" << std::setfill('0') << std::setw(L3D_DISP_CAMS) << camID;
-        std::cout << "]: #lines = " << std::setfill(' ') << std::setw(L3D_DISP_LINES) << lines->width();
+        std::cout << "]: #lines = " << std::setfill(' ') << std::setw(L3D_DISP_LINES) << v->num_lines();
         std::cout << " [" << std::setfill('0') << std::setw(L3D_DISP_CAMS) << views_.size() << "]" << std::endl;
         display_text_mutex_.unlock();
 
         views_[camID] = v;
         view_order_.push_back(camID);
-        matches_[camID] = std::vector<std::list<L3DPP::Match> >(lines->width());
+        std::vector<L3DPP::MatchList>(v->num_lines(),L3DPP::MatchList(L3DPP::ArenaAllocator<L3DPP::Match>(matchArena(camID)))).swap(matches_[camID]);
         num_matches_[camID] = 0;
         processed_[camID] = false;
         visual_neighbors_[camID] = std::set<unsigned int>();
-        num_lines_total_ += lines->width();
+        num_lines_total_ += v->num_lines();
         views_avg_depths_.push_back(fmax(median_depth,L3D_EPS));
 
         if(neighbors_by_worldpoints_)
@@ -223,7 +528,6 @@ namespace L3DPP
             // neighbors explicitely given
             setVisualNeighbors(camID,wps_or_neighbors);
         }
-        view_mutex_.unlock();
     }
 
     //------------------------------------------------------------------------------
@@ -246,20 +550,13 @@ namespace L3DPP
     }
 
     //------------------------------------------------------------------------------
-    L3DPP::DataArray<float4>* Line3D::detectLineSegments(const unsigned int camID, const cv::Mat& image)
+    L3DPP::DataArray<float4>* Line3D::detectLineSegments(const unsigned int camID, const cv::Mat& image,
+                                                         const Eigen::Matrix3d& K,
+                                                         const Eigen::VectorXd& dist_coeffs,
+                                                         std::vector<L3DPP::LineDescriptor>* descriptors)
     {
         // check image format
-        cv::Mat imgGray;
-        if(image.type() == CV_8UC3)
-        {
-            // convert to grayscale
-            cv::cvtColor(image,imgGray,CV_RGB2GRAY);
-        }
-        else if(image.type() == CV_8U)
-        {
-            imgGray = image.clone();
-        }
-        else
+        if(image.type() != CV_8UC3 && image.type() != CV_8U)
         {
             display_text_mutex_.lock();
             std::cout << prefix_err_ << "image type not supported! must be CV_8U (gray) or CV_8UC3 (RGB)!" << std::endl;
@@ -268,79 +565,110 @@ namespace L3DPP
         }
 
         // check image size
-        int max_dim = std::max(imgGray.rows,imgGray.cols);
+        int max_dim = std::max(image.rows,image.cols);
         float upscale_x = 1.0f;
         float upscale_y = 1.0f;
-        unsigned int new_width = imgGray.cols;
-        unsigned int new_height = imgGray.rows;
+        unsigned int new_width = image.cols;
+        unsigned int new_height = image.rows;
 
-        cv::Mat imgResized;
         if(max_image_width_ > 0 && max_dim > max_image_width_)
         {
             // rescale
             float s = float(max_image_width_)/float(max_dim);
-            cv::resize(imgGray,imgResized,cv::Size(),s,s);
+            new_width = std::max(cvRound(float(image.cols)*s),1);
+            new_height = std::max(cvRound(float(image.rows)*s),1);
 
-            upscale_x = float(imgGray.cols)/float(imgResized.cols);
-            upscale_y = float(imgGray.rows)/float(imgResized.rows);
-
-            new_width = imgResized.cols;
-            new_height = imgResized.rows;
-        }
-        else
-        {
-            imgResized = imgGray.clone();
+            upscale_x = float(image.cols)/float(new_width);
+            upscale_y = float(image.rows)/float(new_height);
         }
 
-        // see if lines already exist
+        // see if lines (and descriptors) already exist
         L3DPP::DataArray<float4>* segments = NULL;
-        std::stringstream str;
+        std::stringstream str,str_desc;
+        bool descriptors_loaded = false;
         if(load_segments_)
         {
             str << data_folder_ << "segments_L3D++_" << camID << "_" << new_width << "x" << new_height << "_" << L3D_DEF_MAX_NUM_SEGMENTS << ".bin";
+            str_desc << data_folder_ << "descriptors_L3D++_" << camID << "_" << new_width << "x" << new_height << "_" << L3D_DEF_MAX_NUM_SEGMENTS << ".bin";
 
             boost::filesystem::path file(str.str());
             if(boost::filesystem::exists(file))
             {
                 segments = new L3DPP::DataArray<float4>();
                 L3DPP::serializeFromFile(str.str(),*segments);
-                return segments;
+
+                if(descriptors == NULL)
+                    return segments;
+
+                boost::filesystem::path file_desc(str_desc.str());
+                if(boost::filesystem::exists(file_desc))
+                {
+                    L3DPP::serializeFromFile(str_desc.str(),*descriptors);
+                    descriptors_loaded = (descriptors->size() == segments->width());
+                }
+
+                if(descriptors_loaded)
+                    return segments;
             }
         }
 
-        // detect line segments
+        // detector input (the image itself is only read)
+        cv::Mat imgResized;
+        if(dist_coeffs.size() == 5)
+        {
+            // undistort + resize + grayscale (one pass)
+            undistortResizeGray(image,imgResized,K,dist_coeffs,new_width,new_height);
+        }
+        else
+        {
+            cv::Mat imgGray;
+            if(image.type() == CV_8UC3)
+                cv::cvtColor(image,imgGray,CV_RGB2GRAY);
+            else
+                imgGray = image;
+
+            if(new_width != image.cols || new_height != image.rows)
+                cv::resize(imgGray,imgResized,cv::Size(new_width,new_height));
+            else
+                imgResized = imgGray;
+        }
+
+        if(segments == NULL)
+        {
+            // detect line segments
 #ifndef L3DPP_OPENCV3
-        cv::Ptr<cv::LineSegmentDetector> lsd = cv::createLineSegmentDetectorPtr(cv::LSD_REFINE_ADV);
+            cv::Ptr<cv::LineSegmentDetector> lsd = cv::createLineSegmentDetectorPtr(cv::LSD_REFINE_ADV);
 #else
-        cv::Ptr<cv::LineSegmentDetector> lsd = cv::createLineSegmentDetector(cv::LSD_REFINE_ADV);
+            cv::Ptr<cv::LineSegmentDetector> lsd = cv::createLineSegmentDetector(cv::LSD_REFINE_ADV);
 #endif //L3DPP_LSD_EXT
-        std::vector<cv::Vec4f> detections;
-        lsd->detect(imgResized,detections);
+            std::vector<cv::Vec4f> detections;
+            lsd->detect(imgResized,detections);
 
-        float diag = sqrtf(float(image.rows*image.rows)+float(image.cols*image.cols));
-        float min_len = diag*L3D_DEF_MIN_LINE_LENGTH_FACTOR;
+            float diag = sqrtf(float(image.rows*image.rows)+float(image.cols*image.cols));
+            float min_len = diag*L3D_DEF_MIN_LINE_LENGTH_FACTOR;
 
-        L3DPP::lines2D_sorted_by_length sorted;
-        for(size_t i=0; i<detections.size(); ++i)
-        {
-            cv::Vec4f data = detections[i];
+            L3DPP::lines2D_sorted_by_length sorted;
+            for(size_t i=0; i<detections.size(); ++i)
+            {
+                cv::Vec4f data = detections[i];
 
-            L3DPP::SegmentData2D seg2D;
-            seg2D.p1x_ = data(0)*upscale_x;
-            seg2D.p1y_ = data(1)*upscale_y;
-            seg2D.p2x_ = data(2)*upscale_x;
-            seg2D.p2y_ = data(3)*upscale_y;
+                L3DPP::SegmentData2D seg2D;
+                seg2D.p1x_ = data(0)*upscale_x;
+                seg2D.p1y_ = data(1)*upscale_y;
+                seg2D.p2x_ = data(2)*upscale_x;
+                seg2D.p2y_ = data(3)*upscale_y;
 
-            float dx = seg2D.p1x_-seg2D.p2x_;
-            float dy = seg2D.p1y_-seg2D.p2y_;
-            seg2D.length_ = sqrtf(dx*dx + dy*dy);
+                float dx = seg2D.p1x_-seg2D.p2x_;
+                float dy = seg2D.p1y_-seg2D.p2y_;
+                seg2D.length_ = sqrtf(dx*dx + dy*dy);
 
-            if(seg2D.length_ > min_len)
-                sorted.push(seg2D);
-        }
+                if(seg2D.length_ > min_len)
+                    sorted.push(seg2D);
+            }
+
+            if(sorted.size() == 0)
+                return NULL;
 
-        if(sorted.size() > 0)
-        {
             // convert to dataArray
             if(sorted.size() < max_line_segments_)
                 segments = new L3DPP::DataArray<float4>(sorted.size(),1);
@@ -364,11 +692,109 @@ namespace L3DPP
             {
                 L3DPP::serializeToFile(str.str(),*segments);
             }
+        }
 
-            return segments;
+        // line descriptors (on the detector input)
+        if(descriptors != NULL && !descriptors_loaded)
+        {
+            L3DPP::computeLineDescriptors(imgResized,segments,1.0f/upscale_x,1.0f/upscale_y,
+                                          *descriptors);
+
+            if(load_segments_)
+            {
+                L3DPP::serializeToFile(str_desc.str(),*descriptors);
+            }
         }
 
-        return NULL;
+        return segments;
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::undistortResizeGray(const cv::Mat& image, cv::Mat& result,
+                                     const Eigen::Matrix3d& K,
+                                     const Eigen::VectorXd& dist_coeffs,
+                                     const unsigned int width,
+                                     const unsigned int height)
+    {
+        result = cv::Mat(height,width,CV_8U);
+
+        // distortion model (same as cv::initUndistortRectifyMap)
+        const double fx = K(0,0); const double fy = K(1,1);
+        const double cx = K(0,2); const double cy = K(1,2);
+        const double k1 = dist_coeffs(0); const double k2 = dist_coeffs(1);
+        const double p1 = dist_coeffs(2); const double p2 = dist_coeffs(3);
+        const double k3 = dist_coeffs(4);
+
+        // output pixel centers -> full resolution
+        const double sx = double(image.cols)/double(width);
+        const double sy = double(image.rows)/double(height);
+
+        const int max_x = image.cols-1;
+        const int max_y = image.rows-1;
+        const bool rgb = (image.type() == CV_8UC3);
+
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for
+#endif //L3DPP_OPENMP
+        for(int r=0; r<height; ++r)
+        {
+            unsigned char* out = result.ptr<unsigned char>(r);
+
+            double yn = ((double(r)+0.5)*sy-0.5-cy)/fy;
+            for(int c=0; c<width; ++c)
+            {
+                double xn = ((double(c)+0.5)*sx-0.5-cx)/fx;
+
+                // distort
+                double r2 = xn*xn + yn*yn;
+                double radial = 1.0 + r2*(k1 + r2*(k2 + r2*k3));
+                double xd = xn*radial + 2.0*p1*xn*yn + p2*(r2 + 2.0*xn*xn);
+                double yd = yn*radial + p1*(r2 + 2.0*yn*yn) + 2.0*p2*xn*yn;
+
+                float u = fx*xd + cx;
+                float v = fy*yd + cy;
+
+                // bilinear sample (outside -> black)
+                int u0 = int(floorf(u));
+                int v0 = int(floorf(v));
+                float a = u-float(u0);
+                float b = v-float(v0);
+
+                float val = 0.0f;
+                for(int dy=0; dy<2; ++dy)
+                {
+                    int y = v0+dy;
+                    if(y < 0 || y > max_y)
+                        continue;
+
+                    const unsigned char* row = image.ptr<unsigned char>(y);
+                    float wy = (dy == 0) ? 1.0f-b : b;
+                    for(int dx=0; dx<2; ++dx)
+                    {
+                        int x = u0+dx;
+                        if(x < 0 || x > max_x)
+                            continue;
+
+                        float wx = (dx == 0) ? 1.0f-a : a;
+                        float gray;
+                        if(rgb)
+                        {
+                            // same weights as CV_RGB2GRAY
+                            const unsigned char* px = row+3*x;
+                            gray = 0.299f*px[0] + 0.587f*px[1] + 0.114f*px[2];
+                        }
+                        else
+                        {
+                            gray = row[x];
+                        }
+
+                        val += wx*wy*gray;
+                    }
+                }
+
+                out[c] = cv::saturate_cast<unsigned char>(val);
+            }
+        }
     }
 
     //------------------------------------------------------------------------------
@@ -417,12 +843,6 @@ namespace L3DPP
         estimated_position3D_.clear();
         entry_map_.clear();
 
-        // compute spatial regularizer
-        if(!fixed3Dregularizer_)
-            std::cout << prefix_ << "computing spatial regularizers... [" << sigma_p_ << " px]" << std::endl;
-        else
-            std::cout << prefix_ << "computing spatial regularizers... [" << sigma_p_ << " m]" << std::endl;
-
         med_scene_depth_ = const_regularization_depth_;
         if(const_regularization_depth_ < 0.0f && fixed3Dregularizer_ && views_avg_depths_.size() > 0)
         {
@@ -435,59 +855,71 @@ namespace L3DPP
         // translate reconstruction (for better numerical stability)
         translate();
 
-#ifdef L3DPP_OPENMP
-        #pragma omp parallel for
-#endif //L3DPP_OPENMP
-        for(int i=0; i<view_order_.size(); ++i)
-        {
-            unsigned int camID = view_order_[i];
+        // find visual neighbors
+        std::cout << prefix_ << "computing visual neighbors...     [" << num_neighbors_ << " imgs.]" << std::endl;
+        std::cout << prefix_ << "starting to match " << views_.size() << " images..." << std::endl;
 
-            if(!fixed3Dregularizer_)
-                views_[camID]->computeSpatialRegularizer(sigma_p_);
-            else
-                views_[camID]->update_k(sigma_p_,med_scene_depth_);
+        computeVisualNeighbors();
 
-            // reset matches
-            matches_[camID] = std::vector<std::list<L3DPP::Match> >(views_[camID]->num_lines());
-            num_matches_[camID] = 0;
-            processed_[camID] = false;
+        // graph partition per NUMA node
+        std::map<unsigned int,unsigned int> view2part;
+        if(numa_.enabled() && numWorkerThreads() > 1)
+            partitionViewGraph(numa_.num_nodes(),view2part);
+
+        // processing order and placement of the view data
+        std::vector<unsigned int> order;
+        std::vector<std::list<unsigned int> > release;
+        computeProcessingOrder(view2part,order,release);
+        assignViewsToNodes(order,view2part);
+
+        // release matches of a previous run
+        std::map<unsigned int,std::vector<L3DPP::MatchList> >::iterator m_it = matches_.begin();
+        for(; m_it!=matches_.end(); ++m_it)
+        {
+            m_it->second.clear();
         }
+        for(size_t i=0; i<match_arenas_.size(); ++i)
+            match_arenas_[i]->release();
 
-        // find visual neighbors
-        std::cout << prefix_ << "computing visual neighbors...     [" << num_neighbors_ << " imgs.]" << std::endl;
-        std::cout << prefix_ << "starting to match " << views_.size() << " images..." << std::endl;
+        // compute spatial regularizer
+        if(!fixed3Dregularizer_)
+            std::cout << prefix_ << "computing spatial regularizers... [" << sigma_p_ << " px]" << std::endl;
+        else
+            std::cout << prefix_ << "computing spatial regularizers... [" << sigma_p_ << " m]" << std::endl;
 
+        // views are processed by a thread on their own node
+        // (matches are allocated there as well, pinned or not)
 #ifdef L3DPP_OPENMP
-        #pragma omp parallel for
+        #pragma omp parallel for schedule(static,1)
 #endif //L3DPP_OPENMP
-        for(int i=0; i<view_order_.size(); ++i)
+        for(int t=0; t<thread_views_.size(); ++t)
         {
-            unsigned int camID = view_order_[i];
+            L3DPP::ThreadPinning pinning(numa_,thread_nodes_[t],pin_threads_);
+            L3DPP::MemoryPlacement placement(numa_,thread_nodes_[t]);
 
-            if(fixed_visual_neighbors_.find(camID) != fixed_visual_neighbors_.end())
+            for(size_t i=0; i<thread_views_[t].size(); ++i)
             {
-                if(visual_neighbors_[camID].size() == 0)
-                {
-                    // fixed neighbors
-                    std::list<unsigned int>::iterator n_it = fixed_visual_neighbors_[camID].begin();
-                    for(; n_it!=fixed_visual_neighbors_[camID].end(); ++n_it)
-                    {
-                        if(views_.find(*n_it) != views_.end())
-                            visual_neighbors_[camID].insert(*n_it);
-                    }
-                }
-            }
-            else
-            {
-                // compute neighbors from WP overlap
-                findVisualNeighborsFromWPs(camID);
+                unsigned int camID = thread_views_[t][i];
+
+                if(!fixed3Dregularizer_)
+                    views_[camID]->computeSpatialRegularizer(sigma_p_);
+                else
+                    views_[camID]->update_k(sigma_p_,med_scene_depth_);
+
+                // reset matches (swap -> the lists keep the arena of the node)
+                std::vector<L3DPP::MatchList>(views_[camID]->num_lines(),L3DPP::MatchList(L3DPP::ArenaAllocator<L3DPP::Match>(matchArena(camID)))).swap(matches_[camID]);
+                num_matches_[camID] = 0;
+                processed_[camID] = false;
             }
         }
 
         // match images
         std::cout << prefix_ << "computing matches..." << std::endl;
 
-        computeMatches();
+        computeMatches(order,release);
+
+        // free pooled temporaries
+        buffer_pool_.clear();
 
         // translate back
         untranslate();
@@ -496,6 +928,34 @@ namespace L3DPP
         view_reserve_mutex_.unlock();
     }
 
+    //------------------------------------------------------------------------------
+    void Line3D::partitionViews(const unsigned int num_parts,
+                                std::map<unsigned int,unsigned int>& view2part,
+                                const unsigned int num_neighbors, const int kNN)
+    {
+        // no new views can be added in the meantime!
+        view_reserve_mutex_.lock();
+        view_mutex_.lock();
+
+        view2part.clear();
+        if(views_.size() == 0)
+        {
+            std::cout << prefix_wng_ << "no images to partition! forgot to add them?" << std::endl;
+            view_mutex_.unlock();
+            view_reserve_mutex_.unlock();
+            return;
+        }
+
+        num_neighbors_ = std::max(int(num_neighbors),2);
+        kNN_ = kNN;
+
+        computeVisualNeighbors();
+        partitionViewGraph(std::max(num_parts,(unsigned int)1),view2part);
+
+        view_mutex_.unlock();
+        view_reserve_mutex_.unlock();
+    }
+
     //------------------------------------------------------------------------------
     void Line3D::translate()
     {
@@ -531,7 +991,8 @@ namespace L3DPP
         std::cout << -translation_(1) << " ";
         std::cout << -translation_(2) << std::endl;
 
-        // apply translation to views and 3D lines
+        // apply translation to views (the published model
+        // always stays in the original coordinates)
         performTranslation(-translation_);
     }
 
@@ -542,6 +1003,23 @@ namespace L3DPP
 
         // untranslate back to the original coordinates
         performTranslation(translation_);
+
+        // 3D lines of the current reconstruction (computed in the translated
+        // frame, handed over to the result snapshot afterwards)
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for
+#endif //L3DPP_OPENMP
+        for(int i=0; i<lines3D_.size(); ++i)
+        {
+            L3DPP::FinalLine3D& L = lines3D_[i];
+            std::vector<L3DPP::Segment3D>::iterator it = L.collinear3Dsegments_.begin();
+            for(; it!=L.collinear3Dsegments_.end(); ++it)
+            {
+                (*it).translate(translation_);
+            }
+
+            L.underlyingCluster_.translate(translation_);
+        }
     }
 
     //------------------------------------------------------------------------------
@@ -555,22 +1033,36 @@ namespace L3DPP
         {
             views_[view_order_[i]]->translate(t);
         }
+    }
 
-        // translate available 3D lines
+    //------------------------------------------------------------------------------
+    void Line3D::computeVisualNeighbors()
+    {
 #ifdef L3DPP_OPENMP
         #pragma omp parallel for
 #endif //L3DPP_OPENMP
-        for(int i=0; i<lines3D_.size(); ++i)
+        for(int i=0; i<view_order_.size(); ++i)
         {
-            L3DPP::FinalLine3D L = lines3D_[i];
-            std::list<L3DPP::Segment3D>::iterator it = L.collinear3Dsegments_.begin();
-            for(; it!=L.collinear3Dsegments_.end(); ++it)
+            unsigned int camID = view_order_[i];
+
+            if(fixed_visual_neighbors_.find(camID) != fixed_visual_neighbors_.end())
             {
-                (*it).translate(t);
+                if(visual_neighbors_[camID].size() == 0)
+                {
+                    // fixed neighbors
+                    std::list<unsigned int>::iterator n_it = fixed_visual_neighbors_[camID].begin();
+                    for(; n_it!=fixed_visual_neighbors_[camID].end(); ++n_it)
+                    {
+                        if(views_.find(*n_it) != views_.end())
+                            visual_neighbors_[camID].insert(*n_it);
+                    }
+                }
+            }
+            else
+            {
+                // compute neighbors from WP overlap
+                findVisualNeighborsFromWPs(camID);
             }
-
-            L.underlyingCluster_.translate(t);
-            lines3D_[i] = L;
         }
     }
 
@@ -699,44 +1191,62 @@ namespace L3DPP
     }
 
     //------------------------------------------------------------------------------
-    void Line3D::computeMatches()
+    void Line3D::computeMatches(const std::vector<unsigned int>& order,
+                                const std::vector<std::list<unsigned int> >& release)
     {
-        std::map<unsigned int,std::set<unsigned int> >::const_iterator it = visual_neighbors_.begin();
-        for(; it!=visual_neighbors_.end(); ++it)
+        // kernels (settings are constant for the whole stage)
+        bool all_active = true;
+        std::map<unsigned int,L3DPP::View*>::const_iterator v_it = views_.begin();
+        for(; v_it!=views_.end() && all_active; ++v_it)
+            all_active = v_it->second->all_active();
+
+        MatchingKernel matching = matchingKernel(all_active);
+
+        // matching on the NUMA nodes (all views upfront, each pair of neighbors once)
+        bool on_nodes = (pin_threads_ && !useGPU_ && numa_.enabled() && thread_views_.size() > 1 &&
+                         views_.size() >= thread_views_.size());
+        if(on_nodes)
+            matchViewsOnNodes(order,matching);
+
+        for(size_t p=0; p<order.size(); ++p)
         {
+            unsigned int src = order[p];
+
             std::cout << prefix_;
             if(useGPU_)
                 std::cout << "@GPU: ";
             else
                 std::cout << "@CPU: ";
 
-            std::cout << "[" << std::setfill('0') << std::setw(L3D_DISP_CAMS) << it->first << "] --> ";
+            std::cout << "[" << std::setfill('0') << std::setw(L3D_DISP_CAMS) << src << "] --> ";
 
             // init GPU data
             if(useGPU_)
-                initSrcDataGPU(it->first);
+                initViewDataGPU(src);
+
+            // next view in the processing order -> its segments are
+            // fetched while this view is matched and scored
+            if(!useGPU_ && p+1 < order.size())
+                views_[order[p+1]]->prefetch();
 
-            std::set<unsigned int>::const_iterator n_it = it->second.begin();
-            for(; n_it!=it->second.end(); ++n_it)
+            std::set<unsigned int>::const_iterator n_it = visual_neighbors_[src].begin();
+            for(; n_it!=visual_neighbors_[src].end() && !on_nodes; ++n_it)
             {
-                if(matched_[it->first].find(*n_it) == matched_[it->first].end())
+                if(matched_[src].find(*n_it) == matched_[src].end())
                 {
                     // not yet matched
                     std::cout << "[" << std::setfill('0') << std::setw(L3D_DISP_CAMS) << *n_it << "] ";
 
                     // compute fundamental matrix
-                    Eigen::Matrix3d F = getFundamentalMatrix(views_[it->first],
+                    Eigen::Matrix3d F = getFundamentalMatrix(views_[src],
                                                              views_[*n_it]);
 
                     // matching
-                    if(useGPU_)
-                        matchingGPU(it->first,*n_it,F);
-                    else
-                        matchingCPU(it->first,*n_it,F);
+                    (this->*matching)(src,*n_it,F);
 
                     // set matched
-                    matched_[it->first].insert(*n_it);
-                    matched_[*n_it].insert(it->first);
+                    matched_[src].insert(*n_it);
+                    matched_[*n_it].insert(src);
                 }
             }
 
@@ -745,48 +1255,56 @@ namespace L3DPP
             // check matches for orientation
             if(L3D_DEF_CHECK_MATCH_ORIENTATION)
             {
-                checkMatchOrientation(it->first);
+                checkMatchOrientation(src);
             }
 
             // scoring
             float valid_f;
 
             if(useGPU_)
-                scoringGPU(it->first,valid_f);
+                scoringGPU(src,valid_f);
             else
-                scoringCPU(it->first,valid_f);
+                scoreView(src,valid_f);
 
             std::cout << prefix_ << "scoring: " << "clusterable_segments = " << int(valid_f*100) << "%";
             std::cout << std::endl;
 
-            // cleanup GPU data
+            // cleanup GPU data (views that are not needed anymore)
             if(useGPU_)
-                removeSrcDataGPU(it->first);
+            {
+                std::list<unsigned int>::const_iterator r_it = release[p].begin();
+                for(; r_it!=release[p].end(); ++r_it)
+                    removeViewDataGPU(*r_it);
+            }
 
             // store inverse matches
-            storeInverseMatches(it->first);
+            storeInverseMatches(src);
 
             // filter invalid matches
-            filterMatches(it->first);
+            filterMatches(src);
 
             // set processed
-            processed_[it->first] = true;
+            processed_[src] = true;
 
             std::cout << prefix_ << "#matches: ";
-            std::cout << std::setfill(' ') << std::setw(L3D_DISP_MATCHES) << num_matches_[it->first] << std::endl;
-            std::cout << prefix_ << "median_depth: " << views_[it->first]->median_depth() << std::endl;
+            std::cout << std::setfill(' ') << std::setw(L3D_DISP_MATCHES) << num_matches_[src] << std::endl;
+            std::cout << prefix_ << "median_depth: " << views_[src]->median_depth() << std::endl;
         }
 
+        // multi-view tracks (mutually best, valid matches)
+        buildTracks();
+        std::cout << prefix_ << "#tracks: " << tracks_.size() << std::endl;
+
         /*
         // DEBUG: save all remaining matches
         std::vector<L3DPP::Segment3D> all_matches;
-        std::map<unsigned int,std::vector<std::list<L3DPP::Match> > >::iterator dbg_it = matches_.begin();
+        std::map<unsigned int,std::vector<L3DPP::MatchList> >::iterator dbg_it = matches_.begin();
         for(; dbg_it!=matches_.end(); ++dbg_it)
         {
             L3DPP::View* v = views_[dbg_it->first];
             for(size_t i=0; i<dbg_it->second.size(); ++i)
             {
-                std::list<L3DPP::Match>::iterator dbg_it2 = dbg_it->second.at(i).begin();
+                L3DPP::MatchList::iterator dbg_it2 = dbg_it->second.at(i).begin();
                 for(; dbg_it2!=dbg_it->second.at(i).end(); ++dbg_it2)
                 {
                     L3DPP::Match m = *dbg_it2;
@@ -801,12 +1319,268 @@ namespace L3DPP
         std::vector<L3DPP::Segment3D> best_matches;
         for(size_t i=0; i<estimated_position3D_.size(); ++i)
         {
-            best_matches.push_back(estimated_position3D_[i].first);
+            best_matches.push_back(estimated_position3D_[i].seg3D());
         }
         saveTempResultAsSTL(data_folder_,"best",best_matches);
         */
     }
 
+    //------------------------------------------------------------------------------
+    void Line3D::matchViewsOnNodes(const std::vector<unsigned int>& order,
+                                   const MatchingKernel matching)
+    {
+        // pairs to match per view (each pair once, in processing order)
+        std::map<unsigned int,std::list<std::pair<unsigned int,Eigen::Matrix3d> > > targets;
+        for(size_t p=0; p<order.size(); ++p)
+        {
+            unsigned int src = order[p];
+
+            std::set<unsigned int>::const_iterator n_it = visual_neighbors_[src].begin();
+            for(; n_it!=visual_neighbors_[src].end(); ++n_it)
+            {
+                if(matched_[src].find(*n_it) == matched_[src].end())
+                {
+                    Eigen::Matrix3d F = getFundamentalMatrix(views_[src],views_[*n_it]);
+                    targets[src].push_back(std::pair<unsigned int,Eigen::Matrix3d>(*n_it,F));
+
+                    matched_[src].insert(*n_it);
+                    matched_[*n_it].insert(src);
+                }
+            }
+        }
+
+        std::cout << prefix_ << "@CPU: matching " << targets.size() << " views on ";
+        std::cout << numa_.num_nodes() << " NUMA nodes..." << std::endl;
+
+        // each view is matched by one thread on its node
+        // (pinned, the kernel's inner loop runs serially in this thread)
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for schedule(static,1)
+#endif //L3DPP_OPENMP
+        for(int t=0; t<thread_views_.size(); ++t)
+        {
+            L3DPP::ThreadPinning pinning(numa_,thread_nodes_[t]);
+
+            for(size_t i=0; i<thread_views_[t].size(); ++i)
+            {
+                unsigned int src = thread_views_[t][i];
+                std::map<unsigned int,std::list<std::pair<unsigned int,Eigen::Matrix3d> > >::const_iterator t_it = targets.find(src);
+                if(t_it == targets.end())
+                    continue;
+
+                // next view of this thread
+                if(i+1 < thread_views_[t].size())
+                    views_[thread_views_[t][i+1]]->prefetch();
+
+                std::list<std::pair<unsigned int,Eigen::Matrix3d> >::const_iterator it = t_it->second.begin();
+                for(; it!=t_it->second.end(); ++it)
+                    (this->*matching)(src,it->first,it->second);
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::computeProcessingOrder(const std::map<unsigned int,unsigned int>& view2part,
+                                        std::vector<unsigned int>& order,
+                                        std::vector<std::list<unsigned int> >& release)
+    {
+        // bandwidth reducing order of the visual neighbor graph
+        // -> neighboring views are processed close in time
+        if(view2part.size() == 0)
+        {
+            L3DPP::ViewGraph graph(visual_neighbors_);
+            order = graph.orderRCM();
+        }
+        else
+        {
+            // partition by partition
+            std::map<unsigned int,std::map<unsigned int,std::set<unsigned int> > > subgraphs;
+            std::map<unsigned int,unsigned int>::const_iterator p_it = view2part.begin();
+            for(; p_it!=view2part.end(); ++p_it)
+            {
+                std::set<unsigned int>& neighbors = subgraphs[p_it->second][p_it->first];
+
+                std::set<unsigned int>::const_iterator n_it = visual_neighbors_[p_it->first].begin();
+                for(; n_it!=visual_neighbors_[p_it->first].end(); ++n_it)
+                {
+                    std::map<unsigned int,unsigned int>::const_iterator n_part = view2part.find(*n_it);
+                    if(n_part != view2part.end() && n_part->second == p_it->second)
+                        neighbors.insert(*n_it);
+                }
+            }
+
+            order.clear();
+            std::map<unsigned int,std::map<unsigned int,std::set<unsigned int> > >::const_iterator s_it = subgraphs.begin();
+            for(; s_it!=subgraphs.end(); ++s_it)
+            {
+                L3DPP::ViewGraph graph(s_it->second);
+                std::vector<unsigned int> part_order = graph.orderRCM();
+                order.insert(order.end(),part_order.begin(),part_order.end());
+            }
+        }
+
+        // find the last processing step in which a view is needed
+        // (as source, or as target of a not yet matched pair)
+        std::map<unsigned int,size_t> last_use;
+        std::set<std::pair<unsigned int,unsigned int> > pairs;
+        for(size_t p=0; p<order.size(); ++p)
+        {
+            unsigned int src = order[p];
+            last_use[src] = p;
+
+            std::set<unsigned int>::const_iterator n_it = visual_neighbors_[src].begin();
+            for(; n_it!=visual_neighbors_[src].end(); ++n_it)
+            {
+                std::pair<unsigned int,unsigned int> pair(std::min(src,*n_it),
+                                                          std::max(src,*n_it));
+                if(pairs.find(pair) == pairs.end())
+                {
+                    pairs.insert(pair);
+                    last_use[*n_it] = p;
+                }
+            }
+        }
+
+        // views that can be released after each step
+        release = std::vector<std::list<unsigned int> >(order.size());
+        std::map<unsigned int,size_t>::const_iterator l_it = last_use.begin();
+        for(; l_it!=last_use.end(); ++l_it)
+            release[l_it->second].push_back(l_it->first);
+    }
+
+    //------------------------------------------------------------------------------
+    int Line3D::numWorkerThreads()
+    {
+#ifdef L3DPP_OPENMP
+        return std::max(omp_get_max_threads(),1);
+#else
+        return 1;
+#endif //L3DPP_OPENMP
+    }
+
+    //------------------------------------------------------------------------------
+    double Line3D::estimatedViewCost(const unsigned int camID)
+    {
+        // segments x neighbors x expected matches per segment
+        double num_neighbors = double(visual_neighbors_[camID].size());
+        double kNN = (kNN_ > 0) ? double(kNN_) : double(L3D_DEF_KNN);
+        return double(views_[camID]->num_lines())*num_neighbors*(num_neighbors*kNN+1.0);
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::partitionViewGraph(const unsigned int num_parts,
+                                    std::map<unsigned int,unsigned int>& view2part)
+    {
+        std::map<unsigned int,double> weights;
+        std::map<unsigned int,L3DPP::View*>::const_iterator it = views_.begin();
+        for(; it!=views_.end(); ++it)
+            weights[it->first] = estimatedViewCost(it->first);
+
+        L3DPP::ViewGraph graph(visual_neighbors_);
+        view2part = graph.partition(num_parts,weights);
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::assignViewsToNodes(const std::vector<unsigned int>& order,
+                                    const std::map<unsigned int,unsigned int>& view2part)
+    {
+        int num_threads = numWorkerThreads();
+        unsigned int num_nodes = numa_.num_nodes();
+
+        // threads are distributed over the nodes in contiguous blocks
+        std::vector<unsigned int> thread2node(num_threads,0);
+        std::vector<std::vector<int> > node_threads(num_nodes);
+        std::vector<unsigned int> used_nodes;
+        for(int t=0; t<num_threads; ++t)
+        {
+            thread2node[t] = numa_.nodeForThread(t,num_threads);
+            if(node_threads[thread2node[t]].size() == 0)
+                used_nodes.push_back(thread2node[t]);
+
+            node_threads[thread2node[t]].push_back(t);
+        }
+
+        // all views (views without neighbors might be missing in the order)
+        std::vector<unsigned int> all_views = order;
+        std::set<unsigned int> ordered(order.begin(),order.end());
+        for(size_t i=0; i<view_order_.size(); ++i)
+        {
+            if(ordered.find(view_order_[i]) == ordered.end())
+                all_views.push_back(view_order_[i]);
+        }
+
+        // one partition per node (with threads), least loaded thread within a node
+        std::map<unsigned int,unsigned int> previous_nodes = view2node_;
+        view2node_.clear();
+        thread_views_ = std::vector<std::vector<unsigned int> >(num_threads);
+        std::vector<double> thread_load(num_threads,0.0);
+        for(size_t i=0; i<all_views.size(); ++i)
+        {
+            unsigned int camID = all_views[i];
+
+            unsigned int part = 0;
+            std::map<unsigned int,unsigned int>::const_iterator p_it = view2part.find(camID);
+            if(p_it != view2part.end())
+                part = p_it->second%used_nodes.size();
+
+            unsigned int node = used_nodes[part];
+            view2node_[camID] = node;
+
+            int best = node_threads[node][0];
+            for(size_t j=1; j<node_threads[node].size(); ++j)
+            {
+                if(thread_load[node_threads[node][j]] < thread_load[best])
+                    best = node_threads[node][j];
+            }
+
+            thread_views_[best].push_back(camID);
+            thread_load[best] += estimatedViewCost(camID);
+        }
+        thread_nodes_ = thread2node;
+
+        if(!numa_.enabled() || num_threads < 2)
+            return;
+
+        std::cout << prefix_ << "NUMA: " << num_nodes << " nodes, " << num_threads << " threads";
+        std::cout << " [pinning=" << pin_threads_ << "]" << std::endl;
+
+        // move the view data to the owning node (the copy is placed
+        // there by the memory policy, threads are pinned only on request)
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for schedule(static,1)
+#endif //L3DPP_OPENMP
+        for(int t=0; t<num_threads; ++t)
+        {
+            L3DPP::ThreadPinning pinning(numa_,thread2node[t],pin_threads_);
+            L3DPP::MemoryPlacement placement(numa_,thread2node[t]);
+
+            for(size_t i=0; i<thread_views_[t].size(); ++i)
+            {
+                unsigned int camID = thread_views_[t][i];
+
+                std::map<unsigned int,unsigned int>::const_iterator p_it = previous_nodes.find(camID);
+                if(p_it == previous_nodes.end() || p_it->second != thread2node[t])
+                    views_[camID]->relocate();
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    unsigned int Line3D::viewNode(const unsigned int camID) const
+    {
+        std::map<unsigned int,unsigned int>::const_iterator it = view2node_.find(camID);
+        if(it == view2node_.end() || it->second >= numa_.num_nodes())
+            return 0;
+
+        return it->second;
+    }
+
+    //------------------------------------------------------------------------------
+    L3DPP::Arena* Line3D::matchArena(const unsigned int camID)
+    {
+        return match_arenas_[viewNode(camID)];
+    }
+
     //------------------------------------------------------------------------------
     void Line3D::checkMatchOrientation(const unsigned int src)
     {
@@ -820,29 +1594,25 @@ namespace L3DPP
 #endif //L3DPP_OPENMP
         for(int i=0; i<matches_[src].size(); ++i)
         {
-            std::list<L3DPP::Match> remaining;
-
-            std::list<L3DPP::Match>::const_iterator it = matches_[src][i].begin();
-            for(; it!=matches_[src][i].end(); ++it)
+            // filter in place (no copy into the arena)
+            L3DPP::MatchList::iterator it = matches_[src][i].begin();
+            while(it!=matches_[src][i].end())
             {
-                L3DPP::Match m = *it;
-
-                // unproject
-                L3DPP::Segment3D seg3D = unprojectMatch(m);
-
-                // check angle
-                double ang = views_[m.src_camID_]->segmentQualityAngle(seg3D,m.src_segID_);
+                // check angle (kernel precision)
+                bool valid;
+                if(float_precision_)
+                    valid = validMatchOrientation<L3DPP::SinglePrecision>(*it);
+                else
+                    valid = validMatchOrientation<L3DPP::DoublePrecision>(*it);
 
-                if(ang > L3D_PI_1_32 && ang < L3D_PI_31_32)
-                {
-                    remaining.push_back(m);
-                }
+                if(valid)
+                    ++it;
+                else
+                    it = matches_[src][i].erase(it);
             }
 
-            matches_[src][i] = remaining;
-
             match_mutex_.lock();
-            num_matches += remaining.size();
+            num_matches += matches_[src][i].size();
             match_mutex_.unlock();
         }
 
@@ -857,6 +1627,17 @@ namespace L3DPP
         std::cout << " (~" << int(perc) << "%)" << std::endl;
     }
 
+    //------------------------------------------------------------------------------
+    template<class P>
+    bool Line3D::validMatchOrientation(const L3DPP::Match& m)
+    {
+        L3DPP::View* v = views_[m.src_camID_];
+        typename P::Vector3 dir = v->unprojectedDirAs<P>(m.src_segID_,m.depth_p1_,m.depth_p2_);
+        double ang = v->segmentQualityAngleAs<P>(dir,m.src_segID_);
+
+        return (ang > L3D_PI_1_32 && ang < L3D_PI_31_32);
+    }
+
     //------------------------------------------------------------------------------
     Eigen::Matrix3d Line3D::getFundamentalMatrix(L3DPP::View* src, L3DPP::View* tgt)
     {
@@ -897,49 +1678,121 @@ namespace L3DPP
     }
 
     //------------------------------------------------------------------------------
+    template<bool KNN, bool ALL_ACTIVE, class P>
     void Line3D::matchingCPU(const unsigned int src, const unsigned int tgt,
                              const Eigen::Matrix3d& F)
     {
+        typedef typename P::Scalar Scalar;
+        typedef typename P::Vector2 Vector2;
+        typedef typename P::Vector3 Vector3;
+        typedef typename P::Matrix3 Matrix3;
+
         L3DPP::View* v_src = views_[src];
         L3DPP::View* v_tgt = views_[tgt];
 
-        L3DPP::DataArray<float4>* lines_src = v_src->lines();
-        L3DPP::DataArray<float4>* lines_tgt = v_tgt->lines();
+        // unchecked access (inner loop), quantized segments are dequantized per access
+        const L3DPP::SegmentAccessor lines_src = v_src->segments();
+        const L3DPP::SegmentAccessor lines_tgt = v_tgt->segments();
+
+        // epipolar geometry for image coordinates relative to the principal
+        // points (well conditioned, also in single precision)
+        Eigen::Matrix3d T_src = Eigen::Matrix3d::Identity();
+        Eigen::Matrix3d T_tgt = Eigen::Matrix3d::Identity();
+        T_src.block<2,1>(0,2) = v_src->pp().head<2>();
+        T_tgt.block<2,1>(0,2) = v_tgt->pp().head<2>();
+        Eigen::Matrix3d F_c = T_tgt.transpose()*F*T_src;
+        F_c /= fmax(F_c.norm(),L3D_EPS);
+
+        const Vector3 pp_src(v_src->pp().x(),v_src->pp().y(),0.0);
+        const Vector3 pp_tgt(v_tgt->pp().x(),v_tgt->pp().y(),0.0);
+
+        // camera data in kernel precision (baseline computed in double precision)
+        const Matrix3 F_k = F_c.cast<Scalar>();
+        const Matrix3& RtKinv_src = v_src->RtKinvAs<P>();
+        const Matrix3& RtKinv_tgt = v_tgt->RtKinvAs<P>();
+        const Vector3 baseline = v_tgt->centerOffsetAs<P>(v_src);
+
+        // line descriptors (photometric pre-check)
+        const bool check_descriptors = (use_descriptors_ && v_src->has_descriptors() &&
+                                        v_tgt->has_descriptors());
+        const unsigned int max_hamming = L3D_DEF_LINE_DESC_MAX_HAMMING*float(L3D_LINE_DESC_BITS);
+
+        // keypoint anchors (only if both views share enough worldpoint observations)
+        const bool use_anchors = useKeypointAnchors(v_src,v_tgt);
+        const float radius_src = L3D_DEF_KEYPOINT_RADIUS_FACTOR*v_src->diagonal();
+        const float radius_tgt = L3D_DEF_KEYPOINT_RADIUS_FACTOR*v_tgt->diagonal();
 
         unsigned int num_matches = 0;
 
+        // no nested team when called per thread (see matchViewsOnNodes)
 #ifdef L3DPP_OPENMP
-        #pragma omp parallel for
+        #pragma omp parallel for if(!omp_in_parallel())
 #endif //L3DPP_OPENMP
-        for(int r=0; r<lines_src->width(); ++r)
+        for(int r=0; r<lines_src.size(); ++r)
         {
+            // progressive mode: only the longest segments
+            if(!ALL_ACTIVE && !v_src->active(r))
+                continue;
+
+            const float4 seg_src = lines_src[r];
+
+            // no shared structure around the segment -> plain epipolar search
+            L3DPP::SegmentAnchors anchors;
+            const bool anchored = (use_anchors && anchors.init(v_src->keypoints(),v_tgt->keypoints(),
+                                                               seg_src,radius_src,radius_tgt));
+
             int new_matches = 0;
 
             // source line
-            Eigen::Vector3d p1(lines_src->dataCPU(r,0)[0].x,
-                               lines_src->dataCPU(r,0)[0].y,1.0);
-            Eigen::Vector3d p2(lines_src->dataCPU(r,0)[0].z,
-                               lines_src->dataCPU(r,0)[0].w,1.0);
+            Vector3 p1(seg_src.x,seg_src.y,1.0);
+            Vector3 p2(seg_src.z,seg_src.w,1.0);
 
             // epipolar lines
-            Eigen::Vector3d epi_p1 = F*p1;
-            Eigen::Vector3d epi_p2 = F*p2;
+            Vector3 epi_p1 = F_k*(p1-pp_src);
+            Vector3 epi_p2 = F_k*(p2-pp_src);
 
-            // use priority queue when kNN > 0
-            L3DPP::pairwise_matches scored_matches;
+            // rays through the endpoints
+            Vector3 ray_p1 = (RtKinv_src*p1).normalized();
+            Vector3 ray_p2 = (RtKinv_src*p2).normalized();
 
-            for(size_t c=0; c<lines_tgt->width(); ++c)
+            // k best matches (kNN > 0)
+            L3DPP::KNNMatches scored_matches(KNN ? kNN_ : 0);
+
+            for(size_t c=0; c<lines_tgt.size(); ++c)
             {
+                if(!ALL_ACTIVE && !v_tgt->active(c))
+                    continue;
+
+                const float4 seg_tgt = lines_tgt[c];
+
+                // descriptor distance (cheap, before any geometry)
+                unsigned int hamming = 0;
+                if(check_descriptors)
+                {
+                    hamming = L3DPP::hammingDistance(v_src->descriptor(r),v_tgt->descriptor(c));
+                    if(hamming > max_hamming)
+                        continue;
+                }
+
+                // distance to the predicted position (cheap, before any geometry)
+                float support = 1.0f;
+                if(anchored)
+                {
+                    support = anchors.support(seg_tgt);
+                    if(support <= 0.0f)
+                        continue;
+                }
+
                 // target line
-                Eigen::Vector3d q1(lines_tgt->dataCPU(c,0)[0].x,
-                                   lines_tgt->dataCPU(c,0)[0].y,1.0);
-                Eigen::Vector3d q2(lines_tgt->dataCPU(c,0)[0].z,
-                                   lines_tgt->dataCPU(c,0)[0].w,1.0);
-                Eigen::Vector3d l2 = q1.cross(q2);
+                Vector3 q1(seg_tgt.x,seg_tgt.y,1.0);
+                Vector3 q2(seg_tgt.z,seg_tgt.w,1.0);
+                Vector3 q1_c = q1-pp_tgt;
+                Vector3 q2_c = q2-pp_tgt;
+                Vector3 l2 = q1_c.cross(q2_c);
 
                 // intersect
-                Eigen::Vector3d p1_proj = l2.cross(epi_p1);
-                Eigen::Vector3d p2_proj = l2.cross(epi_p2);
+                Vector3 p1_proj = l2.cross(epi_p1);
+                Vector3 p2_proj = l2.cross(epi_p2);
 
                 if(fabs(p1_proj.z()) > L3D_EPS && fabs(p2_proj.z()) > L3D_EPS)
                 {
@@ -948,20 +1801,19 @@ namespace L3DPP
                     p2_proj /= p2_proj.z();
 
                     // check overlap
-                    std::vector<Eigen::Vector3d> collinear_points(4);
-                    collinear_points[0] = p1_proj;
-                    collinear_points[1] = p2_proj;
-                    collinear_points[2] = q1;
-                    collinear_points[3] = q2;
-                    float score = mutualOverlap(collinear_points);
+                    Vector3 collinear_points[4] = {p1_proj,p2_proj,q1_c,q2_c};
+                    float score = mutualOverlap<P>(collinear_points);
 
                     if(score > epipolar_overlap_)
                     {
                         // triangulate
-                        Eigen::Vector2d depths_src = triangulationDepths(src,p1,p2,
-                                                                         tgt,q1,q2);
-                        Eigen::Vector2d depths_tgt = triangulationDepths(tgt,q1,q2,
-                                                                         src,p1,p2);
+                        Vector3 ray_q1 = (RtKinv_tgt*q1).normalized();
+                        Vector3 ray_q2 = (RtKinv_tgt*q2).normalized();
+
+                        Vector2 depths_src = triangulationDepths<P>(ray_p1,ray_p2,
+                                                                    ray_q1,ray_q2,baseline);
+                        Vector2 depths_tgt = triangulationDepths<P>(ray_q1,ray_q2,
+                                                                    ray_p1,ray_p2,-baseline);
 
                         if(depths_src.x() > L3D_EPS && depths_src.y() > L3D_EPS &&
                                 depths_tgt.x() > L3D_EPS && depths_tgt.y() > L3D_EPS)
@@ -979,10 +1831,15 @@ namespace L3DPP
                             M.depth_q1_ = depths_tgt.x();
                             M.depth_q2_ = depths_tgt.y();
 
-                            if(kNN_ > 0)
+                            if(KNN)
                             {
-                                // kNN matching
-                                scored_matches.push(M);
+                                // kNN matching (ranked by overlap, descriptor similarity
+                                // and keypoint support)
+                                float rank = score*support;
+                                if(check_descriptors)
+                                    rank *= (1.0f-float(hamming)/float(L3D_LINE_DESC_BITS));
+
+                                scored_matches.push(M,rank);
                             }
                             else
                             {
@@ -996,12 +1853,12 @@ namespace L3DPP
             }
 
             // push kNN matches into list
-            if(kNN_ > 0)
+            if(KNN)
             {
-                while(new_matches < kNN_ && !scored_matches.empty())
+                const std::vector<L3DPP::Match>& best = scored_matches.sorted();
+                for(size_t i=0; i<best.size(); ++i)
                 {
-                    matches_[src][r].push_back(scored_matches.top());
-                    scored_matches.pop();
+                    matches_[src][r].push_back(best[i]);
                     ++new_matches;
                 }
             }
@@ -1015,24 +1872,66 @@ namespace L3DPP
     }
 
     //------------------------------------------------------------------------------
-    void Line3D::initSrcDataGPU(const unsigned int src)
+    Line3D::MatchingKernel Line3D::matchingKernel(const bool all_active) const
+    {
+        if(useGPU_)
+            return &Line3D::matchingGPU;
+
+        if(float_precision_)
+            return matchingKernelCPU<L3DPP::SinglePrecision>(all_active);
+        else
+            return matchingKernelCPU<L3DPP::DoublePrecision>(all_active);
+    }
+
+    //------------------------------------------------------------------------------
+    template<class P>
+    Line3D::MatchingKernel Line3D::matchingKernelCPU(const bool all_active) const
+    {
+        if(kNN_ > 0)
+        {
+            if(all_active)
+                return &Line3D::matchingCPU<true,true,P>;
+            else
+                return &Line3D::matchingCPU<true,false,P>;
+        }
+        else
+        {
+            if(all_active)
+                return &Line3D::matchingCPU<false,true,P>;
+            else
+                return &Line3D::matchingCPU<false,false,P>;
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    Line3D::ScoringKernel Line3D::scoringKernel() const
+    {
+        if(float_precision_)
+            return &Line3D::scoringCPU<L3DPP::SinglePrecision>;
+        else
+            return &Line3D::scoringCPU<L3DPP::DoublePrecision>;
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::initViewDataGPU(const unsigned int camID)
     {
 #ifdef L3DPP_CUDA
-        // upload
-        L3DPP::View* v1 = views_[src];
-        v1->lines()->upload();
-        v1->RtKinvGPU()->upload();
+        // upload (if not already resident)
+        L3DPP::View* v = views_[camID];
+        v->uploadLines();
+        if(!v->RtKinvGPU()->onGPU())
+            v->RtKinvGPU()->upload();
 #endif //L3DPP_CUDA
     }
 
     //------------------------------------------------------------------------------
-    void Line3D::removeSrcDataGPU(const unsigned int src)
+    void Line3D::removeViewDataGPU(const unsigned int camID)
     {
 #ifdef L3DPP_CUDA
         // cleanup
-        L3DPP::View* v1 = views_[src];
-        v1->lines()->removeFromGPU();
-        v1->RtKinvGPU()->removeFromGPU();
+        L3DPP::View* v = views_[camID];
+        v->removeLinesFromGPU();
+        v->RtKinvGPU()->removeFromGPU();
 #endif //L3DPP_CUDA
     }
 
@@ -1041,62 +1940,98 @@ namespace L3DPP
                              const Eigen::Matrix3d& F)
     {
 #ifdef L3DPP_CUDA
-        // INFO: src data must be on GPU! initSrcDataGPU(src)
+        // INFO: src data must be on GPU! initViewDataGPU(src)
         L3DPP::View* v1 = views_[src];
 
-        // upload segments to GPU
+        // upload segments and RtKinv to GPU (stays resident until
+        // the view is not needed anymore, see computeMatches())
         L3DPP::View* v2 = views_[tgt];
-        v2->lines()->upload();
+        initViewDataGPU(tgt);
 
         // move F to GPU
         L3DPP::DataArray<float>* F_GPU = NULL;
         eigen2dataArray(F_GPU,F);
         F_GPU->upload();
 
-        // move RtKinv to GPU
-        v2->RtKinvGPU()->upload();
-
         // match segments on GPU
         unsigned int num_matches = L3DPP::match_lines_GPU(v1->lines(),v2->lines(),F_GPU,
                                                           v1->RtKinvGPU(),v2->RtKinvGPU(),
                                                           v1->C_GPU(),v2->C_GPU(),
                                                           &(matches_[src]),src,tgt,
-                                                          epipolar_overlap_,kNN_);
+                                                          epipolar_overlap_,kNN_,
+                                                          &buffer_pool_);
+
+        // line descriptors (matches are filtered afterwards on the GPU path)
+        const bool check_descriptors = (use_descriptors_ && v1->has_descriptors() &&
+                                        v2->has_descriptors());
+        const unsigned int max_hamming = L3D_DEF_LINE_DESC_MAX_HAMMING*float(L3D_LINE_DESC_BITS);
+
+        // keypoint anchors (filtered afterwards as well)
+        const bool use_anchors = useKeypointAnchors(v1,v2);
+        const float radius_src = L3D_DEF_KEYPOINT_RADIUS_FACTOR*v1->diagonal();
+        const float radius_tgt = L3D_DEF_KEYPOINT_RADIUS_FACTOR*v2->diagonal();
+
+        if(!v1->all_active() || !v2->all_active() || check_descriptors || use_anchors)
+        {
+            // progressive mode: remove matches of inactive segments,
+            // remove matches with dissimilar descriptors or without shared structure
+            for(size_t r=0; r<matches_[src].size(); ++r)
+            {
+                // no shared structure around the segment -> all matches are kept
+                L3DPP::SegmentAnchors anchors;
+                const bool anchored = (use_anchors && anchors.init(v1->keypoints(),v2->keypoints(),
+                                                                   v1->segment(r),radius_src,radius_tgt));
+
+                L3DPP::MatchList::iterator m_it = matches_[src][r].begin();
+                while(m_it!=matches_[src][r].end())
+                {
+                    if(m_it->tgt_camID_ == tgt && (!v1->active(r) || !v2->active(m_it->tgt_segID_) ||
+                                                   (check_descriptors &&
+                                                    L3DPP::hammingDistance(v1->descriptor(r),v2->descriptor(m_it->tgt_segID_)) > max_hamming) ||
+                                                   (anchored && anchors.support(v2->segment(m_it->tgt_segID_)) <= 0.0f)))
+                    {
+                        m_it = matches_[src][r].erase(m_it);
+                        --num_matches;
+                    }
+                    else
+                    {
+                        ++m_it;
+                    }
+                }
+            }
+        }
 
         num_matches_[src] += num_matches;
 
         // cleanup
-        v2->lines()->removeFromGPU();
-        v2->RtKinvGPU()->removeFromGPU();
         delete F_GPU;
 
 #endif //L3DPP_CUDA
     }
 
     //------------------------------------------------------------------------------
-    bool Line3D::pointOnSegment(const Eigen::Vector3d& x, const Eigen::Vector3d& p1,
-                                const Eigen::Vector3d& p2)
+    template<class P>
+    bool Line3D::pointOnSegment(const typename P::Vector3& x, const typename P::Vector3& p1,
+                                const typename P::Vector3& p2)
     {
-        Eigen::Vector2d v1(p1.x()-x.x(),p1.y()-x.y());
-        Eigen::Vector2d v2(p2.x()-x.x(),p2.y()-x.y());
+        typename P::Vector2 v1(p1.x()-x.x(),p1.y()-x.y());
+        typename P::Vector2 v2(p2.x()-x.x(),p2.y()-x.y());
         return (v1.dot(v2) < L3D_EPS);
     }
 
     //------------------------------------------------------------------------------
-    float Line3D::mutualOverlap(const std::vector<Eigen::Vector3d>& collinear_points)
+    template<class P>
+    float Line3D::mutualOverlap(const typename P::Vector3* collinear_points)
     {
         float overlap = 0.0f;
 
-        if(collinear_points.size() != 4)
-            return 0.0f;
-
-        Eigen::Vector3d p1 = collinear_points[0];
-        Eigen::Vector3d p2 = collinear_points[1];
-        Eigen::Vector3d q1 = collinear_points[2];
-        Eigen::Vector3d q2 = collinear_points[3];
+        const typename P::Vector3& p1 = collinear_points[0];
+        const typename P::Vector3& p2 = collinear_points[1];
+        const typename P::Vector3& q1 = collinear_points[2];
+        const typename P::Vector3& q2 = collinear_points[3];
 
-        if(pointOnSegment(p1,q1,q2) || pointOnSegment(p2,q1,q2) ||
-                pointOnSegment(q1,p1,p2) || pointOnSegment(q2,p1,p2))
+        if(pointOnSegment<P>(p1,q1,q2) || pointOnSegment<P>(p2,q1,q2) ||
+                pointOnSegment<P>(q1,p1,p2) || pointOnSegment<P>(q2,p1,p2))
         {
             // find outer distance and inner points
             float max_dist = 0.0f;
@@ -1165,31 +2100,23 @@ namespace L3DPP
     }
 
     //------------------------------------------------------------------------------
-    Eigen::Vector2d Line3D::triangulationDepths(const unsigned int src_camID, const Eigen::Vector3d& p1,
-                                                const Eigen::Vector3d& p2, const unsigned int tgt_camID,
-                                                const Eigen::Vector3d& line_q1, const Eigen::Vector3d& line_q2)
+    template<class P>
+    typename P::Vector2 Line3D::triangulationDepths(const typename P::Vector3& ray_p1,
+                                                    const typename P::Vector3& ray_p2,
+                                                    const typename P::Vector3& ray_q1,
+                                                    const typename P::Vector3& ray_q2,
+                                                    const typename P::Vector3& baseline)
     {
-        L3DPP::View* v_src = views_[src_camID];
-        L3DPP::View* v_tgt = views_[tgt_camID];
-
-        // rays through points
-        Eigen::Vector3d C1 = v_src->C();
-        Eigen::Vector3d ray_p1 = v_src->getNormalizedRay(p1);
-        Eigen::Vector3d ray_p2 = v_src->getNormalizedRay(p2);
-
-        // plane
-        Eigen::Vector3d C2 = v_tgt->C();
-        Eigen::Vector3d ray_q1 = v_tgt->getNormalizedRay(line_q1);
-        Eigen::Vector3d ray_q2 = v_tgt->getNormalizedRay(line_q2);
-        Eigen::Vector3d n = ray_q1.cross(ray_q2);
+        // plane through the second camera center and the matched segment
+        typename P::Vector3 n = ray_q1.cross(ray_q2);
         n.normalize();
 
         if(fabs(ray_p1.dot(n)) < L3D_EPS || fabs(ray_p2.dot(n)) < L3D_EPS)
-            return Eigen::Vector2d(-1,-1);
+            return typename P::Vector2(-1,-1);
 
-        double d1 = (C2.dot(n) - n.dot(C1)) / (n.dot(ray_p1));
-        double d2 = (C2.dot(n) - n.dot(C1)) / (n.dot(ray_p2));
-        return Eigen::Vector2d(d1,d2);
+        // intersect rays (relative to the first camera center)
+        typename P::Scalar b = n.dot(baseline);
+        return typename P::Vector2(b/n.dot(ray_p1),b/n.dot(ray_p2));
     }
 
     //------------------------------------------------------------------------------
@@ -1205,99 +2132,239 @@ namespace L3DPP
     }
 
     //------------------------------------------------------------------------------
-    void Line3D::scoringCPU(const unsigned int src, float& valid_f)
+    template<class P>
+    bool Line3D::scoringCPU(const unsigned int camID, const unsigned int segID)
     {
-        // init
-        valid_f = 0.0f;
-        L3DPP::View* v = views_[src];
+        L3DPP::View* v = views_[camID];
         float k = v->k();
+        L3DPP::MatchList& matches = matches_[camID][segID];
 
-        unsigned int num_valid = 0;
+        bool valid_match_exists = false;
+        size_t num_hyps = matches.size();
 
-        // iterative scoring
-#ifdef L3DPP_OPENMP
-        #pragma omp parallel for
-#endif //L3DPP_OPENMP
-        for(int i=0; i<matches_[src].size(); ++i)
+        // unproject once in kernel precision (directions, spatial regularizers),
+        // the endpoints are expressed relative to the camera centers
+        typename P::Vector3 ray1,ray2;
+        v->segmentRaysAs<P>(segID,ray1,ray2);
+
+        std::vector<L3DPP::Match> hyps(matches.begin(),matches.end());
+        std::vector<typename P::Vector3> dirs(num_hyps);
+        std::vector<float> regs1(num_hyps);
+        std::vector<float> regs2(num_hyps);
+        for(size_t j=0; j<num_hyps; ++j)
         {
-            bool valid_match_exists = false;
+            const L3DPP::Match& M = hyps[j];
+            typename P::Vector3 P1 = ray1*typename P::Scalar(M.depth_p1_);
+            typename P::Vector3 P2 = ray2*typename P::Scalar(M.depth_p2_);
 
-            std::list<L3DPP::Match>::iterator it = matches_[src][i].begin();
-            for(; it!=matches_[src][i].end(); ++it)
+            typename P::Vector3 d = P2-P1;
+            typename P::Scalar len = d.norm();
+            dirs[j] = (len > L3D_EPS) ? typename P::Vector3(d/len) : typename P::Vector3(P::Vector3::Zero());
+
+            float sig1 = M.depth_p1_*k;
+            float sig2 = M.depth_p2_*k;
+
+            // compute spatial regularizers (tgt)
+            L3DPP::View* v_tgt = views_[M.tgt_camID_];
+            typename P::Vector3 offset = v->centerOffsetAs<P>(v_tgt);
+            float sig1_tgt = v_tgt->regularizerFromOffsetAs<P>(offset+P1);
+            float sig2_tgt = v_tgt->regularizerFromOffsetAs<P>(offset+P2);
+
+            regs1[j] = 0.5f*(2.0f*sig1*sig1 + 2.0f*sig1_tgt*sig1_tgt);
+            regs2[j] = 0.5f*(2.0f*sig2*sig2 + 2.0f*sig2_tgt*sig2_tgt);
+        }
+
+        // many hypotheses -> hash by depths (only hypotheses within the
+        // depth radius of the similarity cutoff can contribute)
+        bool use_hash = (num_hyps >= L3D_DEF_SCORING_HASH_MIN_HYPOTHESES &&
+                         L3D_DEF_MIN_SIMILARITY_3D > 0.0f && L3D_DEF_MIN_SIMILARITY_3D < 1.0f);
+        std::vector<float> radii1,radii2,angles;
+        float radius_angle = 180.0f;
+        L3DPP::HypothesisHash hash;
+        if(use_hash)
+        {
+            // all hypotheses lie in the viewing plane -> direction = angle in this plane
+            typename P::Vector3 e2 = ray2-ray1*ray1.dot(ray2);
+            if(e2.norm() > L3D_EPS)
             {
-                L3DPP::Match M = *it;
-                float score3D = 0.0f;
-                std::map<unsigned int,float> score_per_cam;
+                e2.normalize();
+                angles.resize(num_hyps);
+                for(size_t j=0; j<num_hyps; ++j)
+                {
+                    float angle = atan2(dirs[j].dot(e2),dirs[j].dot(ray1))/M_PI*180.0f;
+                    angles[j] = (angle < 0.0f) ? angle+180.0f : angle;
+                }
+            }
 
-                // unproject once
-                L3DPP::Segment3D M3D = v->unprojectSegment(M.src_segID_,M.depth_p1_,M.depth_p2_);
+            buildHypothesisHash(hyps,regs1,regs2,angles,radii1,radii2,radius_angle,hash);
+        }
 
-                // compute spatial regularizers
-                float reg1,reg2;
-                float sig1 = M.depth_p1_*k;
-                float sig2 = M.depth_p2_*k;
+        std::vector<unsigned int> candidates;
+        for(size_t j=0; j<num_hyps; ++j)
+        {
+            const L3DPP::Match& M = hyps[j];
+            float score3D = 0.0f;
+            std::map<unsigned int,float> score_per_cam;
 
-                reg1 = 2.0f*sig1*sig1;
-                reg2 = 2.0f*sig2*sig2;
+            // candidates (in list order)
+            bool all_candidates = true;
+            if(use_hash && radii1[j] >= 0.0f)
+            {
+                if(angles.size() > 0)
+                    hash.query(M.depth_p1_,M.depth_p2_,radii1[j],radii2[j],angles[j],radius_angle,candidates);
+                else
+                    hash.query(M.depth_p1_,M.depth_p2_,radii1[j],radii2[j],candidates);
 
-                // compute spatial regularizers (tgt)
-                float sig1_tgt = views_[M.tgt_camID_]->regularizerFrom3Dpoint(M3D.P1());
-                float sig2_tgt = views_[M.tgt_camID_]->regularizerFrom3Dpoint(M3D.P2());
+                all_candidates = false;
+            }
 
-                reg1 = 0.5f*(reg1 + 2.0f*sig1_tgt*sig1_tgt);
-                reg2 = 0.5f*(reg2 + 2.0f*sig2_tgt*sig2_tgt);
+            size_t num_candidates = all_candidates ? num_hyps : candidates.size();
+            for(size_t c=0; c<num_candidates; ++c)
+            {
+                size_t j2 = all_candidates ? c : candidates[c];
+                const L3DPP::Match& M2 = hyps[j2];
 
-                std::list<L3DPP::Match>::const_iterator it2 = matches_[src][i].begin();
-                for(; it2!=matches_[src][i].end(); ++it2)
+                if(M.tgt_camID_ != M2.tgt_camID_)
                 {
-                    L3DPP::Match M2 = *it2;
+                    // compute similarity
+                    float sim = similarityForScoring<P>(M,M2,dirs[j],dirs[j2],regs1[j],regs2[j]);
 
-                    if(M.tgt_camID_ != M2.tgt_camID_)
+                    if(score_per_cam.find(M2.tgt_camID_) != score_per_cam.end())
                     {
-                        // compute similarity
-                        float sim = similarityForScoring(M,M2,M3D,reg1,reg2);
-
-                        if(score_per_cam.find(M2.tgt_camID_) != score_per_cam.end())
-                        {
-                            if(sim > score_per_cam[M2.tgt_camID_])
-                            {
-                                score3D -= score_per_cam[M2.tgt_camID_];
-                                score3D += sim;
-                                score_per_cam[M2.tgt_camID_] = sim;
-                            }
-                        }
-                        else
+                        if(sim > score_per_cam[M2.tgt_camID_])
                         {
+                            score3D -= score_per_cam[M2.tgt_camID_];
                             score3D += sim;
                             score_per_cam[M2.tgt_camID_] = sim;
                         }
                     }
+                    else
+                    {
+                        score3D += sim;
+                        score_per_cam[M2.tgt_camID_] = sim;
+                    }
                 }
+            }
+
+            hyps[j].score3D_ = score3D;
+            if(score3D > L3D_DEF_MIN_BEST_SCORE_3D)
+            {
+                valid_match_exists = true;
+            }
+        }
+
+        // write back
+        L3DPP::MatchList::iterator it = matches.begin();
+        for(size_t j=0; it!=matches.end(); ++it,++j)
+            (*it).score3D_ = hyps[j].score3D_;
+
+        return valid_match_exists;
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::scoreView(const unsigned int src, float& valid_f)
+    {
+        ScoringKernel scoring = scoringKernel();
 
-                (*it).score3D_ = score3D;
-                if(score3D > L3D_DEF_MIN_BEST_SCORE_3D)
+        unsigned int num_valid = 0;
+        unsigned int node = viewNode(src);
+
+        // segment by segment, the hypothesis arrays are placed on the
+        // node of the view (threads run there as well, if pinned)
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel
+#endif //L3DPP_OPENMP
+        {
+            L3DPP::ThreadPinning pinning(numa_,node,pin_threads_);
+            L3DPP::MemoryPlacement placement(numa_,node);
+
+#ifdef L3DPP_OPENMP
+            #pragma omp for schedule(dynamic)
+#endif //L3DPP_OPENMP
+            for(int i=0; i<matches_[src].size(); ++i)
+            {
+                if((this->*scoring)(src,i))
                 {
-                    valid_match_exists = true;
+                    scoring_mutex_.lock();
+                    ++num_valid;
+                    scoring_mutex_.unlock();
                 }
             }
+        }
 
-            if(valid_match_exists)
+        // check number of segments with valid matches
+        valid_f = float(num_valid)/float(views_[src]->num_lines());
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::buildHypothesisHash(const std::vector<L3DPP::Match>& hyps,
+                                     const std::vector<float>& regs1,
+                                     const std::vector<float>& regs2,
+                                     const std::vector<float>& angles,
+                                     std::vector<float>& radii1,
+                                     std::vector<float>& radii2,
+                                     float& radius_angle,
+                                     L3DPP::HypothesisHash& hash)
+    {
+        // exp(-d^2/reg) > min_sim <=> |d| < sqrt(reg*ln(1/min_sim))
+        // (with a small margin for rounding errors), same for the angle
+        float log_t = -logf(L3D_DEF_MIN_SIMILARITY_3D);
+        radius_angle = sqrtf(two_sigA_sqr_*log_t)*1.01f+0.1f;
+        radii1.resize(hyps.size());
+        radii2.resize(hyps.size());
+
+        std::vector<float> depths1(hyps.size());
+        std::vector<float> depths2(hyps.size());
+        std::vector<float> radii;
+        float min_depth = std::numeric_limits<float>::max();
+        float max_depth = -std::numeric_limits<float>::max();
+        for(size_t j=0; j<hyps.size(); ++j)
+        {
+            radii1[j] = sqrtf(fmax(regs1[j],0.0f)*log_t)*1.01f+L3D_EPS;
+            radii2[j] = sqrtf(fmax(regs2[j],0.0f)*log_t)*1.01f+L3D_EPS;
+
+            depths1[j] = hyps[j].depth_p1_;
+            depths2[j] = hyps[j].depth_p2_;
+
+            if(radii1[j] < std::numeric_limits<float>::max() &&
+                    radii2[j] < std::numeric_limits<float>::max())
             {
-                scoring_mutex_.lock();
-                ++num_valid;
-                scoring_mutex_.unlock();
+                radii.push_back(fmax(radii1[j],radii2[j]));
+            }
+            else
+            {
+                // invalid (NaN/inf) -> all hypotheses are candidates
+                radii1[j] = -1.0f;
+                radii2[j] = -1.0f;
             }
+
+            min_depth = fmin(min_depth,fmin(depths1[j],depths2[j]));
+            max_depth = fmax(max_depth,fmax(depths1[j],depths2[j]));
         }
 
-        // check number of segments with valid matches
-        valid_f = float(num_valid)/float(v->num_lines());
+        // cell size: median radius (at most 'num_hyps' cells per axis)
+        float cell_size = (max_depth-min_depth)/float(hyps.size());
+        if(radii.size() > 0)
+        {
+            std::nth_element(radii.begin(),radii.begin()+radii.size()/2,radii.end());
+            cell_size = fmax(cell_size,radii[radii.size()/2]);
+        }
+        cell_size = fmax(cell_size,L3D_EPS);
+
+        // angle cells: max. angle difference (a query
+        // covers at most three of them)
+        float angle_cell_size = 180.0f;
+        if(angles.size() == hyps.size() && radius_angle < 45.0f)
+            angle_cell_size = radius_angle;
+
+        hash.build(depths1,depths2,angles,cell_size,angle_cell_size);
     }
 
     //------------------------------------------------------------------------------
     void Line3D::scoringGPU(const unsigned int src, float& valid_f)
     {
 #ifdef L3DPP_CUDA
-        // INFO: src data must be on GPU! initSrcDataGPU(src) -> remove afterwards!
+        // INFO: src data must be on GPU! initViewDataGPU(src) -> remove afterwards!
 
         // init
         valid_f = 0.0f;
@@ -1311,61 +2378,61 @@ namespace L3DPP
         sortMatches(src);
 
         // find start and end indices
-        L3DPP::DataArray<int2>* ranges = new L3DPP::DataArray<int2>(v->num_lines(),1);
+        L3DPP::DataArray<int2> ranges(v->num_lines(),1,&buffer_pool_);
         unsigned int offset = 0;
         for(size_t i=0; i<v->num_lines(); ++i)
         {
             if(matches_[src][i].size() > 0)
             {
-                ranges->dataCPU(i,0)[0] = make_int2(offset,offset+matches_[src][i].size()-1);
+                ranges.dataCPU(i,0)[0] = make_int2(offset,offset+matches_[src][i].size()-1);
                 offset += matches_[src][i].size();
             }
             else
             {
                 // no matches for this segment
-                ranges->dataCPU(i,0)[0] = make_int2(-1,-1);
+                ranges.dataCPU(i,0)[0] = make_int2(-1,-1);
             }
         }
 
         // store matches in array
-        L3DPP::DataArray<float4>* matches = new L3DPP::DataArray<float4>(num_matches_[src],1);
-        L3DPP::DataArray<float2>* regularizers_tgt = new L3DPP::DataArray<float2>(num_matches_[src],1);
-        L3DPP::DataArray<float>* scores = new L3DPP::DataArray<float>(num_matches_[src],1,true);
+        L3DPP::DataArray<float4> matches(num_matches_[src],1,&buffer_pool_);
+        L3DPP::DataArray<float2> regularizers_tgt(num_matches_[src],1,&buffer_pool_);
+        L3DPP::DataArray<float> scores(num_matches_[src],1,&buffer_pool_,true);
 
 #ifdef L3DPP_OPENMP
         #pragma omp parallel for
 #endif //L3DPP_OPENMP
         for(int i=0; i<matches_[src].size(); ++i)
         {
-            int offset = ranges->dataCPU(i,0)[0].x;
+            int offset = ranges.dataCPU(i,0)[0].x;
             if(offset >= 0)
             {
                 int id = 0;
-                std::list<L3DPP::Match>::const_iterator it = matches_[src][i].begin();
+                L3DPP::MatchList::const_iterator it = matches_[src][i].begin();
                 for(; it!=matches_[src][i].end(); ++it,++id)
                 {
                     L3DPP::Match m = *it;
-                    matches->dataCPU(offset+id,0)[0] = make_float4(i,m.tgt_camID_,
+                    matches.dataCPU(offset+id,0)[0] = make_float4(i,m.tgt_camID_,
                                                                    m.depth_p1_,m.depth_p2_);
                     L3DPP::Segment3D s3D = v->unprojectSegment(m.src_segID_,m.depth_p1_,m.depth_p2_);
-                    regularizers_tgt->dataCPU(offset+id,0)[0] = make_float2(views_[m.tgt_camID_]->regularizerFrom3Dpoint(s3D.P1()),
+                    regularizers_tgt.dataCPU(offset+id,0)[0] = make_float2(views_[m.tgt_camID_]->regularizerFrom3Dpoint(s3D.P1()),
                                                                             views_[m.tgt_camID_]->regularizerFrom3Dpoint(s3D.P2()));
                 }
             }
         }
 
         // upload
-        ranges->upload();
-        matches->upload();
-        regularizers_tgt->upload();
+        ranges.upload();
+        matches.upload();
+        regularizers_tgt.upload();
 
         unsigned int num_valid = 0;
 
         // score on GPU
-        L3DPP::score_matches_GPU(v->lines(),matches,ranges,scores,regularizers_tgt,
+        L3DPP::score_matches_GPU(v->lines(),&matches,&ranges,&scores,&regularizers_tgt,
                                  v->RtKinvGPU(),v->C_GPU(),
                                  two_sigA_sqr_,k,L3D_DEF_MIN_SIMILARITY_3D);
-        scores->download();
+        scores.download();
 
         // write back
 #ifdef L3DPP_OPENMP
@@ -1374,15 +2441,15 @@ namespace L3DPP
         for(int i=0; i<matches_[src].size(); ++i)
         {
             bool valid_match_exists = false;
-            int offset = ranges->dataCPU(i,0)[0].x;
+            int offset = ranges.dataCPU(i,0)[0].x;
             if(offset >= 0)
             {
                 int id = 0;
-                std::list<L3DPP::Match>::iterator it = matches_[src][i].begin();
+                L3DPP::MatchList::iterator it = matches_[src][i].begin();
                 for(; it!=matches_[src][i].end(); ++it,++id)
                 {
                     // get score
-                    float score = scores->dataCPU(offset+id,0)[0];
+                    float score = scores.dataCPU(offset+id,0)[0];
 
                     // update
                     (*it).score3D_ = score;
@@ -1404,27 +2471,25 @@ namespace L3DPP
 
         // check number of segments with valid matches
         valid_f = float(num_valid)/float(v->num_lines());
-
-        // cleanup
-        delete ranges;
-        delete matches;
-        delete scores;
-        delete regularizers_tgt;
 #endif //L3DPP_CUDA
     }
 
     //------------------------------------------------------------------------------
+    template<class P>
     float Line3D::similarityForScoring(const L3DPP::Match& m1, const L3DPP::Match& m2,
-                                       const L3DPP::Segment3D& seg3D1,
+                                       const typename P::Vector3& dir1,
+                                       const typename P::Vector3& dir2,
                                        const float reg1, const float reg2)
     {
-        L3DPP::Segment3D seg3D2 = unprojectMatch(m2,true);
-
-        if(seg3D1.length() < L3D_EPS || seg3D2.length() < L3D_EPS)
+        if(dir1.squaredNorm() < L3D_EPS || dir2.squaredNorm() < L3D_EPS)
             return 0.0f;
 
-        // angular similarity
-        float angle = angleBetweenSeg3D(seg3D1,seg3D2,true);
+        // angular similarity (undirected)
+        float dot_p = dir1.dot(dir2);
+        float angle = acos(fmax(fmin(dot_p,1.0f),-1.0f))/M_PI*180.0f;
+        if(angle > 90.0f)
+            angle = 180.0f-angle;
+
         float sim_a = expf(-angle*angle/two_sigA_sqr_);
 
         // positional similarity
@@ -1455,34 +2520,27 @@ namespace L3DPP
             return 0.0f;
         }
 
-        size_t ent1 = entry_map_[seg1];
-        std::pair<L3DPP::Segment3D,L3DPP::Match> data1 = estimated_position3D_[ent1];
-        L3DPP::Segment3D s1 = data1.first;
-        L3DPP::Match m1 = data1.second;
-
-        return similarity(s1,m1,seg2,truncate);
-    }
-
-    //------------------------------------------------------------------------------
-    float Line3D::similarity(const L3DPP::Segment3D& s1, const L3DPP::Match& m1,
-                             const L3DPP::Segment2D& seg2, const bool truncate)
-    {
-        // check for 3D estimates
         if(entry_map_.find(seg2) == entry_map_.end())
         {
             return 0.0f;
         }
 
-        size_t ent2 = entry_map_[seg2];
-        std::pair<L3DPP::Segment3D,L3DPP::Match> data2 = estimated_position3D_[ent2];
-        L3DPP::Segment3D s2 = data2.first;
-        L3DPP::Match m2 = data2.second;
+        return similarity(estimated_position3D_[entry_map_[seg1]],
+                          estimated_position3D_[entry_map_[seg2]],truncate);
+    }
+
+    //------------------------------------------------------------------------------
+    float Line3D::similarity(const L3DPP::Hypothesis3D& hyp1, const L3DPP::Hypothesis3D& hyp2,
+                             const bool truncate)
+    {
+        L3DPP::Segment3D s1 = hyp1.seg3D();
+        L3DPP::Segment3D s2 = hyp2.seg3D();
 
         if(s1.length() < L3D_EPS || s2.length() < L3D_EPS)
             return 0.0f;
 
-        L3DPP::View* v1 = views_[m1.src_camID_];
-        L3DPP::View* v2 = views_[m2.src_camID_];
+        L3DPP::View* v1 = views_[hyp1.camID()];
+        L3DPP::View* v2 = views_[hyp2.camID()];
 
         // angular similarity
         float angle = angleBetweenSeg3D(s1,s2,true);
@@ -1506,31 +2564,31 @@ namespace L3DPP
 
         float reg11,reg12,reg21,reg22;
         float sig11;
-        if(m1.depth_p1_ > cutoff1)
+        if(hyp1.depth_p1() > cutoff1)
             sig11 = cutoff1*v1->k();
         else
-            sig11 = m1.depth_p1_*v1->k();
+            sig11 = hyp1.depth_p1()*v1->k();
 
         float sig12;
-        if(m1.depth_p2_ > cutoff1)
+        if(hyp1.depth_p2() > cutoff1)
             sig12 = cutoff1*v1->k();
         else
-            sig12 = m1.depth_p2_*v1->k();
+            sig12 = hyp1.depth_p2()*v1->k();
 
         reg11 = 2.0f*sig11*sig11;
         reg12 = 2.0f*sig12*sig12;
 
         float sig21;
-        if(m2.depth_p1_ > cutoff2)
+        if(hyp2.depth_p1() > cutoff2)
             sig21 = cutoff2*v2->k();
         else
-            sig21 = m2.depth_p1_*v2->k();
+            sig21 = hyp2.depth_p1()*v2->k();
 
         float sig22;
-        if(m2.depth_p2_ > cutoff2)
+        if(hyp2.depth_p2() > cutoff2)
             sig22 = cutoff2*v2->k();
         else
-            sig22 = m2.depth_p2_*v2->k();
+            sig22 = hyp2.depth_p2()*v2->k();
 
         reg21 = 2.0f*sig21*sig21;
         reg22 = 2.0f*sig22*sig22;
@@ -1592,7 +2650,7 @@ namespace L3DPP
         float max_score = 0.0f;
         for(size_t i=0; i<matches_[src].size(); ++i)
         {
-            std::list<L3DPP::Match>::const_iterator it = matches_[src][i].begin();
+            L3DPP::MatchList::const_iterator it = matches_[src][i].begin();
             for(; it!=matches_[src][i].end(); ++it)
             {
                 max_score = fmax(max_score,(*it).score3D_);
@@ -1613,17 +2671,19 @@ namespace L3DPP
             L3DPP::Match best_match;
             best_match.score3D_ = 0.0f;
 
-            std::list<L3DPP::Match> matches = matches_[src][i];
-            matches_[src][i].clear();
-            std::list<L3DPP::Match>::const_iterator it = matches.begin();
-            for(; it!=matches.end(); ++it)
+            L3DPP::MatchList::iterator it = matches_[src][i].begin();
+            while(it!=matches_[src][i].end())
             {
                 if((*it).score3D_ > 0.0f && (*it).score3D_ > score_lim)
                 {
-                    matches_[src][i].push_back(*it);
-
                     if((*it).score3D_ > best_match.score3D_)
                         best_match = (*it);
+
+                    ++it;
+                }
+                else
+                {
+                    it = matches_[src][i].erase(it);
                 }
             }
 
@@ -1638,7 +2698,7 @@ namespace L3DPP
                 L3DPP::Segment3D seg3D = unprojectMatch(best_match,true);
                 best_match_mutex_.lock();
                 entry_map_[seg] = estimated_position3D_.size();
-                estimated_position3D_.push_back(std::pair<L3DPP::Segment3D,L3DPP::Match>(seg3D,best_match));
+                estimated_position3D_.push_back(L3DPP::Hypothesis3D(seg3D,best_match));
 
                 // store depths
                 depths.push_back(best_match.depth_p1_);
@@ -1673,7 +2733,7 @@ namespace L3DPP
     {
         for(size_t i=0; i<matches_[src].size(); ++i)
         {
-            std::list<L3DPP::Match>::const_iterator it = matches_[src][i].begin();
+            L3DPP::MatchList::const_iterator it = matches_[src][i].begin();
             for(; it!=matches_[src][i].end(); ++it)
             {
                 L3DPP::Match m = *it;
@@ -1698,10 +2758,120 @@ namespace L3DPP
         }
     }
 
+    //------------------------------------------------------------------------------
+    void Line3D::buildTracks()
+    {
+        tracks_.clear();
+
+        // one node per segment (consecutive per view)
+        std::map<unsigned int,int> offsets;
+        int num_nodes = 0;
+        std::map<unsigned int,std::vector<L3DPP::MatchList> >::const_iterator m_it = matches_.begin();
+        for(; m_it!=matches_.end(); ++m_it)
+        {
+            offsets[m_it->first] = num_nodes;
+            num_nodes += m_it->second.size();
+        }
+
+        // best (valid) match of each segment per target view
+        std::vector<std::pair<std::pair<int,int>,float> > best;
+        for(m_it=matches_.begin(); m_it!=matches_.end(); ++m_it)
+        {
+            int offset = offsets[m_it->first];
+            for(size_t i=0; i<m_it->second.size(); ++i)
+            {
+                std::map<unsigned int,std::pair<int,float> > best_per_view;
+                L3DPP::MatchList::const_iterator it = m_it->second[i].begin();
+                for(; it!=m_it->second[i].end(); ++it)
+                {
+                    std::map<unsigned int,int>::const_iterator o_it = offsets.find(it->tgt_camID_);
+                    if(o_it == offsets.end() || it->score3D_ <= 0.0f)
+                        continue;
+
+                    std::map<unsigned int,std::pair<int,float> >::iterator b_it = best_per_view.find(it->tgt_camID_);
+                    if(b_it == best_per_view.end() || it->score3D_ > b_it->second.second)
+                        best_per_view[it->tgt_camID_] = std::pair<int,float>(o_it->second+it->tgt_segID_,it->score3D_);
+                }
+
+                std::map<unsigned int,std::pair<int,float> >::const_iterator b_it = best_per_view.begin();
+                for(; b_it!=best_per_view.end(); ++b_it)
+                {
+                    int a = offset+i;
+                    int b = b_it->second.first;
+                    best.push_back(std::pair<std::pair<int,int>,float>(std::pair<int,int>(std::min(a,b),std::max(a,b)),
+                                                                       b_it->second.second));
+                }
+            }
+        }
+
+        // mutual correspondences (best in both directions -> pair found twice)
+        std::sort(best.begin(),best.end());
+        std::vector<std::pair<float,std::pair<int,int> > > links;
+        for(size_t i=1; i<best.size(); ++i)
+        {
+            if(best[i].first == best[i-1].first)
+            {
+                float score = fmin(best[i].second,best[i-1].second);
+                links.push_back(std::pair<float,std::pair<int,int> >(score,best[i].first));
+            }
+        }
+
+        // join the strongest links first, tracks are limited in size
+        // (no giant components through chains of weak links)
+        std::sort(links.rbegin(),links.rend());
+        L3DPP::CLUniverse* u = new L3DPP::CLUniverse(num_nodes);
+        for(size_t i=0; i<links.size(); ++i)
+        {
+            int a = u->find(links[i].second.first);
+            int b = u->find(links[i].second.second);
+            if(a != b && u->size(a)+u->size(b) <= L3D_DEF_MAX_TRACK_SIZE)
+                u->join(a,b);
+        }
+
+        // segments with matches only (unlinked segments -> single segment tracks)
+        std::map<int,size_t> root2track;
+        for(m_it=matches_.begin(); m_it!=matches_.end(); ++m_it)
+        {
+            int offset = offsets[m_it->first];
+            for(size_t i=0; i<m_it->second.size(); ++i)
+            {
+                if(m_it->second[i].size() == 0)
+                    continue;
+
+                L3DPP::Segment2D seg(m_it->first,i);
+                int root = u->find(offset+i);
+                std::map<int,size_t>::const_iterator t_it = root2track.find(root);
+                if(t_it == root2track.end())
+                {
+                    root2track[root] = tracks_.size();
+                    tracks_.push_back(std::vector<L3DPP::Segment2D>(1,seg));
+                }
+                else
+                {
+                    tracks_[t_it->second].push_back(seg);
+                }
+            }
+        }
+        delete u;
+
+        // largest tracks first (load balancing)
+        std::vector<std::pair<size_t,size_t> > by_size(tracks_.size());
+        for(size_t t=0; t<tracks_.size(); ++t)
+            by_size[t] = std::pair<size_t,size_t>(tracks_[t].size(),t);
+
+        std::sort(by_size.rbegin(),by_size.rend());
+
+        std::vector<std::vector<L3DPP::Segment2D> > sorted(tracks_.size());
+        for(size_t t=0; t<by_size.size(); ++t)
+            sorted[t].swap(tracks_[by_size[t].second]);
+
+        tracks_.swap(sorted);
+    }
+
     //------------------------------------------------------------------------------
     void Line3D::reconstruct3Dlines(const unsigned int visibility_t, const bool perform_diffusion,
                                     const float collinearity_t, const bool use_CERES,
-                                    const unsigned int max_iter_CERES)
+                                    const unsigned int max_iter_CERES, const float rdd_prune_t)
     {
         // no views can be added during reconstruction!
         view_mutex_.lock();
@@ -1722,18 +2892,12 @@ namespace L3DPP
         visibility_t_ = std::max(int(visibility_t),3);
         clusters3D_.clear();
         lines3D_.clear();
+        spatial_index_.clear();
         float prev_collin_t = collinearity_t_;
         collinearity_t_ = collinearity_t;
 
-#ifdef L3DPP_CUDA
-        perform_RDD_ = (perform_diffusion && useGPU_);
-        if(perform_diffusion && !useGPU_)
-            std::cout << prefix_err_ << "diffusion only possible when GPU mode enabled! using graph clustering instead..." << std::endl;
-#else
-        perform_RDD_ = false;
-        if(perform_diffusion)
-            std::cout << prefix_err_ << "diffusion not possible without CUDA! using graph clustering instead..." << std::endl;
-#endif //L3DPP_CUDA
+        perform_RDD_ = perform_diffusion;
+        rdd_prune_t_ = std::max(rdd_prune_t,0.0f);
 
 #ifdef L3DPP_CERES
         use_CERES_ = use_CERES;
@@ -1778,15 +2942,18 @@ namespace L3DPP
         computingAffinityMatrix();
 
         std::cout << prefix_ << "A: ";
-        std::cout << "#entries=" << A_.size() << ", #rows=" << global2local_.size();
+        std::cout << "#entries=" << A_.size() << ", #rows=" << local2global_.size();
 
-        unsigned int perc = float(global2local_.size())/float(num_lines_total_)*100.0f;
-        std::cout << " [~" << perc << "%]" << std::endl;
+        unsigned int perc = float(local2global_.size())/float(num_lines_total_)*100.0f;
+        std::cout << " [~" << perc << "%], #tracks=" << track_rows_.size() << std::endl;
 
         // perform diffusion
         if(perform_RDD_)
         {
-            std::cout << prefix_ << "matrix diffusion..." << std::endl;
+            std::cout << prefix_ << "matrix diffusion...";
+            if(rdd_prune_t_ > 0.0f)
+                std::cout << " [prune_t=" << rdd_prune_t_ << "]";
+            std::cout << std::endl;
             performRDD();
         }
 
@@ -1794,8 +2961,8 @@ namespace L3DPP
         std::cout << prefix_ << "clustering segments..." << std::endl;
         clusterSegments();
 
-        global2local_.clear();
         local2global_.clear();
+        track_rows_.clear();
 
         // optimize
         if(use_CERES_)
@@ -1814,11 +2981,35 @@ namespace L3DPP
         std::cout << prefix_ << "filtering tiny segments..." << std::endl;
         filterTinySegments();
 
+        // segment IDs for the results
+        if(spatial_segment_order_)
+            mapToOriginalSegmentIDs();
+
         std::cout << prefix_ << "3D lines: total=" << lines3D_.size() << std::endl;
 
         // untranslate
         untranslate();
 
+        // spatial and reverse index
+        spatial_index_.build(lines3D_);
+
+        std::map<unsigned int,unsigned int> num_segments;
+        std::map<unsigned int,L3DPP::View*>::const_iterator v_it = views_.begin();
+        for(; v_it!=views_.end(); ++v_it)
+            num_segments[v_it->first] = v_it->second->num_lines();
+
+        L3DPP::ReverseIndex reverse_index;
+        reverse_index.build(lines3D_,num_segments);
+
+        // the snapshot takes over the model (previous one stays valid while in use)
+        L3DPP::ResultSnapshot* snapshot = new L3DPP::ResultSnapshot(lines3D_,reverse_index);
+        snapshot_mutex_.lock();
+        std::swap(snapshot,snapshot_);
+        snapshot_mutex_.unlock();
+
+        if(snapshot != NULL)
+            snapshot->release();
+
         view_reserve_mutex_.unlock();
         view_mutex_.unlock();
     }
@@ -1826,7 +3017,23 @@ namespace L3DPP
     //------------------------------------------------------------------------------
     void Line3D::findCollinearSegments()
     {
-        if(collinearity_t_ > L3D_EPS)
+        if(collinearity_t_ > L3D_EPS && !useGPU_ && thread_views_.size() > 1 &&
+                views_.size() >= thread_views_.size())
+        {
+            // one view per thread (on the node that owns the view)
+            std::cout << prefix_ << "processing " << views_.size() << " views..." << std::endl;
+#ifdef L3DPP_OPENMP
+            #pragma omp parallel for schedule(static,1)
+#endif //L3DPP_OPENMP
+            for(int t=0; t<thread_views_.size(); ++t)
+            {
+                L3DPP::ThreadPinning pinning(numa_,thread_nodes_[t],pin_threads_);
+
+                for(size_t i=0; i<thread_views_[t].size(); ++i)
+                    views_[thread_views_[t][i]]->findCollinearSegments(collinearity_t_,useGPU_);
+            }
+        }
+        else if(collinearity_t_ > L3D_EPS)
         {
             std::map<unsigned int,L3DPP::View*>::iterator it=views_.begin();
             unsigned int i=0;
@@ -1853,226 +3060,494 @@ namespace L3DPP
     {
         // reset
         A_.clear();
-        global2local_.clear();
+        affinity_arena_.release();
         local2global_.clear();
-        localID_ = 0;
-        used_.clear();
+        track_rows_.clear();
+
+        // candidate pairs: hypotheses of matched segments (always within one track),
+        // 'directed' keeps the segment in whose match list a pair was found
+        std::vector<std::pair<size_t,size_t> > candidates;
+        std::vector<std::pair<size_t,size_t> > directed;
+        std::vector<int> entry2track(estimated_position3D_.size(),-1);
 
 #ifdef L3DPP_OPENMP
-        #pragma omp parallel for
+        #pragma omp parallel for schedule(dynamic)
 #endif //L3DPP_OPENMP
-        for(int i=0; i<estimated_position3D_.size(); ++i)
+        for(int t=0; t<tracks_.size(); ++t)
         {
-            L3DPP::Segment3D seg3D = estimated_position3D_[i].first;
-            L3DPP::Match m = estimated_position3D_[i].second;
-            L3DPP::Segment2D seg2D(m.src_camID_,m.src_segID_);
-            bool found_aff = false;
-            int id1 = -1;
-
-            // iterate over matches
-            std::list<L3DPP::Match>::const_iterator m_it = matches_[m.src_camID_][m.src_segID_].begin();
-            for(; m_it!=matches_[m.src_camID_][m.src_segID_].end(); ++m_it)
+            std::vector<std::pair<size_t,size_t> > local_directed;
+            for(size_t k=0; k<tracks_[t].size(); ++k)
             {
-                L3DPP::Match m2 = *m_it;
-                L3DPP::Segment2D seg2D2(m2.tgt_camID_,m2.tgt_segID_);
+                const L3DPP::Segment2D& seg2D = tracks_[t][k];
+                std::map<L3DPP::Segment2D,size_t>::const_iterator e1_it = entry_map_.find(seg2D);
 
-                float sim = similarity(seg3D,m,seg2D2,false);
+                // no 3D hypothesis -> no affinity
+                if(e1_it == entry_map_.end())
+                    continue;
 
-                if(sim > L3D_DEF_MIN_AFFINITY && unused(seg2D,seg2D2))
+                size_t ent = e1_it->second;
+                entry2track[ent] = t;
+
+                L3DPP::MatchList::const_iterator m_it = matches_[seg2D.camID()][seg2D.segID()].begin();
+                for(; m_it!=matches_[seg2D.camID()][seg2D.segID()].end(); ++m_it)
                 {
-                    // check IDs
-                    if(id1 < 0)
-                        id1 = getLocalID(seg2D);
+                    L3DPP::Segment2D seg2D2(m_it->tgt_camID_,m_it->tgt_segID_);
+                    std::map<L3DPP::Segment2D,size_t>::const_iterator e_it = entry_map_.find(seg2D2);
 
-                    int id2 = getLocalID(seg2D2);
+                    if(e_it != entry_map_.end() && e_it->second != ent)
+                        local_directed.push_back(std::pair<size_t,size_t>(ent,e_it->second));
+                }
+            }
 
-                    // push into affinity matrix
-                    aff_mat_mutex_.lock();
+            aff_mat_mutex_.lock();
+            directed.insert(directed.end(),local_directed.begin(),local_directed.end());
+            aff_mat_mutex_.unlock();
+        }
 
-                    CLEdge e;
-                    e.i_ = id1;
-                    e.j_ = id2;
-                    e.w_ = sim;
-                    A_.push_back(e);
-                    e.i_ = id2;
-                    e.j_ = id1;
-                    A_.push_back(e);
-                    found_aff = true;
+        // each unordered pair only once (similarity is symmetric)
+        candidates.resize(directed.size());
+        for(size_t i=0; i<directed.size(); ++i)
+        {
+            candidates[i] = std::pair<size_t,size_t>(std::min(directed[i].first,directed[i].second),
+                                                     std::max(directed[i].first,directed[i].second));
+        }
+        std::sort(candidates.begin(),candidates.end());
+        candidates.erase(std::unique(candidates.begin(),candidates.end()),candidates.end());
 
-                    aff_mat_mutex_.unlock();
+        HypothesisBatch batch;
+        gatherHypotheses(batch);
 
-                    // add links to potentially collinear segments to tgt
-                    if(collinearity_t_ > L3D_EPS)
-                    {
-                        L3DPP::View* v = views_[seg2D2.camID()];
-                        std::list<unsigned int> coll = v->collinearSegments(seg2D2.segID());
+        std::vector<std::pair<std::pair<size_t,size_t>,float> > affinities;
+        evaluateAffinities(batch,candidates,affinities);
 
-                        std::list<unsigned int>::const_iterator cit = coll.begin();
-                        for(; cit!=coll.end(); ++cit)
-                        {
-                            L3DPP::Segment2D seg2D2_coll(seg2D2.camID(),*cit);
+        if(collinearity_t_ > L3D_EPS && affinities.size() > 0)
+        {
+            // links to potentially collinear segments (as before): a hypothesis is linked
+            // to the collinear segments of the matches it has a valid affinity with,
+            // and to its own collinear segments if it has any valid affinity
+            std::set<std::pair<size_t,size_t> > valid_pairs;
+            for(size_t i=0; i<affinities.size(); ++i)
+                valid_pairs.insert(affinities[i].first);
+
+            std::vector<std::pair<size_t,size_t> > coll_candidates;
+            std::vector<bool> linked(estimated_position3D_.size(),false);
+            for(size_t i=0; i<directed.size(); ++i)
+            {
+                size_t ent1 = directed[i].first;
+                size_t ent2 = directed[i].second;
+                if(valid_pairs.find(std::pair<size_t,size_t>(std::min(ent1,ent2),std::max(ent1,ent2))) == valid_pairs.end())
+                    continue;
 
-                            float sim = similarity(seg3D,m,seg2D2_coll,false);
+                linked[ent1] = true;
 
-                            if(sim > L3D_DEF_MIN_AFFINITY && unused(seg2D,seg2D2_coll))
-                            {
-                                // check IDs
-                                int id2 = getLocalID(seg2D2_coll);
-
-                                // push into affinity matrix
-                                aff_mat_mutex_.lock();
-
-                                CLEdge e;
-                                e.i_ = id1;
-                                e.j_ = id2;
-                                e.w_ = sim;
-                                A_.push_back(e);
-                                e.i_ = id2;
-                                e.j_ = id1;
-                                A_.push_back(e);
-
-                                aff_mat_mutex_.unlock();
-                            }
-                        }
+                const L3DPP::Hypothesis3D& hyp = estimated_position3D_[ent2];
+                std::list<unsigned int> coll = views_[hyp.camID()]->collinearSegments(hyp.segID());
+
+                std::list<unsigned int>::const_iterator cit = coll.begin();
+                for(; cit!=coll.end(); ++cit)
+                {
+                    std::map<L3DPP::Segment2D,size_t>::const_iterator e_it = entry_map_.find(L3DPP::Segment2D(hyp.camID(),*cit));
+                    if(e_it != entry_map_.end() && e_it->second != ent1)
+                    {
+                        coll_candidates.push_back(std::pair<size_t,size_t>(std::min(ent1,e_it->second),
+                                                                           std::max(ent1,e_it->second)));
                     }
                 }
             }
 
-            // add links to potentially collinear segments
-            if(found_aff && id1 >= 0 && collinearity_t_ > L3D_EPS)
+            for(size_t ent=0; ent<linked.size(); ++ent)
             {
-                L3DPP::View* v = views_[seg2D.camID()];
-                std::list<unsigned int> coll = v->collinearSegments(seg2D.segID());
+                if(!linked[ent])
+                    continue;
+
+                const L3DPP::Hypothesis3D& hyp = estimated_position3D_[ent];
+                std::list<unsigned int> coll = views_[hyp.camID()]->collinearSegments(hyp.segID());
 
                 std::list<unsigned int>::const_iterator cit = coll.begin();
                 for(; cit!=coll.end(); ++cit)
                 {
-                    L3DPP::Segment2D seg2D_coll(seg2D.camID(),*cit);
+                    std::map<L3DPP::Segment2D,size_t>::const_iterator e_it = entry_map_.find(L3DPP::Segment2D(hyp.camID(),*cit));
+                    if(e_it != entry_map_.end() && e_it->second != ent)
+                    {
+                        coll_candidates.push_back(std::pair<size_t,size_t>(std::min(ent,e_it->second),
+                                                                           std::max(ent,e_it->second)));
+                    }
+                }
+            }
+
+            // not yet evaluated pairs
+            std::sort(coll_candidates.begin(),coll_candidates.end());
+            coll_candidates.erase(std::unique(coll_candidates.begin(),coll_candidates.end()),coll_candidates.end());
+
+            std::vector<std::pair<size_t,size_t> > new_candidates;
+            std::set_difference(coll_candidates.begin(),coll_candidates.end(),
+                                candidates.begin(),candidates.end(),
+                                std::back_inserter(new_candidates));
+
+            evaluateAffinities(batch,new_candidates,affinities);
+        }
+
+        if(affinities.size() == 0)
+            return;
+
+        // local IDs (=row index in A matrix)
+        std::vector<int> entry2local(estimated_position3D_.size(),-1);
+        for(size_t i=0; i<affinities.size(); ++i)
+        {
+            size_t ent[2] = {affinities[i].first.first,affinities[i].first.second};
+            for(unsigned int k=0; k<2; ++k)
+            {
+                if(entry2local[ent[k]] < 0)
+                {
+                    entry2local[ent[k]] = local2global_.size();
+                    local2global_.push_back(estimated_position3D_[ent[k]].seg2D());
+                }
+            }
+        }
+
+        // affinity matrix (symmetric)
+        for(size_t i=0; i<affinities.size(); ++i)
+        {
+            CLEdge e;
+            e.i_ = entry2local[affinities[i].first.first];
+            e.j_ = entry2local[affinities[i].first.second];
+            e.w_ = affinities[i].second;
+            A_.push_back(e);
+            e.i_ = entry2local[affinities[i].first.second];
+            e.j_ = entry2local[affinities[i].first.first];
+            A_.push_back(e);
+        }
+
+        // rows per track
+        groupTrackRows(entry2track,entry2local);
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::HypothesisBatch::resize(const size_t n)
+    {
+        x_.resize(n); y_.resize(n); z_.resize(n);
+        dx_.resize(n); dy_.resize(n); dz_.resize(n);
+        length_.resize(n);
+        reg1_.resize(n); reg2_.resize(n);
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::gatherHypotheses(HypothesisBatch& batch)
+    {
+        batch.resize(estimated_position3D_.size());
+
+        // cutoff depths (per view)
+        std::map<unsigned int,std::pair<float,float> > cutoff_k;
+        std::map<unsigned int,L3DPP::View*>::const_iterator v_it = views_.begin();
+        for(; v_it!=views_.end(); ++v_it)
+        {
+            float cutoff = v_it->second->median_depth();
+            if(med_scene_depth_lines_ > L3D_EPS)
+                cutoff = fmin(cutoff,med_scene_depth_lines_);
+
+            cutoff_k[v_it->first] = std::pair<float,float>(cutoff,v_it->second->k());
+        }
+
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for
+#endif //L3DPP_OPENMP
+        for(int i=0; i<estimated_position3D_.size(); ++i)
+        {
+            const L3DPP::Hypothesis3D& hyp = estimated_position3D_[i];
+            L3DPP::Segment3D seg3D = hyp.seg3D();
+            Eigen::Vector3f dir = seg3D.dirAs<L3DPP::SinglePrecision>();
+
+            batch.x_[i] = seg3D.P1().x();
+            batch.y_[i] = seg3D.P1().y();
+            batch.z_[i] = seg3D.P1().z();
+            batch.dx_[i] = dir.x();
+            batch.dy_[i] = dir.y();
+            batch.dz_[i] = dir.z();
+            batch.length_[i] = seg3D.length();
+
+            const std::pair<float,float>& ck = cutoff_k.find(hyp.camID())->second;
+            float sig1 = fmin(hyp.depth_p1(),ck.first)*ck.second;
+            float sig2 = fmin(hyp.depth_p2(),ck.first)*ck.second;
+            batch.reg1_[i] = fmax(2.0f*sig1*sig1,L3D_EPS);
+            batch.reg2_[i] = fmax(2.0f*sig2*sig2,L3D_EPS);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::evaluateAffinities(const HypothesisBatch& batch,
+                                    const std::vector<std::pair<size_t,size_t> >& candidates,
+                                    std::vector<std::pair<std::pair<size_t,size_t>,float> >& valid)
+    {
+        std::vector<float> sims(candidates.size(),0.0f);
+
+        const int num_blocks = (candidates.size()+L3D_AFFINITY_BLOCK_SIZE-1)/L3D_AFFINITY_BLOCK_SIZE;
+        const float inv_two_sigA_sqr = 1.0f/two_sigA_sqr_;
+
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for
+#endif //L3DPP_OPENMP
+        for(int b=0; b<num_blocks; ++b)
+        {
+            const size_t first = size_t(b)*L3D_AFFINITY_BLOCK_SIZE;
+            const int n = std::min(candidates.size()-first,size_t(L3D_AFFINITY_BLOCK_SIZE));
+
+            // gather both hypotheses of each pair (local arrays -> vectorized below)
+            float x1[L3D_AFFINITY_BLOCK_SIZE], y1[L3D_AFFINITY_BLOCK_SIZE], z1[L3D_AFFINITY_BLOCK_SIZE];
+            float dx1[L3D_AFFINITY_BLOCK_SIZE], dy1[L3D_AFFINITY_BLOCK_SIZE], dz1[L3D_AFFINITY_BLOCK_SIZE];
+            float len1[L3D_AFFINITY_BLOCK_SIZE], reg11[L3D_AFFINITY_BLOCK_SIZE], reg12[L3D_AFFINITY_BLOCK_SIZE];
+            float x2[L3D_AFFINITY_BLOCK_SIZE], y2[L3D_AFFINITY_BLOCK_SIZE], z2[L3D_AFFINITY_BLOCK_SIZE];
+            float dx2[L3D_AFFINITY_BLOCK_SIZE], dy2[L3D_AFFINITY_BLOCK_SIZE], dz2[L3D_AFFINITY_BLOCK_SIZE];
+            float len2[L3D_AFFINITY_BLOCK_SIZE], reg21[L3D_AFFINITY_BLOCK_SIZE], reg22[L3D_AFFINITY_BLOCK_SIZE];
+
+            for(int j=0; j<n; ++j)
+            {
+                const size_t h1 = candidates[first+j].first;
+                const size_t h2 = candidates[first+j].second;
+
+                x1[j] = batch.x_[h1]; y1[j] = batch.y_[h1]; z1[j] = batch.z_[h1];
+                dx1[j] = batch.dx_[h1]; dy1[j] = batch.dy_[h1]; dz1[j] = batch.dz_[h1];
+                len1[j] = batch.length_[h1]; reg11[j] = batch.reg1_[h1]; reg12[j] = batch.reg2_[h1];
 
-                    float sim = similarity(seg3D,m,seg2D_coll,false);
+                x2[j] = batch.x_[h2]; y2[j] = batch.y_[h2]; z2[j] = batch.z_[h2];
+                dx2[j] = batch.dx_[h2]; dy2[j] = batch.dy_[h2]; dz2[j] = batch.dz_[h2];
+                len2[j] = batch.length_[h2]; reg21[j] = batch.reg1_[h2]; reg22[j] = batch.reg2_[h2];
+            }
 
-                    if(sim > L3D_DEF_MIN_AFFINITY && unused(seg2D,seg2D_coll))
-                    {
-                        // check IDs
-                        int id2 = getLocalID(seg2D_coll);
-
-                        // push into affinity matrix
-                        aff_mat_mutex_.lock();
-
-                        CLEdge e;
-                        e.i_ = id1;
-                        e.j_ = id2;
-                        e.w_ = sim;
-                        A_.push_back(e);
-                        e.i_ = id2;
-                        e.j_ = id1;
-                        A_.push_back(e);
-
-                        aff_mat_mutex_.unlock();
-                    }
-                }
+            // positional similarity: min(exp(-a),exp(-b)) = exp(-max(a,b)),
+            // only the largest exponent is needed (branchless, selects
+            // instead of fmaxf -> vectorized without fast-math)
+            float pos_exp[L3D_AFFINITY_BLOCK_SIZE];
+            float cos_a[L3D_AFFINITY_BLOCK_SIZE];
+            for(int j=0; j<n; ++j)
+            {
+                // P1 of the second segment relative to P1 of the first one
+                float wx = x2[j]-x1[j];
+                float wy = y2[j]-y1[j];
+                float wz = z2[j]-z1[j];
+
+                // endpoints of segment 1 -> line 2
+                float t11 = -(wx*dx2[j] + wy*dy2[j] + wz*dz2[j]);
+                float rx11 = -wx - t11*dx2[j];
+                float ry11 = -wy - t11*dy2[j];
+                float rz11 = -wz - t11*dz2[j];
+                float d11 = rx11*rx11 + ry11*ry11 + rz11*rz11;
+
+                float ex = len1[j]*dx1[j]-wx;
+                float ey = len1[j]*dy1[j]-wy;
+                float ez = len1[j]*dz1[j]-wz;
+                float t12 = ex*dx2[j] + ey*dy2[j] + ez*dz2[j];
+                float rx12 = ex - t12*dx2[j];
+                float ry12 = ey - t12*dy2[j];
+                float rz12 = ez - t12*dz2[j];
+                float d12 = rx12*rx12 + ry12*ry12 + rz12*rz12;
+
+                // endpoints of segment 2 -> line 1
+                float t21 = wx*dx1[j] + wy*dy1[j] + wz*dz1[j];
+                float rx21 = wx - t21*dx1[j];
+                float ry21 = wy - t21*dy1[j];
+                float rz21 = wz - t21*dz1[j];
+                float d21 = rx21*rx21 + ry21*ry21 + rz21*rz21;
+
+                float fx = wx + len2[j]*dx2[j];
+                float fy = wy + len2[j]*dy2[j];
+                float fz = wz + len2[j]*dz2[j];
+                float t22 = fx*dx1[j] + fy*dy1[j] + fz*dz1[j];
+                float rx22 = fx - t22*dx1[j];
+                float ry22 = fy - t22*dy1[j];
+                float rz22 = fz - t22*dz1[j];
+                float d22 = rx22*rx22 + ry22*ry22 + rz22*rz22;
+
+                float e11 = d11/reg11[j];
+                float e12 = d12/reg12[j];
+                float e21 = d21/reg21[j];
+                float e22 = d22/reg22[j];
+
+                float e1 = (e11 > e12) ? e11 : e12;
+                float e2 = (e21 > e22) ? e21 : e22;
+                float e = (e1 > e2) ? e1 : e2;
+
+                // invalid segments -> zero similarity
+                bool valid_seg = ((len1[j] >= L3D_EPS) & (len2[j] >= L3D_EPS));
+                pos_exp[j] = valid_seg ? e : 1e30f;
+
+                // undirected angle
+                float c = dx1[j]*dx2[j] + dy1[j]*dy2[j] + dz1[j]*dz2[j];
+                c = (c < 0.0f) ? -c : c;
+                cos_a[j] = (c < 1.0f) ? c : 1.0f;
+            }
+
+            // angular similarity (one exp per pair)
+            for(int j=0; j<n; ++j)
+            {
+                float angle = acosf(cos_a[j])/M_PI*180.0f;
+                float ang_exp = angle*angle*inv_two_sigA_sqr;
+                sims[first+j] = expf(-fmax(ang_exp,pos_exp[j]));
             }
         }
 
-        // cleanup
-        used_.clear();
+        for(size_t i=0; i<candidates.size(); ++i)
+        {
+            if(sims[i] > L3D_DEF_MIN_AFFINITY)
+                valid.push_back(std::pair<std::pair<size_t,size_t>,float>(candidates[i],sims[i]));
+        }
     }
 
     //------------------------------------------------------------------------------
-    bool Line3D::unused(const Segment2D &seg1, const Segment2D &seg2)
+    void Line3D::groupTrackRows(const std::vector<int>& entry2track,
+                                const std::vector<int>& entry2local)
     {
-        bool unused = true;
+        track_rows_.clear();
 
-        // check if used
-        aff_used_mutex_.lock();
-        if(used_[seg1].find(seg2) != used_[seg1].end())
+        std::vector<int> local2track(local2global_.size(),-1);
+        for(size_t ent=0; ent<entry2local.size(); ++ent)
         {
-            // already used
-            unused = false;
+            if(entry2local[ent] >= 0)
+                local2track[entry2local[ent]] = entry2track[ent];
         }
-        else
+
+        // merge tracks that are connected by collinearity links
+        L3DPP::CLUniverse* u = new L3DPP::CLUniverse(tracks_.size());
+        L3DPP::CLEdgeList::const_iterator it = A_.begin();
+        for(; it!=A_.end(); ++it)
+        {
+            int a = u->find(local2track[it->i_]);
+            int b = u->find(local2track[it->j_]);
+            if(a != b)
+                u->join(a,b);
+        }
+
+        std::map<int,size_t> root2rows;
+        for(int id=0; id<local2global_.size(); ++id)
         {
-            // not yet used
-            used_[seg1].insert(seg2);
-            used_[seg2].insert(seg1);
+            int root = u->find(local2track[id]);
+            std::map<int,size_t>::const_iterator t_it = root2rows.find(root);
+            if(t_it == root2rows.end())
+            {
+                root2rows[root] = track_rows_.size();
+                track_rows_.push_back(std::vector<int>(1,id));
+            }
+            else
+            {
+                track_rows_[t_it->second].push_back(id);
+            }
         }
-        aff_used_mutex_.unlock();
+        delete u;
+
+        // largest tracks first (load balancing)
+        std::vector<std::pair<size_t,size_t> > by_size(track_rows_.size());
+        for(size_t t=0; t<track_rows_.size(); ++t)
+            by_size[t] = std::pair<size_t,size_t>(track_rows_[t].size(),t);
+
+        std::sort(by_size.rbegin(),by_size.rend());
 
-        return unused;
+        std::vector<std::vector<int> > sorted(track_rows_.size());
+        for(size_t t=0; t<by_size.size(); ++t)
+            sorted[t].swap(track_rows_[by_size[t].second]);
+
+        track_rows_.swap(sorted);
     }
 
     //------------------------------------------------------------------------------
-    int Line3D::getLocalID(const Segment2D &seg)
+    void Line3D::performRDD()
     {
-        int id;
-        aff_id_mutex_.lock();
-        if(global2local_.find(seg) == global2local_.end())
-        {
-            id = localID_;
-            ++localID_;
+        if(A_.size() == 0)
+            return;
+
+        // sparse matrix (CSR + CSC)
+        L3DPP::SparseMatrix* W = new L3DPP::SparseMatrix(A_,local2global_.size());
+        std::vector<unsigned int> iterations;
 
-            global2local_[seg] = id;
-            local2global_[id] = seg;
+#ifdef L3DPP_CUDA
+        if(useGPU_)
+        {
+            // perform RDD (whole matrix), pruning is not supported since the
+            // kernels work on the fixed CSR structure (an entry that is set to
+            // zero would be recomputed from its row in the next iteration)
+            if(rdd_prune_t_ > 0.0f)
+                std::cout << prefix_wng_ << "RDD: pruning is not available on the GPU, using the full matrix" << std::endl;
+
+            iterations.push_back(L3DPP::replicator_dynamics_diffusion_GPU(W,L3D_DEF_RDD_MAX_ITER,
+                                                                          L3D_DEF_RDD_TOLERANCE));
+            W->download();
         }
         else
+#endif //L3DPP_CUDA
         {
-            id = global2local_[seg];
-        }
-        aff_id_mutex_.unlock();
-        return id;
-    }
+            // position of each row within its track
+            std::vector<int> row2pos(local2global_.size(),-1);
+            for(size_t t=0; t<track_rows_.size(); ++t)
+            {
+                for(size_t k=0; k<track_rows_[t].size(); ++k)
+                    row2pos[track_rows_[t][k]] = k;
+            }
 
-    //------------------------------------------------------------------------------
-    void Line3D::performRDD()
-    {
-#ifdef L3DPP_CUDA
-        // create sparse GPU matrix
-        L3DPP::SparseMatrix* W = new L3DPP::SparseMatrix(A_,global2local_.size());
+            // perform RDD (per track)
+            std::vector<float> result(W->num_entries(),0.0f);
+            iterations.resize(track_rows_.size(),0);
 
-        // perform RDD
-        L3DPP::replicator_dynamics_diffusion_GPU(W,prefix_);
+#ifdef L3DPP_OPENMP
+            #pragma omp parallel for schedule(dynamic)
+#endif //L3DPP_OPENMP
+            for(int t=0; t<track_rows_.size(); ++t)
+            {
+                if(track_rows_[t].size() < 2)
+                    continue;
 
-        // update affinities (symmetrify)
-        W->download();
-        A_.clear();
+                iterations[t] = L3DPP::replicatorDynamicsDiffusion(W,track_rows_[t],row2pos,&result[0],
+                                                                   L3D_DEF_RDD_MAX_ITER,
+                                                                   L3D_DEF_RDD_TOLERANCE,
+                                                                   rdd_prune_t_);
+            }
 
-        std::map<int,std::map<int,float> > entries;
-        for(unsigned int i=0; i<W->entries()->width(); ++i)
-        {
-            int s1 = W->entries()->dataCPU(i,0)[0].x;
-            int s2 = W->entries()->dataCPU(i,0)[0].y;
-            float w12 = W->entries()->dataCPU(i,0)[0].z;
+            std::copy(result.begin(),result.end(),W->values());
+        }
 
-            float w21 = w12;
-            if(entries[s2].find(s1) != entries[s2].end())
+        // iteration stats
+        unsigned int max_iter = 0;
+        float avg_iter = 0.0f;
+        size_t num_runs = 0;
+        for(size_t i=0; i<iterations.size(); ++i)
+        {
+            if(iterations[i] > 0)
             {
-                // other one already processed
-                w21 = entries[s2][s1];
+                max_iter = std::max(max_iter,iterations[i]);
+                avg_iter += iterations[i];
+                ++num_runs;
             }
+        }
+        if(num_runs > 0)
+            avg_iter /= float(num_runs);
 
-            float w = fmin(w12,w21);
+        std::cout << prefix_ << "RDD: #iterations: avg=" << avg_iter << ", max=" << max_iter;
+        std::cout << " [" << num_runs << " component(s)]" << std::endl;
 
-            entries[s1][s2] = w;
-            entries[s2][s1] = w;
-        }
+        // update affinities (symmetrify)
+        A_.clear();
+        affinity_arena_.release();
 
-        std::map<int,std::map<int,float> >::const_iterator it = entries.begin();
-        for(; it!=entries.end(); ++it)
+        const L3DPP::SparseOffset* offsets = W->row_offsets();
+        const L3DPP::SparseIndex* cols = W->col_indices();
+        const float* vals = W->values();
+        for(unsigned int r=0; r<W->num_rows_cols(); ++r)
         {
-            std::map<int,float>::const_iterator it2 = it->second.begin();
-            for(; it2!=it->second.end(); ++it2)
+            for(L3DPP::SparseOffset p=offsets[r]; p<offsets[r+1]; ++p)
             {
+                // w = min(w_rc,w_cr)
+                float w = vals[p];
+                L3DPP::SparseOffset q = W->find(cols[p],r);
+                if(q < W->num_entries())
+                    w = fmin(w,vals[q]);
+
                 CLEdge e;
-                e.i_ = it->first;
-                e.j_ = it2->first;
-                e.w_ = it2->second;
+                e.i_ = r;
+                e.j_ = cols[p];
+                e.w_ = w;
                 A_.push_back(e);
             }
         }
 
         // cleanup
         delete W;
-#endif //L3DPP_CUDA
     }
 
     //------------------------------------------------------------------------------
@@ -2085,88 +3560,121 @@ namespace L3DPP
         if(A_.size() == 0)
             return;
 
-        // graph clustering
-        L3DPP::CLUniverse* u = L3DPP::performClustering(A_,global2local_.size(),3.0f);
-
-        // clustering done
-        A_.clear();
-
-        //process clusters
-        std::map<int,std::list<L3DPP::Segment2D> > cluster2segments;
-        std::map<int,std::map<unsigned int,bool> > cluster2cameras;
-        std::vector<int> unique_clusters;
-
-        std::map<int,L3DPP::Segment2D>::const_iterator it = local2global_.begin();
-        for(; it!=local2global_.end(); ++it)
+        // position of each segment within its track
+        std::vector<int> local2track(local2global_.size(),-1);
+        std::vector<int> local2pos(local2global_.size(),-1);
+        for(size_t t=0; t<track_rows_.size(); ++t)
         {
-            int clID = u->find(it->first);
-            L3DPP::Segment2D seg = it->second;
-
-            if(cluster2segments.find(clID) == cluster2segments.end())
-                unique_clusters.push_back(clID);
-
-            // store segment
-            cluster2segments[clID].push_back(seg);
-            // store camera
-            cluster2cameras[clID][seg.camID()] = true;
+            for(size_t k=0; k<track_rows_[t].size(); ++k)
+            {
+                local2track[track_rows_[t][k]] = t;
+                local2pos[track_rows_[t][k]] = k;
+            }
         }
-        delete u;
 
-        if(cluster2segments.size() == 0)
+        // split affinity matrix into tracks (no edges in between)
+        std::vector<L3DPP::CLEdgeList> track_edges(track_rows_.size(),L3DPP::CLEdgeList(L3DPP::ArenaAllocator<L3DPP::CLEdge>(&cluster_arena_)));
+        L3DPP::CLEdgeList::const_iterator e_it = A_.begin();
+        for(; e_it!=A_.end(); ++e_it)
         {
-            std::cout << prefix_wng_ << "no clusters found..." << std::endl;
-            return;
+            L3DPP::CLEdge e = *e_it;
+            int t = local2track[e.i_];
+            e.i_ = local2pos[e.i_];
+            e.j_ = local2pos[e.j_];
+            track_edges[t].push_back(e);
         }
 
-        std::cout << prefix_ << "clusters: ";
-        std::cout << "total=" << cluster2segments.size() << ", ";
+        // clustering done
+        A_.clear();
+        affinity_arena_.release();
+
+        // graph clustering per track (independent for disjoint tracks)
+        unsigned int num_clusters = 0;
 
-        // create 3D lines for valid clusters
 #ifdef L3DPP_OPENMP
-        #pragma omp parallel for
+        #pragma omp parallel for schedule(dynamic)
 #endif //L3DPP_OPENMP
-        for(int i=0; i<unique_clusters.size(); ++i)
+        for(int t=0; t<track_rows_.size(); ++t)
         {
-            int clID = unique_clusters[i];
+            if(track_edges[t].size() == 0)
+                continue;
 
-            if(cluster2cameras[clID].size() >= visibility_t_)
+            L3DPP::CLUniverse* u = L3DPP::performClustering(track_edges[t],track_rows_[t].size(),3.0f);
+
+            //process clusters
+            std::map<int,std::vector<L3DPP::Segment2D> > cluster2segments;
+            std::map<int,std::set<unsigned int> > cluster2cameras;
+            for(int k=0; k<track_rows_[t].size(); ++k)
             {
-                // create 3D line cluster
-                L3DPP::LineCluster3D LC = get3DlineFromCluster(cluster2segments[clID]);
+                int clID = u->find(k);
+                L3DPP::Segment2D seg = local2global_[track_rows_[t][k]];
+
+                // store segment
+                cluster2segments[clID].push_back(seg);
+                // store camera
+                cluster2cameras[clID].insert(seg.camID());
+            }
+            delete u;
 
-                if(LC.size() > 0)
+            // create 3D lines for valid clusters
+            L3DPP::ArenaAllocator<L3DPP::LineCluster3D> cluster_alloc(&cluster_arena_);
+            std::list<L3DPP::LineCluster3D,L3DPP::ArenaAllocator<L3DPP::LineCluster3D> > valid(cluster_alloc);
+            std::map<int,std::vector<L3DPP::Segment2D> >::const_iterator c_it = cluster2segments.begin();
+            for(; c_it!=cluster2segments.end(); ++c_it)
+            {
+                if(cluster2cameras[c_it->first].size() >= visibility_t_)
                 {
-                    // 3D line valid --> store in list
-                    cluster_mutex_.lock();
-                    clusters3D_.push_back(LC);
-                    cluster_mutex_.unlock();
+                    // create 3D line cluster
+                    L3DPP::LineCluster3D LC = get3DlineFromCluster(c_it->second);
+
+                    if(LC.size() > 0)
+                        valid.push_back(LC);
                 }
             }
+
+            // 3D lines valid --> store in list
+            cluster_mutex_.lock();
+            num_clusters += cluster2segments.size();
+            clusters3D_.insert(clusters3D_.end(),valid.begin(),valid.end());
+            cluster_mutex_.unlock();
         }
+
+        // release stage memory
+        track_edges.clear();
+        cluster_arena_.release();
+
+        if(num_clusters == 0)
+        {
+            std::cout << prefix_wng_ << "no clusters found..." << std::endl;
+            return;
+        }
+
+        std::cout << prefix_ << "clusters: ";
+        std::cout << "total=" << num_clusters << ", ";
         std::cout << "valid=" << clusters3D_.size();
 
-        unsigned int perc = float(clusters3D_.size())/float(cluster2segments.size())*100;
+        unsigned int perc = float(clusters3D_.size())/float(num_clusters)*100;
         std::cout << " [~" << perc << "%]";
 
         std::cout << std::endl;
     }
 
     //------------------------------------------------------------------------------
-    L3DPP::LineCluster3D Line3D::get3DlineFromCluster(const std::list<L3DPP::Segment2D>& cluster)
+    L3DPP::LineCluster3D Line3D::get3DlineFromCluster(const std::vector<L3DPP::Segment2D>& cluster)
     {
         // create scatter matrix
         Eigen::Vector3d P(0,0,0);
         int n = cluster.size()*2;
         Eigen::MatrixXd L_points(3,n);
 
-        std::list<L3DPP::Segment2D>::const_iterator it = cluster.begin();
+        std::vector<L3DPP::Segment2D>::const_iterator it = cluster.begin();
         unsigned int reference_cam = 0;
         float max_len_2D = 0.0f;
         for(size_t i=0; it!=cluster.end(); ++it,i+=2)
         {
             // get 3D hypothesis
             size_t pos = entry_map_[*it];
-            L3DPP::Segment3D hyp3D = estimated_position3D_[pos].first;
+            L3DPP::Segment3D hyp3D = estimated_position3D_[pos].seg3D();
 
             P += hyp3D.P1();
             P += hyp3D.P2();
@@ -2283,7 +3791,7 @@ namespace L3DPP
 #endif //L3DPP_OPENMP
         for(int i=0; i<clusters3D_.size(); ++i)
         {
-            std::list<L3DPP::Segment3D> collinear = findCollinearSegments(clusters3D_[i]);
+            std::vector<L3DPP::Segment3D> collinear = findCollinearSegments(clusters3D_[i]);
 
             if(collinear.size() > 0)
             {
@@ -2296,6 +3804,9 @@ namespace L3DPP
                 cluster_mutex_.unlock();
             }
         }
+
+        // release temporary line points
+        cluster_arena_.release();
     }
 
     //------------------------------------------------------------------------------
@@ -2313,8 +3824,8 @@ namespace L3DPP
         {
             L3DPP::View* v = views_[lines3D_[i].underlyingCluster_.reference_view()];
 
-            std::list<L3DPP::Segment3D> filteredSegments;
-            std::list<L3DPP::Segment3D>::const_iterator it = lines3D_[i].collinear3Dsegments_.begin();
+            std::vector<L3DPP::Segment3D> filteredSegments;
+            std::vector<L3DPP::Segment3D>::const_iterator it = lines3D_[i].collinear3Dsegments_.begin();
             for(; it!=lines3D_[i].collinear3Dsegments_.end(); ++it)
             {
                 if(v->projectedLongEnough(*it))
@@ -2339,14 +3850,38 @@ namespace L3DPP
     }
 
     //------------------------------------------------------------------------------
-    std::list<L3DPP::Segment3D> Line3D::findCollinearSegments(const L3DPP::LineCluster3D& cluster)
+    void Line3D::mapToOriginalSegmentIDs()
+    {
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for
+#endif //L3DPP_OPENMP
+        for(int i=0; i<lines3D_.size(); ++i)
+        {
+            const L3DPP::LineCluster3D& cluster = lines3D_[i].underlyingCluster_;
+
+            std::vector<L3DPP::Segment2D> residuals(cluster.residuals()->size());
+            for(size_t j=0; j<residuals.size(); ++j)
+            {
+                L3DPP::Segment2D seg2D = cluster.residuals()->at(j);
+                L3DPP::View* v = views_[seg2D.camID()];
+                residuals[j] = L3DPP::Segment2D(seg2D.camID(),v->originalID(seg2D.segID()));
+            }
+
+            lines3D_[i].underlyingCluster_ = L3DPP::LineCluster3D(cluster.seg3D(),residuals,
+                                                                  cluster.reference_view());
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    std::vector<L3DPP::Segment3D> Line3D::findCollinearSegments(const L3DPP::LineCluster3D& cluster)
     {
         // project onto 3D line
-        std::list<L3DPP::Segment3D> collinear_segments;
+        std::vector<L3DPP::Segment3D> collinear_segments;
         Eigen::Vector3d COG = 0.5*(cluster.seg3D().P1()+cluster.seg3D().P2());
-        std::list<L3DPP::Segment2D>::const_iterator it = cluster.residuals()->begin();
+        std::vector<L3DPP::Segment2D>::const_iterator it = cluster.residuals()->begin();
 
-        std::list<L3DPP::PointOn3DLine> linePoints;
+        L3DPP::ArenaAllocator<L3DPP::PointOn3DLine> point_alloc(&cluster_arena_);
+        L3DPP::PointOn3DLineList linePoints(point_alloc);
         std::vector<Eigen::Vector3d> pts(cluster.residuals()->size()*2);
 
         float distToCOG = 0.0f;
@@ -2397,7 +3932,7 @@ namespace L3DPP
             return collinear_segments;
 
         // sort by distance to border
-        std::list<L3DPP::PointOn3DLine>::iterator lit = linePoints.begin();
+        L3DPP::PointOn3DLineList::iterator lit = linePoints.begin();
         for(; lit!=linePoints.end(); ++lit)
         {
             (*lit).distToBorder_ = (pts[(*lit).pointID_]-border).norm();
@@ -2451,23 +3986,328 @@ namespace L3DPP
         return collinear_segments;
     }
 
+    //------------------------------------------------------------------------------
+    void Line3D::reconstructProgressive(const double time_budget, const unsigned int target_num_lines,
+                                        const unsigned int num_stages, const float sigma_position,
+                                        const float sigma_angle, const unsigned int num_neighbors,
+                                        const float epipolar_overlap, const int kNN,
+                                        const float const_regularization_depth,
+                                        const unsigned int visibility_t, const bool perform_diffusion,
+                                        const float collinearity_t, const bool use_CERES,
+                                        const unsigned int max_iter_CERES, const float rdd_prune_t)
+    {
+        progressive_mutex_.lock();
+        for(size_t i=0; i<progressive_lines3D_.size(); ++i)
+            progressive_lines3D_[i]->release();
+
+        progressive_lines3D_.clear();
+        progressive_times_.clear();
+        progressive_mutex_.unlock();
+
+        unsigned int stages = std::max(num_stages,(unsigned int)1);
+        unsigned int max_neighbors = std::max(int(num_neighbors),2);
+
+#ifdef L3DPP_CERES
+        bool optimize = use_CERES;
+#else
+        bool optimize = false;
+#endif //L3DPP_CERES
+
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+        double last_matching = 0.0;
+        double last_reconstruction = 0.0;
+        double last_cost = 0.0;
+
+        unsigned int total_stages = optimize ? stages+1 : stages;
+        for(unsigned int s=0; s<total_stages; ++s)
+        {
+            bool refine = (s < stages);
+
+            // segments (longest first) and neighbors for this stage
+            float fraction = refine ? powf(0.5f,float(stages-1-s)) : 1.0f;
+            unsigned int neighbors = refine ? std::max((max_neighbors*(s+1)+stages-1)/stages,(unsigned int)2) : max_neighbors;
+
+            // expected duration (matching cost ~ segments x neighbors x matches per segment)
+            double cost = double(fraction)*double(neighbors)*double(neighbors);
+            double expected = last_reconstruction;
+            if(refine && last_cost > 0.0)
+                expected += last_matching*cost/last_cost;
+
+            double elapsed = double((boost::posix_time::microsec_clock::local_time()-start).total_microseconds())*1e-6;
+            if(s > 0 && time_budget > 0.0 && elapsed+expected > time_budget)
+            {
+                std::cout << prefix_ << "progressive: time budget reached after " << s << " stage(s) [";
+                std::cout << elapsed << "s]" << std::endl;
+                break;
+            }
+
+            std::cout << std::endl << prefix_ << "[P] PROGRESSIVE STAGE " << s+1 << "/" << total_stages;
+            std::cout << " [segments=" << int(fraction*100.0f) << "%, neighbors=" << neighbors;
+            std::cout << ", CERES=" << !refine << "]" << std::endl;
+
+            boost::posix_time::ptime stage_start = boost::posix_time::microsec_clock::local_time();
+            if(refine)
+            {
+                view_mutex_.lock();
+                std::map<unsigned int,L3DPP::View*>::iterator v_it = views_.begin();
+                for(; v_it!=views_.end(); ++v_it)
+                    v_it->second->setActiveFraction(fraction);
+                view_mutex_.unlock();
+
+                matchImages(sigma_position,sigma_angle,neighbors,epipolar_overlap,
+                            kNN,const_regularization_depth);
+
+                last_matching = double((boost::posix_time::microsec_clock::local_time()-stage_start).total_microseconds())*1e-6;
+                last_cost = cost;
+            }
+
+            boost::posix_time::ptime reconstruction_start = boost::posix_time::microsec_clock::local_time();
+            reconstruct3Dlines(visibility_t,perform_diffusion,collinearity_t,
+                               !refine,max_iter_CERES,rdd_prune_t);
+
+            last_reconstruction = double((boost::posix_time::microsec_clock::local_time()-reconstruction_start).total_microseconds())*1e-6;
+
+            // intermediate model (shared, not copied)
+            const L3DPP::ResultSnapshot* model = acquireResultSnapshot();
+            if(model == NULL)
+                break;
+
+            size_t num_lines = model->num_lines();
+            double time = double((boost::posix_time::microsec_clock::local_time()-start).total_microseconds())*1e-6;
+            progressive_mutex_.lock();
+            progressive_lines3D_.push_back(model);
+            progressive_times_.push_back(time);
+            progressive_mutex_.unlock();
+
+            std::cout << prefix_ << "progressive: #lines3D = " << num_lines << " [" << time << "s]" << std::endl;
+
+            if(target_num_lines > 0 && num_lines >= target_num_lines)
+            {
+                std::cout << prefix_ << "progressive: quality target reached" << std::endl;
+                break;
+            }
+        }
+
+        // reset
+        view_mutex_.lock();
+        std::map<unsigned int,L3DPP::View*>::iterator v_it = views_.begin();
+        for(; v_it!=views_.end(); ++v_it)
+            v_it->second->setActiveFraction(1.0f);
+        view_mutex_.unlock();
+    }
+
+    //------------------------------------------------------------------------------
+    unsigned int Line3D::numProgressiveResults()
+    {
+        progressive_mutex_.lock();
+        unsigned int num = progressive_lines3D_.size();
+        progressive_mutex_.unlock();
+        return num;
+    }
+
+    //------------------------------------------------------------------------------
+    bool Line3D::getProgressive3Dlines(const unsigned int stage, std::vector<L3DPP::FinalLine3D>& result,
+                                       double& time)
+    {
+        progressive_mutex_.lock();
+        bool valid = (stage < progressive_lines3D_.size());
+        if(valid)
+        {
+            result = progressive_lines3D_[stage]->lines3D();
+            time = progressive_times_[stage];
+        }
+        progressive_mutex_.unlock();
+        return valid;
+    }
+
     //------------------------------------------------------------------------------
     void Line3D::get3Dlines(std::vector<L3DPP::FinalLine3D>& result)
     {
         view_mutex_.lock();
         view_reserve_mutex_.lock();
-        result = lines3D_;
+        result = model();
+        view_reserve_mutex_.unlock();
+        view_mutex_.unlock();
+    }
+
+    //------------------------------------------------------------------------------
+    const L3DPP::ResultSnapshot* Line3D::acquireResultSnapshot()
+    {
+        snapshot_mutex_.lock();
+        const L3DPP::ResultSnapshot* snapshot = snapshot_;
+        if(snapshot != NULL)
+            snapshot->retain();
+        snapshot_mutex_.unlock();
+        return snapshot;
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::queryLinesInBox(const std::vector<L3DPP::SpatialBox>& boxes,
+                                 std::vector<std::vector<L3DPP::SpatialHit> >& results)
+    {
+        view_mutex_.lock();
+        view_reserve_mutex_.lock();
+        spatial_index_.queryBox(boxes,results);
+        view_reserve_mutex_.unlock();
+        view_mutex_.unlock();
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::queryNearestLines(const std::vector<Eigen::Vector3d>& points, const unsigned int k,
+                                   std::vector<std::vector<L3DPP::SpatialHit> >& results)
+    {
+        view_mutex_.lock();
+        view_reserve_mutex_.lock();
+        spatial_index_.queryNearest(points,k,results);
+        view_reserve_mutex_.unlock();
+        view_mutex_.unlock();
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::queryLinesInFrustum(const std::vector<L3DPP::SpatialFrustum>& frusta,
+                                     std::vector<std::vector<L3DPP::SpatialHit> >& results)
+    {
+        view_mutex_.lock();
+        view_reserve_mutex_.lock();
+        spatial_index_.queryFrustum(frusta,results);
+        view_reserve_mutex_.unlock();
+        view_mutex_.unlock();
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::queryLinesOnRay(const std::vector<L3DPP::SpatialRay>& rays,
+                                 std::vector<std::vector<L3DPP::SpatialHit> >& results)
+    {
+        view_mutex_.lock();
+        view_reserve_mutex_.lock();
+        spatial_index_.queryRay(rays,results);
+        view_reserve_mutex_.unlock();
+        view_mutex_.unlock();
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::getSupportedLines(const unsigned int camID, std::vector<L3DPP::LineSupport>& result)
+    {
+        view_mutex_.lock();
+        view_reserve_mutex_.lock();
+
+        size_t num;
+        const L3DPP::LineSupport* support = NULL;
+        if(snapshot_ != NULL)
+            support = snapshot_->reverse_index().support(camID,num);
+        if(support != NULL)
+            result.assign(support,support+num);
+        else
+            result.clear();
+
+        view_reserve_mutex_.unlock();
+        view_mutex_.unlock();
+    }
+
+    //------------------------------------------------------------------------------
+    int Line3D::getLineOfSegment(const unsigned int camID, const unsigned int segID)
+    {
+        view_mutex_.lock();
+        view_reserve_mutex_.lock();
+        int lineID = -1;
+        if(snapshot_ != NULL)
+            lineID = snapshot_->reverse_index().lineID(camID,segID);
+        view_reserve_mutex_.unlock();
+        view_mutex_.unlock();
+        return lineID;
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::projectLines(const Eigen::Matrix3d& K, const Eigen::Matrix3d& R,
+                              const Eigen::Vector3d& t, const unsigned int width,
+                              const unsigned int height,
+                              std::vector<L3DPP::ProjectedSegment2D>& result,
+                              const float near_depth)
+    {
+        L3DPP::SegmentProjector projector(K,R,t,width,height,near_depth);
+
+        view_mutex_.lock();
+        view_reserve_mutex_.lock();
+        projectModel(projector,result);
+        view_reserve_mutex_.unlock();
+        view_mutex_.unlock();
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::projectLines(const unsigned int camID,
+                              std::vector<L3DPP::ProjectedSegment2D>& result,
+                              const float near_depth)
+    {
+        std::vector<unsigned int> camIDs(1,camID);
+        std::vector<std::vector<L3DPP::ProjectedSegment2D> > results;
+        projectLines(camIDs,results,near_depth);
+        result.swap(results[0]);
+    }
+
+    //------------------------------------------------------------------------------
+    void Line3D::projectLines(const std::vector<unsigned int>& camIDs,
+                              std::vector<std::vector<L3DPP::ProjectedSegment2D> >& results,
+                              const float near_depth)
+    {
+        view_mutex_.lock();
+        view_reserve_mutex_.lock();
+
+        results = std::vector<std::vector<L3DPP::ProjectedSegment2D> >(camIDs.size());
+
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for schedule(dynamic)
+#endif //L3DPP_OPENMP
+        for(int i=0; i<camIDs.size(); ++i)
+        {
+            std::map<unsigned int,L3DPP::View*>::const_iterator v_it = views_.find(camIDs[i]);
+            if(v_it == views_.end())
+                continue;
+
+            L3DPP::View* v = v_it->second;
+            L3DPP::SegmentProjector projector(v->K(),v->R(),v->t(),v->width(),
+                                              v->height(),near_depth);
+            projectModel(projector,results[i]);
+        }
+
         view_reserve_mutex_.unlock();
         view_mutex_.unlock();
     }
 
+    //------------------------------------------------------------------------------
+    void Line3D::projectModel(const L3DPP::SegmentProjector& projector,
+                              std::vector<L3DPP::ProjectedSegment2D>& result)
+    {
+        if(spatial_index_.empty())
+        {
+            result.clear();
+            return;
+        }
+
+        // frustum culling
+        std::vector<L3DPP::SpatialHit> candidates;
+        spatial_index_.queryFrustum(projector.frustum(),candidates);
+
+        projector.project(model(),candidates,result);
+    }
+
+    //------------------------------------------------------------------------------
+    const std::vector<L3DPP::FinalLine3D>& Line3D::model() const
+    {
+        static const std::vector<L3DPP::FinalLine3D> empty;
+        if(snapshot_ == NULL)
+            return empty;
+
+        return snapshot_->lines3D();
+    }
+
     //------------------------------------------------------------------------------
     void Line3D::saveResultAsSTL(const std::string& output_folder)
     {
         view_mutex_.lock();
         view_reserve_mutex_.lock();
 
-        if(lines3D_.size() == 0)
+        const std::vector<L3DPP::FinalLine3D>& lines3D = model();
+        if(lines3D.size() == 0)
         {
             std::cout << prefix_wng_ << "no 3D lines to save!" << std::endl;
             view_reserve_mutex_.unlock();
@@ -2483,11 +4323,11 @@ namespace L3DPP
 
         file << "solid lineModel" << std::endl;
 
-        for(size_t i=0; i<lines3D_.size(); ++i)
+        for(size_t i=0; i<lines3D.size(); ++i)
         {
-            L3DPP::FinalLine3D current = lines3D_[i];
+            const L3DPP::FinalLine3D& current = lines3D[i];
 
-            std::list<L3DPP::Segment3D>::const_iterator it2 = current.collinear3Dsegments_.begin();
+            std::vector<L3DPP::Segment3D>::const_iterator it2 = current.collinear3Dsegments_.begin();
             for(; it2!=current.collinear3Dsegments_.end(); ++it2)
             {
                 Eigen::Vector3d P1 = (*it2).P1();
@@ -2581,7 +4421,8 @@ namespace L3DPP
         view_mutex_.lock();
         view_reserve_mutex_.lock();
 
-        if(lines3D_.size() == 0)
+        const std::vector<L3DPP::FinalLine3D>& lines3D = model();
+        if(lines3D.size() == 0)
         {
             std::cout << prefix_wng_ << "no 3D lines to save!" << std::endl;
             view_reserve_mutex_.unlock();
@@ -2598,11 +4439,11 @@ namespace L3DPP
         size_t lineID = 0;
         size_t pointID = 1;
         std::map<size_t,size_t> lines2points;
-        for(size_t i=0; i<lines3D_.size(); ++i)
+        for(size_t i=0; i<lines3D.size(); ++i)
         {
-            L3DPP::FinalLine3D current = lines3D_[i];
+            const L3DPP::FinalLine3D& current = lines3D[i];
 
-            std::list<L3DPP::Segment3D>::const_iterator it2 = current.collinear3Dsegments_.begin();
+            std::vector<L3DPP::Segment3D>::const_iterator it2 = current.collinear3Dsegments_.begin();
             for(; it2!=current.collinear3Dsegments_.end(); ++it2,++lineID,pointID+=2)
             {
                 Eigen::Vector3d P1 = (*it2).P1();
@@ -2633,7 +4474,8 @@ namespace L3DPP
         view_mutex_.lock();
         view_reserve_mutex_.lock();
 
-        if(lines3D_.size() == 0)
+        const std::vector<L3DPP::FinalLine3D>& lines3D = model();
+        if(lines3D.size() == 0)
         {
             std::cout << prefix_wng_ << "no 3D lines to save!" << std::endl;
             view_reserve_mutex_.unlock();
@@ -2647,16 +4489,16 @@ namespace L3DPP
         std::ofstream file;
         file.open(filename.c_str());
 
-        for(size_t i=0; i<lines3D_.size(); ++i)
+        for(size_t i=0; i<lines3D.size(); ++i)
         {
-            L3DPP::FinalLine3D current = lines3D_[i];
+            const L3DPP::FinalLine3D& current = lines3D[i];
 
             if(current.collinear3Dsegments_.size() == 0)
                 continue;
 
             // write 3D segments
             file << current.collinear3Dsegments_.size() << " ";
-            std::list<L3DPP::Segment3D>::const_iterator it2 = current.collinear3Dsegments_.begin();
+            std::vector<L3DPP::Segment3D>::const_iterator it2 = current.collinear3Dsegments_.begin();
             for(; it2!=current.collinear3Dsegments_.end(); ++it2)
             {
                 Eigen::Vector3d P1 = (*it2).P1();
@@ -2668,7 +4510,7 @@ namespace L3DPP
 
             // write 2D residuals
             file << current.underlyingCluster_.residuals()->size() << " ";
-            std::list<L3DPP::Segment2D>::const_iterator it3 = current.underlyingCluster_.residuals()->begin();
+            std::vector<L3DPP::Segment2D>::const_iterator it3 = current.underlyingCluster_.residuals()->begin();
             for(; it3!=current.underlyingCluster_.residuals()->end(); ++it3)
             {
                 file << (*it3).camID() << " " << (*it3).segID() << " ";
@@ -2692,7 +4534,8 @@ namespace L3DPP
         view_mutex_.lock();
         view_reserve_mutex_.lock();
 
-        if(lines3D_.size() == 0)
+        const std::vector<L3DPP::FinalLine3D>& lines3D = model();
+        if(lines3D.size() == 0)
         {
             std::cout << prefix_wng_ << "no 3D lines to save!" << std::endl;
             view_reserve_mutex_.unlock();
@@ -2704,7 +4547,7 @@ namespace L3DPP
         std::string filename = output_folder+"/"+createOutputFilename()+".bin";
 
         // serialize
-        L3DPP::serializeToFile(filename,lines3D_);
+        L3DPP::serializeToFile(filename,lines3D);
 
         view_reserve_mutex_.unlock();
         view_mutex_.unlock();
@@ -2759,7 +4602,9 @@ namespace L3DPP
         Eigen::Vector4f coords(0,0,0,0);
         if(views_.find(seg2D.camID()) != views_.end())
         {
-            coords = views_[seg2D.camID()]->getLineSegment2D(seg2D.segID());
+            L3DPP::View* v = views_[seg2D.camID()];
+            if(seg2D.segID() < v->num_lines())
+                coords = v->getLineSegment2D(v->internalID(seg2D.segID()));
         }
         return coords;
     }
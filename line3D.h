@@ -18,11 +18,17 @@
 #include <queue>
 #include <iostream>
 #include <iomanip>
+#include <iterator>
 
 // external
 #include "eigen3/Eigen/Eigen"
 #include "boost/filesystem.hpp"
 #include "boost/thread/mutex.hpp"
+#include "boost/date_time/posix_time/posix_time.hpp"
+
+#ifdef L3DPP_OPENMP
+#include <omp.h>
+#endif //L3DPP_OPENMP
 
 // OpenCV and LSD
 #ifndef L3DPP_OPENCV3
@@ -43,6 +49,17 @@
 #include "cudawrapper.h"
 #include "optimization.h"
 #include "sparsematrix.h"
+#include "viewgraph.h"
+#include "numatopology.h"
+#include "spatialindex.h"
+#include "projection.h"
+#include "reverseindex.h"
+#include "resultsnapshot.h"
+#include "precision.h"
+#include "imagebatch.h"
+#include "hypothesishash.h"
+#include "linedescriptor.h"
+#include "keypointgrid.h"
 
 /**
  * Line3D++ - Base Class
@@ -58,6 +75,41 @@
 
 namespace L3DPP
 {
+    // candidate pairs per block (vectorized affinity evaluation)
+    const unsigned int L3D_AFFINITY_BLOCK_SIZE = 256;
+
+    // optional features of the Line3D++ constructor
+    // -------------------------------------
+    // quantize_segments     - stores the 2D line segments in 16-bit fixed point (relative to the range of all
+    //                         endpoints, i.e. about the image size) to halve their memory (for very large datasets).
+    //                         the rounding error is below range/131070 pixels (e.g. < 0.035 px for 4500 px images)
+    // spatial_segment_order - stores the 2D line segments of each image along a Morton curve (by midpoint)
+    //                         for better memory locality. segment IDs in the results (and for
+    //                         getSegmentCoords2D(...)) always refer to the original order
+    // float_precision       - matching and scoring (CPU) in single precision (faster, camera centers
+    //                         and 3D points stay in double precision)
+    // use_descriptors       - binary line descriptors (see linedescriptor.h) are computed for detected segments
+    //                         (and stored with them) and used to reject and rank match candidates before
+    //                         triangulation. if false -> matching is purely geometric
+    // pin_threads           - NUMA machines only: worker threads are pinned to the node of the views they process
+    //                         (view data is placed there), the previous CPU masks are restored after each stage.
+    //                         if false -> threads are never pinned and the view data stays where it was allocated
+    struct Line3DOptions
+    {
+        Line3DOptions() :
+            quantize_segments_(L3D_DEF_QUANTIZE_SEGMENTS),
+            spatial_segment_order_(L3D_DEF_SPATIAL_SEGMENT_ORDER),
+            float_precision_(L3D_DEF_FLOAT_PRECISION),
+            use_descriptors_(L3D_DEF_USE_LINE_DESCRIPTORS),
+            pin_threads_(L3D_DEF_PIN_THREADS){}
+
+        bool quantize_segments_;
+        bool spatial_segment_order_;
+        bool float_precision_;
+        bool use_descriptors_;
+        bool pin_threads_;
+    };
+
     class Line3D
     {
     public:
@@ -77,12 +129,14 @@ namespace L3DPP
         //                            if false -> an explicit list of matching neighbors has to be provided
         //                            (--> see void addImage(...))
         // use_GPU                  - uses the GPU for processing whenever possible (highly recommended, requires CUDA!)
+        // options                  - optional features (see Line3DOptions)
         Line3D(const std::string& output_folder,
                const bool load_segments=L3D_DEF_LOAD_AND_STORE_SEGMENTS,
                const int max_img_width=L3D_DEF_MAX_IMG_WIDTH,
                const unsigned int max_line_segments=L3D_DEF_MAX_NUM_SEGMENTS,
                const bool neighbors_by_worldpoints=true,
-               const bool use_GPU=true);
+               const bool use_GPU=true,
+               const L3DPP::Line3DOptions& options=L3DPP::Line3DOptions());
         ~Line3D();
 
         // void addImage(...): add a new image to the system [multithreading safe]
@@ -107,6 +161,51 @@ namespace L3DPP
                       const std::list<unsigned int>& wps_or_neighbors,
                       const std::vector<cv::Vec4f>& line_segments=std::vector<cv::Vec4f>());
 
+        // void addImage(...): add a new (distorted) image to the system [multithreading safe]
+        // -------------------------------------
+        // PARAMETERS:
+        // -------------------------------------
+        // same as above, plus
+        // radial_coeffs     - up to three radial distortion coefficients (set unused to zero!)
+        // tangential_coeffs - up tp two tangential distortion coefficients (set unused to zero!)
+        // the image is undistorted, resized (see max_img_width) and converted to grayscale in
+        // a single pass for the line segment detection (no separate undistortImage(...) needed)
+        void addImage(const unsigned int camID, cv::Mat& image,
+                      const Eigen::Matrix3d& K, const Eigen::Matrix3d& R,
+                      const Eigen::Vector3d& t, const float median_depth,
+                      const std::list<unsigned int>& wps_or_neighbors,
+                      const Eigen::Vector3d& radial_coeffs,
+                      const Eigen::Vector2d& tangential_coeffs);
+
+        // void addImages(...): adds a batch of images to the system [multithreading safe]
+        // -------------------------------------
+        // PARAMETERS:
+        // -------------------------------------
+        // batch - the images and their parameters (see imagebatch.h), images without data are
+        //         loaded by the provider of the batch
+        // the images are loaded and their line segments are detected in parallel (OpenMP),
+        // all views are registered at once afterwards (preferable to calling addImage(...)
+        // from a parallel loop)
+        void addImages(const L3DPP::ImageBatch& batch);
+
+        // void addKeypoints(...): adds the 2D observations of the worldpoints to an image [multithreading safe]
+        // -------------------------------------
+        // PARAMETERS:
+        // -------------------------------------
+        // camID             - ID of the image (added with addImage(...))
+        // wpIDs             - worldpoint IDs (as for addImage(...))
+        // positions         - 2D position of each worldpoint in the (distorted) image
+        // radial_coeffs     - up to three radial distortion coefficients (set unused to zero!)
+        // tangential_coeffs - up tp two tangential distortion coefficients (set unused to zero!)
+        // matching prefers segments close to observations of worldpoints shared by both images and
+        // skips segments that are far from any shared structure (only if both images have enough
+        // shared worldpoints). keypoints can also be passed with the ImageBatch (see addImages(...))
+        void addKeypoints(const unsigned int camID,
+                          const std::list<unsigned int>& wpIDs,
+                          const std::vector<Eigen::Vector2f>& positions,
+                          const Eigen::Vector3d& radial_coeffs=Eigen::Vector3d::Zero(),
+                          const Eigen::Vector2d& tangential_coeffs=Eigen::Vector2d::Zero());
+
         // void undistortImage(...): undistorts an image based on given distortion coefficients
         // -------------------------------------
         // PARAMETERS:
@@ -147,6 +246,21 @@ namespace L3DPP
                          const int kNN=L3D_DEF_KNN,
                          const float const_regularization_depth=-1.0f);
 
+        // void partitionViews(...): partitions the images into balanced groups (e.g. for distributed processing),
+        //                           such that only few image pairs have to be matched across groups
+        //                           (multilevel graph partitioning of the visual neighbor graph)
+        // -------------------------------------
+        // PARAMETERS:
+        // -------------------------------------
+        // num_parts     - number of groups
+        // view2part     - camID -> group (output)
+        // num_neighbors - number of neighboring images with which each image is matched (see matchImages(...))
+        // kNN           - k-nearest-neighbor matching (see matchImages(...)), used to estimate the workload
+        void partitionViews(const unsigned int num_parts,
+                            std::map<unsigned int,unsigned int>& view2part,
+                            const unsigned int num_neighbors=L3D_DEF_MATCHING_NEIGHBORS,
+                            const int kNN=L3D_DEF_KNN);
+
         // void reconstruct3Dlines(...): reconstruct a line-based 3D model (after matching)
         // -------------------------------------
         // PARAMETERS:
@@ -154,24 +268,155 @@ namespace L3DPP
         // visibility_t      - minimum number of different cameras from which clustered 2D segments must originate,
         //                     such that the resulting 3D line is considered to be valid
         // perform_diffusion - perform Replicator Dynamics Diffusion [Donoser, BMVC'13] before
-        //                     segment clustering
+        //                     segment clustering (CPU: per track with pruning, GPU: whole matrix)
         // collinearity_t    - threshold (in pixels) for segments from one image to be considered potentially collinear
         //                     if <= 0 -> collinearity not considered (default)
         // use_CERES         - 3D lines are optimized (bundled) using the Ceres-Solver (recommended!)
         // max_iter_CERES    - maximum number of iterations for Ceres
+        // rdd_prune_t       - diffusion (CPU only): row-normalized affinities below this value are removed
+        //                     for good during the iterations (faster for large tracks), if <= 0 -> no pruning
         void reconstruct3Dlines(const unsigned int visibility_t=L3D_DEF_MIN_VISIBILITY_T,
                                 const bool perform_diffusion=L3D_DEF_PERFORM_RDD,
                                 const float collinearity_t=L3D_DEF_COLLINEARITY_T,
                                 const bool use_CERES=L3D_DEF_USE_CERES,
-                                const unsigned int max_iter_CERES=L3D_DEF_CERES_MAX_ITER);
+                                const unsigned int max_iter_CERES=L3D_DEF_CERES_MAX_ITER,
+                                const float rdd_prune_t=L3D_DEF_RDD_PRUNE_T);
+
+        // void reconstructProgressive(...): matching and reconstruction within a time budget (e.g. for previews).
+        //                                   The model is refined in stages, starting with the longest segments and
+        //                                   a reduced set of visual neighbors: stage s uses 1/2^(num_stages-1-s) of the
+        //                                   segments and (s+1)/num_stages of the neighbors (only for neighbors derived
+        //                                   from worldpoints). Ceres is applied in an additional last stage.
+        //                                   Each intermediate model is available via getProgressive3Dlines(...)
+        //                                   (also while the reconstruction is running), get3Dlines(...) returns the latest one.
+        // -------------------------------------
+        // PARAMETERS:
+        // -------------------------------------
+        // time_budget      - in seconds, a stage is only started if it is expected to finish in time
+        //                    (the first stage is always computed). if <= 0 -> no deadline
+        // target_num_lines - quality target: stops as soon as a model has at least this many 3D lines
+        //                    if 0 -> no target
+        // num_stages       - number of refinement stages (without the Ceres stage)
+        // others           - see matchImages(...) and reconstruct3Dlines(...)
+        void reconstructProgressive(const double time_budget,
+                                    const unsigned int target_num_lines=0,
+                                    const unsigned int num_stages=L3D_DEF_PROGRESSIVE_STAGES,
+                                    const float sigma_position=L3D_DEF_SCORING_POS_REGULARIZER,
+                                    const float sigma_angle=L3D_DEF_SCORING_ANG_REGULARIZER,
+                                    const unsigned int num_neighbors=L3D_DEF_MATCHING_NEIGHBORS,
+                                    const float epipolar_overlap=L3D_DEF_EPIPOLAR_OVERLAP,
+                                    const int kNN=L3D_DEF_KNN,
+                                    const float const_regularization_depth=-1.0f,
+                                    const unsigned int visibility_t=L3D_DEF_MIN_VISIBILITY_T,
+                                    const bool perform_diffusion=L3D_DEF_PERFORM_RDD,
+                                    const float collinearity_t=L3D_DEF_COLLINEARITY_T,
+                                    const bool use_CERES=L3D_DEF_USE_CERES,
+                                    const unsigned int max_iter_CERES=L3D_DEF_CERES_MAX_ITER,
+                                    const float rdd_prune_t=L3D_DEF_RDD_PRUNE_T);
+
+        // unsigned int numProgressiveResults(): number of intermediate models (see reconstructProgressive(...))
+        unsigned int numProgressiveResults();
+
+        // bool getProgressive3Dlines(...): returns an intermediate model (false if it does not exist)
+        // -------------------------------------
+        // PARAMETERS:
+        // -------------------------------------
+        // stage  - index of the intermediate model (0 -> coarsest)
+        // result - list of reconstructed 3D lines (see "segment3D.h")
+        // time   - seconds from the start of the progressive reconstruction until the model was available
+        bool getProgressive3Dlines(const unsigned int stage, std::vector<L3DPP::FinalLine3D>& result,
+                                   double& time);
 
-        // void get3Dlines(...): returns the current 3D model
+        // void get3Dlines(...): returns the current 3D model (copy, see acquireResultSnapshot(...) for
+        //                      read-only access without copying)
         // -------------------------------------
         // PARAMETERS:
         // -------------------------------------
         // result - list of reconstructed 3D lines (see "segment3D.h")
         void get3Dlines(std::vector<L3DPP::FinalLine3D>& result);
 
+        // const L3DPP::ResultSnapshot* acquireResultSnapshot(...): read-only access to the current 3D model
+        //                                                          without copying it (flat arrays, see "line3D_c.h"
+        //                                                          for the plain C interface). the snapshot is created
+        //                                                          at the end of reconstruct3Dlines(...) and does not
+        //                                                          block while a new model is computed.
+        //                                                          returns NULL if there is no model yet, otherwise
+        //                                                          the snapshot must be released (->release()).
+        //                                                          the model is moved into the snapshot (no copy),
+        //                                                          the flat arrays are built on the first ->view(...)
+        // -------------------------------------
+        // PARAMETERS:
+        // -------------------------------------
+        // none
+        const L3DPP::ResultSnapshot* acquireResultSnapshot();
+
+        // l3dpp_line3d* handle(): this object for the plain C interface (see "line3D_c.h"),
+        //                         fromHandle(...) converts it back
+        l3dpp_line3d* handle(){return reinterpret_cast<l3dpp_line3d*>(this);}
+        static L3DPP::Line3D* fromHandle(l3dpp_line3d* handle){return reinterpret_cast<L3DPP::Line3D*>(handle);}
+
+        // void query*(...): spatial queries on the current 3D model (batched, multithreaded). uses a bounding
+        //                   volume hierarchy over the collinear 3D segments, which is built at the end of
+        //                   reconstruct3Dlines(...). the lineIDs in the results refer to get3Dlines(...),
+        //                   the segmentIDs to FinalLine3D::collinear3Dsegments_ (see "spatialindex.h")
+        // -------------------------------------
+        // PARAMETERS:
+        // -------------------------------------
+        // boxes   - axis aligned boxes           --> all 3D segments intersecting the box
+        // points  - 3D points                    --> the k nearest 3D lines (closest segment per line, by distance)
+        // k       - number of nearest 3D lines
+        // frusta  - view frusta (camera params)  --> all 3D segments (partially) inside the frustum
+        // rays    - rays with a radius           --> all 3D segments within the radius (by position along the ray)
+        // results - one list of hits per query
+        void queryLinesInBox(const std::vector<L3DPP::SpatialBox>& boxes,
+                             std::vector<std::vector<L3DPP::SpatialHit> >& results);
+        void queryNearestLines(const std::vector<Eigen::Vector3d>& points, const unsigned int k,
+                               std::vector<std::vector<L3DPP::SpatialHit> >& results);
+        void queryLinesInFrustum(const std::vector<L3DPP::SpatialFrustum>& frusta,
+                                 std::vector<std::vector<L3DPP::SpatialHit> >& results);
+        void queryLinesOnRay(const std::vector<L3DPP::SpatialRay>& rays,
+                             std::vector<std::vector<L3DPP::SpatialHit> >& results);
+
+        // void getSupportedLines(...): returns the 3D lines that are supported by an image, and the 2D segments
+        //                              through which they are supported (reverse index, built at the end of
+        //                              reconstruct3Dlines(...), O(#result))
+        // int getLineOfSegment(...): returns the 3D line a 2D segment belongs to (-1 if none)
+        // -------------------------------------
+        // PARAMETERS:
+        // -------------------------------------
+        // camID  - ID of the image
+        // segID  - ID of the 2D segment (as in the residuals of the 3D lines)
+        // result - (lineID,segID) pairs sorted by lineID, lineIDs refer to get3Dlines(...)
+        void getSupportedLines(const unsigned int camID, std::vector<L3DPP::LineSupport>& result);
+        int getLineOfSegment(const unsigned int camID, const unsigned int segID);
+
+        // void projectLines(...): projects the current 3D model into a camera (batched, frustum culling via
+        //                         the spatial index). segments are clipped at the near plane and at the image
+        //                         borders. arbitrary 3D segments can be projected with L3DPP::SegmentProjector
+        //                         (see "projection.h")
+        // -------------------------------------
+        // PARAMETERS:
+        // -------------------------------------
+        // K,R,t         - camera intrinsics and pose [camera model: point2D = K [R | t] point3D]
+        // width, height - image size
+        //
+        // camID         - ID of a view (added with addImage(...))
+        // camIDs        - several views (processed in parallel, one result per view)
+        //
+        // result(s)     - clipped 2D segments with depths, lineIDs refer to get3Dlines(...)
+        // near_depth    - near plane (in scene units, <= 0 -> everything in front of the camera)
+        void projectLines(const Eigen::Matrix3d& K, const Eigen::Matrix3d& R,
+                          const Eigen::Vector3d& t, const unsigned int width,
+                          const unsigned int height,
+                          std::vector<L3DPP::ProjectedSegment2D>& result,
+                          const float near_depth=0.0f);
+        void projectLines(const unsigned int camID,
+                          std::vector<L3DPP::ProjectedSegment2D>& result,
+                          const float near_depth=0.0f);
+        void projectLines(const std::vector<unsigned int>& camIDs,
+                          std::vector<std::vector<L3DPP::ProjectedSegment2D> >& results,
+                          const float near_depth=0.0f);
+
         // void saveResultAs*(...): saves current 3D model in different ways
         // -------------------------------------
         // PARAMETERS:
@@ -188,7 +433,8 @@ namespace L3DPP
         // -------------------------------------
         // PARAMETERS:
         // -------------------------------------
-        // seg2D - desired 2D segment (camID and segmentID)
+        // seg2D - desired 2D segment (camID and segmentID, as given in the results
+        //         or the order of the line segments passed to addImage(...))
         //
         // camID - camera ID of desired 2D line segment
         // segID - segment ID of desired 2D line segment
@@ -207,9 +453,15 @@ namespace L3DPP
         // -------------------------------------
         // PARAMETERS:
         // -------------------------------------
-        // camID - ID of the given view (for re-loading only)
-        // image - the corresponding image (cv::Mat, CV_8U or CV_8UC3)
-        L3DPP::DataArray<float4>* detectLineSegments(const unsigned int camID, const cv::Mat& image);
+        // camID       - ID of the given view (for re-loading only)
+        // image       - the corresponding image (cv::Mat, CV_8U or CV_8UC3)
+        // K           - camera intrinsics (only needed for distorted images)
+        // dist_coeffs - distortion coefficients (k1,k2,p1,p2,k3), empty -> image is undistorted
+        // descriptors - if not NULL -> line descriptors are computed (and stored) as well
+        L3DPP::DataArray<float4>* detectLineSegments(const unsigned int camID, const cv::Mat& image,
+                                                     const Eigen::Matrix3d& K=Eigen::Matrix3d::Identity(),
+                                                     const Eigen::VectorXd& dist_coeffs=Eigen::VectorXd(),
+                                                     std::vector<L3DPP::LineDescriptor>* descriptors=NULL);
 
         // --------------------------------------------------
         // helper functions (needed in specific executables):
@@ -233,6 +485,55 @@ namespace L3DPP
                                               Eigen::Vector3d& t_out);
 
     private:
+        // adds an image (dist_coeffs: see detectLineSegments(...))
+        void insertImage(const unsigned int camID, cv::Mat& image,
+                         const Eigen::Matrix3d& K, const Eigen::Matrix3d& R,
+                         const Eigen::Vector3d& t, const float median_depth,
+                         const std::list<unsigned int>& wps_or_neighbors,
+                         const std::vector<cv::Vec4f>& line_segments,
+                         const Eigen::VectorXd& dist_coeffs);
+
+        // reserves the camIDs (reserved[i] = false -> ID already in use)
+        void reserveViews(const std::vector<unsigned int>& camIDs,
+                          std::vector<bool>& reserved);
+
+        // releases reserved camIDs (views that could not be created)
+        void releaseViews(const std::vector<unsigned int>& camIDs);
+
+        // checks if the image is large enough for reliable results
+        bool checkImageSize(const cv::Mat& image);
+
+        // creates a view (detects the 2D segments if none are given), NULL on failure
+        L3DPP::View* createView(const unsigned int camID, const cv::Mat& image,
+                                const Eigen::Matrix3d& K, const Eigen::Matrix3d& R,
+                                const Eigen::Vector3d& t, const float median_depth,
+                                const size_t num_wps_or_neighbors,
+                                const cv::Vec4f* line_segments, const size_t num_line_segments,
+                                const Eigen::VectorXd& dist_coeffs);
+
+        // keypoint grid of a view (positions are undistorted, see detectLineSegments(...))
+        static L3DPP::KeypointGrid* createKeypointGrid(const L3DPP::View* v,
+                                                       const unsigned int* wpIDs,
+                                                       const Eigen::Vector2f* positions,
+                                                       const size_t num,
+                                                       const Eigen::VectorXd& dist_coeffs);
+
+        // true if both views share enough keypoints for anchored matching
+        // (computed once per pair of views)
+        bool useKeypointAnchors(const L3DPP::View* v1, const L3DPP::View* v2);
+
+        // registers a created view [view_mutex_ must be locked!]
+        void registerView(L3DPP::View* v, const float median_depth,
+                          const std::list<unsigned int>& wps_or_neighbors);
+
+        // undistortion, resizing and grayscale conversion in one pass (one
+        // bilinear sample per output pixel, constant border)
+        static void undistortResizeGray(const cv::Mat& image, cv::Mat& result,
+                                        const Eigen::Matrix3d& K,
+                                        const Eigen::VectorXd& dist_coeffs,
+                                        const unsigned int width,
+                                        const unsigned int height);
+
         // process worldpoint list
         void processWPlist(const unsigned int camID, const std::list<unsigned int>& wps);
 
@@ -240,14 +541,61 @@ namespace L3DPP
         void setVisualNeighbors(const unsigned int camID, const std::list<unsigned int>& neighbors);
 
         // find visual neighbors
+        void computeVisualNeighbors();
         void findVisualNeighborsFromWPs(const unsigned int camID);
 
-        // initialize/cleanup src data on/from GPU
-        void initSrcDataGPU(const unsigned int src);
-        void removeSrcDataGPU(const unsigned int src);
+        // initialize/cleanup view data on/from GPU
+        void initViewDataGPU(const unsigned int camID);
+        void removeViewDataGPU(const unsigned int camID);
 
         // compute matches between images
-        void computeMatches();
+        void computeMatches(const std::vector<unsigned int>& order,
+                            const std::vector<std::list<unsigned int> >& release);
+
+        // locality aware order in which the views are processed
+        // (partition by partition, if given)
+        void computeProcessingOrder(const std::map<unsigned int,unsigned int>& view2part,
+                                    std::vector<unsigned int>& order,
+                                    std::vector<std::list<unsigned int> >& release);
+
+        // expected matching/scoring workload of a view
+        double estimatedViewCost(const unsigned int camID);
+
+        // balanced partitioning of the visual neighbor graph
+        void partitionViewGraph(const unsigned int num_parts,
+                                std::map<unsigned int,unsigned int>& view2part);
+
+        // distribute views over the NUMA nodes (one partition per node),
+        // relocate the view data to its node
+        void assignViewsToNodes(const std::vector<unsigned int>& order,
+                                const std::map<unsigned int,unsigned int>& view2part);
+
+        // NUMA node of a view and the arena for its matches (on that node)
+        unsigned int viewNode(const unsigned int camID) const;
+        L3DPP::Arena* matchArena(const unsigned int camID);
+
+        // number of OpenMP worker threads
+        int numWorkerThreads();
+
+        // matching/scoring kernels (selected once per stage),
+        // CPU scoring kernels score the hypotheses of a single segment
+        typedef void (Line3D::*MatchingKernel)(const unsigned int, const unsigned int,
+                                               const Eigen::Matrix3d&);
+        typedef bool (Line3D::*ScoringKernel)(const unsigned int, const unsigned int);
+        MatchingKernel matchingKernel(const bool all_active) const;
+        ScoringKernel scoringKernel() const;
+        template<class P>
+        MatchingKernel matchingKernelCPU(const bool all_active) const;
+
+        // matches all views on the CPU, each view by a pinned thread
+        // on its NUMA node (views of different nodes concurrently)
+        void matchViewsOnNodes(const std::vector<unsigned int>& order,
+                               const MatchingKernel matching);
+
+        // CPU matching, specialized for kNN matching (kNN_ > 0),
+        // progressive mode (ALL_ACTIVE -> no segment filtering) and
+        // the numeric precision P (see precision.h)
+        template<bool KNN, bool ALL_ACTIVE, class P>
         void matchingCPU(const unsigned int src, const unsigned int tgt,
                          const Eigen::Matrix3d& F);
         void matchingGPU(const unsigned int src, const unsigned int tgt,
@@ -257,32 +605,61 @@ namespace L3DPP
         Eigen::Matrix3d getFundamentalMatrix(L3DPP::View* src, L3DPP::View* tgt);
 
         // check if a given point x is inside a line segment p1,p2 (point must be on the line!)
-        bool pointOnSegment(const Eigen::Vector3d& x, const Eigen::Vector3d& p1,
-                            const Eigen::Vector3d& p2);
+        template<class P>
+        bool pointOnSegment(const typename P::Vector3& x, const typename P::Vector3& p1,
+                            const typename P::Vector3& p2);
 
         // compute segment overlap (input: 4 collinear points)
-        float mutualOverlap(const std::vector<Eigen::Vector3d>& collinear_points);
+        template<class P>
+        float mutualOverlap(const typename P::Vector3* collinear_points);
 
         // compute endpoint depths for a line segment, based on a match
-        Eigen::Vector2d triangulationDepths(const unsigned int src_camID, const Eigen::Vector3d& p1,
-                                            const Eigen::Vector3d& p2, const unsigned int tgt_camID,
-                                            const Eigen::Vector3d& line_q1, const Eigen::Vector3d& line_q2);
+        // (normalized rays through the endpoints and the matched segment,
+        // baseline = C_tgt - C_src)
+        template<class P>
+        typename P::Vector2 triangulationDepths(const typename P::Vector3& ray_p1,
+                                                const typename P::Vector3& ray_p2,
+                                                const typename P::Vector3& ray_q1,
+                                                const typename P::Vector3& ray_q2,
+                                                const typename P::Vector3& baseline);
 
         // sort matches for each source segment
         void sortMatches(const unsigned int src);
 
-        // score matches
-        void scoringCPU(const unsigned int src, float& valid_f);
+        // score matches (CPU: hypotheses of one segment, true -> valid hypothesis exists,
+        // GPU: all segments of a view)
+        template<class P>
+        bool scoringCPU(const unsigned int camID, const unsigned int segID);
         void scoringGPU(const unsigned int src, float& valid_f);
 
-        // similarity between two matches/segments
+        // score all hypotheses of a view on the CPU, segment by segment
+        // (fraction of segments with a valid hypothesis)
+        void scoreView(const unsigned int src, float& valid_f);
+
+        // hashes the hypotheses of one segment by their depths and their angles
+        // in the viewing plane (for scoringCPU, empty angles -> depths only),
+        // radii: max. depth/angle differences for a similarity above
+        // L3D_DEF_MIN_SIMILARITY_3D (negative -> compare with all hypotheses)
+        void buildHypothesisHash(const std::vector<L3DPP::Match>& hyps,
+                                 const std::vector<float>& regs1,
+                                 const std::vector<float>& regs2,
+                                 const std::vector<float>& angles,
+                                 std::vector<float>& radii1,
+                                 std::vector<float>& radii2,
+                                 float& radius_angle,
+                                 L3DPP::HypothesisHash& hash);
+
+        // similarity between two matches/segments (directions
+        // of the unprojected matches, zero -> invalid)
+        template<class P>
         float similarityForScoring(const L3DPP::Match& m1, const L3DPP::Match& m2,
-                                   const L3DPP::Segment3D& seg3D1,
+                                   const typename P::Vector3& dir1,
+                                   const typename P::Vector3& dir2,
                                    const float reg1, const float reg2);
         float similarity(const L3DPP::Segment2D& seg1, const L3DPP::Segment2D& seg2,
                          const bool truncate);
-        float similarity(const L3DPP::Segment3D& s1, const L3DPP::Match& m1,
-                         const L3DPP::Segment2D& seg2, const bool truncate);
+        float similarity(const L3DPP::Hypothesis3D& hyp1, const L3DPP::Hypothesis3D& hyp2,
+                         const bool truncate);
 
         // angle between two segments (in degrees!)
         float angleBetweenSeg3D(const L3DPP::Segment3D& s1, const L3DPP::Segment3D& s2,
@@ -293,22 +670,50 @@ namespace L3DPP
 
         // check match orientation (angle between optical axis and 3D segment)
         void checkMatchOrientation(const unsigned int src);
+        template<class P>
+        bool validMatchOrientation(const L3DPP::Match& m);
 
-        // store new matches for other image as well
+        // store matches for the other image as well
         void storeInverseMatches(const unsigned int src);
 
+        // link the matched segments into multi-view tracks (after filtering):
+        // mutually best correspondences, strongest first, at most
+        // L3D_DEF_MAX_TRACK_SIZE segments per track (largest first)
+        void buildTracks();
+
         // filter out invalid matches
         void filterMatches(const unsigned int src);
 
         // find collinear 2D segments (per image)
         void findCollinearSegments();
 
-        // computing affinity matrix
+        // computing affinity matrix (track by track)
         void computingAffinityMatrix();
-        bool unused(const L3DPP::Segment2D& seg1, const L3DPP::Segment2D& seg2);
 
-        // get a local ID for clustering (=row index in A matrix)
-        int getLocalID(const L3DPP::Segment2D& seg);
+        // 3D hypotheses in structure-of-arrays layout (for the affinity evaluation)
+        struct HypothesisBatch
+        {
+            void resize(const size_t n);
+
+            // first endpoint, direction (zero -> invalid) and length
+            std::vector<float> x_,y_,z_;
+            std::vector<float> dx_,dy_,dz_;
+            std::vector<float> length_;
+            // positional regularizers of both endpoints (2*sigma^2)
+            std::vector<float> reg1_,reg2_;
+        };
+        void gatherHypotheses(HypothesisBatch& batch);
+
+        // evaluates candidate pairs of 3D hypotheses (entries in estimated_position3D_),
+        // valid pairs are appended to 'valid'
+        void evaluateAffinities(const HypothesisBatch& batch,
+                                const std::vector<std::pair<size_t,size_t> >& candidates,
+                                std::vector<std::pair<std::pair<size_t,size_t>,float> >& valid);
+
+        // rows of the affinity matrix per track (tracks that are connected
+        // by collinearity links are merged, no edges in between afterwards)
+        void groupTrackRows(const std::vector<int>& entry2track,
+                            const std::vector<int>& entry2local);
 
         // perform replicator dynamics diffusion on A
         void performRDD();
@@ -322,8 +727,11 @@ namespace L3DPP
         // filter tiny segments
         void filterTinySegments();
 
+        // residuals of the final 3D lines -> original segment IDs
+        void mapToOriginalSegmentIDs();
+
         // get 3D line from clustered 3D lines
-        L3DPP::LineCluster3D get3DlineFromCluster(const std::list<L3DPP::Segment2D>& cluster);
+        L3DPP::LineCluster3D get3DlineFromCluster(const std::vector<L3DPP::Segment2D>& cluster);
 
         // project 2D segment onto 3D line
         L3DPP::Segment3D project2DsegmentOnto3Dline(const L3DPP::Segment2D& seg2D,
@@ -331,7 +739,7 @@ namespace L3DPP
                                                     bool& success);
 
         // compute collinear segments on cluster
-        std::list<L3DPP::Segment3D> findCollinearSegments(const L3DPP::LineCluster3D& cluster);
+        std::vector<L3DPP::Segment3D> findCollinearSegments(const L3DPP::LineCluster3D& cluster);
 
         // optimize (bundle) 3D line clusters
         void optimizeClusters();
@@ -344,7 +752,17 @@ namespace L3DPP
                                  const std::string& suffix,
                                  const std::vector<L3DPP::Segment3D>& lines3D);
 
-        // translate/untranslate views and 3D models (for better numerical stability)
+        // current 3D model (owned by the snapshot, empty if there is none),
+        // requires view_mutex_ (the snapshot is only replaced while it is locked)
+        const std::vector<L3DPP::FinalLine3D>& model() const;
+
+        // projects the 3D model with frustum culling (no locking)
+        void projectModel(const L3DPP::SegmentProjector& projector,
+                          std::vector<L3DPP::ProjectedSegment2D>& result);
+
+        // translate/untranslate views (for better numerical stability), untranslate
+        // also moves the 3D lines of the current reconstruction to the original
+        // coordinates (before they are handed over to the result snapshot)
         void translate();
         void untranslate();
         void performTranslation(const Eigen::Vector3d t);
@@ -355,12 +773,17 @@ namespace L3DPP
         std::string prefix_err_;
         std::string prefix_wng_;
         bool useGPU_;
+        L3DPP::BufferPool buffer_pool_;
         boost::mutex display_text_mutex_;
 
         // line segment detection
         unsigned int max_line_segments_;
         int max_image_width_;
         bool load_segments_;
+        bool quantize_segments_;
+        bool spatial_segment_order_;
+        bool float_precision_;
+        bool use_descriptors_;
         float collinearity_t_;
 
         // view data
@@ -375,6 +798,13 @@ namespace L3DPP
         float med_scene_depth_lines_;
         Eigen::Vector3d translation_;
 
+        // NUMA placement (views per worker thread, on the owning node)
+        L3DPP::NumaTopology numa_;
+        bool pin_threads_;
+        std::map<unsigned int,unsigned int> view2node_;
+        std::vector<unsigned int> thread_nodes_;
+        std::vector<std::vector<unsigned int> > thread_views_;
+
         // neighbors
         bool neighbors_by_worldpoints_;
         std::map<unsigned int,std::list<unsigned int> > worldpoints2views_;
@@ -391,13 +821,17 @@ namespace L3DPP
         boost::mutex scoring_mutex_;
         std::map<unsigned int,std::set<unsigned int> > matched_;
         std::map<unsigned int,std::map<unsigned int,Eigen::Matrix3d> > fundamentals_;
-        std::map<unsigned int,std::vector<std::list<L3DPP::Match> > > matches_;
+        boost::mutex anchor_mutex_;
+        std::map<std::pair<unsigned int,unsigned int>,bool> anchor_pairs_;
+        std::vector<L3DPP::Arena*> match_arenas_; // one per NUMA node
+        std::map<unsigned int,std::vector<L3DPP::MatchList> > matches_;
         std::map<unsigned int,unsigned int> num_matches_;
         std::map<unsigned int,bool> processed_;
+        std::vector<std::vector<L3DPP::Segment2D> > tracks_;
 
         // scoring
         boost::mutex best_match_mutex_;
-        std::vector<std::pair<L3DPP::Segment3D,L3DPP::Match> > estimated_position3D_;
+        std::vector<L3DPP::Hypothesis3D> estimated_position3D_;
         std::map<L3DPP::Segment2D,size_t> entry_map_;
         float sigma_p_;
         float sigma_a_;
@@ -407,20 +841,27 @@ namespace L3DPP
 
         // reconstruction
         bool perform_RDD_;
+        float rdd_prune_t_;
         bool use_CERES_;
         unsigned int max_iter_CERES_;
-        int localID_;
         unsigned int visibility_t_;
-        boost::mutex aff_id_mutex_;
-        boost::mutex aff_used_mutex_;
         boost::mutex aff_mat_mutex_;
         boost::mutex cluster_mutex_;
-        std::list<L3DPP::CLEdge> A_;
-        std::map<L3DPP::Segment2D,int> global2local_;
-        std::map<int,L3DPP::Segment2D> local2global_;
+        L3DPP::Arena affinity_arena_;
+        L3DPP::Arena cluster_arena_;
+        L3DPP::CLEdgeList A_;
+        std::vector<L3DPP::Segment2D> local2global_;
+        std::vector<std::vector<int> > track_rows_;
         std::vector<L3DPP::LineCluster3D> clusters3D_;
         std::vector<L3DPP::FinalLine3D> lines3D_;
-        std::map<L3DPP::Segment2D,std::set<L3DPP::Segment2D> > used_;
+        L3DPP::SpatialIndex spatial_index_;
+        boost::mutex snapshot_mutex_;
+        L3DPP::ResultSnapshot* snapshot_;
+
+        // progressive reconstruction (shared snapshots)
+        boost::mutex progressive_mutex_;
+        std::vector<const L3DPP::ResultSnapshot*> progressive_lines3D_;
+        std::vector<double> progressive_times_;
     };
 }
 
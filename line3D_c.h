@@ -0,0 +1,101 @@
+#ifndef I3D_LINE3D_PP_LINE3D_C_H_
+#define I3D_LINE3D_PP_LINE3D_C_H_
+
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+/**
+ * Line3D++ - C Result API
+ * ====================
+ * Read-only, zero-copy access to the
+ * 3D model of a reconstruction (plain C,
+ * no boost/Eigen headers required).
+ * The data is owned by an immutable,
+ * reference counted snapshot that stays
+ * valid until it is released (also when
+ * the model is recomputed meanwhile).
+ * ====================
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* opaque handles */
+typedef struct l3dpp_line3d l3dpp_line3d;       /* an L3DPP::Line3D object */
+typedef struct l3dpp_snapshot l3dpp_snapshot;   /* an L3DPP::ResultSnapshot */
+
+/* flat view of a snapshot (all strides in elements, not bytes) */
+typedef struct l3dpp_result_view
+{
+    /* counts */
+    size_t num_lines;       /* final 3D lines */
+    size_t num_segments;    /* collinear 3D segments (of all lines) */
+    size_t num_residuals;   /* 2D residuals (of all lines) */
+    size_t num_views;       /* images */
+
+    /* 3D line of line i: lines[i*line_stride+0..5] = (x1,y1,z1,x2,y2,z2) */
+    const double* lines;
+    size_t line_stride;
+
+    /* collinear 3D segments of line i: segment_offsets[i] .. segment_offsets[i+1]-1,
+       segment j: segments[j*segment_stride+0..5] = (x1,y1,z1,x2,y2,z2) */
+    const uint32_t* segment_offsets;
+    const double* segments;
+    size_t segment_stride;
+
+    /* 2D residuals of line i: residual_offsets[i] .. residual_offsets[i+1]-1,
+       residual j: residuals[j*residual_stride+0..1] = (camID,segID) */
+    const uint32_t* residual_offsets;
+    const uint32_t* residuals;
+    size_t residual_stride;
+
+    /* reverse index, view v = view_ids[v] (sorted):
+       supported lines: view_support_offsets[v] .. view_support_offsets[v+1]-1,
+       entry j: view_support[j*view_support_stride+0..1] = (lineID,segID)
+       2D segments that are part of a line: view_segment_offsets[v] .. view_segment_offsets[v+1]-1,
+       entry j: segment view_segment_ids[j] (sorted per view) -> line view_segment_lines[j],
+       segments that are not listed are not part of any line */
+    const uint32_t* view_ids;
+    const uint32_t* view_support_offsets;
+    const uint32_t* view_support;
+    size_t view_support_stride;
+    const uint32_t* view_segment_offsets;
+    const uint32_t* view_segment_ids;
+    const int32_t* view_segment_lines;
+} l3dpp_result_view;
+
+/* creates a Line3D++ object with the default parameters (NULL on failure),
+   objects created in C++ are passed as L3DPP::Line3D::handle() */
+l3dpp_line3d* l3dpp_line3d_create(const char* output_folder);
+
+/* destroys an object from l3dpp_line3d_create(...),
+   acquired snapshots stay valid */
+void l3dpp_line3d_destroy(l3dpp_line3d* line3d);
+
+/* latest result of a reconstruction (NULL if there is none),
+   must be released with l3dpp_snapshot_release(...) */
+const l3dpp_snapshot* l3dpp_snapshot_acquire(l3dpp_line3d* line3d);
+
+/* additional reference / release a reference */
+void l3dpp_snapshot_retain(const l3dpp_snapshot* snapshot);
+void l3dpp_snapshot_release(const l3dpp_snapshot* snapshot);
+
+/* fills the view (pointers are valid until the snapshot is released),
+   returns 0 on success */
+int l3dpp_snapshot_view(const l3dpp_snapshot* snapshot, l3dpp_result_view* view);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* I3D_LINE3D_PP_LINE3D_C_H_ */
@@ -0,0 +1,134 @@
+#include "linedescriptor.h"
+
+// std
+#include <cmath>
+
+#ifdef L3DPP_OPENMP
+#include <omp.h>
+#endif //L3DPP_OPENMP
+
+namespace L3DPP
+{
+    //------------------------------------------------------------------------------
+    void computeLineDescriptors(const cv::Mat& gray,
+                                L3DPP::DataArray<float4>* segments,
+                                const float scale_x, const float scale_y,
+                                std::vector<L3DPP::LineDescriptor>& descriptors)
+    {
+        descriptors.clear();
+        if(segments == NULL || gray.type() != CV_8U)
+            return;
+
+        descriptors.resize(segments->width());
+
+        const int half_width = int(L3D_LINE_DESC_BANDS*L3D_LINE_DESC_BAND_WIDTH)/2;
+
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for
+#endif //L3DPP_OPENMP
+        for(int i=0; i<segments->width(); ++i)
+        {
+            float4 coords = segments->dataCPU(i,0)[0];
+            float x1 = coords.x*scale_x; float y1 = coords.y*scale_y;
+            float x2 = coords.z*scale_x; float y2 = coords.w*scale_y;
+
+            float len = sqrtf((x2-x1)*(x2-x1)+(y2-y1)*(y2-y1));
+            if(len < 1.0f)
+                continue;
+
+            // segment frame
+            float dx = (x2-x1)/len; float dy = (y2-y1)/len;
+            float nx = -dy; float ny = dx;
+
+            unsigned int num_samples = std::min(std::max(int(len),2),int(L3D_LINE_DESC_MAX_SAMPLES));
+
+            // gradient statistics per band: across+, across-, along+, along-
+            float stats[L3D_LINE_DESC_BANDS][L3D_LINE_DESC_STATS];
+            for(unsigned int b=0; b<L3D_LINE_DESC_BANDS; ++b)
+                for(unsigned int s=0; s<L3D_LINE_DESC_STATS; ++s)
+                    stats[b][s] = 0.0f;
+
+            for(unsigned int k=0; k<num_samples; ++k)
+            {
+                float t = float(k)/float(num_samples-1);
+                float px = x1+t*(x2-x1);
+                float py = y1+t*(y2-y1);
+
+                for(int o=-half_width; o<half_width; ++o)
+                {
+                    int x = cvRound(px+(float(o)+0.5f)*nx);
+                    int y = cvRound(py+(float(o)+0.5f)*ny);
+                    if(x < 1 || y < 1 || x >= gray.cols-1 || y >= gray.rows-1)
+                        continue;
+
+                    float gx = float(gray.at<uchar>(y,x+1))-float(gray.at<uchar>(y,x-1));
+                    float gy = float(gray.at<uchar>(y+1,x))-float(gray.at<uchar>(y-1,x));
+
+                    float g_across = gx*nx+gy*ny;
+                    float g_along = gx*dx+gy*dy;
+
+                    unsigned int b = (o+half_width)/L3D_LINE_DESC_BAND_WIDTH;
+                    if(g_across > 0.0f)
+                        stats[b][0] += g_across;
+                    else
+                        stats[b][1] -= g_across;
+
+                    if(g_along > 0.0f)
+                        stats[b][2] += g_along;
+                    else
+                        stats[b][3] -= g_along;
+                }
+            }
+
+            // canonical orientation (dominant gradient across the line is positive),
+            // flipping the segment mirrors the bands and swaps the signs
+            float across = 0.0f;
+            for(unsigned int b=0; b<L3D_LINE_DESC_BANDS; ++b)
+                across += stats[b][0]-stats[b][1];
+
+            if(across < 0.0f)
+            {
+                for(unsigned int b=0; b<L3D_LINE_DESC_BANDS/2; ++b)
+                {
+                    for(unsigned int s=0; s<L3D_LINE_DESC_STATS; ++s)
+                        std::swap(stats[b][s],stats[L3D_LINE_DESC_BANDS-1-b][s]);
+                }
+
+                for(unsigned int b=0; b<L3D_LINE_DESC_BANDS; ++b)
+                {
+                    std::swap(stats[b][0],stats[b][1]);
+                    std::swap(stats[b][2],stats[b][3]);
+                }
+            }
+
+            // binary tests
+            L3DPP::LineDescriptor desc;
+            unsigned int bit = 0;
+            for(unsigned int s=0; s<L3D_LINE_DESC_STATS; ++s)
+            {
+                for(unsigned int b1=0; b1<L3D_LINE_DESC_BANDS; ++b1)
+                {
+                    for(unsigned int b2=b1+1; b2<L3D_LINE_DESC_BANDS; ++b2,++bit)
+                    {
+                        if(stats[b1][s] > stats[b2][s])
+                            desc.setBit(bit);
+                    }
+                }
+            }
+
+            for(unsigned int b=0; b<L3D_LINE_DESC_BANDS; ++b)
+            {
+                for(unsigned int s1=0; s1<L3D_LINE_DESC_STATS; ++s1)
+                {
+                    for(unsigned int s2=s1+1; s2<L3D_LINE_DESC_STATS; ++s2,++bit)
+                    {
+                        if(stats[b][s1] > stats[b][s2])
+                            desc.setBit(bit);
+                    }
+                }
+            }
+
+            descriptors[i] = desc;
+        }
+    }
+}
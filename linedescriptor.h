@@ -0,0 +1,120 @@
+#ifndef I3D_LINE3D_PP_LINEDESCRIPTOR_H_
+#define I3D_LINE3D_PP_LINEDESCRIPTOR_H_
+
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <vector>
+#include <iostream>
+#include <stdint.h>
+
+// external
+#include "boost/serialization/nvp.hpp"
+
+// opencv
+#ifndef L3DPP_OPENCV3
+#include "opencv/cv.h"
+#else
+#include "opencv2/core.hpp"
+#endif //L3DPP_OPENCV3
+
+// internal
+#include "dataArray.h"
+
+/**
+ * Line3D++ - LineDescriptor
+ * ====================
+ * Binary band descriptor for 2D line
+ * segments (similar to LBD): the support
+ * region is split into bands parallel to
+ * the segment, each band is described by
+ * its gradient statistics in the segment
+ * frame (+/- across and along the line).
+ * The bits are pairwise comparisons of
+ * these statistics (between bands and
+ * within a band), i.e. the descriptor
+ * is invariant to affine intensity changes.
+ * Descriptors are compared using the
+ * Hamming distance.
+ * ====================
+ */
+
+namespace L3DPP
+{
+    // descriptor layout
+    const unsigned int L3D_LINE_DESC_BANDS = 8;
+    const unsigned int L3D_LINE_DESC_BAND_WIDTH = 3;
+    const unsigned int L3D_LINE_DESC_STATS = 4;
+    const unsigned int L3D_LINE_DESC_MAX_SAMPLES = 64;
+    // STATS*BANDS*(BANDS-1)/2 + BANDS*STATS*(STATS-1)/2 = 112+48
+    const unsigned int L3D_LINE_DESC_BITS = 160;
+    const unsigned int L3D_LINE_DESC_WORDS = 5;
+
+    //------------------------------------------------------------------------------
+    struct LineDescriptor
+    {
+        LineDescriptor()
+        {
+            for(unsigned int i=0; i<L3D_LINE_DESC_WORDS; ++i)
+                bits_[i] = 0;
+        }
+
+        void setBit(const unsigned int b)
+        {
+            bits_[b/32] |= (uint32_t(1) << (b%32));
+        }
+
+        uint32_t bits_[L3D_LINE_DESC_WORDS];
+
+        // serialization
+        template<class Archive>
+        void serialize(Archive & ar, const unsigned int version)
+        {
+            ar & boost::serialization::make_nvp("bits_", bits_);
+        }
+    };
+
+    // number of set bits
+    inline unsigned int popcount32(uint32_t x)
+    {
+#ifdef __GNUC__
+        return __builtin_popcount(x);
+#else
+        x = x - ((x >> 1) & 0x55555555);
+        x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+        return (((x + (x >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+#endif //__GNUC__
+    }
+
+    // Hamming distance [0,L3D_LINE_DESC_BITS]
+    inline unsigned int hammingDistance(const L3DPP::LineDescriptor& d1,
+                                        const L3DPP::LineDescriptor& d2)
+    {
+        unsigned int dist = 0;
+        for(unsigned int i=0; i<L3D_LINE_DESC_WORDS; ++i)
+            dist += popcount32(d1.bits_[i] ^ d2.bits_[i]);
+
+        return dist;
+    }
+
+    // computes the descriptors of all segments
+    // gray     - image (CV_8U) on which the segments were detected
+    // segments - segment coordinates (x1,y1,x2,y2)
+    // scale_x/scale_y - segment coordinates -> image coordinates
+    void computeLineDescriptors(const cv::Mat& gray,
+                                L3DPP::DataArray<float4>* segments,
+                                const float scale_x, const float scale_y,
+                                std::vector<L3DPP::LineDescriptor>& descriptors);
+}
+
+#endif //I3D_LINE3D_PP_LINEDESCRIPTOR_H_
@@ -100,6 +100,7 @@
 #include <limits.h>
 #include <float.h>
 #include "lsd.hpp"
+#include "lsd_profile.hpp"
 
 /** ln(10) */
 #ifndef M_LN10
@@ -2067,14 +2068,23 @@ double * LineSegmentDetection( int * n_out,
   image = new_image_double_ptr( (unsigned int) X, (unsigned int) Y, img );
   if( scale != 1.0 )
     {
+      LSD_PROFILE_BEGIN(t_scale);
       scaled_image = gaussian_sampler( image, scale, sigma_scale );
+      LSD_PROFILE_END(t_scale,SCALE);
+
+      LSD_PROFILE_BEGIN(t_gradient);
       angles = ll_angle( scaled_image, rho, &list_p, &mem_p,
                          &modgrad, (unsigned int) n_bins );
+      LSD_PROFILE_END(t_gradient,GRADIENT);
       free_image_double(scaled_image);
     }
   else
-    angles = ll_angle( image, rho, &list_p, &mem_p, &modgrad,
-                       (unsigned int) n_bins );
+    {
+      LSD_PROFILE_BEGIN(t_gradient);
+      angles = ll_angle( image, rho, &list_p, &mem_p, &modgrad,
+                         (unsigned int) n_bins );
+      LSD_PROFILE_END(t_gradient,GRADIENT);
+    }
   xsize = angles->xsize;
   ysize = angles->ysize;
 
@@ -2112,15 +2122,21 @@ double * LineSegmentDetection( int * n_out,
        /* there is no risk of double comparison problems here
           because we are only interested in the exact NOTDEF value */
       {
+        int found;
+
         /* find the region of connected point and ~equal angle */
+        LSD_PROFILE_BEGIN(t_grow);
         region_grow( list_p->x, list_p->y, angles, reg, &reg_size,
                      &reg_angle, used, prec );
+        LSD_PROFILE_END(t_grow,REGION_GROW);
 
         /* reject small regions */
         if( reg_size < min_reg_size ) continue;
 
         /* construct rectangular approximation for the region */
+        LSD_PROFILE_BEGIN(t_rect);
         region2rect(reg,reg_size,modgrad,reg_angle,prec,p,&rec);
+        LSD_PROFILE_END(t_rect,REGION_GROW);
 
         /* Check if the rectangle exceeds the minimal density of
            region points. If not, try to improve the region.
@@ -2131,12 +2147,18 @@ double * LineSegmentDetection( int * n_out,
            by R. Grompone von Gioi, J. Jakubowicz, J.M. Morel, and G. Randall.
            The original algorithm is obtained with density_th = 0.0.
          */
-        if( !refine( reg, &reg_size, modgrad, reg_angle,
-                     prec, p, &rec, used, angles, density_th ) ) continue;
+        LSD_PROFILE_BEGIN(t_refine);
+        found = refine( reg, &reg_size, modgrad, reg_angle,
+                        prec, p, &rec, used, angles, density_th );
 
         /* compute NFA value */
-        log_nfa = rect_improve(&rec,angles,logNT,log_eps);
-        if( log_nfa <= log_eps ) continue;
+        if( found )
+          {
+            log_nfa = rect_improve(&rec,angles,logNT,log_eps);
+            found = !( log_nfa <= log_eps );
+          }
+        LSD_PROFILE_END(t_refine,REFINE);
+        if( !found ) continue;
 
         /* A New Line Segment was found! */
         ++ls_count;  /* increase line segment counter */
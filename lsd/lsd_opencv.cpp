@@ -54,6 +54,7 @@
 #include <opencv2/highgui/highgui.hpp> // Only for imshow
 
 #include "lsd_opencv.hpp"
+#include "lsd_profile.hpp"
 
 /////////////////////////////////////////////////////////////////////////////////////////
 // Default LSD parameters
@@ -546,6 +547,7 @@ void LineSegmentDetectorImpl::flsd(std::vector<Vec4f>& lines,
     std::vector<coorlist> list;
     if(SCALE != 1)
     {
+        LSD_PROFILE_BEGIN(t_scale);
         Mat gaussian_img;
         const double sigma = (SCALE < 1)?(SIGMA_SCALE / SCALE):(SIGMA_SCALE);
         const double sprec = 3;
@@ -554,12 +556,18 @@ void LineSegmentDetectorImpl::flsd(std::vector<Vec4f>& lines,
         GaussianBlur(image, gaussian_img, ksize, sigma);
         // Scale image to needed size
         resize(gaussian_img, scaled_image, Size(), SCALE, SCALE);
+        LSD_PROFILE_END(t_scale, SCALE);
+
+        LSD_PROFILE_BEGIN(t_gradient);
         ll_angle(rho, N_BINS, list);
+        LSD_PROFILE_END(t_gradient, GRADIENT);
     }
     else
     {
         scaled_image = image;
+        LSD_PROFILE_BEGIN(t_gradient);
         ll_angle(rho, N_BINS, list);
+        LSD_PROFILE_END(t_gradient, GRADIENT);
     }
 
     LOG_NT = 5 * (log10(double(img_width)) + log10(double(img_height))) / 2 + log10(11.0);
@@ -580,28 +588,36 @@ void LineSegmentDetectorImpl::flsd(std::vector<Vec4f>& lines,
         {
             int reg_size;
             double reg_angle;
+            LSD_PROFILE_BEGIN(t_grow);
             region_grow(list[i].p, reg, reg_size, reg_angle, prec);
+            LSD_PROFILE_END(t_grow, REGION_GROW);
 
             // Ignore small regions
             if(reg_size < min_reg_size) { continue; }
 
             // Construct rectangular approximation for the region
             rect rec;
+            LSD_PROFILE_BEGIN(t_rect);
             region2rect(reg, reg_size, reg_angle, prec, p, rec);
+            LSD_PROFILE_END(t_rect, REGION_GROW);
 
             double log_nfa = -1;
+            bool found = true;
+            LSD_PROFILE_BEGIN(t_refine);
             if(doRefine > LSD_REFINE_NONE)
             {
                 // At least REFINE_STANDARD lvl.
-                if(!refine(reg, reg_size, reg_angle, prec, p, rec, DENSITY_TH)) { continue; }
+                found = refine(reg, reg_size, reg_angle, prec, p, rec, DENSITY_TH);
 
-                if(doRefine >= LSD_REFINE_ADV)
+                if(found && doRefine >= LSD_REFINE_ADV)
                 {
                     // Compute NFA
                     log_nfa = rect_improve(rec);
-                    if(log_nfa <= LOG_EPS) { continue; }
+                    found = !(log_nfa <= LOG_EPS);
                 }
             }
+            LSD_PROFILE_END(t_refine, REFINE);
+            if(!found) { continue; }
             // Found new line
             ++ls_count;
 
@@ -0,0 +1,84 @@
+#ifndef LSD_PROFILE_HPP
+#define LSD_PROFILE_HPP
+
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+/**
+ * Line3D++ - LSD stage timers
+ * ====================
+ * Accumulated runtime of the LSD stages
+ * (scale, gradient, region grow, refine).
+ * Only active when the detector sources
+ * are compiled with -DLSD_PROFILE (detector
+ * benchmark), otherwise the macros expand
+ * to nothing. Not thread safe!
+ * ====================
+ */
+
+namespace lsd_profile
+{
+    enum Stage
+    {
+        SCALE = 0,
+        GRADIENT,
+        REGION_GROW,
+        REFINE,
+        NUM_STAGES
+    };
+
+    inline const char* stageName(const int stage)
+    {
+        static const char* names[NUM_STAGES] = {"scale","gradient","region_grow","refine"};
+        return (stage >= 0 && stage < NUM_STAGES) ? names[stage] : "unknown";
+    }
+}
+
+#ifdef LSD_PROFILE
+
+#include <opencv2/core/core.hpp>
+
+namespace lsd_profile
+{
+    // accumulated ticks per stage
+    inline int64* ticks()
+    {
+        static int64 t[NUM_STAGES] = {0,0,0,0};
+        return t;
+    }
+
+    inline void reset()
+    {
+        for(int i=0; i<NUM_STAGES; ++i)
+            ticks()[i] = 0;
+    }
+
+    inline void add(const int stage, const int64 start)
+    {
+        ticks()[stage] += cv::getTickCount()-start;
+    }
+
+    // accumulated time [ms] since the last reset()
+    inline double ms(const int stage)
+    {
+        return double(ticks()[stage])*1000.0/cv::getTickFrequency();
+    }
+}
+
+#define LSD_PROFILE_BEGIN(var) const int64 var = cv::getTickCount()
+#define LSD_PROFILE_END(var,stage) lsd_profile::add(lsd_profile::stage,var)
+
+#else
+
+#define LSD_PROFILE_BEGIN(var)
+#define LSD_PROFILE_END(var,stage)
+
+#endif //LSD_PROFILE
+
+#endif //LSD_PROFILE_HPP
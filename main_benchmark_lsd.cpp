@@ -0,0 +1,460 @@
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// EXTERNAL
+#include <tclap/CmdLine.h>
+#include <tclap/CmdLineInterface.h>
+#include <boost/filesystem.hpp>
+
+// std
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+
+// opencv
+#ifdef L3DPP_OPENCV3
+#include <opencv2/highgui.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#else
+#include <opencv/highgui.h>
+#include "opencv/cv.h"
+#include "lsd/lsd_opencv.hpp"
+#endif //L3DPP_OPENCV3
+
+// lsd
+#include "lsd/lsd.hpp"
+#include "lsd/lsd_profile.hpp"
+
+// lib
+#include "commons.h"
+
+// INFO:
+// This executable benchmarks the line segment detectors (LSD) on all images of one or more folders
+// (default: the testdata). For each detector it reports the runtime in ms/MPixel (total and per stage),
+// the number of detected segments and the repeatability w.r.t. the other detectors.
+// The stage timers are only available for the detectors that are compiled with -DLSD_PROFILE
+// (the bundled ones), the OpenCV 3 detector only reports the total runtime.
+// To add a new detector, derive from DetectorBackend and add it in createBackends(...).
+
+//------------------------------------------------------------------------------
+// line segment detector
+class DetectorBackend
+{
+public:
+    virtual ~DetectorBackend(){}
+
+    // name for the report
+    virtual std::string name() const = 0;
+
+    // true -> stage timers (lsd_profile) are filled by detect(...)
+    virtual bool profiled() const = 0;
+
+    // detects segments in a grayscale image (CV_8UC1)
+    virtual void detect(const cv::Mat& image, std::vector<cv::Vec4f>& segments) = 0;
+};
+
+//------------------------------------------------------------------------------
+// reference implementation (lsd/lsd.cpp)
+class LsdCBackend : public DetectorBackend
+{
+public:
+    std::string name() const {return "lsd_c";}
+
+    bool profiled() const
+    {
+#ifdef LSD_PROFILE
+        return true;
+#else
+        return false;
+#endif //LSD_PROFILE
+    }
+
+    void detect(const cv::Mat& image, std::vector<cv::Vec4f>& segments)
+    {
+        segments.clear();
+
+        // double image (part of the total runtime)
+        data_.resize(image.rows*image.cols);
+        for(int r=0; r<image.rows; ++r)
+        {
+            const uchar* row = image.ptr<uchar>(r);
+            for(int c=0; c<image.cols; ++c)
+                data_[r*image.cols+c] = double(row[c]);
+        }
+
+        int num = 0;
+        double* out = lsd(&num,&data_[0],image.cols,image.rows);
+        if(out == NULL)
+            return;
+
+        segments.resize(num);
+        for(int i=0; i<num; ++i)
+        {
+            segments[i] = cv::Vec4f(float(out[7*i+0]),float(out[7*i+1]),
+                                    float(out[7*i+2]),float(out[7*i+3]));
+        }
+        free(out);
+    }
+
+private:
+    std::vector<double> data_;
+};
+
+//------------------------------------------------------------------------------
+// OpenCV implementation (bundled LineSegmentDetectorImpl, or the one from OpenCV 3)
+class LsdOpenCVBackend : public DetectorBackend
+{
+public:
+    LsdOpenCVBackend()
+    {
+#ifndef L3DPP_OPENCV3
+        lsd_ = cv::createLineSegmentDetectorPtr(cv::LSD_REFINE_ADV);
+#else
+        lsd_ = cv::createLineSegmentDetector(cv::LSD_REFINE_ADV);
+#endif //L3DPP_OPENCV3
+    }
+
+    std::string name() const
+    {
+#ifndef L3DPP_OPENCV3
+        return "lsd_opencv";
+#else
+        return "opencv3";
+#endif //L3DPP_OPENCV3
+    }
+
+    bool profiled() const
+    {
+#if defined(LSD_PROFILE) && !defined(L3DPP_OPENCV3)
+        return true;
+#else
+        return false;
+#endif //LSD_PROFILE
+    }
+
+    void detect(const cv::Mat& image, std::vector<cv::Vec4f>& segments)
+    {
+        segments.clear();
+        lsd_->detect(image,segments);
+    }
+
+private:
+    cv::Ptr<cv::LineSegmentDetector> lsd_;
+};
+
+//------------------------------------------------------------------------------
+void createBackends(std::vector<DetectorBackend*>& backends)
+{
+    backends.push_back(new LsdCBackend());
+    backends.push_back(new LsdOpenCVBackend());
+}
+
+//------------------------------------------------------------------------------
+// accumulated results of one detector
+struct BackendStats
+{
+    BackendStats() : failed_(false), num_images_(0), mpixels_(0.0),
+        total_ms_(0.0), num_segments_(0), num_long_segments_(0)
+    {
+        for(int i=0; i<lsd_profile::NUM_STAGES; ++i)
+            stage_ms_[i] = 0.0;
+    }
+
+    bool failed_;
+    unsigned int num_images_;
+    double mpixels_;
+    double total_ms_;
+    double stage_ms_[lsd_profile::NUM_STAGES];
+    size_t num_segments_;
+    size_t num_long_segments_;
+};
+
+//------------------------------------------------------------------------------
+// true if both endpoints are within 'tolerance' (in any order)
+bool segmentsMatch(const cv::Vec4f& s1, const cv::Vec4f& s2, const float tolerance)
+{
+    float t2 = tolerance*tolerance;
+
+    float d11 = (s1[0]-s2[0])*(s1[0]-s2[0]) + (s1[1]-s2[1])*(s1[1]-s2[1]);
+    float d22 = (s1[2]-s2[2])*(s1[2]-s2[2]) + (s1[3]-s2[3])*(s1[3]-s2[3]);
+    if(d11 <= t2 && d22 <= t2)
+        return true;
+
+    float d12 = (s1[0]-s2[2])*(s1[0]-s2[2]) + (s1[1]-s2[3])*(s1[1]-s2[3]);
+    float d21 = (s1[2]-s2[0])*(s1[2]-s2[0]) + (s1[3]-s2[1])*(s1[3]-s2[1]);
+    return (d12 <= t2 && d21 <= t2);
+}
+
+//------------------------------------------------------------------------------
+// number of segments in 'seg1' with a corresponding segment in 'seg2'
+size_t repeatedSegments(const std::vector<cv::Vec4f>& seg1, const std::vector<cv::Vec4f>& seg2,
+                        const float tolerance)
+{
+    size_t num = 0;
+    for(size_t i=0; i<seg1.size(); ++i)
+    {
+        for(size_t j=0; j<seg2.size(); ++j)
+        {
+            if(segmentsMatch(seg1[i],seg2[j],tolerance))
+            {
+                ++num;
+                break;
+            }
+        }
+    }
+    return num;
+}
+
+//------------------------------------------------------------------------------
+bool isImageFile(const boost::filesystem::path& p)
+{
+    std::string ext = p.extension().string();
+    std::transform(ext.begin(),ext.end(),ext.begin(),::tolower);
+    return (ext == ".jpg" || ext == ".jpeg" || ext == ".png" ||
+            ext == ".tif" || ext == ".tiff" || ext == ".bmp" ||
+            ext == ".pgm" || ext == ".ppm");
+}
+
+int main(int argc, char *argv[])
+{
+    TCLAP::CmdLine cmd("LINE3D++");
+
+    TCLAP::MultiArg<std::string> inputArg("i", "input_folder", "folder containing the images (can be used multiple times, if not specified --> ../testdata/)", false, "string");
+    cmd.add(inputArg);
+
+    TCLAP::ValueArg<int> scaleArg("w", "max_image_width", "scale image down to fixed max width for line segment detection", false, L3D_DEF_MAX_IMG_WIDTH, "int");
+    cmd.add(scaleArg);
+
+    TCLAP::ValueArg<int> repetitionsArg("n", "num_repetitions", "number of runs per image and detector (runtimes are averaged)", false, 3, "int");
+    cmd.add(repetitionsArg);
+
+    TCLAP::ValueArg<float> toleranceArg("t", "repeatability_t", "max endpoint distance [px] for two segments to be considered repeated", false, 2.0f, "float");
+    cmd.add(toleranceArg);
+
+    TCLAP::ValueArg<bool> verboseArg("v", "verbose", "print the results per image", false, false, "bool");
+    cmd.add(verboseArg);
+
+    // read arguments
+    cmd.parse(argc,argv);
+    std::vector<std::string> inputFolders = inputArg.getValue();
+    if(inputFolders.size() == 0)
+        inputFolders.push_back("../testdata/");
+
+    int maxWidth = scaleArg.getValue();
+    int repetitions = std::max(repetitionsArg.getValue(),1);
+    float tolerance = fabs(toleranceArg.getValue());
+    bool verbose = verboseArg.getValue();
+
+    // collect images
+    std::vector<std::string> images;
+    for(size_t i=0; i<inputFolders.size(); ++i)
+    {
+        boost::filesystem::path folder(inputFolders[i]);
+        if(!boost::filesystem::is_directory(folder))
+        {
+            std::cerr << "input folder " << folder << " does not exist!" << std::endl;
+            return -1;
+        }
+
+        std::vector<std::string> files;
+        boost::filesystem::directory_iterator it(folder), end;
+        for(; it!=end; ++it)
+        {
+            if(boost::filesystem::is_regular_file(it->path()) && isImageFile(it->path()))
+                files.push_back(it->path().string());
+        }
+        std::sort(files.begin(),files.end());
+        images.insert(images.end(),files.begin(),files.end());
+    }
+
+    if(images.size() == 0)
+    {
+        std::cerr << "no images found!" << std::endl;
+        return -1;
+    }
+
+    // detectors
+    std::vector<DetectorBackend*> backends;
+    createBackends(backends);
+    const size_t num_backends = backends.size();
+
+    std::vector<BackendStats> stats(num_backends);
+    // repeated[b1*num_backends+b2] -> segments of b1 found by b2
+    std::vector<size_t> repeated(num_backends*num_backends,0);
+
+    std::cout << "benchmarking " << num_backends << " detectors on " << images.size() << " images ";
+    std::cout << "(" << repetitions << " runs per image)" << std::endl;
+
+    for(size_t i=0; i<images.size(); ++i)
+    {
+        // load image (same preprocessing as Line3D++)
+        cv::Mat image = cv::imread(images[i],CV_LOAD_IMAGE_GRAYSCALE);
+        if(image.empty())
+        {
+            std::cerr << "could not load image: " << images[i] << std::endl;
+            continue;
+        }
+
+        if(maxWidth > 0 && image.cols > maxWidth)
+        {
+            float s = float(maxWidth)/float(image.cols);
+            cv::Mat imgResized;
+            cv::resize(image,imgResized,cv::Size(maxWidth,cvRound(float(image.rows)*s)));
+            image = imgResized;
+        }
+
+        double mpixels = double(image.rows*image.cols)/1e6;
+        float diag = sqrtf(float(image.rows*image.rows)+float(image.cols*image.cols));
+        float min_len = diag*L3D_DEF_MIN_LINE_LENGTH_FACTOR;
+
+        if(verbose)
+            std::cout << images[i] << " [" << image.cols << "x" << image.rows << "]" << std::endl;
+
+        std::vector<std::vector<cv::Vec4f> > segments(num_backends);
+        for(size_t b=0; b<num_backends; ++b)
+        {
+            if(stats[b].failed_)
+                continue;
+
+            lsd_profile::reset();
+            double total_ms = 0.0;
+            try
+            {
+                for(int r=0; r<repetitions; ++r)
+                {
+                    int64 start = cv::getTickCount();
+                    backends[b]->detect(image,segments[b]);
+                    total_ms += double(cv::getTickCount()-start)*1000.0/cv::getTickFrequency();
+                }
+            }
+            catch(const cv::Exception& e)
+            {
+                // e.g. LSD not available in this OpenCV version
+                std::cerr << backends[b]->name() << " failed: " << e.what() << std::endl;
+                stats[b].failed_ = true;
+                segments[b].clear();
+                continue;
+            }
+
+            BackendStats& st = stats[b];
+            ++st.num_images_;
+            st.mpixels_ += mpixels;
+            st.total_ms_ += total_ms/double(repetitions);
+
+            if(backends[b]->profiled())
+            {
+                for(int s=0; s<lsd_profile::NUM_STAGES; ++s)
+                    st.stage_ms_[s] += lsd_profile::ms(s)/double(repetitions);
+            }
+
+            size_t num_long = 0;
+            for(size_t j=0; j<segments[b].size(); ++j)
+            {
+                const cv::Vec4f& seg = segments[b][j];
+                float len = sqrtf((seg[0]-seg[2])*(seg[0]-seg[2])+(seg[1]-seg[3])*(seg[1]-seg[3]));
+                if(len > min_len)
+                    ++num_long;
+            }
+            st.num_segments_ += segments[b].size();
+            st.num_long_segments_ += num_long;
+
+            if(verbose)
+            {
+                std::cout << "    " << std::setw(12) << std::left << backends[b]->name() << std::right;
+                std::cout << std::fixed << std::setprecision(2) << std::setw(10) << total_ms/double(repetitions) << " ms";
+                std::cout << std::setw(8) << segments[b].size() << " segments" << std::endl;
+            }
+        }
+
+        // repeatability
+        for(size_t b1=0; b1<num_backends; ++b1)
+        {
+            for(size_t b2=0; b2<num_backends; ++b2)
+            {
+                if(b1 != b2 && !stats[b1].failed_ && !stats[b2].failed_)
+                    repeated[b1*num_backends+b2] += repeatedSegments(segments[b1],segments[b2],tolerance);
+            }
+        }
+    }
+
+    // report
+    std::cout << std::endl << "runtime [ms/MPixel]:" << std::endl;
+    std::cout << std::setw(14) << std::left << "detector" << std::right << std::setw(10) << "total";
+    for(int s=0; s<lsd_profile::NUM_STAGES; ++s)
+        std::cout << std::setw(13) << lsd_profile::stageName(s);
+    std::cout << std::setw(12) << "segments" << std::setw(12) << "long" << std::endl;
+
+    for(size_t b=0; b<num_backends; ++b)
+    {
+        const BackendStats& st = stats[b];
+        std::cout << std::setw(14) << std::left << backends[b]->name() << std::right;
+        if(st.failed_ || st.num_images_ == 0)
+        {
+            std::cout << std::setw(10) << "n/a" << std::endl;
+            continue;
+        }
+
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << std::setw(10) << st.total_ms_/st.mpixels_;
+        for(int s=0; s<lsd_profile::NUM_STAGES; ++s)
+        {
+            if(backends[b]->profiled())
+                std::cout << std::setw(13) << st.stage_ms_[s]/st.mpixels_;
+            else
+                std::cout << std::setw(13) << "-";
+        }
+
+        // average per image
+        std::cout << std::setprecision(1);
+        std::cout << std::setw(12) << double(st.num_segments_)/double(st.num_images_);
+        std::cout << std::setw(12) << double(st.num_long_segments_)/double(st.num_images_) << std::endl;
+    }
+    std::cout << "(segments: average per image, long: longer than ";
+    std::cout << L3D_DEF_MIN_LINE_LENGTH_FACTOR << "*diagonal)" << std::endl;
+
+    if(num_backends > 1)
+    {
+        std::cout << std::endl << "repeatability (row found by column, tolerance: " << tolerance << "px):" << std::endl;
+        std::cout << std::setw(14) << "";
+        for(size_t b=0; b<num_backends; ++b)
+            std::cout << std::setw(14) << backends[b]->name();
+        std::cout << std::endl;
+
+        for(size_t b1=0; b1<num_backends; ++b1)
+        {
+            std::cout << std::setw(14) << std::left << backends[b1]->name() << std::right;
+            for(size_t b2=0; b2<num_backends; ++b2)
+            {
+                if(b1 == b2 || stats[b1].failed_ || stats[b2].failed_ || stats[b1].num_segments_ == 0)
+                {
+                    std::cout << std::setw(14) << "-";
+                    continue;
+                }
+
+                double rep = double(repeated[b1*num_backends+b2])/double(stats[b1].num_segments_);
+                std::cout << std::fixed << std::setprecision(3) << std::setw(14) << rep;
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    // cleanup
+    for(size_t b=0; b<num_backends; ++b)
+        delete backends[b];
+
+    return 0;
+}
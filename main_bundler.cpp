@@ -81,6 +81,9 @@ int main(int argc, char *argv[])
     TCLAP::ValueArg<bool> diffusionArg("d", "diffusion", "perform Replicator Dynamics Diffusion before clustering", false, L3D_DEF_PERFORM_RDD, "bool");
     cmd.add(diffusionArg);
 
+    TCLAP::ValueArg<float> diffusionPruneArg("D", "diffusion_prune", "diffusion (CPU): remove affinities below this value during the iterations (0 -> no pruning)", false, L3D_DEF_RDD_PRUNE_T, "float");
+    cmd.add(diffusionPruneArg);
+
     TCLAP::ValueArg<bool> loadArg("l", "load_and_store_flag", "load/store segments (recommended for big images)", false, L3D_DEF_LOAD_AND_STORE_SEGMENTS, "bool");
     cmd.add(loadArg);
 
@@ -96,6 +99,24 @@ int main(int argc, char *argv[])
     TCLAP::ValueArg<float> constRegDepthArg("z", "const_reg_depth", "use a constant regularization depth (only when sigma_p is metric!)", false, -1.0f, "float");
     cmd.add(constRegDepthArg);
 
+    TCLAP::ValueArg<bool> quantizeArg("q", "quantize_segments", "store 2D segments in 16-bit fixed point (less memory for very large datasets)", false, L3D_DEF_QUANTIZE_SEGMENTS, "bool");
+    cmd.add(quantizeArg);
+
+    TCLAP::ValueArg<bool> spatialOrderArg("s", "spatial_order", "store 2D segments in spatial (Morton) order for better memory locality", false, L3D_DEF_SPATIAL_SEGMENT_ORDER, "bool");
+    cmd.add(spatialOrderArg);
+
+    TCLAP::ValueArg<bool> floatPrecisionArg("u", "float_precision", "matching and scoring (CPU) in single precision (faster)", false, L3D_DEF_FLOAT_PRECISION, "bool");
+    cmd.add(floatPrecisionArg);
+
+    TCLAP::ValueArg<bool> descriptorsArg("x", "line_descriptors", "use binary line descriptors to reject/rank match candidates (false -> purely geometric matching)", false, L3D_DEF_USE_LINE_DESCRIPTORS, "bool");
+    cmd.add(descriptorsArg);
+
+    TCLAP::ValueArg<bool> pinThreadsArg("N", "pin_threads", "NUMA only: pin the worker threads to the node of the views they process (restored after each stage)", false, L3D_DEF_PIN_THREADS, "bool");
+    cmd.add(pinThreadsArg);
+
+    TCLAP::ValueArg<bool> keypointsArg("j", "keypoint_anchors", "use the 2D observations of the worldpoints to propose/prune match candidates", false, L3D_DEF_USE_KEYPOINT_ANCHORS, "bool");
+    cmd.add(keypointsArg);
+
     // read arguments
     cmd.parse(argc,argv);
     std::string imageFolder = inputArg.getValue().c_str();
@@ -115,6 +136,7 @@ int main(int argc, char *argv[])
     int maxWidth = scaleArg.getValue();
     unsigned int neighbors = std::max(neighborArg.getValue(),2);
     bool diffusion = diffusionArg.getValue();
+    float diffusion_prune = diffusionPruneArg.getValue();
     bool loadAndStore = loadArg.getValue();
     float collinearity = collinArg.getValue();
     bool useGPU = cudaArg.getValue();
@@ -126,6 +148,12 @@ int main(int argc, char *argv[])
     unsigned int maxNumSegments = segNumArg.getValue();
     unsigned int visibility_t = visibilityArg.getValue();
     float constRegDepth = constRegDepthArg.getValue();
+    bool quantize = quantizeArg.getValue();
+    bool spatialOrder = spatialOrderArg.getValue();
+    bool floatPrecision = floatPrecisionArg.getValue();
+    bool useDescriptors = descriptorsArg.getValue();
+    bool pinThreads = pinThreadsArg.getValue();
+    bool useKeypoints = keypointsArg.getValue();
 
     // check if bundle.rd.out exists
     boost::filesystem::path bf(bundleFile);
@@ -140,8 +168,15 @@ int main(int argc, char *argv[])
     boost::filesystem::create_directory(dir);
 
     // create Line3D++ object
+    L3DPP::Line3DOptions options;
+    options.quantize_segments_ = quantize;
+    options.spatial_segment_order_ = spatialOrder;
+    options.float_precision_ = floatPrecision;
+    options.use_descriptors_ = useDescriptors;
+    options.pin_threads_ = pinThreads;
+
     L3DPP::Line3D* Line3D = new L3DPP::Line3D(outputFolder,loadAndStore,maxWidth,
-                                              maxNumSegments,true,useGPU);
+                                              maxNumSegments,true,useGPU,options);
 
     // read bundle.rd.out
     std::ifstream bundle_file;
@@ -220,6 +255,7 @@ int main(int argc, char *argv[])
     // read features (for image similarity calculation)
     std::vector<std::list<unsigned int> > cams_worldpointIDs(num_cams);
     std::vector<std::vector<float> > cams_worldpointDepths(num_cams);
+    std::vector<std::vector<Eigen::Vector2f> > cams_keypoints(num_cams);
     for(unsigned int i=0; i<num_points; ++i)
     {
         // 3D position
@@ -247,6 +283,10 @@ int main(int argc, char *argv[])
             iss >> posX >> posY;
             cams_worldpointIDs[camID].push_back(i);
 
+            // relative to the image center (y-axis pointing up!)
+            if(useKeypoints)
+                cams_keypoints[camID].push_back(Eigen::Vector2f(posX,-posY));
+
             cams_worldpointDepths[camID].push_back((pos3D-cams_centers[camID]).norm());
         }
     }
@@ -349,23 +389,9 @@ int main(int argc, char *argv[])
             K(1,2) = py;
             K(2,2) = 1.0;
 
-            // undistort (if necessary)
-            float d1 = cams_distortion[i].first;
-            float d2 = cams_distortion[i].second;
-
-            cv::Mat img_undist;
-            if(fabs(d1) > L3D_EPS || fabs(d2) > L3D_EPS)
-            {
-                // undistorting
-                Eigen::Vector3d radial(d1,d2,0.0);
-                Eigen::Vector2d tangential(0.0,0.0);
-                Line3D->undistortImage(image,img_undist,radial,tangential,K);
-            }
-            else
-            {
-                // already undistorted
-                img_undist = image;
-            }
+            // distortion (undistorted during line segment detection)
+            Eigen::Vector3d radial(cams_distortion[i].first,cams_distortion[i].second,0.0);
+            Eigen::Vector2d tangential(0.0,0.0);
 
             // median point depth
             std::sort(cams_worldpointDepths[i].begin(),cams_worldpointDepths[i].end());
@@ -373,8 +399,19 @@ int main(int argc, char *argv[])
             float med_depth = cams_worldpointDepths[i].at(med_pos);
 
             // add to system
-            Line3D->addImage(i,img_undist,K,cams_rotation[i],
-                             cams_translation[i],med_depth,cams_worldpointIDs[i]);
+            Line3D->addImage(i,image,K,cams_rotation[i],
+                             cams_translation[i],med_depth,cams_worldpointIDs[i],
+                             radial,tangential);
+
+            // keypoints
+            if(cams_keypoints[i].size() > 0)
+            {
+                for(size_t j=0; j<cams_keypoints[i].size(); ++j)
+                    cams_keypoints[i][j] += Eigen::Vector2f(px,py);
+
+                Line3D->addKeypoints(i,cams_worldpointIDs[i],cams_keypoints[i],
+                                     radial,tangential);
+            }
         }
     }
 
@@ -383,7 +420,8 @@ int main(int argc, char *argv[])
                         kNN,constRegDepth);
 
     // compute result
-    Line3D->reconstruct3Dlines(visibility_t,diffusion,collinearity,useCERES);
+    Line3D->reconstruct3Dlines(visibility_t,diffusion,collinearity,useCERES,
+                               L3D_DEF_CERES_MAX_ITER,diffusion_prune);
 
     // save end result
     std::vector<L3DPP::FinalLine3D> result;
@@ -34,6 +34,30 @@
 // This executable reads colmap results (cameras.txt, images.txt, and points3D.txt) and executes the Line3D++ algorithm.
 // If distortion coefficients are stored in the cameras.txt file, you need to use the _original_ (distorted) images!
 
+//------------------------------------------------------------------------------
+// loads the images on demand (during addImages)
+class ColmapImageProvider : public L3DPP::ImageProvider
+{
+public:
+    ColmapImageProvider(const std::string& folder,
+                        const std::map<unsigned int,std::string>& images) :
+        folder_(folder), images_(images){}
+
+    bool load(const unsigned int camID, cv::Mat& image)
+    {
+        std::map<unsigned int,std::string>::const_iterator it = images_.find(camID);
+        if(it == images_.end())
+            return false;
+
+        image = cv::imread(folder_+"/"+it->second,CV_LOAD_IMAGE_GRAYSCALE);
+        return !image.empty();
+    }
+
+private:
+    std::string folder_;
+    const std::map<unsigned int,std::string>& images_;
+};
+
 int main(int argc, char *argv[])
 {
     TCLAP::CmdLine cmd("LINE3D++");
@@ -74,6 +98,9 @@ int main(int argc, char *argv[])
     TCLAP::ValueArg<bool> diffusionArg("d", "diffusion", "perform Replicator Dynamics Diffusion before clustering", false, L3D_DEF_PERFORM_RDD, "bool");
     cmd.add(diffusionArg);
 
+    TCLAP::ValueArg<float> diffusionPruneArg("D", "diffusion_prune", "diffusion (CPU): remove affinities below this value during the iterations (0 -> no pruning)", false, L3D_DEF_RDD_PRUNE_T, "float");
+    cmd.add(diffusionPruneArg);
+
     TCLAP::ValueArg<bool> loadArg("l", "load_and_store_flag", "load/store segments (recommended for big images)", false, L3D_DEF_LOAD_AND_STORE_SEGMENTS, "bool");
     cmd.add(loadArg);
 
@@ -89,6 +116,24 @@ int main(int argc, char *argv[])
     TCLAP::ValueArg<float> constRegDepthArg("z", "const_reg_depth", "use a constant regularization depth (only when sigma_p is metric!)", false, -1.0f, "float");
     cmd.add(constRegDepthArg);
 
+    TCLAP::ValueArg<bool> quantizeArg("q", "quantize_segments", "store 2D segments in 16-bit fixed point (less memory for very large datasets)", false, L3D_DEF_QUANTIZE_SEGMENTS, "bool");
+    cmd.add(quantizeArg);
+
+    TCLAP::ValueArg<bool> spatialOrderArg("s", "spatial_order", "store 2D segments in spatial (Morton) order for better memory locality", false, L3D_DEF_SPATIAL_SEGMENT_ORDER, "bool");
+    cmd.add(spatialOrderArg);
+
+    TCLAP::ValueArg<bool> floatPrecisionArg("u", "float_precision", "matching and scoring (CPU) in single precision (faster)", false, L3D_DEF_FLOAT_PRECISION, "bool");
+    cmd.add(floatPrecisionArg);
+
+    TCLAP::ValueArg<bool> descriptorsArg("x", "line_descriptors", "use binary line descriptors to reject/rank match candidates (false -> purely geometric matching)", false, L3D_DEF_USE_LINE_DESCRIPTORS, "bool");
+    cmd.add(descriptorsArg);
+
+    TCLAP::ValueArg<bool> pinThreadsArg("N", "pin_threads", "NUMA only: pin the worker threads to the node of the views they process (restored after each stage)", false, L3D_DEF_PIN_THREADS, "bool");
+    cmd.add(pinThreadsArg);
+
+    TCLAP::ValueArg<bool> keypointsArg("j", "keypoint_anchors", "use the 2D observations of the worldpoints to propose/prune match candidates", false, L3D_DEF_USE_KEYPOINT_ANCHORS, "bool");
+    cmd.add(keypointsArg);
+
     // read arguments
     cmd.parse(argc,argv);
     std::string inputFolder = inputArg.getValue().c_str();
@@ -112,6 +157,7 @@ int main(int argc, char *argv[])
     int maxWidth = scaleArg.getValue();
     unsigned int neighbors = std::max(neighborArg.getValue(),2);
     bool diffusion = diffusionArg.getValue();
+    float diffusion_prune = diffusionPruneArg.getValue();
     bool loadAndStore = loadArg.getValue();
     float collinearity = collinArg.getValue();
     bool useGPU = cudaArg.getValue();
@@ -123,14 +169,27 @@ int main(int argc, char *argv[])
     unsigned int maxNumSegments = segNumArg.getValue();
     unsigned int visibility_t = visibilityArg.getValue();
     float constRegDepth = constRegDepthArg.getValue();
+    bool quantize = quantizeArg.getValue();
+    bool spatialOrder = spatialOrderArg.getValue();
+    bool floatPrecision = floatPrecisionArg.getValue();
+    bool useDescriptors = descriptorsArg.getValue();
+    bool pinThreads = pinThreadsArg.getValue();
+    bool useKeypoints = keypointsArg.getValue();
 
     // create output directory
     boost::filesystem::path dir(outputFolder);
     boost::filesystem::create_directory(dir);
 
     // create Line3D++ object
+    L3DPP::Line3DOptions options;
+    options.quantize_segments_ = quantize;
+    options.spatial_segment_order_ = spatialOrder;
+    options.float_precision_ = floatPrecision;
+    options.use_descriptors_ = useDescriptors;
+    options.pin_threads_ = pinThreads;
+
     L3DPP::Line3D* Line3D = new L3DPP::Line3D(outputFolder,loadAndStore,maxWidth,
-                                              maxNumSegments,true,useGPU);
+                                              maxNumSegments,true,useGPU,options);
 
     // check if result files exist
     boost::filesystem::path sfm_cameras(sfmFolder+"/cameras.txt");
@@ -244,6 +303,7 @@ int main(int argc, char *argv[])
     std::map<unsigned int,unsigned int> img2cam;
     std::map<unsigned int,std::string> cams_images;
     std::map<unsigned int,std::list<unsigned int> > cams_worldpoints;
+    std::map<unsigned int,std::vector<Eigen::Vector2f> > cams_keypoints;
     std::map<unsigned int,Eigen::Vector3d> wps_coords;
     std::vector<unsigned int> img_seq;
     unsigned int imgID,camID;
@@ -288,6 +348,7 @@ int main(int argc, char *argv[])
                     double x,y;
                     std::string wpID;
                     std::list<unsigned int> wps;
+                    std::vector<Eigen::Vector2f> kps;
                     bool process = true;
 
                     while(process)
@@ -303,6 +364,9 @@ int main(int argc, char *argv[])
                             {
                                 wps.push_back(wp);
                                 wps_coords[wp] = Eigen::Vector3d(0,0,0);
+
+                                // colmap: pixel centers at +0.5
+                                kps.push_back(Eigen::Vector2f(x-0.5,y-0.5));
                             }
                         }
                         else
@@ -313,6 +377,8 @@ int main(int argc, char *argv[])
                     }
 
                     cams_worldpoints[imgID] = wps;
+                    if(useKeypoints)
+                        cams_keypoints[imgID] = kps;
                 }
 
                 first_line = true;
@@ -349,11 +415,11 @@ int main(int argc, char *argv[])
     }
     points3D_file.close();
 
-    // load images (parallel)
-#ifdef L3DPP_OPENMP
-    #pragma omp parallel for
-#endif //L3DPP_OPENMP
-    for(int i=0; i<img_seq.size(); ++i)
+    // collect images (loaded and processed in parallel by addImages)
+    ColmapImageProvider provider(inputFolder,cams_images);
+    L3DPP::ImageBatch batch(&provider);
+    batch.reserve(img_seq.size());
+    for(size_t i=0; i<img_seq.size(); ++i)
     {
         // get camera params
         unsigned int imgID = img_seq[i];
@@ -371,33 +437,16 @@ int main(int argc, char *argv[])
             Eigen::Vector3d t = cams_t[imgID];
             Eigen::Vector3d C = cams_C[imgID];
 
-            // read image
-            cv::Mat image = cv::imread(inputFolder+"/"+cams_images[imgID],CV_LOAD_IMAGE_GRAYSCALE);
-
-            // undistort image
-            cv::Mat img_undist;
-            if(fabs(radial(0)) > L3D_EPS || fabs(radial(1)) > L3D_EPS || fabs(radial(2)) > L3D_EPS ||
-                    fabs(tangential(0)) > L3D_EPS || fabs(tangential(1)) > L3D_EPS)
-            {
-                // undistorting
-                Line3D->undistortImage(image,img_undist,radial,tangential,K);
-            }
-            else
-            {
-                // already undistorted
-                img_undist = image;
-            }
-
             // compute depths
             if(cams_worldpoints.find(imgID) != cams_worldpoints.end())
             {
-                std::list<unsigned int> wps_list = cams_worldpoints[imgID];
+                std::list<unsigned int>& wps_list = cams_worldpoints[imgID];
+                std::vector<unsigned int> wps(wps_list.begin(),wps_list.end());
                 std::vector<float> depths;
 
-                std::list<unsigned int>::iterator it = wps_list.begin();
-                for(; it!=wps_list.end(); ++it)
+                for(size_t j=0; j<wps.size(); ++j)
                 {
-                    depths.push_back((C-wps_coords[*it]).norm());
+                    depths.push_back((C-wps_coords[wps[j]]).norm());
                 }
 
                 // median depth
@@ -406,19 +455,28 @@ int main(int argc, char *argv[])
                     std::sort(depths.begin(),depths.end());
                     float med_depth = depths[depths.size()/2];
 
-                    // add image
-                    Line3D->addImage(imgID,img_undist,K,R,t,med_depth,wps_list);
+                    // add image (loaded by the provider, undistorted during line segment detection)
+                    batch.add(imgID,cv::Mat(),K,R,t,med_depth,&wps[0],wps.size(),
+                              NULL,0,radial,tangential);
+
+                    // keypoints (same order as the worldpoints)
+                    if(cams_keypoints.find(imgID) != cams_keypoints.end())
+                        batch.setKeypoints(&cams_keypoints[imgID][0]);
                 }
             }
         }
     }
 
+    // add images
+    Line3D->addImages(batch);
+
     // match images
     Line3D->matchImages(sigmaP,sigmaA,neighbors,epipolarOverlap,
                         kNN,constRegDepth);
 
     // compute result
-    Line3D->reconstruct3Dlines(visibility_t,diffusion,collinearity,useCERES);
+    Line3D->reconstruct3Dlines(visibility_t,diffusion,collinearity,useCERES,
+                               L3D_DEF_CERES_MAX_ITER,diffusion_prune);
 
     // save end result
     std::vector<L3DPP::FinalLine3D> result;
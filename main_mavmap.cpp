@@ -82,6 +82,9 @@ int main(int argc, char *argv[])
     TCLAP::ValueArg<bool> diffusionArg("d", "diffusion", "perform Replicator Dynamics Diffusion before clustering", false, L3D_DEF_PERFORM_RDD, "bool");
     cmd.add(diffusionArg);
 
+    TCLAP::ValueArg<float> diffusionPruneArg("D", "diffusion_prune", "diffusion (CPU): remove affinities below this value during the iterations (0 -> no pruning)", false, L3D_DEF_RDD_PRUNE_T, "float");
+    cmd.add(diffusionPruneArg);
+
     TCLAP::ValueArg<bool> loadArg("l", "load_and_store_flag", "load/store segments (recommended for big images)", false, L3D_DEF_LOAD_AND_STORE_SEGMENTS, "bool");
     cmd.add(loadArg);
 
@@ -97,6 +100,21 @@ int main(int argc, char *argv[])
     TCLAP::ValueArg<float> constRegDepthArg("z", "const_reg_depth", "use a constant regularization depth (only when sigma_p is metric!)", false, -1.0f, "float");
     cmd.add(constRegDepthArg);
 
+    TCLAP::ValueArg<bool> quantizeArg("q", "quantize_segments", "store 2D segments in 16-bit fixed point (less memory for very large datasets)", false, L3D_DEF_QUANTIZE_SEGMENTS, "bool");
+    cmd.add(quantizeArg);
+
+    TCLAP::ValueArg<bool> spatialOrderArg("s", "spatial_order", "store 2D segments in spatial (Morton) order for better memory locality", false, L3D_DEF_SPATIAL_SEGMENT_ORDER, "bool");
+    cmd.add(spatialOrderArg);
+
+    TCLAP::ValueArg<bool> floatPrecisionArg("u", "float_precision", "matching and scoring (CPU) in single precision (faster)", false, L3D_DEF_FLOAT_PRECISION, "bool");
+    cmd.add(floatPrecisionArg);
+
+    TCLAP::ValueArg<bool> descriptorsArg("x", "line_descriptors", "use binary line descriptors to reject/rank match candidates (false -> purely geometric matching)", false, L3D_DEF_USE_LINE_DESCRIPTORS, "bool");
+    cmd.add(descriptorsArg);
+
+    TCLAP::ValueArg<bool> pinThreadsArg("N", "pin_threads", "NUMA only: pin the worker threads to the node of the views they process (restored after each stage)", false, L3D_DEF_PIN_THREADS, "bool");
+    cmd.add(pinThreadsArg);
+
     // read arguments
     cmd.parse(argc,argv);
     std::string inputFolder = inputArg.getValue().c_str();
@@ -110,6 +128,7 @@ int main(int argc, char *argv[])
     int maxWidth = scaleArg.getValue();
     unsigned int neighbors = std::max(neighborArg.getValue(),2);
     bool diffusion = diffusionArg.getValue();
+    float diffusion_prune = diffusionPruneArg.getValue();
     bool loadAndStore = loadArg.getValue();
     float collinearity = collinArg.getValue();
     bool useGPU = cudaArg.getValue();
@@ -121,6 +140,11 @@ int main(int argc, char *argv[])
     unsigned int maxNumSegments = segNumArg.getValue();
     unsigned int visibility_t = visibilityArg.getValue();
     float constRegDepth = constRegDepthArg.getValue();
+    bool quantize = quantizeArg.getValue();
+    bool spatialOrder = spatialOrderArg.getValue();
+    bool floatPrecision = floatPrecisionArg.getValue();
+    bool useDescriptors = descriptorsArg.getValue();
+    bool pinThreads = pinThreadsArg.getValue();
 
     if(imgExtension.substr(0,1) != ".")
         imgExtension = "."+imgExtension;
@@ -147,8 +171,15 @@ int main(int argc, char *argv[])
     boost::filesystem::create_directory(dir);
 
     // create Line3D++ object
+    L3DPP::Line3DOptions options;
+    options.quantize_segments_ = quantize;
+    options.spatial_segment_order_ = spatialOrder;
+    options.float_precision_ = floatPrecision;
+    options.use_descriptors_ = useDescriptors;
+    options.pin_threads_ = pinThreads;
+
     L3DPP::Line3D* Line3D = new L3DPP::Line3D(outputFolder,loadAndStore,maxWidth,
-                                              maxNumSegments,false,useGPU);
+                                              maxNumSegments,false,useGPU,options);
 
     // read mavmap result
     std::ifstream mavmap_file;
@@ -331,7 +362,8 @@ int main(int argc, char *argv[])
                         kNN,constRegDepth);
 
     // compute result
-    Line3D->reconstruct3Dlines(visibility_t,diffusion,collinearity,useCERES);
+    Line3D->reconstruct3Dlines(visibility_t,diffusion,collinearity,useCERES,
+                               L3D_DEF_CERES_MAX_ITER,diffusion_prune);
 
     // save end result
     std::vector<L3DPP::FinalLine3D> result;
@@ -78,6 +78,9 @@ int main(int argc, char *argv[])
     TCLAP::ValueArg<bool> diffusionArg("d", "diffusion", "perform Replicator Dynamics Diffusion before clustering", false, L3D_DEF_PERFORM_RDD, "bool");
     cmd.add(diffusionArg);
 
+    TCLAP::ValueArg<float> diffusionPruneArg("D", "diffusion_prune", "diffusion (CPU): remove affinities below this value during the iterations (0 -> no pruning)", false, L3D_DEF_RDD_PRUNE_T, "float");
+    cmd.add(diffusionPruneArg);
+
     TCLAP::ValueArg<bool> loadArg("l", "load_and_store_flag", "load/store segments (recommended for big images)", false, L3D_DEF_LOAD_AND_STORE_SEGMENTS, "bool");
     cmd.add(loadArg);
 
@@ -93,6 +96,21 @@ int main(int argc, char *argv[])
     TCLAP::ValueArg<float> constRegDepthArg("z", "const_reg_depth", "use a constant regularization depth (only when sigma_p is metric!)", false, -1.0f, "float");
     cmd.add(constRegDepthArg);
 
+    TCLAP::ValueArg<bool> quantizeArg("q", "quantize_segments", "store 2D segments in 16-bit fixed point (less memory for very large datasets)", false, L3D_DEF_QUANTIZE_SEGMENTS, "bool");
+    cmd.add(quantizeArg);
+
+    TCLAP::ValueArg<bool> spatialOrderArg("s", "spatial_order", "store 2D segments in spatial (Morton) order for better memory locality", false, L3D_DEF_SPATIAL_SEGMENT_ORDER, "bool");
+    cmd.add(spatialOrderArg);
+
+    TCLAP::ValueArg<bool> floatPrecisionArg("u", "float_precision", "matching and scoring (CPU) in single precision (faster)", false, L3D_DEF_FLOAT_PRECISION, "bool");
+    cmd.add(floatPrecisionArg);
+
+    TCLAP::ValueArg<bool> descriptorsArg("x", "line_descriptors", "use binary line descriptors to reject/rank match candidates (false -> purely geometric matching)", false, L3D_DEF_USE_LINE_DESCRIPTORS, "bool");
+    cmd.add(descriptorsArg);
+
+    TCLAP::ValueArg<bool> pinThreadsArg("N", "pin_threads", "NUMA only: pin the worker threads to the node of the views they process (restored after each stage)", false, L3D_DEF_PIN_THREADS, "bool");
+    cmd.add(pinThreadsArg);
+
     // read arguments
     cmd.parse(argc,argv);
     std::string inputFolder = inputArg.getValue().c_str();
@@ -104,6 +122,7 @@ int main(int argc, char *argv[])
     int maxWidth = scaleArg.getValue();
     unsigned int neighbors = std::max(neighborArg.getValue(),2);
     bool diffusion = diffusionArg.getValue();
+    float diffusion_prune = diffusionPruneArg.getValue();
     bool loadAndStore = loadArg.getValue();
     float collinearity = collinArg.getValue();
     bool useGPU = cudaArg.getValue();
@@ -115,6 +134,11 @@ int main(int argc, char *argv[])
     unsigned int maxNumSegments = segNumArg.getValue();
     unsigned int visibility_t = visibilityArg.getValue();
     float constRegDepth = constRegDepthArg.getValue();
+    bool quantize = quantizeArg.getValue();
+    bool spatialOrder = spatialOrderArg.getValue();
+    bool floatPrecision = floatPrecisionArg.getValue();
+    bool useDescriptors = descriptorsArg.getValue();
+    bool pinThreads = pinThreadsArg.getValue();
 
     // check if json file exists
     boost::filesystem::path json(jsonFile);
@@ -129,8 +153,15 @@ int main(int argc, char *argv[])
     boost::filesystem::create_directory(dir);
 
     // create Line3D++ object
+    L3DPP::Line3DOptions options;
+    options.quantize_segments_ = quantize;
+    options.spatial_segment_order_ = spatialOrder;
+    options.float_precision_ = floatPrecision;
+    options.use_descriptors_ = useDescriptors;
+    options.pin_threads_ = pinThreads;
+
     L3DPP::Line3D* Line3D = new L3DPP::Line3D(outputFolder,loadAndStore,maxWidth,
-                                              maxNumSegments,true,useGPU);
+                                              maxNumSegments,true,useGPU,options);
 
     // parse json file
     std::ifstream jsonFileIFS(jsonFile.c_str());
@@ -380,21 +411,13 @@ int main(int argc, char *argv[])
             // intrinsics
             Eigen::Matrix3d K = K_matrices[intID];
 
-            // undistort (if necessary)
-            bool distorted = is_distorted[intID];
-            Eigen::Vector3d radial = radial_dist[intID];
-            Eigen::Vector2d tangential = tangential_dist[intID];
-
-            cv::Mat img_undist;
-            if(distorted)
-            {
-                // undistorting
-                Line3D->undistortImage(image,img_undist,radial,tangential,K);
-            }
-            else
+            // distortion (undistorted during line segment detection)
+            Eigen::Vector3d radial(0.0,0.0,0.0);
+            Eigen::Vector2d tangential(0.0,0.0);
+            if(is_distorted[intID])
             {
-                // already undistorted
-                img_undist = image;
+                radial = radial_dist[intID];
+                tangential = tangential_dist[intID];
             }
 
             // median point depth
@@ -403,9 +426,10 @@ int main(int argc, char *argv[])
             float med_depth = views2depths[camID].at(med_pos);
 
             // add to system
-            Line3D->addImage(camID,img_undist,K,rotations[camID],
+            Line3D->addImage(camID,image,K,rotations[camID],
                              translations[camID],
-                             med_depth,views2wps[camID]);
+                             med_depth,views2wps[camID],
+                             radial,tangential);
         }
     }
 
@@ -414,7 +438,8 @@ int main(int argc, char *argv[])
                         kNN,constRegDepth);
 
     // compute result
-    Line3D->reconstruct3Dlines(visibility_t,diffusion,collinearity,useCERES);
+    Line3D->reconstruct3Dlines(visibility_t,diffusion,collinearity,useCERES,
+                               L3D_DEF_CERES_MAX_ITER,diffusion_prune);
 
     // save end result
     std::vector<L3DPP::FinalLine3D> result;
@@ -0,0 +1,233 @@
+#include "numatopology.h"
+
+// std
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+
+#ifdef L3DPP_NUMA
+// linux
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// external
+#include "boost/filesystem.hpp"
+
+// memory policies (linux/mempolicy.h, no libnuma needed)
+#define L3D_MPOL_DEFAULT 0
+#define L3D_MPOL_PREFERRED 1
+#endif //L3DPP_NUMA
+
+namespace L3DPP
+{
+    //------------------------------------------------------------------------------
+    NumaTopology::NumaTopology()
+    {
+        num_cpus_ = 0;
+
+#ifdef L3DPP_NUMA
+        // read nodes from sysfs
+        std::map<int,std::vector<int> > nodes;
+        boost::filesystem::path sys_nodes("/sys/devices/system/node");
+
+        boost::system::error_code ec;
+        if(boost::filesystem::is_directory(sys_nodes,ec))
+        {
+            boost::filesystem::directory_iterator it(sys_nodes,ec);
+            boost::filesystem::directory_iterator end;
+            for(; !ec && it!=end; it.increment(ec))
+            {
+                std::string name = it->path().filename().string();
+                if(name.size() < 5 || name.substr(0,4) != "node" ||
+                        name.find_first_not_of("0123456789",4) != std::string::npos)
+                    continue;
+
+                std::ifstream cpulist((it->path()/"cpulist").string().c_str());
+                std::string list;
+                if(!cpulist.is_open() || !std::getline(cpulist,list))
+                    continue;
+
+                std::vector<int> cpus;
+                parseCPUList(list,cpus);
+
+                // memory-only nodes have no CPUs
+                if(cpus.size() > 0)
+                    nodes[atoi(name.substr(4).c_str())] = cpus;
+            }
+        }
+
+        std::map<int,std::vector<int> >::const_iterator n_it = nodes.begin();
+        for(; n_it!=nodes.end(); ++n_it)
+        {
+            cpus_.push_back(n_it->second);
+            node_ids_.push_back(n_it->first);
+            num_cpus_ += n_it->second.size();
+        }
+#endif //L3DPP_NUMA
+
+        if(cpus_.size() == 0)
+        {
+            // single node (CPUs unknown)
+            cpus_.push_back(std::vector<int>());
+            node_ids_.push_back(0);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    unsigned int NumaTopology::nodeForThread(const int thread, const int num_threads) const
+    {
+        if(cpus_.size() < 2 || num_threads < 2 || num_cpus_ == 0)
+            return 0;
+
+        // position of the thread within all CPUs
+        double pos = (double(thread)+0.5)/double(num_threads)*double(num_cpus_);
+
+        size_t cumulative = 0;
+        for(size_t n=0; n<cpus_.size(); ++n)
+        {
+            cumulative += cpus_[n].size();
+            if(pos < double(cumulative))
+                return n;
+        }
+        return cpus_.size()-1;
+    }
+
+    //------------------------------------------------------------------------------
+    void* NumaTopology::allocate(const size_t bytes, const unsigned int node) const
+    {
+#ifdef L3DPP_NUMA
+        if(enabled() && node < num_nodes() && size_t(node_ids_[node]) < L3D_NUMA_MAX_NODES)
+        {
+            // fresh pages (not yet touched) -> the policy decides the node
+            void* ptr = mmap(NULL,bytes,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+            if(ptr == MAP_FAILED)
+                return NULL;
+
+            unsigned long mask[L3D_NUMA_MASK_WORDS] = {0};
+            mask[node_ids_[node]/(8*sizeof(unsigned long))] |= 1UL << (node_ids_[node]%(8*sizeof(unsigned long)));
+
+            // preferred (not bound) -> other nodes if this one is full
+            syscall(SYS_mbind,ptr,bytes,L3D_MPOL_PREFERRED,mask,L3D_NUMA_MAX_NODES+1,0);
+            return ptr;
+        }
+#endif //L3DPP_NUMA
+        return malloc(bytes);
+    }
+
+    //------------------------------------------------------------------------------
+    void NumaTopology::free(void* ptr, const size_t bytes) const
+    {
+        if(ptr == NULL)
+            return;
+
+#ifdef L3DPP_NUMA
+        if(enabled())
+        {
+            munmap(ptr,bytes);
+            return;
+        }
+#endif //L3DPP_NUMA
+        ::free(ptr);
+    }
+
+    //------------------------------------------------------------------------------
+    void NumaTopology::parseCPUList(const std::string& list, std::vector<int>& cpus) const
+    {
+        cpus.clear();
+
+        std::stringstream ss(list);
+        std::string range;
+        while(std::getline(ss,range,','))
+        {
+            if(range.size() == 0)
+                continue;
+
+            size_t dash = range.find('-');
+            if(dash == std::string::npos)
+            {
+                cpus.push_back(atoi(range.c_str()));
+            }
+            else
+            {
+                int first = atoi(range.substr(0,dash).c_str());
+                int last = atoi(range.substr(dash+1).c_str());
+                for(int c=first; c<=last; ++c)
+                    cpus.push_back(c);
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    ThreadPinning::ThreadPinning(const NumaTopology& numa, const unsigned int node,
+                                 const bool enabled)
+    {
+        pinned_ = false;
+
+#ifdef L3DPP_NUMA
+        if(!enabled || !numa.enabled() || node >= numa.num_nodes() || numa.cpus(node).size() == 0)
+            return;
+
+        // remember the current mask (pid 0 -> calling thread)
+        if(sched_getaffinity(0,sizeof(cpu_set_t),&previous_) != 0)
+            return;
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        const std::vector<int>& cpus = numa.cpus(node);
+        for(size_t i=0; i<cpus.size(); ++i)
+        {
+            if(cpus[i] < CPU_SETSIZE)
+                CPU_SET(cpus[i],&set);
+        }
+
+        pinned_ = (sched_setaffinity(0,sizeof(cpu_set_t),&set) == 0);
+#endif //L3DPP_NUMA
+    }
+
+    //------------------------------------------------------------------------------
+    ThreadPinning::~ThreadPinning()
+    {
+#ifdef L3DPP_NUMA
+        if(pinned_)
+            sched_setaffinity(0,sizeof(cpu_set_t),&previous_);
+#endif //L3DPP_NUMA
+    }
+
+    //------------------------------------------------------------------------------
+    MemoryPlacement::MemoryPlacement(const NumaTopology& numa, const unsigned int node,
+                                     const bool enabled)
+    {
+        placed_ = false;
+
+#ifdef L3DPP_NUMA
+        if(!enabled || !numa.enabled() || node >= numa.num_nodes() ||
+                size_t(numa.node_id(node)) >= L3D_NUMA_MAX_NODES)
+            return;
+
+        // remember the current policy (of the calling thread)
+        if(syscall(SYS_get_mempolicy,&previous_mode_,previous_mask_,L3D_NUMA_MAX_NODES,NULL,0) != 0)
+            return;
+
+        unsigned long mask[L3D_NUMA_MASK_WORDS] = {0};
+        mask[numa.node_id(node)/(8*sizeof(unsigned long))] |= 1UL << (numa.node_id(node)%(8*sizeof(unsigned long)));
+
+        placed_ = (syscall(SYS_set_mempolicy,L3D_MPOL_PREFERRED,mask,L3D_NUMA_MAX_NODES+1) == 0);
+#endif //L3DPP_NUMA
+    }
+
+    //------------------------------------------------------------------------------
+    MemoryPlacement::~MemoryPlacement()
+    {
+#ifdef L3DPP_NUMA
+        if(!placed_)
+            return;
+
+        if(previous_mode_ == L3D_MPOL_DEFAULT)
+            syscall(SYS_set_mempolicy,L3D_MPOL_DEFAULT,NULL,0);
+        else
+            syscall(SYS_set_mempolicy,previous_mode_,previous_mask_,L3D_NUMA_MAX_NODES+1);
+#endif //L3DPP_NUMA
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef I3D_LINE3D_PP_NUMATOPOLOGY_H_
+#define I3D_LINE3D_PP_NUMATOPOLOGY_H_
+
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <vector>
+#include <string>
+#include <cstddef>
+
+#ifdef L3DPP_NUMA
+// linux
+#include <sched.h>
+#endif //L3DPP_NUMA
+
+/**
+ * Line3D++ - NumaTopology
+ * ====================
+ * NUMA nodes of the machine and their
+ * CPUs (Linux only, via sysfs). Used to
+ * place the view data, matches and
+ * hypotheses on the node that processes
+ * them and (optionally) to pin worker
+ * threads temporarily.
+ * Falls back to a single node.
+ * ====================
+ */
+
+namespace L3DPP
+{
+#ifdef L3DPP_NUMA
+    // max. number of nodes for the memory policy (bitmask)
+    const size_t L3D_NUMA_MAX_NODES = 1024;
+    const size_t L3D_NUMA_MASK_WORDS = L3D_NUMA_MAX_NODES/(8*sizeof(unsigned long));
+#endif //L3DPP_NUMA
+
+    class NumaTopology
+    {
+    public:
+        NumaTopology();
+
+        // number of nodes (at least one)
+        unsigned int num_nodes() const {return cpus_.size();}
+        bool enabled() const {return (cpus_.size() > 1);}
+
+        // CPUs of a node
+        const std::vector<int>& cpus(const unsigned int node) const {return cpus_[node];}
+
+        // node for a worker thread (threads are distributed in
+        // contiguous blocks, proportional to the number of CPUs)
+        unsigned int nodeForThread(const int thread, const int num_threads) const;
+
+        // memory on a node (the pages are placed there when they are
+        // touched first, independent of the touching thread),
+        // plain malloc/free if disabled
+        void* allocate(const size_t bytes, const unsigned int node) const;
+        void free(void* ptr, const size_t bytes) const;
+
+        // system node ID (for the memory policy)
+        int node_id(const unsigned int node) const {return node_ids_[node];}
+
+    private:
+        // parses a sysfs cpulist (e.g. "0-15,32-47")
+        void parseCPUList(const std::string& list, std::vector<int>& cpus) const;
+
+        // CPUs and system IDs per node
+        std::vector<std::vector<int> > cpus_;
+        std::vector<int> node_ids_;
+        unsigned int num_cpus_;
+    };
+
+    // restricts the calling thread to the CPUs of a node
+    // for the lifetime of the object, the previous CPU mask
+    // is restored afterwards (no-op if disabled)
+    class ThreadPinning
+    {
+    public:
+        ThreadPinning(const NumaTopology& numa, const unsigned int node,
+                      const bool enabled=true);
+        ~ThreadPinning();
+
+        bool pinned() const {return pinned_;}
+
+    private:
+        bool pinned_;
+#ifdef L3DPP_NUMA
+        cpu_set_t previous_;
+#endif //L3DPP_NUMA
+    };
+
+    // the pages that the calling thread touches first are placed
+    // on a node (for the lifetime of the object, independent of
+    // the CPU it runs on), the previous memory policy is
+    // restored afterwards (no-op if disabled)
+    class MemoryPlacement
+    {
+    public:
+        MemoryPlacement(const NumaTopology& numa, const unsigned int node,
+                        const bool enabled=true);
+        ~MemoryPlacement();
+
+        bool placed() const {return placed_;}
+
+    private:
+        bool placed_;
+#ifdef L3DPP_NUMA
+        int previous_mode_;
+        unsigned long previous_mask_[L3D_NUMA_MASK_WORDS];
+#endif //L3DPP_NUMA
+    };
+}
+
+#endif //I3D_LINE3D_PP_NUMATOPOLOGY_H_
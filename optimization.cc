@@ -141,7 +141,7 @@ namespace L3DPP
         for(size_t i=0; i<clusters3D_->size(); ++i)
         {
             // iterate over 2D residuals
-            std::list<L3DPP::Segment2D>::const_iterator it=clusters3D_->at(i).residuals()->begin();
+            std::vector<L3DPP::Segment2D>::const_iterator it=clusters3D_->at(i).residuals()->begin();
             for(; it!=clusters3D_->at(i).residuals()->end(); ++it)
             {
                 L3DPP::Segment2D seg2D = *it;
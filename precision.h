@@ -0,0 +1,47 @@
+#ifndef I3D_LINE3D_PP_PRECISION_H_
+#define I3D_LINE3D_PP_PRECISION_H_
+
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// external
+#include "eigen3/Eigen/Eigen"
+
+/**
+ * Line3D++ - Precision
+ * ====================
+ * Numeric precision policies for the
+ * geometry kernels (matching, scoring).
+ * Camera centers and 3D points are
+ * always stored in double precision,
+ * the kernels only work on rays and
+ * baselines (relative coordinates).
+ * ====================
+ */
+
+namespace L3DPP
+{
+    //------------------------------------------------------------------------------
+    template<typename T>
+    struct Precision
+    {
+        typedef T Scalar;
+        typedef Eigen::Matrix<T,2,1> Vector2;
+        typedef Eigen::Matrix<T,3,1> Vector3;
+        typedef Eigen::Matrix<T,3,3> Matrix3;
+    };
+
+    typedef L3DPP::Precision<float> SinglePrecision;
+    typedef L3DPP::Precision<double> DoublePrecision;
+}
+
+#endif //I3D_LINE3D_PP_PRECISION_H_
@@ -0,0 +1,234 @@
+#include "projection.h"
+
+namespace L3DPP
+{
+    //------------------------------------------------------------------------------
+    SegmentProjector::SegmentProjector(const Eigen::Matrix3d& K, const Eigen::Matrix3d& R,
+                                       const Eigen::Vector3d& t, const unsigned int width,
+                                       const unsigned int height, const float near_depth) :
+        K_(K), R_(R), t_(t), width_(width), height_(height)
+    {
+        C_ = R_.transpose()*(-1.0*t_);
+        near_ = fmax(near_depth,L3D_EPS);
+
+        // normalize K (K(2,2) = 1 -> third coordinate is the depth)
+        Eigen::Matrix3d KR = (K_/K_(2,2))*R_;
+        for(size_t r=0; r<3; ++r)
+            for(size_t c=0; c<3; ++c)
+                KR_[r*3+c] = KR(r,c);
+    }
+
+    //------------------------------------------------------------------------------
+    void SegmentProjector::project(const std::vector<L3DPP::Segment3D>& segments,
+                                   std::vector<L3DPP::ProjectedSegment2D>& result) const
+    {
+        SegmentBatch batch;
+        batch.resize(segments.size());
+        for(size_t i=0; i<segments.size(); ++i)
+            batch.set(i,segments[i].P1(),segments[i].P2(),C_,i,0);
+
+        projectBatch(batch,result);
+    }
+
+    //------------------------------------------------------------------------------
+    void SegmentProjector::project(const std::vector<L3DPP::FinalLine3D>& lines3D,
+                                   std::vector<L3DPP::ProjectedSegment2D>& result) const
+    {
+        size_t num = 0;
+        for(size_t i=0; i<lines3D.size(); ++i)
+            num += lines3D[i].collinear3Dsegments_.size();
+
+        SegmentBatch batch;
+        batch.resize(num);
+
+        size_t pos = 0;
+        for(size_t i=0; i<lines3D.size(); ++i)
+        {
+            for(size_t j=0; j<lines3D[i].collinear3Dsegments_.size(); ++j,++pos)
+            {
+                const L3DPP::Segment3D& seg3D = lines3D[i].collinear3Dsegments_[j];
+                batch.set(pos,seg3D.P1(),seg3D.P2(),C_,i,j);
+            }
+        }
+
+        projectBatch(batch,result);
+    }
+
+    //------------------------------------------------------------------------------
+    void SegmentProjector::project(const std::vector<L3DPP::FinalLine3D>& lines3D,
+                                   const std::vector<L3DPP::SpatialHit>& candidates,
+                                   std::vector<L3DPP::ProjectedSegment2D>& result) const
+    {
+        SegmentBatch batch;
+        batch.resize(candidates.size());
+        for(size_t i=0; i<candidates.size(); ++i)
+        {
+            const L3DPP::SpatialHit& hit = candidates[i];
+            const L3DPP::Segment3D& seg3D = lines3D[hit.lineID_].collinear3Dsegments_[hit.segmentID_];
+            batch.set(i,seg3D.P1(),seg3D.P2(),C_,hit.lineID_,hit.segmentID_);
+        }
+
+        projectBatch(batch,result);
+    }
+
+    //------------------------------------------------------------------------------
+    L3DPP::SpatialFrustum SegmentProjector::frustum() const
+    {
+        return L3DPP::SpatialFrustum(K_,R_,t_,width_,height_,near_);
+    }
+
+    //------------------------------------------------------------------------------
+    void SegmentProjector::SegmentBatch::resize(const size_t n)
+    {
+        x1_.resize(n); y1_.resize(n); z1_.resize(n);
+        x2_.resize(n); y2_.resize(n); z2_.resize(n);
+        lineID_.resize(n);
+        segmentID_.resize(n);
+    }
+
+    //------------------------------------------------------------------------------
+    void SegmentProjector::SegmentBatch::set(const size_t i, const Eigen::Vector3d& P1,
+                                             const Eigen::Vector3d& P2, const Eigen::Vector3d& C,
+                                             const unsigned int lineID,
+                                             const unsigned int segmentID)
+    {
+        // relative to the camera center (float precision
+        // is sufficient, even for large scene coordinates)
+        Eigen::Vector3d D1 = P1-C;
+        Eigen::Vector3d D2 = P2-C;
+        x1_[i] = D1.x(); y1_[i] = D1.y(); z1_[i] = D1.z();
+        x2_[i] = D2.x(); y2_[i] = D2.y(); z2_[i] = D2.z();
+        lineID_[i] = lineID;
+        segmentID_[i] = segmentID;
+    }
+
+    //------------------------------------------------------------------------------
+    void SegmentProjector::projectBatch(const SegmentBatch& batch,
+                                        std::vector<L3DPP::ProjectedSegment2D>& result) const
+    {
+        result.clear();
+
+        const int num = batch.x1_.size();
+        if(num == 0)
+            return;
+
+        const float k00 = KR_[0], k01 = KR_[1], k02 = KR_[2];
+        const float k10 = KR_[3], k11 = KR_[4], k12 = KR_[5];
+        const float k20 = KR_[6], k21 = KR_[7], k22 = KR_[8];
+        const float near_depth = near_;
+
+        const float* x1 = &batch.x1_[0]; const float* y1 = &batch.y1_[0]; const float* z1 = &batch.z1_[0];
+        const float* x2 = &batch.x2_[0]; const float* y2 = &batch.y2_[0]; const float* z2 = &batch.z2_[0];
+
+        // blocks (local output arrays can not alias the input -> vectorized)
+        float u1[L3D_PROJECTION_BLOCK_SIZE], v1[L3D_PROJECTION_BLOCK_SIZE], d1[L3D_PROJECTION_BLOCK_SIZE];
+        float u2[L3D_PROJECTION_BLOCK_SIZE], v2[L3D_PROJECTION_BLOCK_SIZE], d2[L3D_PROJECTION_BLOCK_SIZE];
+
+        result.reserve(num);
+        for(int block=0; block<num; block+=L3D_PROJECTION_BLOCK_SIZE)
+        {
+            const int n = std::min(num-block,int(L3D_PROJECTION_BLOCK_SIZE));
+
+            // homogeneous projection and near plane clipping (branchless,
+            // depth < 0 -> segment behind the near plane)
+            for(int j=0; j<n; ++j)
+            {
+                const int i = block+j;
+                float hx1 = k00*x1[i] + k01*y1[i] + k02*z1[i];
+                float hy1 = k10*x1[i] + k11*y1[i] + k12*z1[i];
+                float hz1 = k20*x1[i] + k21*y1[i] + k22*z1[i];
+                float hx2 = k00*x2[i] + k01*y2[i] + k02*z2[i];
+                float hy2 = k10*x2[i] + k11*y2[i] + k12*z2[i];
+                float hz2 = k20*x2[i] + k21*y2[i] + k22*z2[i];
+
+                // (a1/a2 are zero if the endpoint is in front of the near plane,
+                // selects instead of fmaxf/fminf -> vectorized without fast-math)
+                float dz = hz2-hz1;
+                float dz_safe = dz+copysignf(1e-12f,dz);
+                float o1 = near_depth-hz1;
+                float o2 = near_depth-hz2;
+                float a1 = ((o1 > 0.0f) ? o1 : 0.0f)/dz_safe;
+                float a2 = ((o2 > 0.0f) ? o2 : 0.0f)/(-dz_safe);
+                bool valid = ((hz1 >= near_depth) | (hz2 >= near_depth));
+
+                float cx1 = hx1 + a1*(hx2-hx1);
+                float cy1 = hy1 + a1*(hy2-hy1);
+                float cz1 = hz1 + a1*dz;
+                float cx2 = hx2 + a2*(hx1-hx2);
+                float cy2 = hy2 + a2*(hy1-hy2);
+                float cz2 = hz2 - a2*dz;
+
+                cz1 = (cz1 > near_depth) ? cz1 : near_depth;
+                cz2 = (cz2 > near_depth) ? cz2 : near_depth;
+
+                u1[j] = cx1/cz1; v1[j] = cy1/cz1; d1[j] = valid ? cz1 : -1.0f;
+                u2[j] = cx2/cz2; v2[j] = cy2/cz2; d2[j] = valid ? cz2 : -1.0f;
+            }
+
+            // image borders
+            for(int j=0; j<n; ++j)
+            {
+                if(d1[j] < 0.0f)
+                    continue;
+
+                L3DPP::ProjectedSegment2D seg;
+                seg.lineID_ = batch.lineID_[block+j];
+                seg.segmentID_ = batch.segmentID_[block+j];
+                seg.x1_ = u1[j]; seg.y1_ = v1[j];
+                seg.x2_ = u2[j]; seg.y2_ = v2[j];
+                seg.depth1_ = d1[j];
+                seg.depth2_ = d2[j];
+
+                if(clipToImage(seg))
+                    result.push_back(seg);
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    bool SegmentProjector::clipToImage(L3DPP::ProjectedSegment2D& seg) const
+    {
+        // Liang-Barsky
+        float dx = seg.x2_-seg.x1_;
+        float dy = seg.y2_-seg.y1_;
+        float p[4] = {-dx, dx, -dy, dy};
+        float q[4] = {seg.x1_, float(width_)-seg.x1_, seg.y1_, float(height_)-seg.y1_};
+
+        float t0 = 0.0f;
+        float t1 = 1.0f;
+        for(size_t i=0; i<4; ++i)
+        {
+            if(fabs(p[i]) < L3D_EPS)
+            {
+                if(q[i] < 0.0f)
+                    return false;
+            }
+            else
+            {
+                float r = q[i]/p[i];
+                if(p[i] < 0.0f)
+                    t0 = fmax(t0,r);
+                else
+                    t1 = fmin(t1,r);
+            }
+        }
+
+        if(t0 > t1)
+            return false;
+
+        // inverse depth is linear in image space
+        float inv_d1 = 1.0f/seg.depth1_;
+        float inv_d2 = 1.0f/seg.depth2_;
+
+        L3DPP::ProjectedSegment2D clipped = seg;
+        clipped.x1_ = seg.x1_ + t0*dx;
+        clipped.y1_ = seg.y1_ + t0*dy;
+        clipped.x2_ = seg.x1_ + t1*dx;
+        clipped.y2_ = seg.y1_ + t1*dy;
+        clipped.depth1_ = 1.0f/(inv_d1 + t0*(inv_d2-inv_d1));
+        clipped.depth2_ = 1.0f/(inv_d1 + t1*(inv_d2-inv_d1));
+        seg = clipped;
+
+        return true;
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef I3D_LINE3D_PP_PROJECTION_H_
+#define I3D_LINE3D_PP_PROJECTION_H_
+
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+// external
+#include "eigen3/Eigen/Eigen"
+
+// internal
+#include "segment3D.h"
+#include "spatialindex.h"
+
+/**
+ * Line3D++ - SegmentProjector
+ * ====================
+ * Batched projection of 3D segments
+ * into one camera. Segments are
+ * clipped at the near plane and at
+ * the image borders.
+ * ====================
+ */
+
+namespace L3DPP
+{
+    // segments per block (vectorized projection)
+    const unsigned int L3D_PROJECTION_BLOCK_SIZE = 256;
+
+    //------------------------------------------------------------------------------
+    // projected (and clipped) 3D segment
+    struct ProjectedSegment2D
+    {
+        // index of the 3D line (or segment) and of the collinear segment
+        unsigned int lineID_;
+        unsigned int segmentID_;
+        // image coordinates
+        float x1_;
+        float y1_;
+        float x2_;
+        float y2_;
+        // depths of the (clipped) endpoints
+        float depth1_;
+        float depth2_;
+    };
+
+    //------------------------------------------------------------------------------
+    class SegmentProjector
+    {
+    public:
+        // camera model: point2D = K [R | t] point3D
+        // (near_depth <= 0 -> everything in front of the camera)
+        SegmentProjector(const Eigen::Matrix3d& K, const Eigen::Matrix3d& R,
+                         const Eigen::Vector3d& t, const unsigned int width,
+                         const unsigned int height, const float near_depth=0.0f);
+
+        // projects arbitrary 3D segments (lineID_ -> index in 'segments')
+        void project(const std::vector<L3DPP::Segment3D>& segments,
+                     std::vector<L3DPP::ProjectedSegment2D>& result) const;
+
+        // projects the collinear segments of the final 3D lines (all or only
+        // the given candidates, e.g. from a frustum query)
+        void project(const std::vector<L3DPP::FinalLine3D>& lines3D,
+                     std::vector<L3DPP::ProjectedSegment2D>& result) const;
+        void project(const std::vector<L3DPP::FinalLine3D>& lines3D,
+                     const std::vector<L3DPP::SpatialHit>& candidates,
+                     std::vector<L3DPP::ProjectedSegment2D>& result) const;
+
+        // frustum for culling (spatial index)
+        L3DPP::SpatialFrustum frustum() const;
+
+    private:
+        // segments in structure-of-arrays layout (relative to the camera center)
+        struct SegmentBatch
+        {
+            void resize(const size_t n);
+            void set(const size_t i, const Eigen::Vector3d& P1, const Eigen::Vector3d& P2,
+                     const Eigen::Vector3d& C, const unsigned int lineID,
+                     const unsigned int segmentID);
+
+            std::vector<float> x1_,y1_,z1_;
+            std::vector<float> x2_,y2_,z2_;
+            std::vector<unsigned int> lineID_;
+            std::vector<unsigned int> segmentID_;
+        };
+
+        // projection of a batch (vectorizable inner loop + 2D clipping)
+        void projectBatch(const SegmentBatch& batch,
+                          std::vector<L3DPP::ProjectedSegment2D>& result) const;
+
+        // clips a 2D segment at the image borders (perspective correct depths)
+        bool clipToImage(L3DPP::ProjectedSegment2D& seg) const;
+
+        // camera
+        Eigen::Matrix3d K_;
+        Eigen::Matrix3d R_;
+        Eigen::Vector3d t_;
+        Eigen::Vector3d C_;
+        unsigned int width_;
+        unsigned int height_;
+        float near_;
+
+        // K*R (row major, float)
+        float KR_[9];
+    };
+}
+
+#endif //I3D_LINE3D_PP_PROJECTION_H_
@@ -0,0 +1,199 @@
+#include "resultsnapshot.h"
+#include "line3D.h"
+
+// external
+#include "boost/static_assert.hpp"
+
+namespace L3DPP
+{
+    // the reverse index is exposed without conversion
+    BOOST_STATIC_ASSERT(sizeof(unsigned int) == sizeof(uint32_t));
+    BOOST_STATIC_ASSERT(sizeof(int) == sizeof(int32_t));
+    BOOST_STATIC_ASSERT(sizeof(L3DPP::LineSupport) == 2*sizeof(uint32_t));
+
+    //------------------------------------------------------------------------------
+    ResultSnapshot::ResultSnapshot(std::vector<L3DPP::FinalLine3D>& lines3D,
+                                   L3DPP::ReverseIndex& reverse_index) :
+        references_(1), flat_(false)
+    {
+        lines3D_.swap(lines3D);
+        reverse_index_.swap(reverse_index);
+    }
+
+    //------------------------------------------------------------------------------
+    void ResultSnapshot::retain() const
+    {
+        mutex_.lock();
+        ++references_;
+        mutex_.unlock();
+    }
+
+    //------------------------------------------------------------------------------
+    void ResultSnapshot::release() const
+    {
+        mutex_.lock();
+        bool last = (--references_ == 0);
+        mutex_.unlock();
+
+        if(last)
+            delete this;
+    }
+
+    //------------------------------------------------------------------------------
+    void ResultSnapshot::flatten() const
+    {
+        lines_.resize(lines3D_.size()*6);
+        segment_offsets_.resize(lines3D_.size()+1,0);
+        residual_offsets_.resize(lines3D_.size()+1,0);
+
+        for(size_t i=0; i<lines3D_.size(); ++i)
+        {
+            segment_offsets_[i+1] = segment_offsets_[i]+lines3D_[i].collinear3Dsegments_.size();
+            residual_offsets_[i+1] = residual_offsets_[i]+lines3D_[i].underlyingCluster_.residuals()->size();
+        }
+
+        segments_.resize(segment_offsets_.back()*6);
+        residuals_.resize(residual_offsets_.back()*2);
+
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for
+#endif //L3DPP_OPENMP
+        for(int i=0; i<lines3D_.size(); ++i)
+        {
+            const L3DPP::LineCluster3D& cluster = lines3D_[i].underlyingCluster_;
+            Eigen::Vector3d P1 = cluster.seg3D().P1();
+            Eigen::Vector3d P2 = cluster.seg3D().P2();
+            for(size_t d=0; d<3; ++d)
+            {
+                lines_[i*6+d] = P1(d);
+                lines_[i*6+3+d] = P2(d);
+            }
+
+            for(size_t j=0; j<lines3D_[i].collinear3Dsegments_.size(); ++j)
+            {
+                const L3DPP::Segment3D& seg3D = lines3D_[i].collinear3Dsegments_[j];
+                size_t pos = (segment_offsets_[i]+j)*6;
+                for(size_t d=0; d<3; ++d)
+                {
+                    segments_[pos+d] = seg3D.P1()(d);
+                    segments_[pos+3+d] = seg3D.P2()(d);
+                }
+            }
+
+            for(size_t j=0; j<cluster.residuals()->size(); ++j)
+            {
+                const L3DPP::Segment2D& seg2D = cluster.residuals()->at(j);
+                size_t pos = (residual_offsets_[i]+j)*2;
+                residuals_[pos] = seg2D.camID();
+                residuals_[pos+1] = seg2D.segID();
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    void ResultSnapshot::view(l3dpp_result_view* v) const
+    {
+        flat_mutex_.lock();
+        if(!flat_)
+        {
+            flatten();
+            flat_ = true;
+        }
+        flat_mutex_.unlock();
+
+        v->num_lines = num_lines();
+        v->num_segments = segments_.size()/6;
+        v->num_residuals = residuals_.size()/2;
+        v->num_views = reverse_index_.num_views();
+
+        v->lines = lines_.empty() ? NULL : &lines_[0];
+        v->line_stride = 6;
+
+        v->segment_offsets = &segment_offsets_[0];
+        v->segments = segments_.empty() ? NULL : &segments_[0];
+        v->segment_stride = 6;
+
+        v->residual_offsets = &residual_offsets_[0];
+        v->residuals = residuals_.empty() ? NULL : &residuals_[0];
+        v->residual_stride = 2;
+
+        v->view_ids = NULL;
+        v->view_support_offsets = NULL;
+        v->view_support = NULL;
+        v->view_segment_offsets = NULL;
+        v->view_segment_ids = NULL;
+        v->view_segment_lines = NULL;
+        v->view_support_stride = 2;
+
+        if(reverse_index_.num_views() > 0)
+        {
+            v->view_ids = reinterpret_cast<const uint32_t*>(&reverse_index_.camIDs()[0]);
+            v->view_support_offsets = reinterpret_cast<const uint32_t*>(&reverse_index_.support_offsets()[0]);
+            v->view_segment_offsets = reinterpret_cast<const uint32_t*>(&reverse_index_.segment_offsets()[0]);
+
+            if(!reverse_index_.support().empty())
+                v->view_support = reinterpret_cast<const uint32_t*>(&reverse_index_.support()[0]);
+            if(!reverse_index_.segment_lines().empty())
+            {
+                v->view_segment_ids = reinterpret_cast<const uint32_t*>(&reverse_index_.segment_ids()[0]);
+                v->view_segment_lines = reinterpret_cast<const int32_t*>(&reverse_index_.segment_lines()[0]);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// C API
+//------------------------------------------------------------------------------
+extern "C"
+{
+    //------------------------------------------------------------------------------
+    l3dpp_line3d* l3dpp_line3d_create(const char* output_folder)
+    {
+        if(output_folder == NULL)
+            return NULL;
+
+        L3DPP::Line3D* L = new L3DPP::Line3D(std::string(output_folder));
+        return L->handle();
+    }
+
+    //------------------------------------------------------------------------------
+    void l3dpp_line3d_destroy(l3dpp_line3d* line3d)
+    {
+        delete L3DPP::Line3D::fromHandle(line3d);
+    }
+
+    //------------------------------------------------------------------------------
+    const l3dpp_snapshot* l3dpp_snapshot_acquire(l3dpp_line3d* line3d)
+    {
+        if(line3d == NULL)
+            return NULL;
+
+        L3DPP::Line3D* L = L3DPP::Line3D::fromHandle(line3d);
+        return reinterpret_cast<const l3dpp_snapshot*>(L->acquireResultSnapshot());
+    }
+
+    //------------------------------------------------------------------------------
+    void l3dpp_snapshot_retain(const l3dpp_snapshot* snapshot)
+    {
+        if(snapshot != NULL)
+            reinterpret_cast<const L3DPP::ResultSnapshot*>(snapshot)->retain();
+    }
+
+    //------------------------------------------------------------------------------
+    void l3dpp_snapshot_release(const l3dpp_snapshot* snapshot)
+    {
+        if(snapshot != NULL)
+            reinterpret_cast<const L3DPP::ResultSnapshot*>(snapshot)->release();
+    }
+
+    //------------------------------------------------------------------------------
+    int l3dpp_snapshot_view(const l3dpp_snapshot* snapshot, l3dpp_result_view* view)
+    {
+        if(snapshot == NULL || view == NULL)
+            return -1;
+
+        reinterpret_cast<const L3DPP::ResultSnapshot*>(snapshot)->view(view);
+        return 0;
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef I3D_LINE3D_PP_RESULTSNAPSHOT_H_
+#define I3D_LINE3D_PP_RESULTSNAPSHOT_H_
+
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <vector>
+#include <iostream>
+
+// external
+#include "boost/thread/mutex.hpp"
+
+// internal
+#include "line3D_c.h"
+#include "segment3D.h"
+#include "reverseindex.h"
+
+/**
+ * Line3D++ - ResultSnapshot
+ * ====================
+ * Immutable 3D model (lines, collinear
+ * segments, residuals and reverse index)
+ * that is shared by reference counting.
+ * Backs the C result API (see "line3D_c.h"),
+ * the flat arrays are only built when
+ * they are requested for the first time.
+ * ====================
+ */
+
+namespace L3DPP
+{
+    class ResultSnapshot
+    {
+    public:
+        // snapshot with one reference, takes over the model
+        // (lines3D and reverse_index are empty afterwards)
+        ResultSnapshot(std::vector<L3DPP::FinalLine3D>& lines3D,
+                       L3DPP::ReverseIndex& reverse_index);
+
+        // reference counting [thread-safe], the snapshot is
+        // deleted when the last reference is released
+        void retain() const;
+        void release() const;
+
+        // flat view (pointers into the snapshot) [thread-safe]
+        void view(l3dpp_result_view* v) const;
+
+        // data access
+        size_t num_lines() const {return lines3D_.size();}
+        const std::vector<L3DPP::FinalLine3D>& lines3D() const {return lines3D_;}
+        const L3DPP::ReverseIndex& reverse_index() const {return reverse_index_;}
+
+    private:
+        // only via release()
+        ~ResultSnapshot(){}
+
+        // builds the flat arrays (once)
+        void flatten() const;
+
+        // reference count
+        mutable boost::mutex mutex_;
+        mutable unsigned int references_;
+
+        // model
+        std::vector<L3DPP::FinalLine3D> lines3D_;
+        L3DPP::ReverseIndex reverse_index_;
+
+        // flat arrays: 3D lines and collinear segments (x1,y1,z1,x2,y2,z2)
+        mutable boost::mutex flat_mutex_;
+        mutable bool flat_;
+        mutable std::vector<double> lines_;
+        mutable std::vector<uint32_t> segment_offsets_;
+        mutable std::vector<double> segments_;
+
+        // flat arrays: residuals (camID,segID)
+        mutable std::vector<uint32_t> residual_offsets_;
+        mutable std::vector<uint32_t> residuals_;
+    };
+}
+
+#endif //I3D_LINE3D_PP_RESULTSNAPSHOT_H_
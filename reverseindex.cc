@@ -0,0 +1,165 @@
+#include "reverseindex.h"
+
+namespace L3DPP
+{
+    //------------------------------------------------------------------------------
+    void ReverseIndex::build(const std::vector<L3DPP::FinalLine3D>& lines3D,
+                             const std::map<unsigned int,unsigned int>& num_segments)
+    {
+        clear();
+
+        // views (sorted by camID)
+        std::vector<unsigned int> num_segs;
+        std::map<unsigned int,unsigned int>::const_iterator it = num_segments.begin();
+        for(; it!=num_segments.end(); ++it)
+        {
+            local_[it->first] = camIDs_.size();
+            camIDs_.push_back(it->first);
+            num_segs.push_back(it->second);
+        }
+
+        // count residuals per view
+        std::vector<unsigned int> counts(camIDs_.size()+1,0);
+        for(size_t i=0; i<lines3D.size(); ++i)
+        {
+            const std::vector<L3DPP::Segment2D>* residuals = lines3D[i].underlyingCluster_.residuals();
+            for(size_t j=0; j<residuals->size(); ++j)
+            {
+                const L3DPP::Segment2D& seg2D = residuals->at(j);
+                int v = localID(seg2D.camID());
+                if(v >= 0 && seg2D.segID() < num_segs[v])
+                    ++counts[v+1];
+            }
+        }
+
+        support_offsets_ = std::vector<unsigned int>(camIDs_.size()+1,0);
+        for(size_t v=0; v<camIDs_.size(); ++v)
+            support_offsets_[v+1] = support_offsets_[v]+counts[v+1];
+
+        // fill (lines in increasing order -> sorted by lineID)
+        support_.resize(support_offsets_.back());
+        std::vector<unsigned int> pos(support_offsets_.begin(),support_offsets_.end()-1);
+        for(size_t i=0; i<lines3D.size(); ++i)
+        {
+            const std::vector<L3DPP::Segment2D>* residuals = lines3D[i].underlyingCluster_.residuals();
+            for(size_t j=0; j<residuals->size(); ++j)
+            {
+                const L3DPP::Segment2D& seg2D = residuals->at(j);
+                int v = localID(seg2D.camID());
+                if(v < 0 || seg2D.segID() >= num_segs[v])
+                    continue;
+
+                support_[pos[v]] = L3DPP::LineSupport(i,seg2D.segID());
+                ++pos[v];
+            }
+        }
+
+        // segment -> line: the same entries sorted by segID, first line
+        // wins (segments are usually part of one line only)
+        std::vector<std::vector<L3DPP::LineSupport> > by_segment(camIDs_.size());
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for
+#endif //L3DPP_OPENMP
+        for(int v=0; v<camIDs_.size(); ++v)
+        {
+            std::vector<L3DPP::LineSupport>& segs = by_segment[v];
+            segs.assign(support_.begin()+support_offsets_[v],
+                        support_.begin()+support_offsets_[v+1]);
+            std::sort(segs.begin(),segs.end(),L3DPP::sortLineSupportBySegment);
+
+            size_t num_unique = 0;
+            for(size_t k=0; k<segs.size(); ++k)
+            {
+                if(num_unique == 0 || segs[num_unique-1].segID_ != segs[k].segID_)
+                    segs[num_unique++] = segs[k];
+            }
+            segs.resize(num_unique);
+
+            // sort by segID within a line
+            std::sort(support_.begin()+support_offsets_[v],
+                      support_.begin()+support_offsets_[v+1],
+                      L3DPP::sortLineSupport);
+        }
+
+        segment_offsets_ = std::vector<unsigned int>(camIDs_.size()+1,0);
+        for(size_t v=0; v<camIDs_.size(); ++v)
+            segment_offsets_[v+1] = segment_offsets_[v]+by_segment[v].size();
+
+        segment_ids_.resize(segment_offsets_.back());
+        segment_lines_.resize(segment_offsets_.back());
+        for(size_t v=0; v<camIDs_.size(); ++v)
+        {
+            for(size_t k=0; k<by_segment[v].size(); ++k)
+            {
+                segment_ids_[segment_offsets_[v]+k] = by_segment[v][k].segID_;
+                segment_lines_[segment_offsets_[v]+k] = by_segment[v][k].lineID_;
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    void ReverseIndex::clear()
+    {
+        camIDs_.clear();
+        local_.clear();
+        support_offsets_.clear();
+        support_.clear();
+        segment_offsets_.clear();
+        segment_ids_.clear();
+        segment_lines_.clear();
+    }
+
+    //------------------------------------------------------------------------------
+    void ReverseIndex::swap(L3DPP::ReverseIndex& other)
+    {
+        camIDs_.swap(other.camIDs_);
+        local_.swap(other.local_);
+        support_offsets_.swap(other.support_offsets_);
+        support_.swap(other.support_);
+        segment_offsets_.swap(other.segment_offsets_);
+        segment_ids_.swap(other.segment_ids_);
+        segment_lines_.swap(other.segment_lines_);
+    }
+
+    //------------------------------------------------------------------------------
+    const L3DPP::LineSupport* ReverseIndex::support(const unsigned int camID, size_t& num) const
+    {
+        num = 0;
+        int v = localID(camID);
+        if(v < 0)
+            return NULL;
+
+        num = support_offsets_[v+1]-support_offsets_[v];
+        if(num == 0)
+            return NULL;
+
+        return &support_[support_offsets_[v]];
+    }
+
+    //------------------------------------------------------------------------------
+    int ReverseIndex::lineID(const unsigned int camID, const unsigned int segID) const
+    {
+        int v = localID(camID);
+        if(v < 0)
+            return -1;
+
+        // binary search within the view
+        std::vector<unsigned int>::const_iterator first = segment_ids_.begin()+segment_offsets_[v];
+        std::vector<unsigned int>::const_iterator last = segment_ids_.begin()+segment_offsets_[v+1];
+        std::vector<unsigned int>::const_iterator it = std::lower_bound(first,last,segID);
+        if(it == last || *it != segID)
+            return -1;
+
+        return segment_lines_[it-segment_ids_.begin()];
+    }
+
+    //------------------------------------------------------------------------------
+    int ReverseIndex::localID(const unsigned int camID) const
+    {
+        std::map<unsigned int,unsigned int>::const_iterator it = local_.find(camID);
+        if(it == local_.end())
+            return -1;
+
+        return it->second;
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef I3D_LINE3D_PP_REVERSEINDEX_H_
+#define I3D_LINE3D_PP_REVERSEINDEX_H_
+
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <map>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+// internal
+#include "segment3D.h"
+
+/**
+ * Line3D++ - ReverseIndex
+ * ====================
+ * Maps the images to the 3D lines they
+ * support (view -> (lineID,segID)) and
+ * the 2D segments to their 3D line
+ * ((view,segID) -> lineID), both in
+ * CSR format. Only segments that are
+ * part of a 3D line are stored (sorted
+ * by segID per view, binary search).
+ * ====================
+ */
+
+namespace L3DPP
+{
+    //------------------------------------------------------------------------------
+    // 2D segment supporting a 3D line
+    struct LineSupport
+    {
+        LineSupport() : lineID_(0), segID_(0){}
+        LineSupport(const unsigned int lineID, const unsigned int segID) :
+            lineID_(lineID), segID_(segID){}
+
+        // index of the 3D line
+        unsigned int lineID_;
+        // 2D segment in the view
+        unsigned int segID_;
+    };
+
+    static bool sortLineSupport(const L3DPP::LineSupport& s1, const L3DPP::LineSupport& s2)
+    {
+        return ((s1.lineID_ < s2.lineID_) || (s1.lineID_ == s2.lineID_ && s1.segID_ < s2.segID_));
+    }
+
+    static bool sortLineSupportBySegment(const L3DPP::LineSupport& s1, const L3DPP::LineSupport& s2)
+    {
+        return ((s1.segID_ < s2.segID_) || (s1.segID_ == s2.segID_ && s1.lineID_ < s2.lineID_));
+    }
+
+    //------------------------------------------------------------------------------
+    class ReverseIndex
+    {
+    public:
+        ReverseIndex(){}
+
+        // builds the index from the final 3D lines (residuals), 'num_segments'
+        // holds the number of 2D segments for all views (camID -> #segments,
+        // residuals of unknown views or with larger segIDs are ignored)
+        void build(const std::vector<L3DPP::FinalLine3D>& lines3D,
+                   const std::map<unsigned int,unsigned int>& num_segments);
+        void clear();
+
+        // exchanges the contents (no copy)
+        void swap(L3DPP::ReverseIndex& other);
+
+        // view -> supported 3D lines, sorted by lineID_ (NULL if there are none)
+        const L3DPP::LineSupport* support(const unsigned int camID, size_t& num) const;
+
+        // (view,segID) -> lineID (-1 if the segment is not part of a 3D line)
+        int lineID(const unsigned int camID, const unsigned int segID) const;
+
+        // CSR data (local view index v -> camIDs()[v])
+        size_t num_views() const {return camIDs_.size();}
+        const std::vector<unsigned int>& camIDs() const {return camIDs_;}
+        const std::vector<unsigned int>& support_offsets() const {return support_offsets_;}
+        const std::vector<L3DPP::LineSupport>& support() const {return support_;}
+        const std::vector<unsigned int>& segment_offsets() const {return segment_offsets_;}
+        const std::vector<unsigned int>& segment_ids() const {return segment_ids_;}
+        const std::vector<int>& segment_lines() const {return segment_lines_;}
+
+    private:
+        // local view index (-1 if unknown)
+        int localID(const unsigned int camID) const;
+
+        // views
+        std::vector<unsigned int> camIDs_;
+        std::map<unsigned int,unsigned int> local_;
+
+        // view -> (lineID,segID)
+        std::vector<unsigned int> support_offsets_;
+        std::vector<L3DPP::LineSupport> support_;
+
+        // (view,segID) -> lineID (segments of 3D lines only, sorted by segID per view)
+        std::vector<unsigned int> segment_offsets_;
+        std::vector<unsigned int> segment_ids_;
+        std::vector<int> segment_lines_;
+    };
+}
+
+#endif //I3D_LINE3D_PP_REVERSEINDEX_H_
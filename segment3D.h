@@ -12,13 +12,16 @@
 
 // external
 #include "eigen3/Eigen/Eigen"
+#include "boost/serialization/split_member.hpp"
 
 // std
 #include <list>
 #include <set>
+#include <vector>
 
 // internal
 #include "commons.h"
+#include "precision.h"
 
 /**
  * Line3D++ - Segment3D Class
@@ -31,44 +34,35 @@
 namespace L3DPP
 {
     //------------------------------------------------------------------------------
-    // one 3D line segment
+    // one 3D line segment (endpoints in double precision, since the final
+    // lines are stored in world coordinates; direction and length are
+    // cached in single precision)
     class Segment3D
     {
     public:
-        Segment3D()
-        {
-            P1_ = Eigen::Vector3d(0,0,0);
-            P2_ = Eigen::Vector3d(0,0,0);
-            dir_ = Eigen::Vector3d(0,0,0);
-            length_ = 0.0f;
-            valid_ = false;
-        }
+        Segment3D() : P1_(0,0,0), P2_(0,0,0), dir_(0,0,0), length_(0.0f){}
 
         Segment3D(const Eigen::Vector3d& P1,
                   const Eigen::Vector3d& P2)
         {
-            length_ = (P1-P2).norm();
-            if(length_ > L3D_EPS)
+            if((P1-P2).norm() > L3D_EPS)
             {
                 P1_ = P1;
                 P2_ = P2;
-                dir_ = (P2-P1).normalized();
-                valid_ = true;
             }
             else
             {
                 P1_ = Eigen::Vector3d(0,0,0);
                 P2_ = Eigen::Vector3d(0,0,0);
-                dir_ = Eigen::Vector3d(0,0,0);
-                length_ = 0.0f;
-                valid_ = false;
             }
+            updateDirection();
         }
 
         // distance point to line
         float distance_Point2Line(const Eigen::Vector3d& P) const
         {
-            Eigen::Vector3d hlp_pt = P1_ + (dir_ * ((P - P1_).transpose()) * dir_);
+            Eigen::Vector3d d = dir_.cast<double>();
+            Eigen::Vector3d hlp_pt = P1_ + (d * ((P - P1_).transpose()) * d);
             return (hlp_pt-P).norm();
         }
 
@@ -80,26 +74,67 @@ namespace L3DPP
         }
 
         // data access
-        Eigen::Vector3d P1() const {return P1_;}
-        Eigen::Vector3d P2() const {return P2_;}
-        Eigen::Vector3d dir() const {return dir_;}
+        const Eigen::Vector3d& P1() const {return P1_;}
+        const Eigen::Vector3d& P2() const {return P2_;}
+        Eigen::Vector3d dir() const {return dir_.cast<double>();}
+        // direction in kernel precision
+        template<class P>
+        typename P::Vector3 dirAs() const {return dir_.cast<typename P::Scalar>();}
         float length() const {return length_;}
-        bool valid() const {return valid_;}
+        bool valid() const {return (length_ > L3D_EPS);}
 
     private:
+        // direction and length from the endpoints
+        void updateDirection()
+        {
+            Eigen::Vector3d d = P2_-P1_;
+            double len = d.norm();
+            length_ = len;
+            if(len > L3D_EPS)
+                dir_ = (d/len).cast<float>();
+            else
+                dir_ = Eigen::Vector3f(0,0,0);
+        }
+
         Eigen::Vector3d P1_;
         Eigen::Vector3d P2_;
-        Eigen::Vector3d dir_;
+        Eigen::Vector3f dir_;
         float length_;
-        bool valid_;
 
-        // serialization
+        // serialization (file format with redundant length/direction)
         friend class boost::serialization::access;
         template<class Archive>
-        void serialize(Archive & ar, const unsigned int version)
+        void save(Archive & ar, const unsigned int version) const
+        {
+            float len = length();
+            bool is_valid = valid();
+            Eigen::Vector3d d = dir();
+
+            ar & boost::serialization::make_nvp("length_", len);
+            ar & boost::serialization::make_nvp("valid_", is_valid);
+
+            ar & boost::serialization::make_nvp("P1_x", P1_.x());
+            ar & boost::serialization::make_nvp("P1_y", P1_.y());
+            ar & boost::serialization::make_nvp("P1_z", P1_.z());
+
+            ar & boost::serialization::make_nvp("P2_x", P2_.x());
+            ar & boost::serialization::make_nvp("P2_y", P2_.y());
+            ar & boost::serialization::make_nvp("P2_z", P2_.z());
+
+            ar & boost::serialization::make_nvp("dir_x", d.x());
+            ar & boost::serialization::make_nvp("dir_y", d.y());
+            ar & boost::serialization::make_nvp("dir_z", d.z());
+        }
+
+        template<class Archive>
+        void load(Archive & ar, const unsigned int version)
         {
-            ar & boost::serialization::make_nvp("length_", length_);
-            ar & boost::serialization::make_nvp("valid_", valid_);
+            float len;
+            bool is_valid;
+            Eigen::Vector3d d;
+
+            ar & boost::serialization::make_nvp("length_", len);
+            ar & boost::serialization::make_nvp("valid_", is_valid);
 
             ar & boost::serialization::make_nvp("P1_x", P1_.x());
             ar & boost::serialization::make_nvp("P1_y", P1_.y());
@@ -109,10 +144,44 @@ namespace L3DPP
             ar & boost::serialization::make_nvp("P2_y", P2_.y());
             ar & boost::serialization::make_nvp("P2_z", P2_.z());
 
-            ar & boost::serialization::make_nvp("dir_x", dir_.x());
-            ar & boost::serialization::make_nvp("dir_y", dir_.y());
-            ar & boost::serialization::make_nvp("dir_z", dir_.z());
+            ar & boost::serialization::make_nvp("dir_x", d.x());
+            ar & boost::serialization::make_nvp("dir_y", d.y());
+            ar & boost::serialization::make_nvp("dir_z", d.z());
+
+            updateDirection();
         }
+
+        BOOST_SERIALIZATION_SPLIT_MEMBER()
+    };
+
+    //------------------------------------------------------------------------------
+    // 3D hypothesis for a 2D segment (from its best match, in the
+    // local/translated frame -> float precision is sufficient)
+    class Hypothesis3D
+    {
+    public:
+        Hypothesis3D() : P1_(0,0,0), P2_(0,0,0),
+            camID_(0), segID_(0), depth_p1_(0.0f), depth_p2_(0.0f){}
+        Hypothesis3D(const L3DPP::Segment3D& seg3D, const L3DPP::Match& m) :
+            P1_(seg3D.P1().cast<float>()), P2_(seg3D.P2().cast<float>()),
+            camID_(m.src_camID_), segID_(m.src_segID_),
+            depth_p1_(m.depth_p1_), depth_p2_(m.depth_p2_){}
+
+        // data access
+        L3DPP::Segment3D seg3D() const {return L3DPP::Segment3D(P1_.cast<double>(),P2_.cast<double>());}
+        L3DPP::Segment2D seg2D() const {return L3DPP::Segment2D(camID_,segID_);}
+        unsigned int camID() const {return camID_;}
+        unsigned int segID() const {return segID_;}
+        float depth_p1() const {return depth_p1_;}
+        float depth_p2() const {return depth_p2_;}
+
+    private:
+        Eigen::Vector3f P1_;
+        Eigen::Vector3f P2_;
+        unsigned int camID_;
+        unsigned int segID_;
+        float depth_p1_;
+        float depth_p2_;
     };
 
     //------------------------------------------------------------------------------
@@ -122,14 +191,14 @@ namespace L3DPP
     public:
         LineCluster3D(){}
         LineCluster3D(const L3DPP::Segment3D& seg3D,
-                      const std::list<L3DPP::Segment2D>& residuals,
+                      const std::vector<L3DPP::Segment2D>& residuals,
                       const unsigned int ref_view) :
             seg3D_(seg3D), residuals_(residuals),
             reference_view_(ref_view){}
 
         // data access
-        L3DPP::Segment3D seg3D() const {return seg3D_;}
-        const std::list<L3DPP::Segment2D>* residuals() const {return &residuals_;}
+        const L3DPP::Segment3D& seg3D() const {return seg3D_;}
+        const std::vector<L3DPP::Segment2D>* residuals() const {return &residuals_;}
         size_t size() const {return residuals_.size();}
         unsigned int reference_view() const {return reference_view_;}
 
@@ -146,7 +215,7 @@ namespace L3DPP
 
     private:
         L3DPP::Segment3D seg3D_;
-        std::list<L3DPP::Segment2D> residuals_;
+        std::vector<L3DPP::Segment2D> residuals_;
         unsigned int reference_view_;
 
         // serialization
@@ -164,7 +233,7 @@ namespace L3DPP
     // final 3D line result, with collinear 3D segments
     struct FinalLine3D
     {
-        std::list<L3DPP::Segment3D> collinear3Dsegments_;
+        std::vector<L3DPP::Segment3D> collinear3Dsegments_;
         L3DPP::LineCluster3D underlyingCluster_;
 
         // serialization
@@ -1,149 +1,378 @@
 #include "sparsematrix.h"
 
-#ifdef L3DPP_CUDA
-
 namespace L3DPP
 {
     //------------------------------------------------------------------------------
-    SparseMatrix::SparseMatrix(std::list<L3DPP::CLEdge>& entries, const unsigned int num_rows_cols,
-                               const float normalization_factor,
-                               const bool sort_by_row, const bool already_sorted) :
-        num_rows_cols_(num_rows_cols), row_sorted_(sort_by_row)
+    SparseMatrix::SparseMatrix(const L3DPP::CLEdgeList& entries, const unsigned int num_rows_cols,
+                               const float normalization_factor) :
+        num_rows_cols_(num_rows_cols)
     {
         // init
-        entries_ = NULL;
-        start_indices_ = NULL;
+        row_offsets_ = NULL;
+        col_indices_ = NULL;
+        values_ = NULL;
+        col_offsets_ = NULL;
+        row_indices_ = NULL;
+        csc_entries_ = NULL;
         num_entries_ = entries.size();
 
         if(entries.size() == 0 || num_rows_cols == 0)
+        {
+            num_entries_ = 0;
             return;
+        }
+
+        // count entries per row
+        row_offsets_ = new L3DPP::DataArray<SparseOffset>(num_rows_cols_+1,1);
+        SparseOffset* offsets = row_offsets_->dataCPU(0,0);
+        for(unsigned int r=0; r<=num_rows_cols_; ++r)
+            offsets[r] = 0;
+
+        L3DPP::CLEdgeList::const_iterator it = entries.begin();
+        for(; it!=entries.end(); ++it)
+            ++offsets[(*it).i_+1];
 
-        // sort data
-        if(!already_sorted)
+        for(unsigned int r=0; r<num_rows_cols_; ++r)
+            offsets[r+1] += offsets[r];
+
+        // fill (bucket sort by row)
+        col_indices_ = new L3DPP::DataArray<SparseIndex>(num_entries_,1);
+        values_ = new L3DPP::DataArray<float>(num_entries_,1);
+        SparseIndex* cols = col_indices_->dataCPU(0,0);
+        float* vals = values_->dataCPU(0,0);
+
+        std::vector<SparseOffset> pos(offsets,offsets+num_rows_cols_);
+        for(it=entries.begin(); it!=entries.end(); ++it)
         {
-            if(sort_by_row)
-                entries.sort(L3DPP::sortCLEdgesByRow);
-            else
-                entries.sort(L3DPP::sortCLEdgesByCol);
+            SparseOffset p = pos[(*it).i_]++;
+            cols[p] = (*it).j_;
+            vals[p] = (*it).w_/normalization_factor;
         }
 
-        // copy data
-        entries_ = new L3DPP::DataArray<float4>(entries.size(),1);
-        start_indices_ = new L3DPP::DataArray<int>(num_rows_cols_,1);
-        start_indices_->setValue(-1);
-        std::list<CLEdge>::const_iterator it = entries.begin();
-        unsigned int pos = 0;
-        int current_rc = -1;
-        for(; it!=entries.end(); ++it,++pos)
+        // sort by column within the rows
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for schedule(dynamic,64)
+#endif //L3DPP_OPENMP
+        for(int r=0; r<num_rows_cols_; ++r)
         {
-            // store data
-            CLEdge data = *it;
-            data.w_ /= normalization_factor;
-            entries_->dataCPU(pos,0)[0] = make_float4(data.i_,data.j_,data.w_,0.0f);
-
-            // check for new row/column
-            int rc;
-            if(sort_by_row)
-                rc = (*it).i_;
-            else
-                rc = (*it).j_;
-
-            if(current_rc != rc)
+            SparseOffset start = offsets[r];
+            SparseOffset end = offsets[r+1];
+
+            bool sorted = true;
+            for(SparseOffset p=start+1; p<end && sorted; ++p)
+                sorted = (cols[p-1] < cols[p]);
+
+            if(sorted)
+                continue;
+
+            std::vector<std::pair<SparseIndex,float> > row(end-start);
+            for(SparseOffset p=start; p<end; ++p)
+                row[p-start] = std::pair<SparseIndex,float>(cols[p],vals[p]);
+
+            std::sort(row.begin(),row.end());
+
+            for(SparseOffset p=start; p<end; ++p)
             {
-                start_indices_->dataCPU(rc,0)[0] = pos;
-                current_rc = rc;
+                cols[p] = row[p-start].first;
+                vals[p] = row[p-start].second;
             }
         }
 
-        // copy to GPU
-        entries_->upload();
-        start_indices_->upload();
+        buildCSC();
     }
 
     //------------------------------------------------------------------------------
-    SparseMatrix::SparseMatrix(SparseMatrix* M, const bool change_sorting)
+    SparseMatrix::SparseMatrix(const SparseMatrix* M)
     {
         // init
-        entries_ = NULL;
-        start_indices_ = NULL;
+        row_offsets_ = NULL;
+        col_indices_ = NULL;
+        values_ = NULL;
+        col_offsets_ = NULL;
+        row_indices_ = NULL;
+        csc_entries_ = NULL;
         num_rows_cols_ = M->num_rows_cols();
         num_entries_ = M->num_entries();
 
-        if(M->num_entries() == 0 || M->num_rows_cols() == 0)
+        if(num_entries_ == 0 || num_rows_cols_ == 0)
             return;
 
-        if(!change_sorting)
-            row_sorted_ = M->isRowSorted();
-        else
-            row_sorted_ = !M->isRowSorted();
+        // copy data
+        row_offsets_ = new L3DPP::DataArray<SparseOffset>(num_rows_cols_+1,1);
+        col_indices_ = new L3DPP::DataArray<SparseIndex>(num_entries_,1);
+        values_ = new L3DPP::DataArray<float>(num_entries_,1);
+        col_offsets_ = new L3DPP::DataArray<SparseOffset>(num_rows_cols_+1,1);
+        row_indices_ = new L3DPP::DataArray<SparseIndex>(num_entries_,1);
+        csc_entries_ = new L3DPP::DataArray<SparseOffset>(num_entries_,1);
+
+        std::copy(M->row_offsets(),M->row_offsets()+num_rows_cols_+1,row_offsets_->dataCPU(0,0));
+        std::copy(M->col_indices(),M->col_indices()+num_entries_,col_indices_->dataCPU(0,0));
+        std::copy(M->values(),M->values()+num_entries_,values_->dataCPU(0,0));
+        std::copy(M->col_offsets(),M->col_offsets()+num_rows_cols_+1,col_offsets_->dataCPU(0,0));
+        std::copy(M->row_indices(),M->row_indices()+num_entries_,row_indices_->dataCPU(0,0));
+        std::copy(M->csc_entries(),M->csc_entries()+num_entries_,csc_entries_->dataCPU(0,0));
+    }
+
+    //------------------------------------------------------------------------------
+    SparseMatrix::~SparseMatrix()
+    {
+        // cleanup
+        if(row_offsets_ != NULL)
+            delete row_offsets_;
+
+        if(col_indices_ != NULL)
+            delete col_indices_;
+
+        if(values_ != NULL)
+            delete values_;
 
-        // copy entries
-        entries_ = new L3DPP::DataArray<float4>(num_entries_,1);
-        start_indices_ = new L3DPP::DataArray<int>(num_rows_cols_,1);
-        if(!change_sorting)
+        if(col_offsets_ != NULL)
+            delete col_offsets_;
+
+        if(row_indices_ != NULL)
+            delete row_indices_;
+
+        if(csc_entries_ != NULL)
+            delete csc_entries_;
+    }
+
+    //------------------------------------------------------------------------------
+    void SparseMatrix::buildCSC()
+    {
+        const SparseOffset* offsets = row_offsets_->dataCPU(0,0);
+        const SparseIndex* cols = col_indices_->dataCPU(0,0);
+
+        // count entries per column
+        col_offsets_ = new L3DPP::DataArray<SparseOffset>(num_rows_cols_+1,1);
+        SparseOffset* c_offsets = col_offsets_->dataCPU(0,0);
+        for(unsigned int c=0; c<=num_rows_cols_; ++c)
+            c_offsets[c] = 0;
+
+        for(SparseOffset p=0; p<num_entries_; ++p)
+            ++c_offsets[cols[p]+1];
+
+        for(unsigned int c=0; c<num_rows_cols_; ++c)
+            c_offsets[c+1] += c_offsets[c];
+
+        // fill (rows in increasing order -> sorted by row)
+        row_indices_ = new L3DPP::DataArray<SparseIndex>(num_entries_,1);
+        csc_entries_ = new L3DPP::DataArray<SparseOffset>(num_entries_,1);
+        SparseIndex* rows = row_indices_->dataCPU(0,0);
+        SparseOffset* entries = csc_entries_->dataCPU(0,0);
+
+        std::vector<SparseOffset> pos(c_offsets,c_offsets+num_rows_cols_);
+        for(unsigned int r=0; r<num_rows_cols_; ++r)
         {
-            // direct copy
-            M->entries()->copyTo(entries_);
-            M->start_indices()->copyTo(start_indices_);
+            for(SparseOffset p=offsets[r]; p<offsets[r+1]; ++p)
+            {
+                SparseOffset q = pos[cols[p]]++;
+                rows[q] = r;
+                entries[q] = p;
+            }
         }
-        else
+    }
+
+    //------------------------------------------------------------------------------
+    SparseOffset SparseMatrix::find(const SparseIndex r, const SparseIndex c) const
+    {
+        if(num_entries_ == 0 || r >= num_rows_cols_)
+            return num_entries_;
+
+        const SparseIndex* cols = col_indices();
+        const SparseIndex* begin = cols+row_offsets()[r];
+        const SparseIndex* end = cols+row_offsets()[r+1];
+        const SparseIndex* p = std::lower_bound(begin,end,c);
+
+        if(p == end || *p != c)
+            return num_entries_;
+
+        return SparseOffset(p-cols);
+    }
+
+    //------------------------------------------------------------------------------
+    void SparseMatrix::toEdges(L3DPP::CLEdgeList& edges) const
+    {
+        if(num_entries_ == 0)
+            return;
+
+        const SparseOffset* offsets = row_offsets();
+        const SparseIndex* cols = col_indices();
+        const float* vals = values();
+        for(unsigned int r=0; r<num_rows_cols_; ++r)
         {
-            // change sorting
-            std::list<CLEdge> entries;
-            for(unsigned int i=0; i<M->entries()->width(); ++i)
+            for(SparseOffset p=offsets[r]; p<offsets[r+1]; ++p)
             {
                 CLEdge e;
-                e.i_ = M->entries()->dataCPU(i,0)[0].x;
-                e.j_ = M->entries()->dataCPU(i,0)[0].y;
-                e.w_ = M->entries()->dataCPU(i,0)[0].z;
-                entries.push_back(e);
+                e.i_ = r;
+                e.j_ = cols[p];
+                e.w_ = vals[p];
+                edges.push_back(e);
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    unsigned int replicatorDynamicsDiffusion(const L3DPP::SparseMatrix* W,
+                                             const std::vector<int>& rows,
+                                             const std::vector<int>& row2pos,
+                                             float* result, const unsigned int max_iter,
+                                             const float tolerance, const float prune_t)
+    {
+        const size_t n = rows.size();
+        if(n == 0 || W->num_entries() == 0)
+            return 0;
+
+        const SparseOffset* w_offsets = W->row_offsets();
+        const SparseIndex* w_cols = W->col_indices();
+        const float* w_vals = W->values();
+        const SparseOffset* w_col_offsets = W->col_offsets();
+        const SparseIndex* w_rows = W->row_indices();
+        const SparseOffset* w_entries = W->csc_entries();
+
+        // P (rows of the component, same structure as W at first,
+        // pruned entries are removed from their row)
+        std::vector<size_t> offsets(n+1,0);
+        for(size_t k=0; k<n; ++k)
+            offsets[k+1] = offsets[k]+(w_offsets[rows[k]+1]-w_offsets[rows[k]]);
+
+        std::vector<SparseIndex> cols(offsets[n]);
+        std::vector<float> vals(offsets[n]);
+        std::vector<float> vals_new(offsets[n]);
+        std::vector<size_t> len(n);
+        std::vector<float> sums(n,1.0f);
+        for(size_t k=0; k<n; ++k)
+        {
+            SparseOffset start = w_offsets[rows[k]];
+            len[k] = offsets[k+1]-offsets[k];
+
+            // row normalize
+            float sum = 0.0f;
+            for(size_t e=0; e<len[k]; ++e)
+                sum += w_vals[start+e];
+
+            sum = fmax(sum,L3D_EPS);
+            for(size_t e=0; e<len[k]; ++e)
+            {
+                cols[offsets[k]+e] = w_cols[start+e];
+                vals[offsets[k]+e] = w_vals[start+e]/sum;
             }
+        }
 
-            if(row_sorted_)
-                entries.sort(L3DPP::sortCLEdgesByRow);
-            else
-                entries.sort(L3DPP::sortCLEdgesByCol);
+        unsigned int iter = 0;
+        while(iter < max_iter)
+        {
+            ++iter;
 
-            start_indices_->setValue(-1);
-            std::list<CLEdge>::const_iterator it = entries.begin();
-            unsigned int pos = 0;
-            int current_rc = -1;
-            for(; it!=entries.end(); ++it,++pos)
+            // P'(r,c) = P(c,r) * row[P]*col[W]
+            for(size_t k=0; k<n; ++k)
             {
-                // store data
-                CLEdge data = *it;
-                entries_->dataCPU(pos,0)[0] = make_float4(data.i_,data.j_,data.w_,0.0f);
-
-                // check for new row/column
-                int rc;
-                if(row_sorted_)
-                    rc = (*it).i_;
-                else
-                    rc = (*it).j_;
+                const size_t start = offsets[k];
+                const size_t end = offsets[k]+len[k];
+                for(size_t e=start; e<end; ++e)
+                {
+                    const SparseIndex c = cols[e];
+
+                    // merge over the common indices
+                    float mul = 0.0f;
+                    size_t i = start;
+                    SparseOffset j = w_col_offsets[c];
+                    const SparseOffset j_end = w_col_offsets[c+1];
+                    while(i < end && j < j_end)
+                    {
+                        if(cols[i] == w_rows[j])
+                        {
+                            mul += vals[i]*w_vals[w_entries[j]];
+                            ++i;
+                            ++j;
+                        }
+                        else if(cols[i] < w_rows[j])
+                        {
+                            ++i;
+                        }
+                        else
+                        {
+                            ++j;
+                        }
+                    }
 
-                if(current_rc != rc)
+                    // transposed entry (same component)
+                    const int kc = row2pos[c];
+                    const SparseIndex* c_begin = &cols[0]+offsets[kc];
+                    const SparseIndex* c_end = c_begin+len[kc];
+                    const SparseIndex* pos = std::lower_bound(c_begin,c_end,SparseIndex(rows[k]));
+                    if(pos != c_end && *pos == SparseIndex(rows[k]))
+                        mul *= vals[pos-&cols[0]];
+                    else
+                        mul = 0.0f;
+
+                    vals_new[e] = fmax(mul,L3D_EPS);
+                }
+            }
+
+            // row normalize, residual and pruning
+            float residual = 0.0f;
+            for(size_t k=0; k<n; ++k)
+            {
+                const size_t start = offsets[k];
+                const size_t end = offsets[k]+len[k];
+
+                float sum = 0.0f;
+                for(size_t e=start; e<end; ++e)
+                    sum += vals_new[e];
+
+                sums[k] = fmax(sum,L3D_EPS);
+
+                size_t kept = start;
+                for(size_t e=start; e<end; ++e)
                 {
-                    start_indices_->dataCPU(rc,0)[0] = pos;
-                    current_rc = rc;
+                    float v = vals_new[e]/sums[k];
+                    residual = fmax(residual,fabs(v-vals[e]));
+
+                    if(prune_t <= 0.0f || v >= prune_t)
+                    {
+                        cols[kept] = cols[e];
+                        vals[kept] = v;
+                        ++kept;
+                    }
                 }
+                len[k] = kept-start;
+            }
+
+            if(residual < tolerance)
+                break;
+        }
+
+        // result (the last iteration is not normalized, same as on the GPU)
+        for(size_t k=0; k<n; ++k)
+        {
+            const SparseIndex* begin = &cols[0]+offsets[k];
+            const SparseIndex* end = begin+len[k];
+            for(SparseOffset p=w_offsets[rows[k]]; p<w_offsets[rows[k]+1]; ++p)
+            {
+                const SparseIndex* pos = std::lower_bound(begin,end,w_cols[p]);
+                if(pos != end && *pos == w_cols[p])
+                    result[p] = vals[pos-&cols[0]]*sums[k];
+                else
+                    result[p] = 0.0f;
             }
         }
 
-        // copy to GPU
-        entries_->upload();
-        start_indices_->upload();
+        return iter;
     }
 
+#ifdef L3DPP_CUDA
     //------------------------------------------------------------------------------
-    SparseMatrix::~SparseMatrix()
+    void SparseMatrix::upload()
     {
-        // cleanup CPU
-        if(entries_ != NULL)
-            delete entries_;
+        if(num_entries_ == 0)
+            return;
 
-        if(start_indices_ != NULL)
-            delete start_indices_;
+        row_offsets_->upload();
+        col_indices_->upload();
+        values_->upload();
+        col_offsets_->upload();
+        row_indices_->upload();
+        csc_entries_->upload();
     }
-}
-
 #endif //L3DPP_CUDA
+}
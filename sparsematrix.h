@@ -1,7 +1,7 @@
 #ifndef I3D_LINE3D_PP_SPARSEMATRIX_H_
 #define I3D_LINE3D_PP_SPARSEMATRIX_H_
 
-/* 
+/*
  * Line3D++ - Line-based Multi View Stereo
  * Copyright (C) 2015  Manuel Hofer
 
@@ -10,74 +10,149 @@
  * file, You can obtain one at https://mozilla.org/MPL/2.0/.
  */
 
-// check for CUDA
+// check libs
 #include "configLIBS.h"
 
-#ifdef L3DPP_CUDA
+// std
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <stdint.h>
 
 // internal
+#include "commons.h"
 #include "clustering.h"
 #include "dataArray.h"
 
 /**
  * Line3D++ - Sparsematrix
  * ====================
- * Sparse GPU matrix.
+ * Sparse (square) CPU/GPU matrix in CSR
+ * format, with an additional CSC view
+ * (column -> positions in the CSR data).
+ * Indices are stored as integers (32-bit
+ * row/column indices, 64-bit offsets),
+ * the values as floats.
  * ====================
  * Author: M.Hofer, 2015
  */
 
 namespace L3DPP
 {
+    // row/column index and position of an entry
+    typedef uint32_t SparseIndex;
+    typedef uint64_t SparseOffset;
+
     class SparseMatrix
     {
     public:
-        SparseMatrix(std::list<L3DPP::CLEdge>& entries, const unsigned int num_rows_cols,
-                     const float normalization_factor=1.0f,
-                     const bool sort_by_row=false, const bool already_sorted=false);
-        SparseMatrix(SparseMatrix* M, const bool change_sorting=false);
+        // matrix from an edge list (i_ -> row, j_ -> column, no duplicates!),
+        // all values are divided by the normalization_factor
+        SparseMatrix(const L3DPP::CLEdgeList& entries, const unsigned int num_rows_cols,
+                     const float normalization_factor=1.0f);
+        // copy
+        SparseMatrix(const SparseMatrix* M);
         ~SparseMatrix();
 
-        // check element sorting
-        bool isRowSorted(){
-            return row_sorted_;
-        }
-        bool isColSorted(){
-            return !row_sorted_;
-        }
-
         // data access
-        unsigned int num_rows_cols(){
+        unsigned int num_rows_cols() const {
             return num_rows_cols_;
         }
-        unsigned int num_entries(){
+        SparseOffset num_entries() const {
             return num_entries_;
         }
 
+        // CSR (CPU, NULL if empty): row r -> entries row_offsets()[r] .. row_offsets()[r+1]-1 (sorted by column)
+        const SparseOffset* row_offsets() const {
+            return (row_offsets_ != NULL) ? row_offsets_->dataCPU(0,0) : NULL;
+        }
+        const SparseIndex* col_indices() const {
+            return (col_indices_ != NULL) ? col_indices_->dataCPU(0,0) : NULL;
+        }
+        float* values() const {
+            return (values_ != NULL) ? values_->dataCPU(0,0) : NULL;
+        }
+
+        // CSC view (CPU, NULL if empty): column c -> col_offsets()[c] .. col_offsets()[c+1]-1 (sorted by row),
+        // csc_entries() holds the positions of these entries in values()
+        const SparseOffset* col_offsets() const {
+            return (col_offsets_ != NULL) ? col_offsets_->dataCPU(0,0) : NULL;
+        }
+        const SparseIndex* row_indices() const {
+            return (row_indices_ != NULL) ? row_indices_->dataCPU(0,0) : NULL;
+        }
+        const SparseOffset* csc_entries() const {
+            return (csc_entries_ != NULL) ? csc_entries_->dataCPU(0,0) : NULL;
+        }
+
+        // position of entry (r,c) in values() (num_entries() if it does not exist)
+        SparseOffset find(const SparseIndex r, const SparseIndex c) const;
+
+        // all entries as an edge list
+        void toEdges(L3DPP::CLEdgeList& edges) const;
+
         // CPU/GPU data
-        L3DPP::DataArray<float4>* entries(){
-            return entries_;
+        L3DPP::DataArray<SparseOffset>* row_offsets_array(){
+            return row_offsets_;
+        }
+        L3DPP::DataArray<SparseIndex>* col_indices_array(){
+            return col_indices_;
+        }
+        L3DPP::DataArray<float>* values_array(){
+            return values_;
+        }
+        L3DPP::DataArray<SparseOffset>* col_offsets_array(){
+            return col_offsets_;
         }
-        L3DPP::DataArray<int>* start_indices(){
-            return start_indices_;
+        L3DPP::DataArray<SparseIndex>* row_indices_array(){
+            return row_indices_;
         }
+        L3DPP::DataArray<SparseOffset>* csc_entries_array(){
+            return csc_entries_;
+        }
+
+#ifdef L3DPP_CUDA
+        // copy everything to the GPU
+        void upload();
 
-        // download entries to CPU
+        // download values to CPU (the structure does not change)
         void download(){
-            entries_->download();
+            if(values_ != NULL)
+                values_->download();
         }
+#endif //L3DPP_CUDA
 
     private:
-        // CPU/GPU data
-        L3DPP::DataArray<float4>* entries_;
-        L3DPP::DataArray<int>* start_indices_;
+        // builds the CSC view from the CSR data
+        void buildCSC();
+
+        // CSR
+        L3DPP::DataArray<SparseOffset>* row_offsets_;
+        L3DPP::DataArray<SparseIndex>* col_indices_;
+        L3DPP::DataArray<float>* values_;
+
+        // CSC view
+        L3DPP::DataArray<SparseOffset>* col_offsets_;
+        L3DPP::DataArray<SparseIndex>* row_indices_;
+        L3DPP::DataArray<SparseOffset>* csc_entries_;
 
-        bool row_sorted_;
         unsigned int num_rows_cols_;
-        unsigned int num_entries_;
+        SparseOffset num_entries_;
     };
-}
 
-#endif //L3DPP_CUDA
+    // replicator dynamics diffusion (CPU) for one connected component of W
+    // -------------------------------------
+    // rows      - rows (=columns) of the component
+    // row2pos   - row -> position in 'rows' (for all rows of W)
+    // result    - diffused values for the entries of these rows (in the order of W->values())
+    // tolerance - stops when no (row-normalized) entry changes by more than this
+    // prune_t   - (row-normalized) entries below are removed for good (result = 0), 0 -> no pruning
+    // returns the number of iterations
+    unsigned int replicatorDynamicsDiffusion(const L3DPP::SparseMatrix* W,
+                                             const std::vector<int>& rows,
+                                             const std::vector<int>& row2pos,
+                                             float* result, const unsigned int max_iter,
+                                             const float tolerance, const float prune_t);
+}
 
 #endif //I3D_LINE3D_PP_SPARSEMATRIX_H_
@@ -0,0 +1,665 @@
+#include "spatialindex.h"
+
+// std
+#include <set>
+#include <limits>
+#include <functional>
+
+namespace L3DPP
+{
+    //------------------------------------------------------------------------------
+    SpatialFrustum::SpatialFrustum(const Eigen::Matrix3d& K, const Eigen::Matrix3d& R,
+                                   const Eigen::Vector3d& t, const unsigned int width,
+                                   const unsigned int height, const double near_depth,
+                                   const double far_depth)
+    {
+        Eigen::Matrix3d RtKinv = R.transpose()*K.inverse();
+        Eigen::Vector3d C = R.transpose()*(-1.0*t);
+        Eigen::Vector3d axis = R.row(2).transpose().normalized();
+
+        // rays through the image corners
+        Eigen::Vector3d corners[4];
+        corners[0] = RtKinv*Eigen::Vector3d(0,0,1);
+        corners[1] = RtKinv*Eigen::Vector3d(width,0,1);
+        corners[2] = RtKinv*Eigen::Vector3d(width,height,1);
+        corners[3] = RtKinv*Eigen::Vector3d(0,height,1);
+
+        // side planes (through the camera center)
+        for(size_t i=0; i<4; ++i)
+        {
+            Eigen::Vector3d n = corners[i].cross(corners[(i+1)%4]).normalized();
+            if(n.dot(axis) < 0.0)
+                n = -n;
+
+            normals_.push_back(n);
+            offsets_.push_back(-n.dot(C));
+        }
+
+        // near plane
+        normals_.push_back(axis);
+        offsets_.push_back(-axis.dot(C+axis*fmax(near_depth,0.0)));
+
+        // far plane
+        if(far_depth > 0.0)
+        {
+            normals_.push_back(-axis);
+            offsets_.push_back(axis.dot(C+axis*far_depth));
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    void SpatialIndex::build(const std::vector<L3DPP::FinalLine3D>& lines3D)
+    {
+        clear();
+
+        // count primitives
+        std::vector<unsigned int> offsets(lines3D.size()+1,0);
+        for(size_t i=0; i<lines3D.size(); ++i)
+            offsets[i+1] = offsets[i]+lines3D[i].collinear3Dsegments_.size();
+
+        unsigned int num = offsets[lines3D.size()];
+        if(num == 0)
+            return;
+
+        // primitives (input order)
+        P1_.resize(num);
+        P2_.resize(num);
+        lineID_.resize(num);
+        segmentID_.resize(num);
+        centroids_.resize(num);
+
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for
+#endif //L3DPP_OPENMP
+        for(int i=0; i<lines3D.size(); ++i)
+        {
+            for(size_t j=0; j<lines3D[i].collinear3Dsegments_.size(); ++j)
+            {
+                unsigned int pos = offsets[i]+j;
+                const L3DPP::Segment3D& seg3D = lines3D[i].collinear3Dsegments_[j];
+                P1_[pos] = seg3D.P1();
+                P2_[pos] = seg3D.P2();
+                lineID_[pos] = i;
+                segmentID_[pos] = j;
+                centroids_[pos] = 0.5*(P1_[pos]+P2_[pos]);
+            }
+        }
+
+        std::vector<unsigned int> order(num);
+        for(unsigned int i=0; i<num; ++i)
+            order[i] = i;
+
+        // upper levels (serial) -> independent subtrees
+        int num_threads = 1;
+#ifdef L3DPP_OPENMP
+        num_threads = omp_get_max_threads();
+#endif //L3DPP_OPENMP
+
+        std::vector<L3DPP::SpatialIndex::BuildTask> tasks;
+        unsigned int max_task_size = std::max(num/(4*num_threads),L3D_BVH_PARALLEL_MIN);
+        if(num_threads > 1 && num > max_task_size)
+            buildRecursive(0,num,nodes_,order,&tasks,max_task_size);
+        else
+            buildRecursive(0,num,nodes_,order,NULL,max_task_size);
+
+        // subtrees (parallel)
+        std::vector<std::vector<Node> > subtrees(tasks.size());
+        std::vector<unsigned int> roots(tasks.size());
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for schedule(dynamic)
+#endif //L3DPP_OPENMP
+        for(int i=0; i<tasks.size(); ++i)
+        {
+            roots[i] = buildRecursive(tasks[i].begin_,tasks[i].end_,subtrees[i],
+                                      order,NULL,max_task_size);
+        }
+
+        // link subtrees
+        for(size_t i=0; i<tasks.size(); ++i)
+        {
+            unsigned int offset = nodes_.size();
+            for(size_t j=0; j<subtrees[i].size(); ++j)
+            {
+                Node node = subtrees[i][j];
+                if(!node.leaf())
+                {
+                    node.left_ += offset;
+                    node.right_ += offset;
+                }
+                nodes_.push_back(node);
+            }
+
+            if(tasks[i].side_ == 0)
+                nodes_[tasks[i].parent_].left_ = roots[i]+offset;
+            else
+                nodes_[tasks[i].parent_].right_ = roots[i]+offset;
+        }
+
+        // primitives in tree order
+        std::vector<Eigen::Vector3d> P1(num);
+        std::vector<Eigen::Vector3d> P2(num);
+        std::vector<unsigned int> lineID(num);
+        std::vector<unsigned int> segmentID(num);
+
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for
+#endif //L3DPP_OPENMP
+        for(int i=0; i<num; ++i)
+        {
+            unsigned int src = order[i];
+            P1[i] = P1_[src];
+            P2[i] = P2_[src];
+            lineID[i] = lineID_[src];
+            segmentID[i] = segmentID_[src];
+        }
+
+        P1_.swap(P1);
+        P2_.swap(P2);
+        lineID_.swap(lineID);
+        segmentID_.swap(segmentID);
+
+        std::vector<Eigen::Vector3d>().swap(centroids_);
+    }
+
+    //------------------------------------------------------------------------------
+    void SpatialIndex::clear()
+    {
+        nodes_.clear();
+        P1_.clear();
+        P2_.clear();
+        lineID_.clear();
+        segmentID_.clear();
+        centroids_.clear();
+    }
+
+    //------------------------------------------------------------------------------
+    unsigned int SpatialIndex::buildRecursive(const unsigned int begin, const unsigned int end,
+                                              std::vector<Node>& nodes,
+                                              std::vector<unsigned int>& order,
+                                              std::vector<L3DPP::SpatialIndex::BuildTask>* tasks,
+                                              const unsigned int max_task_size) const
+    {
+        unsigned int id = nodes.size();
+        nodes.push_back(Node());
+
+        Node node;
+        boundPrimitives(begin,end,order,node);
+        node.left_ = 0;
+        node.right_ = 0;
+        node.first_ = begin;
+        node.count_ = 0;
+
+        if(end-begin <= L3D_BVH_LEAF_SIZE)
+        {
+            // leaf
+            node.count_ = end-begin;
+            nodes[id] = node;
+            return id;
+        }
+
+        // split at the median of the longest centroid axis
+        Eigen::Vector3d cmin = centroids_[order[begin]];
+        Eigen::Vector3d cmax = cmin;
+        for(unsigned int i=begin+1; i<end; ++i)
+        {
+            cmin = cmin.cwiseMin(centroids_[order[i]]);
+            cmax = cmax.cwiseMax(centroids_[order[i]]);
+        }
+
+        int axis;
+        (cmax-cmin).maxCoeff(&axis);
+
+        unsigned int mid = begin+(end-begin)/2;
+        std::vector<std::pair<double,unsigned int> > keys(end-begin);
+        for(unsigned int i=begin; i<end; ++i)
+            keys[i-begin] = std::pair<double,unsigned int>(centroids_[order[i]](axis),order[i]);
+
+        std::nth_element(keys.begin(),keys.begin()+(mid-begin),keys.end());
+        for(unsigned int i=begin; i<end; ++i)
+            order[i] = keys[i-begin].second;
+
+        nodes[id] = node;
+
+        // children
+        if(tasks != NULL && mid-begin <= max_task_size)
+        {
+            L3DPP::SpatialIndex::BuildTask task;
+            task.begin_ = begin; task.end_ = mid;
+            task.parent_ = id; task.side_ = 0;
+            tasks->push_back(task);
+        }
+        else
+        {
+            unsigned int left = buildRecursive(begin,mid,nodes,order,tasks,max_task_size);
+            nodes[id].left_ = left;
+        }
+
+        if(tasks != NULL && end-mid <= max_task_size)
+        {
+            L3DPP::SpatialIndex::BuildTask task;
+            task.begin_ = mid; task.end_ = end;
+            task.parent_ = id; task.side_ = 1;
+            tasks->push_back(task);
+        }
+        else
+        {
+            unsigned int right = buildRecursive(mid,end,nodes,order,tasks,max_task_size);
+            nodes[id].right_ = right;
+        }
+
+        return id;
+    }
+
+    //------------------------------------------------------------------------------
+    void SpatialIndex::boundPrimitives(const unsigned int begin, const unsigned int end,
+                                       const std::vector<unsigned int>& order,
+                                       Node& node) const
+    {
+        for(size_t d=0; d<3; ++d)
+        {
+            node.min_[d] = std::numeric_limits<double>::max();
+            node.max_[d] = -std::numeric_limits<double>::max();
+        }
+
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            const Eigen::Vector3d& P1 = P1_[order[i]];
+            const Eigen::Vector3d& P2 = P2_[order[i]];
+            for(size_t d=0; d<3; ++d)
+            {
+                node.min_[d] = fmin(node.min_[d],fmin(P1(d),P2(d)));
+                node.max_[d] = fmax(node.max_[d],fmax(P1(d),P2(d)));
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    void SpatialIndex::queryBox(const std::vector<L3DPP::SpatialBox>& boxes,
+                                std::vector<std::vector<L3DPP::SpatialHit> >& results) const
+    {
+        results = std::vector<std::vector<L3DPP::SpatialHit> >(boxes.size());
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for schedule(dynamic)
+#endif //L3DPP_OPENMP
+        for(int i=0; i<boxes.size(); ++i)
+        {
+            queryBox(boxes[i],results[i]);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    void SpatialIndex::queryNearest(const std::vector<Eigen::Vector3d>& points, const unsigned int k,
+                                    std::vector<std::vector<L3DPP::SpatialHit> >& results) const
+    {
+        results = std::vector<std::vector<L3DPP::SpatialHit> >(points.size());
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for schedule(dynamic)
+#endif //L3DPP_OPENMP
+        for(int i=0; i<points.size(); ++i)
+        {
+            queryNearest(points[i],k,results[i]);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    void SpatialIndex::queryFrustum(const std::vector<L3DPP::SpatialFrustum>& frusta,
+                                    std::vector<std::vector<L3DPP::SpatialHit> >& results) const
+    {
+        results = std::vector<std::vector<L3DPP::SpatialHit> >(frusta.size());
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for schedule(dynamic)
+#endif //L3DPP_OPENMP
+        for(int i=0; i<frusta.size(); ++i)
+        {
+            queryFrustum(frusta[i],results[i]);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    void SpatialIndex::queryRay(const std::vector<L3DPP::SpatialRay>& rays,
+                                std::vector<std::vector<L3DPP::SpatialHit> >& results) const
+    {
+        results = std::vector<std::vector<L3DPP::SpatialHit> >(rays.size());
+#ifdef L3DPP_OPENMP
+        #pragma omp parallel for schedule(dynamic)
+#endif //L3DPP_OPENMP
+        for(int i=0; i<rays.size(); ++i)
+        {
+            queryRay(rays[i],results[i]);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    void SpatialIndex::queryBox(const L3DPP::SpatialBox& box, std::vector<L3DPP::SpatialHit>& result) const
+    {
+        result.clear();
+        if(nodes_.empty())
+            return;
+
+        std::vector<unsigned int> stack;
+        stack.push_back(0);
+        while(!stack.empty())
+        {
+            const Node& node = nodes_[stack.back()];
+            stack.pop_back();
+
+            if(!overlaps(node,box))
+                continue;
+
+            if(node.leaf())
+            {
+                for(unsigned int i=node.first_; i<node.first_+node.count_; ++i)
+                {
+                    if(segmentInBox(P1_[i],P2_[i],box))
+                        result.push_back(L3DPP::SpatialHit(lineID_[i],segmentID_[i],0.0f));
+                }
+            }
+            else
+            {
+                stack.push_back(node.right_);
+                stack.push_back(node.left_);
+            }
+        }
+
+        std::sort(result.begin(),result.end(),L3DPP::sortSpatialHitsByID);
+    }
+
+    //------------------------------------------------------------------------------
+    void SpatialIndex::queryNearest(const Eigen::Vector3d& point, const unsigned int k,
+                                    std::vector<L3DPP::SpatialHit>& result) const
+    {
+        result.clear();
+        if(nodes_.empty() || k == 0)
+            return;
+
+        // best first traversal: nodes (>= 0) and primitives (< 0)
+        std::priority_queue<std::pair<double,int>,std::vector<std::pair<double,int> >,
+                std::greater<std::pair<double,int> > > queue;
+        queue.push(std::pair<double,int>(distanceToNode(nodes_[0],point),0));
+
+        std::set<unsigned int> found;
+        while(!queue.empty() && result.size() < k)
+        {
+            std::pair<double,int> current = queue.top();
+            queue.pop();
+
+            if(current.second < 0)
+            {
+                // closest segment of a line
+                unsigned int p = -(current.second+1);
+                if(found.find(lineID_[p]) == found.end())
+                {
+                    found.insert(lineID_[p]);
+                    result.push_back(L3DPP::SpatialHit(lineID_[p],segmentID_[p],current.first));
+                }
+                continue;
+            }
+
+            const Node& node = nodes_[current.second];
+            if(node.leaf())
+            {
+                for(unsigned int i=node.first_; i<node.first_+node.count_; ++i)
+                {
+                    if(found.find(lineID_[i]) == found.end())
+                        queue.push(std::pair<double,int>(distanceToSegment(P1_[i],P2_[i],point),-int(i)-1));
+                }
+            }
+            else
+            {
+                queue.push(std::pair<double,int>(distanceToNode(nodes_[node.left_],point),node.left_));
+                queue.push(std::pair<double,int>(distanceToNode(nodes_[node.right_],point),node.right_));
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    void SpatialIndex::queryFrustum(const L3DPP::SpatialFrustum& frustum,
+                                    std::vector<L3DPP::SpatialHit>& result) const
+    {
+        result.clear();
+        if(nodes_.empty())
+            return;
+
+        std::vector<unsigned int> stack;
+        stack.push_back(0);
+        while(!stack.empty())
+        {
+            const Node& node = nodes_[stack.back()];
+            stack.pop_back();
+
+            if(nodeOutsideFrustum(node,frustum))
+                continue;
+
+            if(node.leaf())
+            {
+                for(unsigned int i=node.first_; i<node.first_+node.count_; ++i)
+                {
+                    if(segmentInFrustum(P1_[i],P2_[i],frustum))
+                        result.push_back(L3DPP::SpatialHit(lineID_[i],segmentID_[i],0.0f));
+                }
+            }
+            else
+            {
+                stack.push_back(node.right_);
+                stack.push_back(node.left_);
+            }
+        }
+
+        std::sort(result.begin(),result.end(),L3DPP::sortSpatialHitsByID);
+    }
+
+    //------------------------------------------------------------------------------
+    void SpatialIndex::queryRay(const L3DPP::SpatialRay& ray, std::vector<L3DPP::SpatialHit>& result) const
+    {
+        result.clear();
+        if(nodes_.empty())
+            return;
+
+        std::vector<unsigned int> stack;
+        stack.push_back(0);
+        while(!stack.empty())
+        {
+            const Node& node = nodes_[stack.back()];
+            stack.pop_back();
+
+            if(!rayHitsNode(node,ray))
+                continue;
+
+            if(node.leaf())
+            {
+                for(unsigned int i=node.first_; i<node.first_+node.count_; ++i)
+                {
+                    double position;
+                    if(raySegment(P1_[i],P2_[i],ray,position))
+                        result.push_back(L3DPP::SpatialHit(lineID_[i],segmentID_[i],position));
+                }
+            }
+            else
+            {
+                stack.push_back(node.right_);
+                stack.push_back(node.left_);
+            }
+        }
+
+        std::sort(result.begin(),result.end(),L3DPP::sortSpatialHitsByDistance);
+    }
+
+    //------------------------------------------------------------------------------
+    bool SpatialIndex::overlaps(const Node& node, const L3DPP::SpatialBox& box)
+    {
+        for(size_t d=0; d<3; ++d)
+        {
+            if(node.max_[d] < box.min_(d) || node.min_[d] > box.max_(d))
+                return false;
+        }
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+    bool SpatialIndex::segmentInBox(const Eigen::Vector3d& P1, const Eigen::Vector3d& P2,
+                                    const L3DPP::SpatialBox& box)
+    {
+        // clip [0,1] against the slabs
+        Eigen::Vector3d dir = P2-P1;
+        double t_min = 0.0;
+        double t_max = 1.0;
+        for(size_t d=0; d<3; ++d)
+        {
+            if(fabs(dir(d)) < L3D_EPS)
+            {
+                if(P1(d) < box.min_(d) || P1(d) > box.max_(d))
+                    return false;
+            }
+            else
+            {
+                double t1 = (box.min_(d)-P1(d))/dir(d);
+                double t2 = (box.max_(d)-P1(d))/dir(d);
+                t_min = fmax(t_min,fmin(t1,t2));
+                t_max = fmin(t_max,fmax(t1,t2));
+                if(t_min > t_max)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+    double SpatialIndex::distanceToNode(const Node& node, const Eigen::Vector3d& p)
+    {
+        double dist = 0.0;
+        for(size_t d=0; d<3; ++d)
+        {
+            double delta = fmax(fmax(node.min_[d]-p(d),p(d)-node.max_[d]),0.0);
+            dist += delta*delta;
+        }
+        return sqrt(dist);
+    }
+
+    //------------------------------------------------------------------------------
+    double SpatialIndex::distanceToSegment(const Eigen::Vector3d& P1, const Eigen::Vector3d& P2,
+                                           const Eigen::Vector3d& p)
+    {
+        Eigen::Vector3d dir = P2-P1;
+        double len_sqr = dir.squaredNorm();
+        double t = 0.0;
+        if(len_sqr > L3D_EPS)
+            t = fmin(fmax((p-P1).dot(dir)/len_sqr,0.0),1.0);
+
+        return (P1+t*dir-p).norm();
+    }
+
+    //------------------------------------------------------------------------------
+    bool SpatialIndex::nodeOutsideFrustum(const Node& node, const L3DPP::SpatialFrustum& frustum)
+    {
+        for(size_t i=0; i<frustum.normals_.size(); ++i)
+        {
+            // box corner farthest along the normal
+            const Eigen::Vector3d& n = frustum.normals_[i];
+            Eigen::Vector3d corner;
+            for(size_t d=0; d<3; ++d)
+                corner(d) = (n(d) >= 0.0) ? node.max_[d] : node.min_[d];
+
+            if(n.dot(corner)+frustum.offsets_[i] < 0.0)
+                return true;
+        }
+        return false;
+    }
+
+    //------------------------------------------------------------------------------
+    bool SpatialIndex::segmentInFrustum(const Eigen::Vector3d& P1, const Eigen::Vector3d& P2,
+                                        const L3DPP::SpatialFrustum& frustum)
+    {
+        // clip [0,1] against all planes
+        double t_min = 0.0;
+        double t_max = 1.0;
+        for(size_t i=0; i<frustum.normals_.size(); ++i)
+        {
+            double f1 = frustum.normals_[i].dot(P1)+frustum.offsets_[i];
+            double f2 = frustum.normals_[i].dot(P2)+frustum.offsets_[i];
+
+            if(f1 < 0.0 && f2 < 0.0)
+                return false;
+
+            if(f1 < 0.0)
+                t_min = fmax(t_min,f1/(f1-f2));
+            else if(f2 < 0.0)
+                t_max = fmin(t_max,f1/(f1-f2));
+
+            if(t_min > t_max)
+                return false;
+        }
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+    bool SpatialIndex::rayHitsNode(const Node& node, const L3DPP::SpatialRay& ray)
+    {
+        // slabs of the box (enlarged by the radius)
+        double t_min = 0.0;
+        double t_max = std::numeric_limits<double>::max();
+        for(size_t d=0; d<3; ++d)
+        {
+            double b_min = node.min_[d]-ray.radius_;
+            double b_max = node.max_[d]+ray.radius_;
+            if(fabs(ray.direction_(d)) < L3D_EPS)
+            {
+                if(ray.origin_(d) < b_min || ray.origin_(d) > b_max)
+                    return false;
+            }
+            else
+            {
+                double t1 = (b_min-ray.origin_(d))/ray.direction_(d);
+                double t2 = (b_max-ray.origin_(d))/ray.direction_(d);
+                t_min = fmax(t_min,fmin(t1,t2));
+                t_max = fmin(t_max,fmax(t1,t2));
+                if(t_min > t_max)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+    bool SpatialIndex::raySegment(const Eigen::Vector3d& P1, const Eigen::Vector3d& P2,
+                                  const L3DPP::SpatialRay& ray, double& position)
+    {
+        // closest points between ray (s >= 0) and segment (t in [0,1])
+        Eigen::Vector3d d2 = P2-P1;
+        Eigen::Vector3d r = ray.origin_-P1;
+        double b = ray.direction_.dot(d2);
+        double c = ray.direction_.dot(r);
+        double e = d2.squaredNorm();
+        double f = d2.dot(r);
+
+        double s = 0.0;
+        double t = 0.0;
+        if(e < L3D_EPS)
+        {
+            // degenerate segment
+            s = fmax(-c,0.0);
+        }
+        else
+        {
+            double denom = e-b*b;
+            if(denom > L3D_EPS)
+                s = fmax((b*f-c*e)/denom,0.0);
+
+            t = (b*s+f)/e;
+            if(t < 0.0)
+            {
+                t = 0.0;
+                s = fmax(-c,0.0);
+            }
+            else if(t > 1.0)
+            {
+                t = 1.0;
+                s = fmax(b-c,0.0);
+            }
+        }
+
+        Eigen::Vector3d Pr = ray.origin_+s*ray.direction_;
+        Eigen::Vector3d Ps = P1+t*d2;
+        position = s;
+        return ((Pr-Ps).norm() <= ray.radius_);
+    }
+}
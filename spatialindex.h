@@ -0,0 +1,224 @@
+#ifndef I3D_LINE3D_PP_SPATIALINDEX_H_
+#define I3D_LINE3D_PP_SPATIALINDEX_H_
+
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <vector>
+#include <queue>
+#include <iostream>
+#include <algorithm>
+
+// external
+#include "eigen3/Eigen/Eigen"
+
+#ifdef L3DPP_OPENMP
+#include <omp.h>
+#endif //L3DPP_OPENMP
+
+// internal
+#include "segment3D.h"
+
+/**
+ * Line3D++ - SpatialIndex
+ * ====================
+ * Immutable bounding volume hierarchy
+ * over the collinear 3D segments of the
+ * final 3D lines. Supports (batched)
+ * box, k-nearest neighbor, frustum
+ * and ray queries.
+ * ====================
+ */
+
+namespace L3DPP
+{
+    // index parameters
+    const unsigned int L3D_BVH_LEAF_SIZE = 4;
+    const unsigned int L3D_BVH_PARALLEL_MIN = 4096;
+
+    //------------------------------------------------------------------------------
+    // query result (IDs refer to the indexed std::vector<FinalLine3D>)
+    struct SpatialHit
+    {
+        SpatialHit() : lineID_(0), segmentID_(0), distance_(0.0f){}
+        SpatialHit(const unsigned int lineID, const unsigned int segmentID,
+                   const float distance) :
+            lineID_(lineID), segmentID_(segmentID), distance_(distance){}
+
+        // index of the 3D line
+        unsigned int lineID_;
+        // index in FinalLine3D::collinear3Dsegments_
+        unsigned int segmentID_;
+        // kNN: distance to the point, ray: position along the ray (0 otherwise)
+        float distance_;
+    };
+
+    // sorting functions for query results
+    static bool sortSpatialHitsByID(const L3DPP::SpatialHit& h1, const L3DPP::SpatialHit& h2)
+    {
+        return ((h1.lineID_ < h2.lineID_) || (h1.lineID_ == h2.lineID_ && h1.segmentID_ < h2.segmentID_));
+    }
+
+    static bool sortSpatialHitsByDistance(const L3DPP::SpatialHit& h1, const L3DPP::SpatialHit& h2)
+    {
+        return (h1.distance_ < h2.distance_);
+    }
+
+    //------------------------------------------------------------------------------
+    // axis aligned box
+    struct SpatialBox
+    {
+        SpatialBox() : min_(Eigen::Vector3d::Zero()), max_(Eigen::Vector3d::Zero()){}
+        SpatialBox(const Eigen::Vector3d& min, const Eigen::Vector3d& max) :
+            min_(min), max_(max){}
+
+        Eigen::Vector3d min_;
+        Eigen::Vector3d max_;
+    };
+
+    //------------------------------------------------------------------------------
+    // view frustum (camera model: point2D = K [R | t] point3D)
+    struct SpatialFrustum
+    {
+        SpatialFrustum(){}
+        SpatialFrustum(const Eigen::Matrix3d& K, const Eigen::Matrix3d& R,
+                       const Eigen::Vector3d& t, const unsigned int width,
+                       const unsigned int height, const double near_depth,
+                       const double far_depth=-1.0);
+
+        // inward facing planes (normal.dot(X) + offset >= 0 -> inside),
+        // four sides, near and (optional) far plane
+        std::vector<Eigen::Vector3d> normals_;
+        std::vector<double> offsets_;
+    };
+
+    //------------------------------------------------------------------------------
+    // ray with a radius (segments closer than 'radius' are hit)
+    struct SpatialRay
+    {
+        SpatialRay() : origin_(Eigen::Vector3d::Zero()), direction_(Eigen::Vector3d::UnitZ()),
+            radius_(0.0){}
+        SpatialRay(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction,
+                   const double radius) :
+            origin_(origin), direction_(direction.normalized()), radius_(radius){}
+
+        Eigen::Vector3d origin_;
+        Eigen::Vector3d direction_;
+        double radius_;
+    };
+
+    //------------------------------------------------------------------------------
+    class SpatialIndex
+    {
+    public:
+        SpatialIndex(){}
+
+        // builds the hierarchy (replaces the previous one)
+        void build(const std::vector<L3DPP::FinalLine3D>& lines3D);
+        void clear();
+
+        // batched queries [thread-safe, kNN/ray results are sorted by distance_,
+        // box/frustum results by lineID_ and segmentID_]
+        // segments intersecting the box
+        void queryBox(const std::vector<L3DPP::SpatialBox>& boxes,
+                      std::vector<std::vector<L3DPP::SpatialHit> >& results) const;
+        // the k nearest 3D lines (closest segment per line)
+        void queryNearest(const std::vector<Eigen::Vector3d>& points, const unsigned int k,
+                          std::vector<std::vector<L3DPP::SpatialHit> >& results) const;
+        // segments (partially) inside the frustum
+        void queryFrustum(const std::vector<L3DPP::SpatialFrustum>& frusta,
+                          std::vector<std::vector<L3DPP::SpatialHit> >& results) const;
+        // segments within the radius of the ray
+        void queryRay(const std::vector<L3DPP::SpatialRay>& rays,
+                      std::vector<std::vector<L3DPP::SpatialHit> >& results) const;
+
+        // single queries
+        void queryBox(const L3DPP::SpatialBox& box, std::vector<L3DPP::SpatialHit>& result) const;
+        void queryNearest(const Eigen::Vector3d& point, const unsigned int k,
+                          std::vector<L3DPP::SpatialHit>& result) const;
+        void queryFrustum(const L3DPP::SpatialFrustum& frustum,
+                          std::vector<L3DPP::SpatialHit>& result) const;
+        void queryRay(const L3DPP::SpatialRay& ray, std::vector<L3DPP::SpatialHit>& result) const;
+
+        // data access
+        size_t num_segments() const {return P1_.size();}
+        size_t num_nodes() const {return nodes_.size();}
+        bool empty() const {return nodes_.empty();}
+
+    private:
+        // tree node (leaf: primitives [first_,first_+count_),
+        // inner node: children left_ and right_)
+        struct Node
+        {
+            double min_[3];
+            double max_[3];
+            unsigned int left_;
+            unsigned int right_;
+            unsigned int first_;
+            unsigned int count_;
+
+            bool leaf() const {return (count_ > 0);}
+        };
+
+        // subtree that is built by one thread
+        struct BuildTask
+        {
+            unsigned int begin_;
+            unsigned int end_;
+            // parent node and side (0 -> left, 1 -> right)
+            int parent_;
+            int side_;
+        };
+
+        // recursive median split on [begin,end) into 'nodes',
+        // returns the (local) index of the subtree root
+        unsigned int buildRecursive(const unsigned int begin, const unsigned int end,
+                                    std::vector<Node>& nodes,
+                                    std::vector<unsigned int>& order,
+                                    std::vector<L3DPP::SpatialIndex::BuildTask>* tasks,
+                                    const unsigned int max_task_size) const;
+
+        // bounding box of primitives
+        void boundPrimitives(const unsigned int begin, const unsigned int end,
+                             const std::vector<unsigned int>& order,
+                             Node& node) const;
+
+        // box/segment helpers
+        static bool overlaps(const Node& node, const L3DPP::SpatialBox& box);
+        static bool segmentInBox(const Eigen::Vector3d& P1, const Eigen::Vector3d& P2,
+                                 const L3DPP::SpatialBox& box);
+        static double distanceToNode(const Node& node, const Eigen::Vector3d& p);
+        static double distanceToSegment(const Eigen::Vector3d& P1, const Eigen::Vector3d& P2,
+                                        const Eigen::Vector3d& p);
+        static bool nodeOutsideFrustum(const Node& node, const L3DPP::SpatialFrustum& frustum);
+        static bool segmentInFrustum(const Eigen::Vector3d& P1, const Eigen::Vector3d& P2,
+                                     const L3DPP::SpatialFrustum& frustum);
+        static bool rayHitsNode(const Node& node, const L3DPP::SpatialRay& ray);
+        static bool raySegment(const Eigen::Vector3d& P1, const Eigen::Vector3d& P2,
+                               const L3DPP::SpatialRay& ray, double& position);
+
+        // hierarchy
+        std::vector<Node> nodes_;
+
+        // primitives (in tree order)
+        std::vector<Eigen::Vector3d> P1_;
+        std::vector<Eigen::Vector3d> P2_;
+        std::vector<unsigned int> lineID_;
+        std::vector<unsigned int> segmentID_;
+
+        // centroids (only during construction)
+        std::vector<Eigen::Vector3d> centroids_;
+    };
+}
+
+#endif //I3D_LINE3D_PP_SPATIALINDEX_H_
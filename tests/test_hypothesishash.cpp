@@ -0,0 +1,203 @@
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <vector>
+#include <set>
+
+// internal
+#include "testcommons.h"
+#include "hypothesishash.h"
+
+//------------------------------------------------------------------------------
+float randomDepth()
+{
+    return -5.0f+55.0f*L3DPP::testRandom();
+}
+
+//------------------------------------------------------------------------------
+// queries vs. a linear scan: every hypothesis in the query box is returned,
+// everything returned lies within one cell of it
+void testQueries(const float cell_size)
+{
+    std::vector<float> depths_p1,depths_p2;
+    for(unsigned int i=0; i<3000; ++i)
+    {
+        depths_p1.push_back(randomDepth());
+
+        // clustered second depths (many hypotheses per cell)
+        if(i%3 == 0)
+            depths_p2.push_back(depths_p1.back()+0.1f*L3DPP::testRandom());
+        else
+            depths_p2.push_back(randomDepth());
+    }
+
+    L3DPP::HypothesisHash hash;
+    hash.build(depths_p1,depths_p2,cell_size);
+    L3DPP_CHECK(hash.size() == depths_p1.size());
+    L3DPP_CHECK(hash.cell_size() == cell_size);
+
+    size_t num_found = 0;
+    for(unsigned int q=0; q<500; ++q)
+    {
+        // also queries outside of the occupied cells
+        float d1 = 1.2f*randomDepth();
+        float d2 = 1.2f*randomDepth();
+        if(q%4 == 0)
+        {
+            // around an existing hypothesis
+            unsigned int id = (unsigned int)(L3DPP::testRandom()*(depths_p1.size()-1));
+            d1 = depths_p1[id];
+            d2 = depths_p2[id];
+        }
+        float r1 = 3.0f*L3DPP::testRandom();
+        float r2 = 3.0f*L3DPP::testRandom();
+
+        std::vector<unsigned int> result;
+        hash.query(d1,d2,r1,r2,result);
+        num_found += result.size();
+
+        std::set<unsigned int> found(result.begin(),result.end());
+        L3DPP_CHECK(found.size() == result.size());
+        for(size_t i=1; i<result.size(); ++i)
+        {
+            L3DPP_CHECK(result[i-1] < result[i]);
+        }
+
+        for(unsigned int i=0; i<depths_p1.size(); ++i)
+        {
+            bool inside = (fabs(depths_p1[i]-d1) <= r1 && fabs(depths_p2[i]-d2) <= r2);
+            bool near = (fabs(depths_p1[i]-d1) <= r1+cell_size && fabs(depths_p2[i]-d2) <= r2+cell_size);
+            bool hit = (found.find(i) != found.end());
+
+            if(inside)
+            {
+                L3DPP_CHECK(hit);
+            }
+            if(hit)
+            {
+                L3DPP_CHECK(near);
+            }
+        }
+    }
+    L3DPP_CHECK(num_found > 0);
+
+    // clear
+    std::vector<unsigned int> result;
+    hash.clear();
+    L3DPP_CHECK(hash.size() == 0);
+    hash.query(depths_p1[0],depths_p2[0],1.0f,1.0f,result);
+    L3DPP_CHECK(result.empty());
+}
+
+//------------------------------------------------------------------------------
+// undirected angle difference (degrees)
+float angleDiff(const float a1, const float a2)
+{
+    float d = fabs(a1-a2);
+    return fmin(d,180.0f-d);
+}
+
+//------------------------------------------------------------------------------
+// queries with direction vs. a linear scan (incl. the wraparound at 0/180 degrees)
+void testAngleQueries(const float cell_size, const float angle_cell_size)
+{
+    std::vector<float> depths_p1,depths_p2,angles;
+    for(unsigned int i=0; i<3000; ++i)
+    {
+        depths_p1.push_back(randomDepth());
+        depths_p2.push_back(depths_p1.back()+2.0f*L3DPP::testRandom());
+
+        // some directions close to 0/180 degrees
+        float angle = 180.0f*L3DPP::testRandom();
+        if(i%5 == 0)
+            angle = (L3DPP::testRandom() > 0.5f) ? 0.5f*L3DPP::testRandom() : 179.5f+0.5f*L3DPP::testRandom();
+        angles.push_back(fmin(angle,179.99f));
+    }
+
+    L3DPP::HypothesisHash hash;
+    hash.build(depths_p1,depths_p2,angles,cell_size,angle_cell_size);
+    L3DPP_CHECK(hash.size() == depths_p1.size());
+    L3DPP_CHECK(hash.num_angle_cells() == (unsigned int)(180.0f/angle_cell_size));
+
+    size_t num_found = 0;
+    size_t num_found_depths = 0;
+    for(unsigned int q=0; q<500; ++q)
+    {
+        unsigned int id = (unsigned int)(L3DPP::testRandom()*(depths_p1.size()-1));
+        float d1 = depths_p1[id];
+        float d2 = depths_p2[id];
+        float angle = angles[id];
+        float r1 = 3.0f*L3DPP::testRandom();
+        float r2 = 3.0f*L3DPP::testRandom();
+        float r_angle = angle_cell_size*L3DPP::testRandom();
+
+        std::vector<unsigned int> result,result_depths;
+        hash.query(d1,d2,r1,r2,angle,r_angle,result);
+        hash.query(d1,d2,r1,r2,result_depths);
+        num_found += result.size();
+        num_found_depths += result_depths.size();
+
+        std::set<unsigned int> found(result.begin(),result.end());
+        for(size_t i=1; i<result.size(); ++i)
+        {
+            L3DPP_CHECK(result[i-1] < result[i]);
+        }
+
+        for(unsigned int i=0; i<depths_p1.size(); ++i)
+        {
+            bool inside = (fabs(depths_p1[i]-d1) <= r1 && fabs(depths_p2[i]-d2) <= r2 &&
+                           angleDiff(angles[i],angle) <= r_angle);
+            bool near = (fabs(depths_p1[i]-d1) <= r1+cell_size && fabs(depths_p2[i]-d2) <= r2+cell_size &&
+                         angleDiff(angles[i],angle) <= r_angle+180.0f/hash.num_angle_cells());
+            bool hit = (found.find(i) != found.end());
+
+            if(inside)
+            {
+                L3DPP_CHECK(hit);
+            }
+            if(hit)
+            {
+                L3DPP_CHECK(near);
+            }
+        }
+    }
+
+    // the direction prunes candidates
+    L3DPP_CHECK(num_found > 0);
+    L3DPP_CHECK(num_found < num_found_depths);
+
+    // no angular cells -> depths only
+    std::vector<float> no_angles;
+    hash.build(depths_p1,depths_p2,no_angles,cell_size,angle_cell_size);
+    L3DPP_CHECK(hash.num_angle_cells() == 1);
+}
+
+//------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    testQueries(1.0f);
+    testQueries(0.25f);
+    testQueries(7.5f);
+    testAngleQueries(1.0f,12.0f);
+    testAngleQueries(0.5f,30.0f);
+
+    // no hypotheses
+    L3DPP::HypothesisHash hash;
+    std::vector<float> empty;
+    std::vector<unsigned int> result(1,0);
+    hash.build(empty,empty,1.0f);
+    hash.query(0.0f,0.0f,10.0f,10.0f,result);
+    L3DPP_CHECK(result.empty());
+
+    return L3DPP::testResult("hypothesishash");
+}
@@ -0,0 +1,189 @@
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <vector>
+#include <list>
+#include <string>
+
+// external
+#include "boost/filesystem.hpp"
+
+// internal
+#include "testcommons.h"
+#include "line3D.h"
+
+/**
+ * Reconstruction of a synthetic scene (given 2D segments, far away
+ * from the origin): the model must be in the original coordinates
+ * and reconstructing twice must give the same model.
+ *
+ * usage: test_line3d <output folder>
+ */
+
+#define TEST_WIDTH 1024
+#define TEST_HEIGHT 768
+#define TEST_FOCAL 800.0
+#define TEST_NUM_CAMS 12
+#define TEST_NUM_LINES 60
+#define TEST_SCENE_SIZE 8.0
+#define TEST_CAM_DIST 25.0
+
+typedef std::vector<std::pair<Eigen::Vector3d,Eigen::Vector3d> > SegmentList;
+
+//------------------------------------------------------------------------------
+Eigen::Vector3d randomPoint(const double range)
+{
+    return Eigen::Vector3d((2.0*L3DPP::testRandom()-1.0)*range,
+                           (2.0*L3DPP::testRandom()-1.0)*range,
+                           (2.0*L3DPP::testRandom()-1.0)*range);
+}
+
+//------------------------------------------------------------------------------
+double distancePointLine(const Eigen::Vector3d& P, const Eigen::Vector3d& Q1,
+                         const Eigen::Vector3d& Q2)
+{
+    Eigen::Vector3d d = (Q2-Q1).normalized();
+    return (Q1+d*d.dot(P-Q1)-P).norm();
+}
+
+//------------------------------------------------------------------------------
+// random 3D segments around 'center', seen by cameras on a circle around it
+void addViews(L3DPP::Line3D* line3D, const Eigen::Vector3d& center,
+              const SegmentList& lines)
+{
+    Eigen::Matrix3d K = Eigen::Matrix3d::Identity();
+    K(0,0) = TEST_FOCAL;
+    K(1,1) = TEST_FOCAL;
+    K(0,2) = 0.5*TEST_WIDTH;
+    K(1,2) = 0.5*TEST_HEIGHT;
+
+    cv::Mat image(TEST_HEIGHT,TEST_WIDTH,CV_8U);
+
+    for(unsigned int c=0; c<TEST_NUM_CAMS; ++c)
+    {
+        // camera looking at the center
+        double phi = 2.0*M_PI*double(c)/double(TEST_NUM_CAMS);
+        Eigen::Vector3d C = center+TEST_CAM_DIST*Eigen::Vector3d(cos(phi),sin(phi),0.3);
+        Eigen::Vector3d z = (center-C).normalized();
+        Eigen::Vector3d x = z.cross(Eigen::Vector3d::UnitZ()).normalized();
+        Eigen::Vector3d y = z.cross(x);
+
+        Eigen::Matrix3d R;
+        R.row(0) = x.transpose();
+        R.row(1) = y.transpose();
+        R.row(2) = z.transpose();
+        Eigen::Vector3d t = -R*C;
+
+        std::vector<cv::Vec4f> segments;
+        for(size_t i=0; i<lines.size(); ++i)
+        {
+            Eigen::Vector3d p1 = K*(R*lines[i].first+t);
+            Eigen::Vector3d p2 = K*(R*lines[i].second+t);
+            segments.push_back(cv::Vec4f(p1.x()/p1.z(),p1.y()/p1.z(),
+                                         p2.x()/p2.z(),p2.y()/p2.z()));
+        }
+
+        std::list<unsigned int> neighbors;
+        for(unsigned int n=0; n<TEST_NUM_CAMS; ++n)
+        {
+            if(n != c)
+                neighbors.push_back(n);
+        }
+
+        line3D->addImage(c,image,K,R,t,TEST_CAM_DIST,neighbors,segments);
+    }
+}
+
+//------------------------------------------------------------------------------
+// collinear segments of the current snapshot
+void snapshotSegments(L3DPP::Line3D* line3D, SegmentList& segments)
+{
+    segments.clear();
+
+    const L3DPP::ResultSnapshot* snapshot = line3D->acquireResultSnapshot();
+    L3DPP_CHECK(snapshot != NULL);
+    if(snapshot == NULL)
+        return;
+
+    for(size_t i=0; i<snapshot->lines3D().size(); ++i)
+    {
+        const std::vector<L3DPP::Segment3D>& coll = snapshot->lines3D()[i].collinear3Dsegments_;
+        for(size_t j=0; j<coll.size(); ++j)
+            segments.push_back(std::pair<Eigen::Vector3d,Eigen::Vector3d>(coll[j].P1(),coll[j].P2()));
+    }
+
+    snapshot->release();
+}
+
+//------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    if(argc < 2)
+    {
+        std::cout << "usage: test_line3d <output folder>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string output = argv[1];
+    boost::filesystem::create_directories(output);
+
+    // scene far away from the origin (translated internally)
+    Eigen::Vector3d center(2e4,-3e4,1e3);
+    SegmentList lines;
+    for(unsigned int i=0; i<TEST_NUM_LINES; ++i)
+    {
+        Eigen::Vector3d P = center+randomPoint(0.5*TEST_SCENE_SIZE);
+        Eigen::Vector3d d = randomPoint(1.0).normalized();
+        lines.push_back(std::pair<Eigen::Vector3d,Eigen::Vector3d>(P,P+(1.0+2.0*L3DPP::testRandom())*d));
+    }
+
+    L3DPP::Line3D* line3D = new L3DPP::Line3D(output,false,-1,L3D_DEF_MAX_NUM_SEGMENTS,false,false);
+    addViews(line3D,center,lines);
+    line3D->matchImages(L3D_DEF_SCORING_POS_REGULARIZER,L3D_DEF_SCORING_ANG_REGULARIZER,
+                        TEST_NUM_CAMS-1);
+
+    // reconstruct twice
+    SegmentList first,second;
+    line3D->reconstruct3Dlines();
+    snapshotSegments(line3D,first);
+    line3D->reconstruct3Dlines();
+    snapshotSegments(line3D,second);
+
+    std::cout << "#segments: " << first.size() << " / " << second.size() << std::endl;
+    L3DPP_CHECK(first.size() > TEST_NUM_LINES/2);
+    L3DPP_CHECK(first.size() == second.size());
+
+    // identical endpoints
+    for(size_t i=0; i<first.size() && i<second.size(); ++i)
+    {
+        L3DPP_CHECK((first[i].first-second[i].first).norm() < 1e-6);
+        L3DPP_CHECK((first[i].second-second[i].second).norm() < 1e-6);
+    }
+
+    // in the original coordinates (on one of the ground truth lines)
+    for(size_t i=0; i<first.size(); ++i)
+    {
+        double min_dist = std::numeric_limits<double>::max();
+        for(size_t j=0; j<lines.size(); ++j)
+        {
+            double dist = fmax(distancePointLine(first[i].first,lines[j].first,lines[j].second),
+                               distancePointLine(first[i].second,lines[j].first,lines[j].second));
+            min_dist = fmin(min_dist,dist);
+        }
+        L3DPP_CHECK(min_dist < 0.01*TEST_SCENE_SIZE);
+    }
+
+    delete line3D;
+
+    return L3DPP::testResult("line3d");
+}
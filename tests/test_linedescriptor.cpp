@@ -0,0 +1,203 @@
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <vector>
+
+// internal
+#include "testcommons.h"
+#include "linedescriptor.h"
+
+#define TEST_IMG_SIZE 256
+
+//------------------------------------------------------------------------------
+float4 segment(const float x1, const float y1, const float x2, const float y2)
+{
+    float4 coords;
+    coords.x = x1; coords.y = y1;
+    coords.z = x2; coords.w = y2;
+    return coords;
+}
+
+//------------------------------------------------------------------------------
+// textured image: random rectangles + noise, values in [0,120]
+cv::Mat createImage()
+{
+    std::vector<float> img(TEST_IMG_SIZE*TEST_IMG_SIZE,0.0f);
+    for(unsigned int r=0; r<60; ++r)
+    {
+        int x0 = int(L3DPP::testRandom()*TEST_IMG_SIZE);
+        int y0 = int(L3DPP::testRandom()*TEST_IMG_SIZE);
+        int w = 10+int(L3DPP::testRandom()*80);
+        int h = 10+int(L3DPP::testRandom()*80);
+        float v = 30.0f*L3DPP::testRandom();
+        for(int y=y0; y<std::min(y0+h,TEST_IMG_SIZE); ++y)
+            for(int x=x0; x<std::min(x0+w,TEST_IMG_SIZE); ++x)
+                img[y*TEST_IMG_SIZE+x] += v;
+    }
+
+    cv::Mat gray(TEST_IMG_SIZE,TEST_IMG_SIZE,CV_8U);
+    for(int y=0; y<TEST_IMG_SIZE; ++y)
+    {
+        for(int x=0; x<TEST_IMG_SIZE; ++x)
+        {
+            float v = img[y*TEST_IMG_SIZE+x]+5.0f*L3DPP::testRandom();
+            gray.at<uchar>(y,x) = uchar(std::min(v,120.0f));
+        }
+    }
+    return gray;
+}
+
+//------------------------------------------------------------------------------
+void describe(const cv::Mat& gray, const std::vector<float4>& coords, const float scale,
+              std::vector<L3DPP::LineDescriptor>& descriptors)
+{
+    L3DPP::DataArray<float4>* segments = new L3DPP::DataArray<float4>(coords.size(),1,false,coords);
+    L3DPP::computeLineDescriptors(gray,segments,scale,scale,descriptors);
+    delete segments;
+
+    L3DPP_CHECK(descriptors.size() == coords.size());
+}
+
+//------------------------------------------------------------------------------
+// Hamming distance vs. counting the bits one by one
+void testHamming()
+{
+    for(unsigned int k=0; k<100; ++k)
+    {
+        L3DPP::LineDescriptor d1,d2;
+        unsigned int expected = 0;
+        for(unsigned int b=0; b<L3DPP::L3D_LINE_DESC_BITS; ++b)
+        {
+            bool b1 = (L3DPP::testRandom() > 0.5f);
+            bool b2 = (L3DPP::testRandom() > 0.5f);
+            if(b1) d1.setBit(b);
+            if(b2) d2.setBit(b);
+            if(b1 != b2) ++expected;
+        }
+
+        L3DPP_CHECK(L3DPP::hammingDistance(d1,d2) == expected);
+        L3DPP_CHECK(L3DPP::hammingDistance(d2,d1) == expected);
+        L3DPP_CHECK(L3DPP::hammingDistance(d1,d1) == 0);
+    }
+
+    L3DPP::LineDescriptor zero,full;
+    for(unsigned int b=0; b<L3DPP::L3D_LINE_DESC_BITS; ++b)
+        full.setBit(b);
+
+    L3DPP_CHECK(L3DPP::hammingDistance(zero,full) == L3DPP::L3D_LINE_DESC_BITS);
+    L3DPP_CHECK(L3DPP::popcount32(0xFFFFFFFF) == 32);
+    L3DPP_CHECK(L3DPP::popcount32(0x80000001) == 2);
+}
+
+//------------------------------------------------------------------------------
+void testDescriptors()
+{
+    cv::Mat gray = createImage();
+
+    // random segments (integer coordinates -> exact under scaling)
+    std::vector<float4> coords,flipped,half;
+    for(unsigned int i=0; i<200; ++i)
+    {
+        float x1 = float(int(20+L3DPP::testRandom()*(TEST_IMG_SIZE-40)));
+        float y1 = float(int(20+L3DPP::testRandom()*(TEST_IMG_SIZE-40)));
+        float x2 = float(int(20+L3DPP::testRandom()*(TEST_IMG_SIZE-40)));
+        float y2 = float(int(20+L3DPP::testRandom()*(TEST_IMG_SIZE-40)));
+        if(fabs(x2-x1)+fabs(y2-y1) < 10.0f)
+            x2 = x1+10.0f;
+
+        coords.push_back(segment(x1,y1,x2,y2));
+        flipped.push_back(segment(x2,y2,x1,y1));
+        half.push_back(segment(0.5f*x1,0.5f*y1,0.5f*x2,0.5f*y2));
+    }
+
+    std::vector<L3DPP::LineDescriptor> desc,desc_flipped,desc_half,desc_affine;
+    describe(gray,coords,1.0f,desc);
+    describe(gray,flipped,1.0f,desc_flipped);
+    describe(gray,half,2.0f,desc_half);
+
+    // affine intensity change (no saturation)
+    cv::Mat gray_affine(TEST_IMG_SIZE,TEST_IMG_SIZE,CV_8U);
+    for(int y=0; y<TEST_IMG_SIZE; ++y)
+        for(int x=0; x<TEST_IMG_SIZE; ++x)
+            gray_affine.at<uchar>(y,x) = 2*gray.at<uchar>(y,x)+10;
+
+    describe(gray_affine,coords,1.0f,desc_affine);
+
+    // same segment, slightly moved (sub-pixel) and another segment
+    std::vector<float4> moved;
+    for(size_t i=0; i<coords.size(); ++i)
+        moved.push_back(segment(coords[i].x+0.3f,coords[i].y-0.2f,coords[i].z+0.3f,coords[i].w-0.2f));
+
+    std::vector<L3DPP::LineDescriptor> desc_moved;
+    describe(gray,moved,1.0f,desc_moved);
+
+    double dist_flipped = 0.0;
+    double dist_moved = 0.0;
+    double dist_other = 0.0;
+    for(size_t i=0; i<desc.size() && i<desc_flipped.size() && i<desc_half.size() &&
+        i<desc_affine.size() && i<desc_moved.size(); ++i)
+    {
+        // scaled coordinates and affine intensities -> identical
+        L3DPP_CHECK(L3DPP::hammingDistance(desc[i],desc_half[i]) == 0);
+        L3DPP_CHECK(L3DPP::hammingDistance(desc[i],desc_affine[i]) == 0);
+
+        dist_flipped += L3DPP::hammingDistance(desc[i],desc_flipped[i]);
+        dist_moved += L3DPP::hammingDistance(desc[i],desc_moved[i]);
+        dist_other += L3DPP::hammingDistance(desc[i],desc[(i+1)%desc.size()]);
+    }
+    dist_flipped /= double(desc.size());
+    dist_moved /= double(desc.size());
+    dist_other /= double(desc.size());
+
+    std::cout << "avg. Hamming distance: flipped=" << dist_flipped << ", moved=" << dist_moved;
+    std::cout << ", other=" << dist_other << std::endl;
+
+    // orientation invariant (up to rounding of the sample positions) and distinctive
+    L3DPP_CHECK(dist_flipped < 2.0);
+    L3DPP_CHECK(dist_moved < 0.5*dist_other);
+    L3DPP_CHECK(dist_other > 0.1*L3DPP::L3D_LINE_DESC_BITS);
+}
+
+//------------------------------------------------------------------------------
+void testInvalidInput()
+{
+    cv::Mat gray = createImage();
+
+    // too short -> empty descriptor
+    std::vector<float4> coords;
+    coords.push_back(segment(50.0f,50.0f,50.5f,50.5f));
+    std::vector<L3DPP::LineDescriptor> desc;
+    describe(gray,coords,1.0f,desc);
+    L3DPP::LineDescriptor zero;
+    L3DPP_CHECK(desc.size() == 1 && L3DPP::hammingDistance(desc[0],zero) == 0);
+
+    // no segments, wrong image type
+    L3DPP::computeLineDescriptors(gray,NULL,1.0f,1.0f,desc);
+    L3DPP_CHECK(desc.empty());
+
+    cv::Mat gray_f(TEST_IMG_SIZE,TEST_IMG_SIZE,CV_32F);
+    L3DPP::DataArray<float4>* segments = new L3DPP::DataArray<float4>(1,1,false,coords);
+    L3DPP::computeLineDescriptors(gray_f,segments,1.0f,1.0f,desc);
+    L3DPP_CHECK(desc.empty());
+    delete segments;
+}
+
+//------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    testHamming();
+    testDescriptors();
+    testInvalidInput();
+
+    return L3DPP::testResult("linedescriptor");
+}
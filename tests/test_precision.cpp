@@ -0,0 +1,212 @@
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cstdlib>
+
+// external
+#include "eigen3/Eigen/Eigen"
+#include "boost/filesystem.hpp"
+
+// internal
+#include "testcommons.h"
+
+/**
+ * Regression on the VisualSfM test data: reconstructs
+ * testdata/ with the CPU kernels in single and double
+ * precision (runLine3Dpp_vsfm) and compares both results
+ * with each other and with testdata/Line3D++_ref/
+ *
+ * usage: test_precision <runLine3Dpp_vsfm> <testdata folder> <output folder>
+ */
+
+// reference (same parameters as below, no CERES)
+#define REF_FILE "Line3D++_ref/Line3D++__W_FULL__N_10__sigmaP_2.5__sigmaA_10__epiOverlap_0.25__kNN_10__vis_3.txt"
+#define PARAMS " -w -1 -n 10 -p 2.5 -a 10 -e 0.25 -k 10 -v 3 -r 0 -c 0 -g 0 -l 0"
+
+// tolerances: segment distance (relative to the scene extent) and
+// min. fraction of segments that are reproduced by the other model,
+// observed: float->double 0.9996, double->float 1.0, reference 0.974
+// (float and double), #lines3D 2584 (float) vs. 2583 (double)
+#define TEST_DIST_T 0.01
+#define TEST_COVERAGE_FLOAT_DOUBLE 0.99
+#define TEST_COVERAGE_REF 0.90
+#define TEST_NUM_LINES_T 0.01
+
+typedef std::vector<std::pair<Eigen::Vector3d,Eigen::Vector3d> > SegmentList;
+
+//------------------------------------------------------------------------------
+// reads the collinear 3D segments of a .txt result, returns the number of 3D lines
+size_t readResult(const std::string& filename, SegmentList& segments)
+{
+    segments.clear();
+
+    std::ifstream file(filename.c_str());
+    if(!file.is_open())
+    {
+        std::cout << "could not open " << filename << std::endl;
+        return 0;
+    }
+
+    size_t num_lines = 0;
+    std::string line;
+    while(std::getline(file,line))
+    {
+        std::istringstream str(line);
+        unsigned int num_segments;
+        if(!(str >> num_segments))
+            continue;
+
+        for(unsigned int i=0; i<num_segments; ++i)
+        {
+            Eigen::Vector3d P1,P2;
+            str >> P1.x() >> P1.y() >> P1.z();
+            str >> P2.x() >> P2.y() >> P2.z();
+            segments.push_back(std::pair<Eigen::Vector3d,Eigen::Vector3d>(P1,P2));
+        }
+        ++num_lines;
+    }
+
+    return num_lines;
+}
+
+//------------------------------------------------------------------------------
+// .txt result in a folder (empty if there is none)
+std::string findResult(const std::string& folder)
+{
+    boost::filesystem::directory_iterator it(folder);
+    for(; it!=boost::filesystem::directory_iterator(); ++it)
+    {
+        if(it->path().extension() == ".txt")
+            return it->path().string();
+    }
+    return "";
+}
+
+//------------------------------------------------------------------------------
+double distancePointSegment(const Eigen::Vector3d& P, const Eigen::Vector3d& Q1,
+                            const Eigen::Vector3d& Q2)
+{
+    Eigen::Vector3d d = Q2-Q1;
+    double len2 = d.squaredNorm();
+    double t = (len2 > 1e-12) ? fmin(fmax((P-Q1).dot(d)/len2,0.0),1.0) : 0.0;
+    return (Q1+t*d-P).norm();
+}
+
+//------------------------------------------------------------------------------
+// fraction of the segments in A that lie on a segment of B (both endpoints within dist_t)
+double coverage(const SegmentList& A, const SegmentList& B, const double dist_t)
+{
+    if(A.empty())
+        return 0.0;
+
+    size_t covered = 0;
+    for(size_t i=0; i<A.size(); ++i)
+    {
+        for(size_t j=0; j<B.size(); ++j)
+        {
+            if(distancePointSegment(A[i].first,B[j].first,B[j].second) < dist_t &&
+                    distancePointSegment(A[i].second,B[j].first,B[j].second) < dist_t)
+            {
+                ++covered;
+                break;
+            }
+        }
+    }
+    return double(covered)/double(A.size());
+}
+
+//------------------------------------------------------------------------------
+// scene extent (bounding box diagonal)
+double extent(const SegmentList& segments)
+{
+    if(segments.empty())
+        return 0.0;
+
+    Eigen::Vector3d min_c = segments[0].first;
+    Eigen::Vector3d max_c = segments[0].first;
+    for(size_t i=0; i<segments.size(); ++i)
+    {
+        min_c = min_c.cwiseMin(segments[i].first).cwiseMin(segments[i].second);
+        max_c = max_c.cwiseMax(segments[i].first).cwiseMax(segments[i].second);
+    }
+    return (max_c-min_c).norm();
+}
+
+//------------------------------------------------------------------------------
+// runs the reconstruction, returns the .txt result
+std::string reconstruct(const std::string& exe, const std::string& testdata,
+                        const std::string& output, const bool float_precision)
+{
+    boost::filesystem::remove_all(output);
+    boost::filesystem::create_directories(output);
+
+    std::stringstream cmd;
+    cmd << "\"" << exe << "\" -i \"" << testdata << "\" -m \"" << testdata << "/vsfm_result.nvm\"";
+    cmd << " -o \"" << output << "\"" << PARAMS << " -u " << (float_precision ? 1 : 0);
+
+    std::cout << cmd.str() << std::endl;
+    L3DPP_CHECK(system(cmd.str().c_str()) == 0);
+
+    return findResult(output);
+}
+
+//------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    if(argc < 4)
+    {
+        std::cout << "usage: test_precision <runLine3Dpp_vsfm> <testdata folder> <output folder>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string exe = argv[1];
+    std::string testdata = argv[2];
+    std::string output = argv[3];
+
+    // reference
+    SegmentList ref;
+    size_t num_ref = readResult(testdata+"/"+REF_FILE,ref);
+    L3DPP_CHECK(num_ref > 0);
+
+    double dist_t = TEST_DIST_T*extent(ref);
+
+    // single and double precision
+    SegmentList res_f,res_d;
+    size_t num_f = readResult(reconstruct(exe,testdata,output+"/float",true),res_f);
+    size_t num_d = readResult(reconstruct(exe,testdata,output+"/double",false),res_d);
+
+    std::cout << "#lines3D: ref=" << num_ref << ", float=" << num_f << ", double=" << num_d << std::endl;
+    L3DPP_CHECK(num_f > 0 && num_d > 0);
+
+    // float vs. double
+    L3DPP_CHECK_NEAR(num_f,num_d,TEST_NUM_LINES_T*num_d);
+
+    double cov_fd = coverage(res_f,res_d,dist_t);
+    double cov_df = coverage(res_d,res_f,dist_t);
+    std::cout << "coverage: float->double=" << cov_fd << ", double->float=" << cov_df << std::endl;
+    L3DPP_CHECK(cov_fd >= TEST_COVERAGE_FLOAT_DOUBLE);
+    L3DPP_CHECK(cov_df >= TEST_COVERAGE_FLOAT_DOUBLE);
+
+    // both vs. reference
+    double cov_rf = coverage(ref,res_f,dist_t);
+    double cov_rd = coverage(ref,res_d,dist_t);
+    std::cout << "coverage of the reference: float=" << cov_rf << ", double=" << cov_rd << std::endl;
+    L3DPP_CHECK(cov_rf >= TEST_COVERAGE_REF);
+    L3DPP_CHECK(cov_rd >= TEST_COVERAGE_REF);
+
+    return L3DPP::testResult("precision");
+}
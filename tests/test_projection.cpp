@@ -0,0 +1,227 @@
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <vector>
+#include <set>
+#include <map>
+
+// internal
+#include "testcommons.h"
+#include "projection.h"
+
+#define TEST_WIDTH 640
+#define TEST_HEIGHT 480
+#define TEST_NEAR 0.5f
+#define TEST_SAMPLES 10000
+
+//------------------------------------------------------------------------------
+Eigen::Vector3d randomPoint(const double range)
+{
+    return Eigen::Vector3d((2.0*L3DPP::testRandom()-1.0)*range,
+                           (2.0*L3DPP::testRandom()-1.0)*range,
+                           (2.0*L3DPP::testRandom()-1.0)*range);
+}
+
+//------------------------------------------------------------------------------
+struct TestCamera
+{
+    Eigen::Matrix3d K_;
+    Eigen::Matrix3d R_;
+    Eigen::Vector3d t_;
+};
+
+//------------------------------------------------------------------------------
+TestCamera randomCamera(const Eigen::Vector3d& offset)
+{
+    TestCamera cam;
+    cam.K_ = Eigen::Matrix3d::Identity();
+    cam.K_(0,0) = 400.0+200.0*L3DPP::testRandom();
+    cam.K_(1,1) = cam.K_(0,0);
+    cam.K_(0,2) = 0.5*TEST_WIDTH;
+    cam.K_(1,2) = 0.5*TEST_HEIGHT;
+
+    cam.R_ = Eigen::AngleAxisd(L3DPP::testRandom()*M_PI,randomPoint(1.0).normalized()).toRotationMatrix();
+    Eigen::Vector3d C = offset+randomPoint(3.0);
+    cam.t_ = -cam.R_*C;
+    return cam;
+}
+
+//------------------------------------------------------------------------------
+// 3D point of an image point with a given depth
+Eigen::Vector3d unproject(const TestCamera& cam, const float x, const float y, const float depth)
+{
+    Eigen::Vector3d p(double(x)*depth,double(y)*depth,depth);
+    return cam.R_.transpose()*(cam.K_.inverse()*p-cam.t_);
+}
+
+//------------------------------------------------------------------------------
+// visible part of a segment [t_min,t_max] (dense sampling, false if invisible)
+bool visibleInterval(const TestCamera& cam, const L3DPP::Segment3D& seg,
+                     double& t_min, double& t_max)
+{
+    t_min = 1.0;
+    t_max = 0.0;
+    for(unsigned int s=0; s<=TEST_SAMPLES; ++s)
+    {
+        double t = double(s)/double(TEST_SAMPLES);
+        Eigen::Vector3d p = cam.K_*(cam.R_*(seg.P1()+t*(seg.P2()-seg.P1()))+cam.t_);
+        if(p.z() < TEST_NEAR)
+            continue;
+
+        double x = p.x()/p.z();
+        double y = p.y()/p.z();
+        if(x < 0.0 || y < 0.0 || x > TEST_WIDTH || y > TEST_HEIGHT)
+            continue;
+
+        t_min = fmin(t_min,t);
+        t_max = fmax(t_max,t);
+    }
+    return (t_min <= t_max);
+}
+
+//------------------------------------------------------------------------------
+// position of a 3D point along a segment (and its distance to the line)
+double segmentPosition(const L3DPP::Segment3D& seg, const Eigen::Vector3d& X, double& dist)
+{
+    Eigen::Vector3d d = seg.P2()-seg.P1();
+    double t = (X-seg.P1()).dot(d)/d.squaredNorm();
+    dist = (seg.P1()+t*d-X).norm();
+    return t;
+}
+
+//------------------------------------------------------------------------------
+// projection and clipping vs. a densely sampled reference
+void testProjection(const Eigen::Vector3d& offset)
+{
+    std::vector<L3DPP::Segment3D> segments;
+    for(unsigned int i=0; i<2000; ++i)
+    {
+        Eigen::Vector3d P = offset+randomPoint(10.0);
+        segments.push_back(L3DPP::Segment3D(P,P+randomPoint(4.0)));
+    }
+
+    for(unsigned int c=0; c<10; ++c)
+    {
+        TestCamera cam = randomCamera(offset);
+        L3DPP::SegmentProjector projector(cam.K_,cam.R_,cam.t_,TEST_WIDTH,TEST_HEIGHT,TEST_NEAR);
+
+        std::vector<L3DPP::ProjectedSegment2D> result;
+        projector.project(segments,result);
+
+        std::map<unsigned int,size_t> projected;
+        for(size_t i=0; i<result.size(); ++i)
+        {
+            L3DPP_CHECK(projected.find(result[i].lineID_) == projected.end());
+            projected[result[i].lineID_] = i;
+        }
+
+        for(size_t i=0; i<segments.size(); ++i)
+        {
+            const L3DPP::Segment3D& seg = segments[i];
+            double t_min,t_max;
+            bool visible = visibleInterval(cam,seg,t_min,t_max);
+
+            std::map<unsigned int,size_t>::const_iterator it = projected.find(i);
+            if(it == projected.end())
+            {
+                // invisible (or only touching the border)
+                L3DPP_CHECK(!visible || t_max-t_min < 2.0/TEST_SAMPLES);
+                continue;
+            }
+
+            const L3DPP::ProjectedSegment2D& p = result[it->second];
+            L3DPP_CHECK(p.segmentID_ == 0);
+
+            // inside the image and in front of the near plane
+            L3DPP_CHECK(p.x1_ > -0.01f && p.x1_ < TEST_WIDTH+0.01f);
+            L3DPP_CHECK(p.x2_ > -0.01f && p.x2_ < TEST_WIDTH+0.01f);
+            L3DPP_CHECK(p.y1_ > -0.01f && p.y1_ < TEST_HEIGHT+0.01f);
+            L3DPP_CHECK(p.y2_ > -0.01f && p.y2_ < TEST_HEIGHT+0.01f);
+            L3DPP_CHECK(p.depth1_ > TEST_NEAR*0.999f);
+            L3DPP_CHECK(p.depth2_ > TEST_NEAR*0.999f);
+
+            if(!visible)
+            {
+                // only a sliver
+                L3DPP_CHECK(fabs(p.x2_-p.x1_)+fabs(p.y2_-p.y1_) < 1.0f);
+                continue;
+            }
+
+            // the endpoints (image position + depth) lie on the 3D segment and
+            // delimit the visible part
+            double dist1,dist2;
+            double t1 = segmentPosition(seg,unproject(cam,p.x1_,p.y1_,p.depth1_),dist1);
+            double t2 = segmentPosition(seg,unproject(cam,p.x2_,p.y2_,p.depth2_),dist2);
+            L3DPP_CHECK(dist1 < 1e-3 && dist2 < 1e-3);
+
+            const double eps = 2.0/TEST_SAMPLES+1e-3;
+            L3DPP_CHECK_NEAR(fmin(t1,t2),t_min,eps);
+            L3DPP_CHECK_NEAR(fmax(t1,t2),t_max,eps);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// final 3D lines: all segments vs. frustum culled candidates
+void testFrustumCandidates()
+{
+    std::vector<L3DPP::FinalLine3D> lines3D(500);
+    for(size_t i=0; i<lines3D.size(); ++i)
+    {
+        Eigen::Vector3d P = randomPoint(10.0);
+        Eigen::Vector3d d = randomPoint(1.0).normalized();
+        lines3D[i].collinear3Dsegments_.push_back(L3DPP::Segment3D(P,P+d));
+        lines3D[i].collinear3Dsegments_.push_back(L3DPP::Segment3D(P+1.5*d,P+3.0*d));
+    }
+
+    L3DPP::SpatialIndex index;
+    index.build(lines3D);
+
+    for(unsigned int c=0; c<10; ++c)
+    {
+        TestCamera cam = randomCamera(Eigen::Vector3d::Zero());
+        L3DPP::SegmentProjector projector(cam.K_,cam.R_,cam.t_,TEST_WIDTH,TEST_HEIGHT,TEST_NEAR);
+
+        std::vector<L3DPP::ProjectedSegment2D> all,culled;
+        projector.project(lines3D,all);
+
+        std::vector<L3DPP::SpatialHit> candidates;
+        index.queryFrustum(projector.frustum(),candidates);
+        projector.project(lines3D,candidates,culled);
+
+        // culling must not lose any visible segment
+        std::set<std::pair<unsigned int,unsigned int> > culled_ids;
+        for(size_t i=0; i<culled.size(); ++i)
+            culled_ids.insert(std::make_pair(culled[i].lineID_,culled[i].segmentID_));
+
+        L3DPP_CHECK(!all.empty());
+        L3DPP_CHECK(culled.size() == all.size());
+        for(size_t i=0; i<all.size(); ++i)
+        {
+            L3DPP_CHECK(culled_ids.find(std::make_pair(all[i].lineID_,all[i].segmentID_)) != culled_ids.end());
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    testProjection(Eigen::Vector3d::Zero());
+
+    // large scene coordinates (float precision relative to the camera)
+    testProjection(Eigen::Vector3d(2e5,-3e5,1e5));
+
+    testFrustumCandidates();
+
+    return L3DPP::testResult("projection");
+}
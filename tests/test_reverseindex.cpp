@@ -0,0 +1,154 @@
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <vector>
+#include <map>
+#include <algorithm>
+
+// internal
+#include "testcommons.h"
+#include "reverseindex.h"
+
+#define TEST_UNKNOWN_VIEW 99
+
+//------------------------------------------------------------------------------
+// random 3D lines with residuals in known views, an unknown view and
+// with out of range segIDs
+void createLines(const std::map<unsigned int,unsigned int>& num_segments,
+                 std::vector<L3DPP::FinalLine3D>& lines3D)
+{
+    std::vector<unsigned int> camIDs;
+    std::map<unsigned int,unsigned int>::const_iterator it = num_segments.begin();
+    for(; it!=num_segments.end(); ++it)
+        camIDs.push_back(it->first);
+    camIDs.push_back(TEST_UNKNOWN_VIEW);
+
+    L3DPP::Segment3D seg3D(Eigen::Vector3d::Zero(),Eigen::Vector3d::UnitX());
+    lines3D.resize(300);
+    for(size_t i=0; i<lines3D.size(); ++i)
+    {
+        std::vector<L3DPP::Segment2D> residuals;
+        unsigned int num_residuals = 2+(unsigned int)(L3DPP::testRandom()*6.0f);
+        for(unsigned int j=0; j<num_residuals; ++j)
+        {
+            unsigned int camID = camIDs[(unsigned int)(L3DPP::testRandom()*(camIDs.size()-0.01f))];
+            unsigned int segID = (unsigned int)(L3DPP::testRandom()*120.0f);
+            residuals.push_back(L3DPP::Segment2D(camID,segID));
+        }
+
+        lines3D[i].collinear3Dsegments_.push_back(seg3D);
+        lines3D[i].underlyingCluster_ = L3DPP::LineCluster3D(seg3D,residuals,residuals[0].camID());
+    }
+}
+
+//------------------------------------------------------------------------------
+// index vs. a linear scan over all residuals
+void checkIndex(const L3DPP::ReverseIndex& index, const std::vector<L3DPP::FinalLine3D>& lines3D,
+                const std::map<unsigned int,unsigned int>& num_segments)
+{
+    L3DPP_CHECK(index.num_views() == num_segments.size());
+    L3DPP_CHECK(index.support_offsets().size() == num_segments.size()+1);
+    L3DPP_CHECK(index.segment_offsets().size() == num_segments.size()+1);
+
+    std::map<unsigned int,unsigned int>::const_iterator it = num_segments.begin();
+    for(; it!=num_segments.end(); ++it)
+    {
+        unsigned int camID = it->first;
+
+        // brute force
+        std::vector<L3DPP::LineSupport> expected;
+        for(size_t i=0; i<lines3D.size(); ++i)
+        {
+            const std::vector<L3DPP::Segment2D>* residuals = lines3D[i].underlyingCluster_.residuals();
+            for(size_t j=0; j<residuals->size(); ++j)
+            {
+                if(residuals->at(j).camID() == camID && residuals->at(j).segID() < it->second)
+                    expected.push_back(L3DPP::LineSupport(i,residuals->at(j).segID()));
+            }
+        }
+        std::sort(expected.begin(),expected.end(),L3DPP::sortLineSupport);
+
+        // view -> lines
+        size_t num;
+        const L3DPP::LineSupport* support = index.support(camID,num);
+        L3DPP_CHECK(num == expected.size());
+        L3DPP_CHECK((support == NULL) == expected.empty());
+        for(size_t k=0; k<num && k<expected.size() && support != NULL; ++k)
+        {
+            L3DPP_CHECK(support[k].lineID_ == expected[k].lineID_);
+            L3DPP_CHECK(support[k].segID_ == expected[k].segID_);
+        }
+
+        // segment -> line (smallest lineID wins)
+        for(unsigned int segID=0; segID<it->second+10; ++segID)
+        {
+            int lineID = -1;
+            for(size_t k=0; k<expected.size(); ++k)
+            {
+                if(expected[k].segID_ == segID)
+                {
+                    lineID = expected[k].lineID_;
+                    break;
+                }
+            }
+            L3DPP_CHECK(index.lineID(camID,segID) == lineID);
+        }
+    }
+
+    // unknown view
+    size_t num;
+    L3DPP_CHECK(index.support(TEST_UNKNOWN_VIEW,num) == NULL && num == 0);
+    L3DPP_CHECK(index.lineID(TEST_UNKNOWN_VIEW,0) == -1);
+}
+
+//------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    std::map<unsigned int,unsigned int> num_segments;
+    num_segments[0] = 100;
+    num_segments[3] = 50;
+    num_segments[7] = 120;
+    num_segments[12] = 0;
+    num_segments[20] = 80;
+
+    std::vector<L3DPP::FinalLine3D> lines3D;
+    createLines(num_segments,lines3D);
+
+    L3DPP::ReverseIndex index;
+    index.build(lines3D,num_segments);
+    checkIndex(index,lines3D,num_segments);
+
+    // rebuild (no leftovers)
+    index.build(lines3D,num_segments);
+    checkIndex(index,lines3D,num_segments);
+
+    // swap
+    L3DPP::ReverseIndex other;
+    other.swap(index);
+    L3DPP_CHECK(index.num_views() == 0);
+    L3DPP_CHECK(index.lineID(0,0) == -1);
+    checkIndex(other,lines3D,num_segments);
+
+    // clear
+    other.clear();
+    size_t num;
+    L3DPP_CHECK(other.num_views() == 0);
+    L3DPP_CHECK(other.support(0,num) == NULL && num == 0);
+
+    // no lines
+    std::vector<L3DPP::FinalLine3D> empty;
+    index.build(empty,num_segments);
+    checkIndex(index,empty,num_segments);
+
+    return L3DPP::testResult("reverseindex");
+}
@@ -0,0 +1,317 @@
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <vector>
+#include <set>
+#include <algorithm>
+
+// internal
+#include "testcommons.h"
+#include "sparsematrix.h"
+#include "clustering.h"
+#include "universe.h"
+
+//------------------------------------------------------------------------------
+// symmetric affinity matrix with disjoint components (some tiny affinities)
+void createAffinities(const std::vector<unsigned int>& sizes, L3DPP::CLEdgeList& edges,
+                      std::vector<std::vector<int> >& components)
+{
+    int offset = 0;
+    for(size_t c=0; c<sizes.size(); ++c)
+    {
+        std::vector<int> rows;
+        for(unsigned int i=0; i<sizes[c]; ++i)
+            rows.push_back(offset+i);
+
+        for(unsigned int i=0; i<sizes[c]; ++i)
+        {
+            for(unsigned int j=i+1; j<sizes[c]; ++j)
+            {
+                // chain (connected) + random edges
+                if(j != i+1 && L3DPP::testRandom() > 0.6f)
+                    continue;
+
+                float w = 0.05f+0.95f*L3DPP::testRandom();
+                if(L3DPP::testRandom() < 0.2f)
+                    w = 1e-7f;
+
+                L3DPP::CLEdge e;
+                e.i_ = offset+i;
+                e.j_ = offset+j;
+                e.w_ = w;
+                edges.push_back(e);
+                e.i_ = offset+j;
+                e.j_ = offset+i;
+                edges.push_back(e);
+            }
+        }
+
+        components.push_back(rows);
+        offset += sizes[c];
+    }
+}
+
+//------------------------------------------------------------------------------
+// RDD on all components, returns the (symmetrified) clusters per row
+void diffuseAndCluster(const L3DPP::SparseMatrix* W, const std::vector<std::vector<int> >& components,
+                       const float prune_t, std::vector<float>& result, std::vector<int>& clusters)
+{
+    std::vector<int> row2pos(W->num_rows_cols(),-1);
+    for(size_t c=0; c<components.size(); ++c)
+    {
+        for(size_t k=0; k<components[c].size(); ++k)
+            row2pos[components[c][k]] = k;
+    }
+
+    result = std::vector<float>(W->num_entries(),0.0f);
+    for(size_t c=0; c<components.size(); ++c)
+    {
+        unsigned int iter = L3DPP::replicatorDynamicsDiffusion(W,components[c],row2pos,&result[0],
+                                                               L3D_DEF_RDD_MAX_ITER,
+                                                               L3D_DEF_RDD_TOLERANCE,prune_t);
+        L3DPP_CHECK(iter > 0 && iter <= L3D_DEF_RDD_MAX_ITER);
+    }
+
+    // symmetrify (same as Line3D::performRDD())
+    L3DPP::CLEdgeList edges;
+    const L3DPP::SparseOffset* offsets = W->row_offsets();
+    const L3DPP::SparseIndex* cols = W->col_indices();
+    for(unsigned int r=0; r<W->num_rows_cols(); ++r)
+    {
+        for(L3DPP::SparseOffset p=offsets[r]; p<offsets[r+1]; ++p)
+        {
+            L3DPP::CLEdge e;
+            e.i_ = r;
+            e.j_ = cols[p];
+            e.w_ = fmin(result[p],result[W->find(cols[p],r)]);
+            edges.push_back(e);
+        }
+    }
+
+    L3DPP::CLUniverse* u = L3DPP::performClustering(edges,W->num_rows_cols(),3.0f);
+    clusters.resize(W->num_rows_cols());
+    for(unsigned int r=0; r<W->num_rows_cols(); ++r)
+        clusters[r] = u->find(r);
+
+    delete u;
+}
+
+//------------------------------------------------------------------------------
+// CSR and CSC view vs. a dense reference, edge list round trip
+void testCSRCSC()
+{
+    const unsigned int n = 300;
+    const float normalization = 4.0f;
+
+    // dense reference (-1 -> no entry), some empty rows/columns
+    std::vector<float> dense(n*n,-1.0f);
+    std::vector<L3DPP::CLEdge> entries;
+    for(unsigned int r=0; r<n; ++r)
+    {
+        for(unsigned int c=0; c<n; ++c)
+        {
+            if(r%17 == 5 || c%23 == 7 || L3DPP::testRandom() > 0.05f)
+                continue;
+
+            L3DPP::CLEdge e;
+            e.i_ = r;
+            e.j_ = c;
+            e.w_ = L3DPP::testRandom();
+            dense[r*n+c] = e.w_/normalization;
+            entries.push_back(e);
+        }
+    }
+
+    // random order
+    for(size_t i=entries.size()-1; i>0; --i)
+        std::swap(entries[i],entries[(size_t)(L3DPP::testRandom()*i)]);
+
+    L3DPP::CLEdgeList edges;
+    for(size_t i=0; i<entries.size(); ++i)
+        edges.push_back(entries[i]);
+
+    L3DPP::SparseMatrix* W = new L3DPP::SparseMatrix(edges,n,normalization);
+    L3DPP_CHECK(W->num_rows_cols() == n);
+    L3DPP_CHECK(W->num_entries() == entries.size());
+
+    // CSR: sorted by column, same values
+    const L3DPP::SparseOffset* row_offsets = W->row_offsets();
+    const L3DPP::SparseIndex* cols = W->col_indices();
+    const float* vals = W->values();
+    L3DPP_CHECK(row_offsets[0] == 0 && row_offsets[n] == W->num_entries());
+    for(unsigned int r=0; r<n; ++r)
+    {
+        unsigned int num = 0;
+        for(unsigned int c=0; c<n; ++c)
+        {
+            if(dense[r*n+c] >= 0.0f)
+                ++num;
+        }
+        L3DPP_CHECK(row_offsets[r+1]-row_offsets[r] == num);
+
+        for(L3DPP::SparseOffset p=row_offsets[r]; p<row_offsets[r+1]; ++p)
+        {
+            L3DPP_CHECK(dense[r*n+cols[p]] == vals[p]);
+            if(p > row_offsets[r])
+            {
+                L3DPP_CHECK(cols[p-1] < cols[p]);
+            }
+        }
+    }
+
+    // CSC: sorted by row, points to the matching CSR entry
+    const L3DPP::SparseOffset* col_offsets = W->col_offsets();
+    const L3DPP::SparseIndex* rows = W->row_indices();
+    const L3DPP::SparseOffset* csc_entries = W->csc_entries();
+    L3DPP_CHECK(col_offsets[0] == 0 && col_offsets[n] == W->num_entries());
+    for(unsigned int c=0; c<n; ++c)
+    {
+        unsigned int num = 0;
+        for(unsigned int r=0; r<n; ++r)
+        {
+            if(dense[r*n+c] >= 0.0f)
+                ++num;
+        }
+        L3DPP_CHECK(col_offsets[c+1]-col_offsets[c] == num);
+
+        for(L3DPP::SparseOffset p=col_offsets[c]; p<col_offsets[c+1]; ++p)
+        {
+            L3DPP::SparseOffset e = csc_entries[p];
+            L3DPP_CHECK(e < W->num_entries());
+            L3DPP_CHECK(cols[e] == c);
+            L3DPP_CHECK(e >= row_offsets[rows[p]] && e < row_offsets[rows[p]+1]);
+            if(p > col_offsets[c])
+            {
+                L3DPP_CHECK(rows[p-1] < rows[p]);
+            }
+        }
+    }
+
+    // find
+    for(unsigned int r=0; r<n; ++r)
+    {
+        for(unsigned int c=0; c<n; ++c)
+        {
+            L3DPP::SparseOffset p = W->find(r,c);
+            if(dense[r*n+c] >= 0.0f)
+            {
+                L3DPP_CHECK(p < W->num_entries() && vals[p] == dense[r*n+c]);
+            }
+            else
+            {
+                L3DPP_CHECK(p == W->num_entries());
+            }
+        }
+    }
+
+    // round trip: edges -> matrix -> edges -> matrix
+    L3DPP::CLEdgeList edges2;
+    W->toEdges(edges2);
+    L3DPP_CHECK(edges2.size() == entries.size());
+
+    L3DPP::CLEdgeList::const_iterator it = edges2.begin();
+    for(; it!=edges2.end(); ++it)
+    {
+        L3DPP_CHECK(dense[(*it).i_*n+(*it).j_] == (*it).w_);
+    }
+
+    L3DPP::SparseMatrix* W2 = new L3DPP::SparseMatrix(edges2,n);
+    L3DPP::SparseMatrix* W3 = new L3DPP::SparseMatrix(W);
+    L3DPP::SparseMatrix* copies[2] = {W2,W3};
+    for(size_t k=0; k<2; ++k)
+    {
+        const L3DPP::SparseMatrix* M = copies[k];
+        L3DPP_CHECK(M->num_entries() == W->num_entries());
+        L3DPP_CHECK(std::equal(row_offsets,row_offsets+n+1,M->row_offsets()));
+        L3DPP_CHECK(std::equal(col_offsets,col_offsets+n+1,M->col_offsets()));
+        L3DPP_CHECK(std::equal(cols,cols+W->num_entries(),M->col_indices()));
+        L3DPP_CHECK(std::equal(vals,vals+W->num_entries(),M->values()));
+        L3DPP_CHECK(std::equal(rows,rows+W->num_entries(),M->row_indices()));
+        L3DPP_CHECK(std::equal(csc_entries,csc_entries+W->num_entries(),M->csc_entries()));
+    }
+
+    delete W;
+    delete W2;
+    delete W3;
+
+    // empty matrix
+    L3DPP::CLEdgeList no_edges;
+    L3DPP::SparseMatrix* E = new L3DPP::SparseMatrix(no_edges,n);
+    L3DPP_CHECK(E->num_entries() == 0);
+    L3DPP_CHECK(E->row_offsets() == NULL && E->col_offsets() == NULL);
+    L3DPP_CHECK(E->find(0,0) == 0);
+    delete E;
+}
+
+//------------------------------------------------------------------------------
+// pruning (opt-in) must not change the clusters compared to an unpruned run
+// (pruned entries do not come back, so the diffused values themselves can differ)
+void testPrunedRDD()
+{
+    size_t num_pruned = 0;
+    for(unsigned int seed=1; seed<=20; ++seed)
+    {
+        L3DPP::test_seed = seed;
+
+        std::vector<unsigned int> sizes;
+        sizes.push_back(6);
+        sizes.push_back(9);
+        sizes.push_back(4);
+        sizes.push_back(15);
+        sizes.push_back(2);
+
+        L3DPP::CLEdgeList edges;
+        std::vector<std::vector<int> > components;
+        createAffinities(sizes,edges,components);
+
+        L3DPP::SparseMatrix* W = new L3DPP::SparseMatrix(edges,36);
+
+        std::vector<float> full,pruned;
+        std::vector<int> clusters_full,clusters_pruned;
+        diffuseAndCluster(W,components,0.0f,full,clusters_full);
+        diffuseAndCluster(W,components,1e-6f,pruned,clusters_pruned);
+
+        // same partition
+        for(size_t i=0; i<clusters_full.size(); ++i)
+        {
+            for(size_t j=i+1; j<clusters_full.size(); ++j)
+            {
+                L3DPP_CHECK((clusters_full[i] == clusters_full[j]) == (clusters_pruned[i] == clusters_pruned[j]));
+            }
+        }
+
+        // no pruning -> all entries survive
+        for(size_t i=0; i<full.size(); ++i)
+        {
+            L3DPP_CHECK(full[i] > 0.0f);
+            if(pruned[i] == 0.0f)
+                ++num_pruned;
+        }
+
+        delete W;
+    }
+
+    // pruning is exercised
+    L3DPP_CHECK(num_pruned > 0);
+
+    // default: no pruning
+    L3DPP_CHECK(L3D_DEF_RDD_PRUNE_T <= 0.0f);
+}
+
+//------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    testPrunedRDD();
+    testCSRCSC();
+    return L3DPP::testResult("sparsematrix");
+}
@@ -0,0 +1,343 @@
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// check libs
+#include "configLIBS.h"
+
+// std
+#include <vector>
+#include <set>
+#include <algorithm>
+
+// internal
+#include "testcommons.h"
+#include "spatialindex.h"
+
+//------------------------------------------------------------------------------
+Eigen::Vector3d randomPoint(const double range)
+{
+    return Eigen::Vector3d((2.0*L3DPP::testRandom()-1.0)*range,
+                           (2.0*L3DPP::testRandom()-1.0)*range,
+                           (2.0*L3DPP::testRandom()-1.0)*range);
+}
+
+//------------------------------------------------------------------------------
+// random 3D lines with 1-3 collinear segments each
+void createLines(const unsigned int num_lines, std::vector<L3DPP::FinalLine3D>& lines3D)
+{
+    lines3D.resize(num_lines);
+    for(unsigned int i=0; i<num_lines; ++i)
+    {
+        Eigen::Vector3d P = randomPoint(10.0);
+        Eigen::Vector3d d = randomPoint(1.0).normalized();
+
+        unsigned int num_segments = 1+(unsigned int)(L3DPP::testRandom()*2.99f);
+        double pos = 0.0;
+        for(unsigned int j=0; j<num_segments; ++j)
+        {
+            double len = 0.1+2.0*L3DPP::testRandom();
+            lines3D[i].collinear3Dsegments_.push_back(L3DPP::Segment3D(P+pos*d,P+(pos+len)*d));
+            pos += len+0.5;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+double distancePointSegment(const Eigen::Vector3d& X, const L3DPP::Segment3D& seg)
+{
+    Eigen::Vector3d d = seg.P2()-seg.P1();
+    double t = fmin(fmax((X-seg.P1()).dot(d)/d.squaredNorm(),0.0),1.0);
+    return (seg.P1()+t*d-X).norm();
+}
+
+//------------------------------------------------------------------------------
+// point on the segment is inside the box (dense sampling)
+bool sampledInBox(const L3DPP::Segment3D& seg, const L3DPP::SpatialBox& box, const double eps)
+{
+    for(unsigned int s=0; s<=1000; ++s)
+    {
+        Eigen::Vector3d X = seg.P1()+(seg.P2()-seg.P1())*(double(s)/1000.0);
+        if((X.array() >= box.min_.array()-eps).all() && (X.array() <= box.max_.array()+eps).all())
+            return true;
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+// min. distance between a ray (s >= 0) and a segment (ternary search, convex)
+double distanceRaySegment(const L3DPP::SpatialRay& ray, const L3DPP::Segment3D& seg)
+{
+    double a = 0.0;
+    double b = 1.0;
+    for(unsigned int it=0; it<200; ++it)
+    {
+        double t1 = a+(b-a)/3.0;
+        double t2 = b-(b-a)/3.0;
+
+        Eigen::Vector3d X1 = seg.P1()+(seg.P2()-seg.P1())*t1;
+        Eigen::Vector3d X2 = seg.P1()+(seg.P2()-seg.P1())*t2;
+        double s1 = fmax((X1-ray.origin_).dot(ray.direction_),0.0);
+        double s2 = fmax((X2-ray.origin_).dot(ray.direction_),0.0);
+        double d1 = (X1-ray.origin_-s1*ray.direction_).norm();
+        double d2 = (X2-ray.origin_-s2*ray.direction_).norm();
+
+        if(d1 < d2)
+            b = t2;
+        else
+            a = t1;
+    }
+
+    Eigen::Vector3d X = seg.P1()+(seg.P2()-seg.P1())*(0.5*(a+b));
+    double s = fmax((X-ray.origin_).dot(ray.direction_),0.0);
+    return (X-ray.origin_-s*ray.direction_).norm();
+}
+
+//------------------------------------------------------------------------------
+// max. violation of the frustum planes over dense samples of the segment (<= 0 -> inside)
+double sampledFrustumViolation(const L3DPP::Segment3D& seg, const L3DPP::SpatialFrustum& frustum)
+{
+    double best = 1e30;
+    for(unsigned int s=0; s<=1000; ++s)
+    {
+        Eigen::Vector3d X = seg.P1()+(seg.P2()-seg.P1())*(double(s)/1000.0);
+        double violation = 0.0;
+        for(size_t i=0; i<frustum.normals_.size(); ++i)
+            violation = fmax(violation,-(frustum.normals_[i].dot(X)+frustum.offsets_[i]));
+
+        best = fmin(best,violation);
+    }
+    return best;
+}
+
+//------------------------------------------------------------------------------
+void testNearest(const std::vector<L3DPP::FinalLine3D>& lines3D, const L3DPP::SpatialIndex& index)
+{
+    const unsigned int k = 7;
+    std::vector<Eigen::Vector3d> points;
+    for(unsigned int i=0; i<200; ++i)
+        points.push_back(randomPoint(12.0));
+
+    std::vector<std::vector<L3DPP::SpatialHit> > results;
+    index.queryNearest(points,k,results);
+    L3DPP_CHECK(results.size() == points.size());
+
+    for(size_t q=0; q<points.size() && q<results.size(); ++q)
+    {
+        // brute force: closest segment per line
+        std::vector<std::pair<double,unsigned int> > dists;
+        for(size_t i=0; i<lines3D.size(); ++i)
+        {
+            double best = 1e30;
+            for(size_t j=0; j<lines3D[i].collinear3Dsegments_.size(); ++j)
+                best = fmin(best,distancePointSegment(points[q],lines3D[i].collinear3Dsegments_[j]));
+
+            dists.push_back(std::pair<double,unsigned int>(best,i));
+        }
+        std::sort(dists.begin(),dists.end());
+
+        L3DPP_CHECK(results[q].size() == k);
+        for(size_t i=0; i<results[q].size() && i<k; ++i)
+        {
+            const L3DPP::SpatialHit& hit = results[q][i];
+            L3DPP_CHECK_NEAR(hit.distance_,dists[i].first,1e-4);
+
+            // the reported segment has the reported distance
+            const L3DPP::Segment3D& seg = lines3D[hit.lineID_].collinear3Dsegments_[hit.segmentID_];
+            L3DPP_CHECK_NEAR(distancePointSegment(points[q],seg),hit.distance_,1e-4);
+
+            // one hit per line
+            for(size_t j=0; j<i; ++j)
+            {
+                L3DPP_CHECK(results[q][j].lineID_ != hit.lineID_);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void testBox(const std::vector<L3DPP::FinalLine3D>& lines3D, const L3DPP::SpatialIndex& index)
+{
+    std::vector<L3DPP::SpatialBox> boxes;
+    for(unsigned int i=0; i<100; ++i)
+    {
+        Eigen::Vector3d C = randomPoint(10.0);
+        Eigen::Vector3d ext = randomPoint(3.0).cwiseAbs();
+        boxes.push_back(L3DPP::SpatialBox(C-ext,C+ext));
+    }
+
+    std::vector<std::vector<L3DPP::SpatialHit> > results;
+    index.queryBox(boxes,results);
+    L3DPP_CHECK(results.size() == boxes.size());
+
+    size_t num_hits = 0;
+    for(size_t q=0; q<boxes.size() && q<results.size(); ++q)
+    {
+        std::set<std::pair<unsigned int,unsigned int> > hits;
+        num_hits += results[q].size();
+        for(size_t i=0; i<results[q].size(); ++i)
+        {
+            hits.insert(std::make_pair(results[q][i].lineID_,results[q][i].segmentID_));
+
+            // sorted by IDs
+            if(i > 0)
+            {
+                L3DPP_CHECK(!L3DPP::sortSpatialHitsByID(results[q][i],results[q][i-1]));
+            }
+        }
+
+        for(size_t i=0; i<lines3D.size(); ++i)
+        {
+            for(size_t j=0; j<lines3D[i].collinear3Dsegments_.size(); ++j)
+            {
+                const L3DPP::Segment3D& seg = lines3D[i].collinear3Dsegments_[j];
+                bool hit = (hits.find(std::make_pair((unsigned int)i,(unsigned int)j)) != hits.end());
+
+                // no false negatives, hits touch the box
+                if(sampledInBox(seg,boxes[q],0.0))
+                {
+                    L3DPP_CHECK(hit);
+                }
+                if(hit)
+                {
+                    L3DPP_CHECK(sampledInBox(seg,boxes[q],0.01));
+                }
+            }
+        }
+    }
+
+    // not trivially empty
+    L3DPP_CHECK(num_hits > 0);
+}
+
+//------------------------------------------------------------------------------
+void testRay(const std::vector<L3DPP::FinalLine3D>& lines3D, const L3DPP::SpatialIndex& index)
+{
+    std::vector<L3DPP::SpatialRay> rays;
+    for(unsigned int i=0; i<100; ++i)
+        rays.push_back(L3DPP::SpatialRay(randomPoint(15.0),randomPoint(1.0),0.2+L3DPP::testRandom()));
+
+    std::vector<std::vector<L3DPP::SpatialHit> > results;
+    index.queryRay(rays,results);
+    L3DPP_CHECK(results.size() == rays.size());
+
+    size_t num_hits = 0;
+    for(size_t q=0; q<rays.size() && q<results.size(); ++q)
+    {
+        std::set<std::pair<unsigned int,unsigned int> > hits;
+        num_hits += results[q].size();
+        for(size_t i=0; i<results[q].size(); ++i)
+        {
+            hits.insert(std::make_pair(results[q][i].lineID_,results[q][i].segmentID_));
+
+            // sorted by position along the ray
+            if(i > 0)
+            {
+                L3DPP_CHECK(results[q][i-1].distance_ <= results[q][i].distance_);
+            }
+        }
+
+        for(size_t i=0; i<lines3D.size(); ++i)
+        {
+            for(size_t j=0; j<lines3D[i].collinear3Dsegments_.size(); ++j)
+            {
+                double dist = distanceRaySegment(rays[q],lines3D[i].collinear3Dsegments_[j]);
+                if(fabs(dist-rays[q].radius_) < 1e-6)
+                    continue;
+
+                bool hit = (hits.find(std::make_pair((unsigned int)i,(unsigned int)j)) != hits.end());
+                L3DPP_CHECK(hit == (dist < rays[q].radius_));
+            }
+        }
+    }
+
+    // not trivially empty
+    L3DPP_CHECK(num_hits > 0);
+}
+
+//------------------------------------------------------------------------------
+void testFrustum(const std::vector<L3DPP::FinalLine3D>& lines3D, const L3DPP::SpatialIndex& index)
+{
+    Eigen::Matrix3d K = Eigen::Matrix3d::Identity();
+    K(0,0) = 500.0; K(1,1) = 500.0;
+    K(0,2) = 320.0; K(1,2) = 240.0;
+
+    std::vector<L3DPP::SpatialFrustum> frusta;
+    for(unsigned int i=0; i<20; ++i)
+    {
+        Eigen::Matrix3d R = Eigen::AngleAxisd(L3DPP::testRandom()*M_PI,randomPoint(1.0).normalized()).toRotationMatrix();
+        Eigen::Vector3d C = randomPoint(5.0);
+        Eigen::Vector3d t = -R*C;
+        frusta.push_back(L3DPP::SpatialFrustum(K,R,t,640,480,0.5,(i%2 == 0) ? 15.0 : -1.0));
+    }
+
+    std::vector<std::vector<L3DPP::SpatialHit> > results;
+    index.queryFrustum(frusta,results);
+    L3DPP_CHECK(results.size() == frusta.size());
+
+    size_t num_hits = 0;
+    for(size_t q=0; q<frusta.size() && q<results.size(); ++q)
+    {
+        std::set<std::pair<unsigned int,unsigned int> > hits;
+        num_hits += results[q].size();
+        for(size_t i=0; i<results[q].size(); ++i)
+            hits.insert(std::make_pair(results[q][i].lineID_,results[q][i].segmentID_));
+
+        for(size_t i=0; i<lines3D.size(); ++i)
+        {
+            for(size_t j=0; j<lines3D[i].collinear3Dsegments_.size(); ++j)
+            {
+                double violation = sampledFrustumViolation(lines3D[i].collinear3Dsegments_[j],frusta[q]);
+                bool hit = (hits.find(std::make_pair((unsigned int)i,(unsigned int)j)) != hits.end());
+
+                // no false negatives, hits touch the frustum
+                if(violation <= 0.0)
+                {
+                    L3DPP_CHECK(hit);
+                }
+                if(hit)
+                {
+                    L3DPP_CHECK(violation < 0.01);
+                }
+            }
+        }
+    }
+
+    // not trivially empty
+    L3DPP_CHECK(num_hits > 0);
+}
+
+//------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    std::vector<L3DPP::FinalLine3D> lines3D;
+    createLines(500,lines3D);
+
+    L3DPP::SpatialIndex index;
+    index.build(lines3D);
+
+    size_t num_segments = 0;
+    for(size_t i=0; i<lines3D.size(); ++i)
+        num_segments += lines3D[i].collinear3Dsegments_.size();
+
+    L3DPP_CHECK(!index.empty());
+    L3DPP_CHECK(index.num_segments() == num_segments);
+
+    testNearest(lines3D,index);
+    testBox(lines3D,index);
+    testRay(lines3D,index);
+    testFrustum(lines3D,index);
+
+    // empty index
+    L3DPP::SpatialIndex empty;
+    std::vector<L3DPP::SpatialHit> result;
+    empty.queryNearest(Eigen::Vector3d::Zero(),3,result);
+    L3DPP_CHECK(result.empty());
+
+    return L3DPP::testResult("spatialindex");
+}
@@ -0,0 +1,68 @@
+#ifndef I3D_LINE3D_PP_TESTCOMMONS_H_
+#define I3D_LINE3D_PP_TESTCOMMONS_H_
+
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// std
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
+/**
+ * Line3D++ - Test commons
+ * ====================
+ * Minimal checks for the behavior tests
+ * (no test framework required). Each test
+ * is a small executable that returns 0
+ * if all checks passed (see CMakeLists.txt).
+ * ====================
+ */
+
+namespace L3DPP
+{
+    // number of failed checks
+    static unsigned int test_failures = 0;
+
+    // deterministic random numbers [0,1]
+    static unsigned int test_seed = 42;
+    static float testRandom()
+    {
+        test_seed = test_seed*1103515245u+12345u;
+        return float((test_seed/65536u)%32768u)/32767.0f;
+    }
+
+    // result of a test executable
+    static int testResult(const std::string& name)
+    {
+        if(test_failures == 0)
+            std::cout << "[" << name << "] passed" << std::endl;
+        else
+            std::cout << "[" << name << "] " << test_failures << " check(s) failed" << std::endl;
+
+        return (test_failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+}
+
+// checks (continue after a failure)
+#define L3DPP_CHECK(cond) \
+    if(!(cond)){ \
+        std::cout << __FILE__ << ":" << __LINE__ << ": check failed: " << #cond << std::endl; \
+        ++L3DPP::test_failures; \
+    }
+
+#define L3DPP_CHECK_NEAR(a,b,eps) \
+    if(!(std::fabs(double(a)-double(b)) <= double(eps))){ \
+        std::cout << __FILE__ << ":" << __LINE__ << ": check failed: " << #a << "=" << (a); \
+        std::cout << " != " << #b << "=" << (b) << " (eps=" << (eps) << ")" << std::endl; \
+        ++L3DPP::test_failures; \
+    }
+
+#endif //I3D_LINE3D_PP_TESTCOMMONS_H_
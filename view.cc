@@ -9,9 +9,9 @@ namespace L3DPP
                const unsigned int width, const unsigned int height,
                const float median_depth,
                L3DPP::DataArray<float>* superpixels) :
-        id_(id), lines_(lines), K_(K), R_(R), t_(t),
-        width_(width), height_(height), initial_median_depth_(fmax(fabs(median_depth),L3D_EPS)),
-        superpixels_(superpixels)
+        lines_(lines), qlines_(NULL), keypoints_(NULL), superpixels_(superpixels),
+        id_(id), K_(K), R_(R), t_(t), width_(width), height_(height),
+        initial_median_depth_(fmax(fabs(median_depth),L3D_EPS))
     {
         // init
         diagonal_ = sqrtf(float(width_*width_+height_*height_));
@@ -19,18 +19,42 @@ namespace L3DPP
 
         collin_t_ = 0.0f;
 
+        num_lines_ = lines_->width();
+        qoffset_x_ = 0.0f;
+        qoffset_y_ = 0.0f;
+        qscale_x_ = 1.0f;
+        qscale_y_ = 1.0f;
+
         // camera
         pp_ = Eigen::Vector3d(K_(0,2),K_(1,2),1.0);
 
         Kinv_ = K_.inverse();
         Rt_ = R_.transpose();
         RtKinv_  = Rt_*Kinv_;
+        RtKinv_f_ = RtKinv_.cast<float>();
         C_ = Rt_ * (-1.0 * t_);
 
         k_ = 0.0f;
         median_depth_ = 0.0f;
         median_sigma_ = 0.0f;
 
+        // rank segments by length (longest first)
+        std::vector<std::pair<float,unsigned int> > by_length(lines_->width());
+        for(unsigned int i=0; i<lines_->width(); ++i)
+        {
+            float4 coords = segment(i);
+            float dx = coords.x-coords.z;
+            float dy = coords.y-coords.w;
+            by_length[i] = std::pair<float,unsigned int>(-(dx*dx+dy*dy),i);
+        }
+        std::sort(by_length.begin(),by_length.end());
+
+        length_rank_ = std::vector<unsigned int>(lines_->width());
+        for(unsigned int i=0; i<by_length.size(); ++i)
+            length_rank_[by_length[i].second] = i;
+
+        num_active_ = lines_->width();
+
 #ifdef L3DPP_CUDA
         C_f3_ = make_float3(C_.x(),C_.y(),C_.z());
         // RtKinv -> data array
@@ -47,9 +71,15 @@ namespace L3DPP
         if(lines_ != NULL)
             delete lines_;
 
+        if(qlines_ != NULL)
+            delete qlines_;
+
         if(superpixels_ != NULL)
             delete superpixels_;
 
+        if(keypoints_ != NULL)
+            delete keypoints_;
+
 #ifdef L3DPP_CUDA
         if(RtKinv_DA_ != NULL)
             delete RtKinv_DA_;
@@ -61,9 +91,9 @@ namespace L3DPP
     {
         img = cv::Mat::zeros(height_,width_,CV_8UC3);
 
-        for(size_t i=0; i<lines_->width(); ++i)
+        for(size_t i=0; i<num_lines_; ++i)
         {
-            float4 coords = lines_->dataCPU(i,0)[0];
+            float4 coords = segment(i);
 
             cv::Point p1(coords.x,coords.y);
             cv::Point p2(coords.z,coords.w);
@@ -75,9 +105,9 @@ namespace L3DPP
     void View::drawSingleLine(const unsigned int id, cv::Mat& img,
                               const cv::Scalar& color)
     {
-        if(id < lines_->width())
+        if(id < num_lines_)
         {
-            float4 coords = lines_->dataCPU(id,0)[0];
+            float4 coords = segment(id);
             cv::Point p1(coords.x,coords.y);
             cv::Point p2(coords.z,coords.w);
             cv::line(img,p1,p2,color,3);
@@ -169,19 +199,233 @@ namespace L3DPP
         }
     }
 
+    //------------------------------------------------------------------------------
+    void View::setActiveFraction(const float f)
+    {
+        float fraction = fmin(fmax(f,0.0f),1.0f);
+        num_active_ = std::max((unsigned int)(ceilf(fraction*float(num_lines_))),
+                               std::min((unsigned int)1,num_lines_));
+    }
+
+    //------------------------------------------------------------------------------
+    void View::relocate()
+    {
+        if(qlines_ != NULL)
+        {
+            // copy (new pages are touched by this thread first)
+            L3DPP::DataArray<L3DPP::QuantizedSegment2D>* qlines = new L3DPP::DataArray<L3DPP::QuantizedSegment2D>(qlines_->width(),
+                                                                                                                   qlines_->height());
+            qlines_->copyTo(qlines);
+            delete qlines_;
+            qlines_ = qlines;
+        }
+        else if(lines_ != NULL)
+        {
+#ifdef L3DPP_CUDA
+            if(lines_->onGPU())
+                return;
+#endif //L3DPP_CUDA
+
+            // copy (new pages are touched by this thread first)
+            L3DPP::DataArray<float4>* lines = new L3DPP::DataArray<float4>(lines_->width(),
+                                                                           lines_->height());
+            lines_->copyTo(lines);
+            delete lines_;
+            lines_ = lines;
+        }
+
+        if(collin_.size() > 0)
+            std::vector<std::list<unsigned int> >(collin_).swap(collin_);
+    }
+
+    //------------------------------------------------------------------------------
+    void View::prefetch()
+    {
+#ifdef __GNUC__
+        const char* data = NULL;
+        size_t bytes = 0;
+        if(qlines_ != NULL)
+        {
+            data = reinterpret_cast<const char*>(qlines_->dataCPU());
+            bytes = num_lines_*sizeof(L3DPP::QuantizedSegment2D);
+        }
+        else if(lines_ != NULL)
+        {
+            data = reinterpret_cast<const char*>(lines_->dataCPU());
+            bytes = num_lines_*sizeof(float4);
+        }
+
+        // one hint per cache line (read, low temporal locality)
+        for(size_t b=0; data != NULL && b<bytes; b+=L3D_CACHE_LINE_SIZE)
+            __builtin_prefetch(data+b,0,1);
+
+        if(descriptors_.size() > 0)
+        {
+            data = reinterpret_cast<const char*>(&descriptors_[0]);
+            bytes = descriptors_.size()*sizeof(L3DPP::LineDescriptor);
+            for(size_t b=0; b<bytes; b+=L3D_CACHE_LINE_SIZE)
+                __builtin_prefetch(data+b,0,1);
+        }
+#endif //__GNUC__
+    }
+
+    //------------------------------------------------------------------------------
+    void View::quantize()
+    {
+        if(qlines_ != NULL || lines_ == NULL)
+            return;
+
+#ifdef L3DPP_CUDA
+        if(lines_->onGPU())
+            return;
+#endif //L3DPP_CUDA
+
+        // range of all endpoints (at least the image, endpoints
+        // outside of the image are covered as well)
+        float min_x = 0.0f; float max_x = float(width_);
+        float min_y = 0.0f; float max_y = float(height_);
+        for(unsigned int i=0; i<num_lines_; ++i)
+        {
+            float4 c = lines_->dataCPU(i,0)[0];
+            min_x = fmin(min_x,fmin(c.x,c.z)); max_x = fmax(max_x,fmax(c.x,c.z));
+            min_y = fmin(min_y,fmin(c.y,c.w)); max_y = fmax(max_y,fmax(c.y,c.w));
+        }
+
+        // range -> [0,65535]
+        qoffset_x_ = min_x;
+        qoffset_y_ = min_y;
+        qscale_x_ = fmax(max_x-min_x,1.0f)/65535.0f;
+        qscale_y_ = fmax(max_y-min_y,1.0f)/65535.0f;
+
+        qlines_ = new L3DPP::DataArray<L3DPP::QuantizedSegment2D>(num_lines_,1);
+        for(unsigned int i=0; i<num_lines_; ++i)
+        {
+            float4 c = lines_->dataCPU(i,0)[0];
+
+            L3DPP::QuantizedSegment2D q;
+            q.x1_ = quantizeCoord(c.x,qoffset_x_,qscale_x_);
+            q.y1_ = quantizeCoord(c.y,qoffset_y_,qscale_y_);
+            q.x2_ = quantizeCoord(c.z,qoffset_x_,qscale_x_);
+            q.y2_ = quantizeCoord(c.w,qoffset_y_,qscale_y_);
+            qlines_->dataCPU(i,0)[0] = q;
+        }
+
+        delete lines_;
+        lines_ = NULL;
+    }
+
+    //------------------------------------------------------------------------------
+    void View::orderSpatially()
+    {
+        if(spatially_ordered() || num_lines_ < 2 || collin_.size() > 0)
+            return;
+
+#ifdef L3DPP_CUDA
+        if(lines_ != NULL && lines_->onGPU())
+            return;
+#endif //L3DPP_CUDA
+
+        // sort by Morton code (ties -> previous order)
+        std::vector<std::pair<unsigned int,unsigned int> > by_code(num_lines_);
+        for(unsigned int i=0; i<num_lines_; ++i)
+            by_code[i] = std::pair<unsigned int,unsigned int>(mortonCode(segment(i)),i);
+
+        std::sort(by_code.begin(),by_code.end());
+
+        original_id_ = std::vector<unsigned int>(num_lines_);
+        internal_id_ = std::vector<unsigned int>(num_lines_);
+        std::vector<unsigned int> length_rank(num_lines_);
+        for(unsigned int i=0; i<num_lines_; ++i)
+        {
+            unsigned int orig = by_code[i].second;
+            original_id_[i] = orig;
+            internal_id_[orig] = i;
+            length_rank[i] = length_rank_[orig];
+        }
+        length_rank_.swap(length_rank);
+
+        // permute segment data
+        if(qlines_ != NULL)
+        {
+            L3DPP::DataArray<L3DPP::QuantizedSegment2D>* qlines = new L3DPP::DataArray<L3DPP::QuantizedSegment2D>(num_lines_,1);
+            for(unsigned int i=0; i<num_lines_; ++i)
+                qlines->dataCPU(i,0)[0] = qlines_->dataCPU(original_id_[i],0)[0];
+
+            delete qlines_;
+            qlines_ = qlines;
+        }
+        else
+        {
+            L3DPP::DataArray<float4>* lines = new L3DPP::DataArray<float4>(num_lines_,1);
+            for(unsigned int i=0; i<num_lines_; ++i)
+                lines->dataCPU(i,0)[0] = lines_->dataCPU(original_id_[i],0)[0];
+
+            delete lines_;
+            lines_ = lines;
+        }
+
+        if(descriptors_.size() > 0)
+        {
+            std::vector<L3DPP::LineDescriptor> descriptors(num_lines_);
+            for(unsigned int i=0; i<num_lines_; ++i)
+                descriptors[i] = descriptors_[original_id_[i]];
+
+            descriptors_.swap(descriptors);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    unsigned short View::quantizeCoord(const float val, const float offset, const float scale)
+    {
+        // (clamping only guards against rounding, the range covers all endpoints)
+        return (unsigned short)(fmin(fmax((val-offset)/scale,0.0f),65535.0f)+0.5f);
+    }
+
+#ifdef L3DPP_CUDA
+    //------------------------------------------------------------------------------
+    void View::uploadLines()
+    {
+        if(qlines_ != NULL && lines_ == NULL)
+        {
+            // temporary float copy (only while on the GPU)
+            lines_ = new L3DPP::DataArray<float4>(num_lines_,1);
+            for(unsigned int i=0; i<num_lines_; ++i)
+                lines_->dataCPU(i,0)[0] = segment(i);
+        }
+
+        if(!lines_->onGPU())
+            lines_->upload();
+    }
+
+    //------------------------------------------------------------------------------
+    void View::removeLinesFromGPU()
+    {
+        if(lines_ == NULL)
+            return;
+
+        lines_->removeFromGPU();
+
+        if(qlines_ != NULL)
+        {
+            delete lines_;
+            lines_ = NULL;
+        }
+    }
+#endif //L3DPP_CUDA
+
     //------------------------------------------------------------------------------
     void View::findCollinGPU()
     {
         // reset
-        collin_ = std::vector<std::list<unsigned int> >(lines_->width());
+        collin_ = std::vector<std::list<unsigned int> >(num_lines_);
 
 #ifdef L3DPP_CUDA
         // upload
-        lines_->upload();
+        uploadLines();
 
         // buffer
-        L3DPP::DataArray<char>* buffer = new L3DPP::DataArray<char>(lines_->width(),
-                                                                    lines_->width(),true);
+        L3DPP::DataArray<char>* buffer = new L3DPP::DataArray<char>(num_lines_,
+                                                                    num_lines_,true);
 
         // GPU function
         L3DPP::find_collinear_segments_GPU(buffer,lines_,collin_t_);
@@ -204,7 +448,7 @@ namespace L3DPP
 
         // cleanup
         delete buffer;
-        lines_->removeFromGPU();
+        removeLinesFromGPU();
 #endif //L3DPP_CUDA
     }
 
@@ -212,7 +456,10 @@ namespace L3DPP
     void View::findCollinCPU()
     {
         // reset
-        collin_ = std::vector<std::list<unsigned int> >(lines_->width());
+        collin_ = std::vector<std::list<unsigned int> >(num_lines_);
+
+        // (dequantized on access)
+        const L3DPP::SegmentAccessor lines = segments();
 
 #ifdef L3DPP_OPENMP
         #pragma omp parallel for
@@ -220,19 +467,19 @@ namespace L3DPP
         for(int r=0; r<collin_.size(); ++r)
         {
             Eigen::Vector3d p[2];
-            float4 l1 = lines_->dataCPU(r,0)[0];
+            float4 l1 = lines[r];
 
             p[0] = Eigen::Vector3d(l1.x,l1.y,1.0f);
             p[1] = Eigen::Vector3d(l1.z,l1.w,1.0f);
             Eigen::Vector3d line1 = p[0].cross(p[1]);
 
-            for(size_t c=0; c<lines_->width(); ++c)
+            for(size_t c=0; c<num_lines_; ++c)
             {
                 if(r == c)
                     continue;
 
                 // line data
-                float4 l2 = lines_->dataCPU(c,0)[0];
+                float4 l2 = lines[c];
 
                 Eigen::Vector3d q[2];
                 q[0] = Eigen::Vector3d(l2.x,l2.y,1.0f);
@@ -279,10 +526,33 @@ namespace L3DPP
         return angle;
     }
 
+    //------------------------------------------------------------------------------
+    unsigned int View::mortonCode(const float4& coords) const
+    {
+        // midpoint -> [0,65535]^2
+        float mx = 0.5f*(coords.x+coords.z)/fmax(float(width_),1.0f);
+        float my = 0.5f*(coords.y+coords.w)/fmax(float(height_),1.0f);
+        unsigned int x = (unsigned int)(fmin(fmax(mx,0.0f),1.0f)*65535.0f);
+        unsigned int y = (unsigned int)(fmin(fmax(my,0.0f),1.0f)*65535.0f);
+
+        // interleave bits
+        x = (x | (x << 8)) & 0x00FF00FF;
+        x = (x | (x << 4)) & 0x0F0F0F0F;
+        x = (x | (x << 2)) & 0x33333333;
+        x = (x | (x << 1)) & 0x55555555;
+
+        y = (y | (y << 8)) & 0x00FF00FF;
+        y = (y | (y << 4)) & 0x0F0F0F0F;
+        y = (y | (y << 2)) & 0x33333333;
+        y = (y | (y << 1)) & 0x55555555;
+
+        return (x | (y << 1));
+    }
+
     //------------------------------------------------------------------------------
     std::list<unsigned int> View::collinearSegments(const unsigned int segID)
     {
-        if(collin_.size() == lines_->width() && segID < lines_->width())
+        if(collin_.size() == num_lines_ && segID < num_lines_)
             return collin_[segID];
         else
             return std::list<unsigned int>();
@@ -331,20 +601,20 @@ namespace L3DPP
                                                     const bool pt1)
     {
         Eigen::Vector3d ray(0,0,0);
-        if(lID < lines_->width())
+        if(lID < num_lines_)
         {
             Eigen::Vector3d p;
             if(pt1)
             {
                 // ray through P1
-                p = Eigen::Vector3d(lines_->dataCPU(lID,0)[0].x,
-                                    lines_->dataCPU(lID,0)[0].y,1.0);
+                p = Eigen::Vector3d(segment(lID).x,
+                                    segment(lID).y,1.0);
             }
             else
             {
                 // ray through P2
-                p = Eigen::Vector3d(lines_->dataCPU(lID,0)[0].z,
-                                    lines_->dataCPU(lID,0)[0].w,1.0);
+                p = Eigen::Vector3d(segment(lID).z,
+                                    segment(lID).w,1.0);
             }
 
             return getNormalizedRay(p);
@@ -357,12 +627,12 @@ namespace L3DPP
                                             const float depth2)
     {
         L3DPP::Segment3D seg3D;
-        if(segID < lines_->width())
+        if(segID < num_lines_)
         {
-            Eigen::Vector3d p1(lines_->dataCPU(segID,0)[0].x,
-                               lines_->dataCPU(segID,0)[0].y,1.0);
-            Eigen::Vector3d p2(lines_->dataCPU(segID,0)[0].z,
-                               lines_->dataCPU(segID,0)[0].w,1.0);
+            Eigen::Vector3d p1(segment(segID).x,
+                               segment(segID).y,1.0);
+            Eigen::Vector3d p2(segment(segID).z,
+                               segment(segID).w,1.0);
 
             seg3D = L3DPP::Segment3D(C_ + getNormalizedRay(p1)*depth1,
                                      C_ + getNormalizedRay(p2)*depth2);
@@ -430,9 +700,9 @@ namespace L3DPP
     Eigen::Vector4f View::getLineSegment2D(const unsigned int id)
     {
         Eigen::Vector4f coords(0,0,0,0);
-        if(id < lines_->width())
+        if(id < num_lines_)
         {
-            float4 c = lines_->dataCPU(id,0)[0];
+            float4 c = segment(id);
             coords(0) = c.x;
             coords(1) = c.y;
             coords(2) = c.z;
@@ -466,12 +736,12 @@ namespace L3DPP
     double View::segmentQualityAngle(const L3DPP::Segment3D& seg3D,
                                      const unsigned int segID)
     {
-        if(segID < lines_->width())
+        if(segID < num_lines_)
         {
-            Eigen::Vector2d p1(lines_->dataCPU(segID,0)[0].x,
-                               lines_->dataCPU(segID,0)[0].y);
-            Eigen::Vector2d p2(lines_->dataCPU(segID,0)[0].z,
-                               lines_->dataCPU(segID,0)[0].w);
+            Eigen::Vector2d p1(segment(segID).x,
+                               segment(segID).y);
+            Eigen::Vector2d p2(segment(segID).z,
+                               segment(segID).w);
             Eigen::Vector2d p = 0.5*(p1+p2);
 
             Eigen::Vector3d r1 = getNormalizedRay(p);
@@ -33,7 +33,10 @@
 #include "commons.h"
 #include "dataArray.h"
 #include "segment3D.h"
+#include "precision.h"
 #include "cudawrapper.h"
+#include "linedescriptor.h"
+#include "keypointgrid.h"
 
 /**
  * Line3D++ - View Class
@@ -46,6 +49,48 @@
 
 namespace L3DPP
 {
+    //------------------------------------------------------------------------------
+    // read access to the 2D segments of a view without copying them,
+    // quantized segments are dequantized on the fly (see View::segments())
+    class SegmentAccessor
+    {
+    public:
+        SegmentAccessor(const float4* lines, const unsigned int num) :
+            lines_(lines), qlines_(NULL), num_(num),
+            offset_x_(0.0f), offset_y_(0.0f), scale_x_(1.0f), scale_y_(1.0f){}
+        SegmentAccessor(const L3DPP::QuantizedSegment2D* qlines, const unsigned int num,
+                        const float offset_x, const float offset_y,
+                        const float scale_x, const float scale_y) :
+            lines_(NULL), qlines_(qlines), num_(num),
+            offset_x_(offset_x), offset_y_(offset_y), scale_x_(scale_x), scale_y_(scale_y){}
+
+        unsigned int size() const {return num_;}
+
+        // coordinates of a segment (x1,y1,x2,y2)
+        float4 operator[](const unsigned int id) const
+        {
+            if(lines_ != NULL)
+                return lines_[id];
+
+            const L3DPP::QuantizedSegment2D& q = qlines_[id];
+            float4 c;
+            c.x = offset_x_+float(q.x1_)*scale_x_;
+            c.y = offset_y_+float(q.y1_)*scale_y_;
+            c.z = offset_x_+float(q.x2_)*scale_x_;
+            c.w = offset_y_+float(q.y2_)*scale_y_;
+            return c;
+        }
+
+    private:
+        const float4* lines_;
+        const L3DPP::QuantizedSegment2D* qlines_;
+        unsigned int num_;
+        float offset_x_;
+        float offset_y_;
+        float scale_x_;
+        float scale_y_;
+    };
+
     class View
     {
     public:
@@ -64,6 +109,85 @@ namespace L3DPP
         // find collinear segments
         void findCollinearSegments(const float dist_t, bool useGPU);
 
+        // restrict processing to the longest segments (fraction in [0,1])
+        void setActiveFraction(const float f);
+        bool active(const unsigned int segID) const {return (length_rank_[segID] < num_active_);}
+        bool all_active() const {return (num_active_ >= num_lines_);}
+        unsigned int num_active_lines() const {return num_active_;}
+
+        // re-allocates the segment data from the calling thread
+        // (first-touch -> memory is placed on its NUMA node)
+        void relocate();
+
+        // hints that the segment data (and descriptors) will be needed
+        // soon: non-blocking prefetch into the cache (GCC/Clang only)
+        void prefetch();
+
+        // stores the segments in 16-bit fixed point (half the memory,
+        // see QuantizedSegment2D for the error bound), segments are
+        // dequantized on access
+        void quantize();
+        bool quantized() const {return (qlines_ != NULL);}
+
+        // reorders the segments along a Morton curve over their midpoints
+        // (spatially close segments are close in memory), the length ranks
+        // are kept and the original IDs can be recovered
+        void orderSpatially();
+        bool spatially_ordered() const {return (original_id_.size() > 0);}
+        unsigned int originalID(const unsigned int segID) const
+        {
+            return spatially_ordered() ? original_id_[segID] : segID;
+        }
+        unsigned int internalID(const unsigned int originalID) const
+        {
+            return spatially_ordered() ? internal_id_[originalID] : originalID;
+        }
+
+        // line descriptors (one per segment in the original order, or none),
+        // must be set before orderSpatially()
+        void setDescriptors(std::vector<L3DPP::LineDescriptor>& descriptors)
+        {
+            if(descriptors.size() == num_lines_ && !spatially_ordered())
+                descriptors_.swap(descriptors);
+        }
+        bool has_descriptors() const {return (descriptors_.size() > 0);}
+        const L3DPP::LineDescriptor& descriptor(const unsigned int segID) const
+        {
+            return descriptors_[segID];
+        }
+
+        // 2D observations of the worldpoints (owned by the view, replaces previous ones)
+        void setKeypoints(L3DPP::KeypointGrid* keypoints)
+        {
+            if(keypoints_ != NULL)
+                delete keypoints_;
+
+            keypoints_ = keypoints;
+        }
+        const L3DPP::KeypointGrid* keypoints() const {return keypoints_;}
+
+        // coordinates of a segment (x1,y1,x2,y2)
+        float4 segment(const unsigned int id) const
+        {
+            return segments()[id];
+        }
+
+        // read access to all segments (quantized segments are dequantized per access)
+        L3DPP::SegmentAccessor segments() const
+        {
+            if(qlines_ == NULL)
+                return L3DPP::SegmentAccessor(lines_->dataCPU(),num_lines_);
+
+            return L3DPP::SegmentAccessor(qlines_->dataCPU(),num_lines_,
+                                          qoffset_x_,qoffset_y_,qscale_x_,qscale_y_);
+        }
+
+#ifdef L3DPP_CUDA
+        // segments on the GPU (quantized segments are dequantized for upload)
+        void uploadLines();
+        void removeLinesFromGPU();
+#endif //L3DPP_CUDA
+
         // draws lines into image
         void drawLineImage(cv::Mat& img);
         void drawSingleLine(const unsigned int id, cv::Mat& img,
@@ -129,6 +253,32 @@ namespace L3DPP
         // compute regularizer with respect to given 3D point
         float regularizerFrom3Dpoint(const Eigen::Vector3d& P);
 
+        // kernel precision P (see precision.h): only directions and offsets
+        // relative to camera centers are used, no world coordinates
+        // -------------------------------------
+        // normalized rays through the endpoints of a segment
+        template<class P>
+        void segmentRaysAs(const unsigned int segID, typename P::Vector3& ray1,
+                           typename P::Vector3& ray2) const;
+        // direction of an unprojected segment (the camera center cancels out)
+        template<class P>
+        typename P::Vector3 unprojectedDirAs(const unsigned int segID, const float depth1,
+                                             const float depth2) const;
+        // offset of the camera center to the center of another view (C - C_v)
+        template<class P>
+        typename P::Vector3 centerOffsetAs(const L3DPP::View* v) const {
+            return (C_-v->C_).cast<typename P::Scalar>();
+        }
+        // regularizer for a 3D point given relative to the camera center
+        template<class P>
+        float regularizerFromOffsetAs(const typename P::Vector3& offset) const {
+            return float(offset.norm())*k_;
+        }
+        // angle between the ray through the segment center and a 3D direction
+        template<class P>
+        double segmentQualityAngleAs(const typename P::Vector3& dir,
+                                     const unsigned int segID) const;
+
         // get coordinates of a specific line segment
         Eigen::Vector4f getLineSegment2D(const unsigned int id);
 
@@ -143,14 +293,17 @@ namespace L3DPP
         Eigen::Matrix3d R() const {return R_;}
         Eigen::Matrix3d Rt() const {return Rt_;}
         Eigen::Matrix3d RtKinv() const {return RtKinv_;}
+        template<class P>
+        const typename P::Matrix3& RtKinvAs() const;
         Eigen::Vector3d t() const {return t_;}
         Eigen::Vector3d pp() const {return pp_;}
         unsigned int width() const {return width_;}
         unsigned int height() const {return height_;}
         float diagonal() const {return diagonal_;}
+        // (quantized: only valid between uploadLines() and removeLinesFromGPU())
         L3DPP::DataArray<float4>* lines(){return lines_;}
         L3DPP::DataArray<float>* superpixels(){return superpixels_;}
-        size_t num_lines() const {return lines_->width();}
+        size_t num_lines() const {return num_lines_;}
         float k() const {return k_;}
         float median_depth() const {return median_depth_;}
         float median_sigma() const {return median_sigma_;}
@@ -181,8 +334,35 @@ namespace L3DPP
         // smaller angle between two lines [0,pi/2]
         float smallerAngle(const Eigen::Vector2d& v1, const Eigen::Vector2d& v2);
 
+        // fixed point coordinate (see quantize())
+        static unsigned short quantizeCoord(const float val, const float offset,
+                                            const float scale);
+
+        // Morton code of the segment midpoint (16 bit per axis)
+        unsigned int mortonCode(const float4& coords) const;
+
         // lines
         L3DPP::DataArray<float4>* lines_;
+        L3DPP::DataArray<L3DPP::QuantizedSegment2D>* qlines_;
+        float qoffset_x_;
+        float qoffset_y_;
+        float qscale_x_;
+        float qscale_y_;
+        unsigned int num_lines_;
+
+        // length rank per segment (0 -> longest)
+        std::vector<unsigned int> length_rank_;
+        unsigned int num_active_;
+
+        // spatial order: internal ID <-> original ID
+        std::vector<unsigned int> original_id_;
+        std::vector<unsigned int> internal_id_;
+
+        // line descriptors (internal order)
+        std::vector<L3DPP::LineDescriptor> descriptors_;
+
+        // worldpoint observations
+        L3DPP::KeypointGrid* keypoints_;
 
         // superpixels (Plane3D)
         L3DPP::DataArray<float>* superpixels_;
@@ -194,6 +374,7 @@ namespace L3DPP
         Eigen::Matrix3d R_;
         Eigen::Matrix3d Rt_;
         Eigen::Matrix3d RtKinv_;
+        Eigen::Matrix3f RtKinv_f_;
         Eigen::Vector3d t_;
         Eigen::Vector3d C_;
         Eigen::Vector3d pp_;
@@ -221,6 +402,65 @@ namespace L3DPP
         float3 C_f3_;
 #endif //L3DPP_CUDA
     };
+
+    //------------------------------------------------------------------------------
+    template<>
+    inline const Eigen::Matrix3f& View::RtKinvAs<L3DPP::SinglePrecision>() const
+    {
+        return RtKinv_f_;
+    }
+
+    //------------------------------------------------------------------------------
+    template<>
+    inline const Eigen::Matrix3d& View::RtKinvAs<L3DPP::DoublePrecision>() const
+    {
+        return RtKinv_;
+    }
+
+    //------------------------------------------------------------------------------
+    template<class P>
+    void View::segmentRaysAs(const unsigned int segID, typename P::Vector3& ray1,
+                             typename P::Vector3& ray2) const
+    {
+        const float4 seg = segment(segID);
+        const typename P::Matrix3& RtKinv = RtKinvAs<P>();
+        ray1 = (RtKinv*typename P::Vector3(seg.x,seg.y,1)).normalized();
+        ray2 = (RtKinv*typename P::Vector3(seg.z,seg.w,1)).normalized();
+    }
+
+    //------------------------------------------------------------------------------
+    template<class P>
+    typename P::Vector3 View::unprojectedDirAs(const unsigned int segID, const float depth1,
+                                               const float depth2) const
+    {
+        if(segID >= num_lines_)
+            return P::Vector3::Zero();
+
+        typename P::Vector3 ray1,ray2;
+        segmentRaysAs<P>(segID,ray1,ray2);
+
+        typename P::Vector3 d = ray2*typename P::Scalar(depth2)-ray1*typename P::Scalar(depth1);
+        typename P::Scalar len = d.norm();
+        if(len > L3D_EPS)
+            return d/len;
+        else
+            return P::Vector3::Zero();
+    }
+
+    //------------------------------------------------------------------------------
+    template<class P>
+    double View::segmentQualityAngleAs(const typename P::Vector3& dir,
+                                       const unsigned int segID) const
+    {
+        if(segID >= num_lines_)
+            return 0.0;
+
+        const float4 seg = segment(segID);
+        typename P::Vector3 p(0.5f*(seg.x+seg.z),0.5f*(seg.y+seg.w),1);
+        typename P::Vector3 r = (RtKinvAs<P>()*p).normalized();
+
+        return acos(fmin(fmax(double(r.dot(dir)),-1.0),1.0));
+    }
 }
 
 #endif //I3D_LINE3D_PP_VIEW_H_
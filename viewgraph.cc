@@ -0,0 +1,583 @@
+#include "viewgraph.h"
+
+// std
+#include <queue>
+#include <limits>
+
+namespace L3DPP
+{
+    //------------------------------------------------------------------------------
+    ViewGraph::ViewGraph(const std::map<unsigned int,std::set<unsigned int> >& neighbors)
+    {
+        // collect all views (neighbors might not have an entry themselves)
+        std::map<unsigned int,std::set<unsigned int> > sym;
+        std::map<unsigned int,std::set<unsigned int> >::const_iterator it = neighbors.begin();
+        for(; it!=neighbors.end(); ++it)
+        {
+            sym[it->first];
+            std::set<unsigned int>::const_iterator n_it = it->second.begin();
+            for(; n_it!=it->second.end(); ++n_it)
+            {
+                if(*n_it == it->first)
+                    continue;
+
+                sym[it->first].insert(*n_it);
+                sym[*n_it].insert(it->first);
+            }
+        }
+
+        // local IDs
+        std::map<unsigned int,size_t> global2local;
+        camIDs_.reserve(sym.size());
+        for(it=sym.begin(); it!=sym.end(); ++it)
+        {
+            global2local[it->first] = camIDs_.size();
+            camIDs_.push_back(it->first);
+        }
+
+        // CSR adjacency
+        offsets_.resize(camIDs_.size()+1,0);
+        size_t v = 0;
+        for(it=sym.begin(); it!=sym.end(); ++it,++v)
+        {
+            offsets_[v+1] = offsets_[v]+it->second.size();
+
+            std::set<unsigned int>::const_iterator n_it = it->second.begin();
+            for(; n_it!=it->second.end(); ++n_it)
+                adjacency_.push_back(global2local[*n_it]);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    std::vector<unsigned int> ViewGraph::orderRCM() const
+    {
+        std::vector<unsigned int> order;
+        order.reserve(camIDs_.size());
+
+        std::vector<bool> done(camIDs_.size(),false);
+        std::vector<bool> visited(camIDs_.size(),false);
+        std::vector<size_t> cm_order;
+        cm_order.reserve(camIDs_.size());
+
+        std::vector<std::pair<size_t,size_t> > next;
+        for(size_t v=0; v<camIDs_.size(); ++v)
+        {
+            if(done[v])
+                continue;
+
+            // new component -> start from a peripheral view
+            size_t root = peripheralNode(v,done,visited);
+
+            size_t head = cm_order.size();
+            cm_order.push_back(root);
+            done[root] = true;
+
+            // Cuthill-McKee: BFS, neighbors by increasing degree
+            while(head < cm_order.size())
+            {
+                size_t u = cm_order[head];
+                ++head;
+
+                next.clear();
+                for(size_t i=offsets_[u]; i<offsets_[u+1]; ++i)
+                {
+                    size_t w = adjacency_[i];
+                    if(!done[w])
+                    {
+                        done[w] = true;
+                        next.push_back(std::pair<size_t,size_t>(degree(w),w));
+                    }
+                }
+
+                std::sort(next.begin(),next.end());
+                for(size_t i=0; i<next.size(); ++i)
+                    cm_order.push_back(next[i].second);
+            }
+        }
+
+        // reverse
+        std::vector<size_t>::const_reverse_iterator r_it = cm_order.rbegin();
+        for(; r_it!=cm_order.rend(); ++r_it)
+            order.push_back(camIDs_[*r_it]);
+
+        return order;
+    }
+
+    //------------------------------------------------------------------------------
+    std::map<unsigned int,unsigned int> ViewGraph::partition(const unsigned int num_parts,
+                                                             const std::map<unsigned int,double>& weights,
+                                                             const double imbalance) const
+    {
+        std::map<unsigned int,unsigned int> view2part;
+        size_t n = camIDs_.size();
+
+        if(num_parts < 2 || n == 0)
+        {
+            for(size_t v=0; v<n; ++v)
+                view2part[camIDs_[v]] = 0;
+
+            return view2part;
+        }
+
+        // finest level (edge weight = number of view pairs)
+        std::vector<PartitionLevel> levels(1);
+        levels[0].offsets_ = offsets_;
+        levels[0].adjacency_ = adjacency_;
+        levels[0].edge_weights_ = std::vector<double>(adjacency_.size(),1.0);
+        levels[0].weights_ = std::vector<double>(n,1.0);
+
+        double total_weight = 0.0;
+        for(size_t v=0; v<n; ++v)
+        {
+            std::map<unsigned int,double>::const_iterator w_it = weights.find(camIDs_[v]);
+            if(w_it != weights.end())
+                levels[0].weights_[v] = std::max(w_it->second,0.0);
+
+            total_weight += levels[0].weights_[v];
+        }
+
+        if(total_weight <= 0.0)
+        {
+            levels[0].weights_ = std::vector<double>(n,1.0);
+            total_weight = double(n);
+        }
+
+        // coarsening
+        size_t coarsen_to = std::max(size_t(15*num_parts),size_t(64));
+        double max_vertex_weight = 1.5*total_weight/double(coarsen_to);
+        while(levels.back().size() > coarsen_to)
+        {
+            PartitionLevel coarse;
+            if(!coarsen(levels.back(),coarse,max_vertex_weight))
+                break;
+
+            levels.push_back(coarse);
+        }
+
+        // initial partition
+        std::vector<unsigned int> parts;
+        initialPartition(levels.back(),num_parts,parts);
+
+        // uncoarsening and refinement
+        double target = total_weight/double(num_parts);
+        for(int l=int(levels.size())-1; l>=0; --l)
+        {
+            const PartitionLevel& level = levels[l];
+
+            if(l < int(levels.size())-1)
+            {
+                // project from coarser level
+                std::vector<unsigned int> fine_parts(level.size());
+                for(size_t v=0; v<level.size(); ++v)
+                    fine_parts[v] = parts[level.coarse_[v]];
+
+                parts.swap(fine_parts);
+            }
+
+            // heavy (coarse) vertices need some slack
+            double max_weight = 0.0;
+            for(size_t v=0; v<level.size(); ++v)
+                max_weight = std::max(max_weight,level.weights_[v]);
+
+            refine(level,num_parts,std::max(imbalance*target,target+max_weight),parts);
+        }
+
+        for(size_t v=0; v<n; ++v)
+            view2part[camIDs_[v]] = parts[v];
+
+        return view2part;
+    }
+
+    //------------------------------------------------------------------------------
+    bool ViewGraph::coarsen(PartitionLevel& fine, PartitionLevel& coarse,
+                            const double max_weight) const
+    {
+        size_t n = fine.size();
+
+        // visit by increasing degree (low degree vertices first)
+        std::vector<std::pair<size_t,size_t> > visit(n);
+        for(size_t v=0; v<n; ++v)
+            visit[v] = std::pair<size_t,size_t>(fine.offsets_[v+1]-fine.offsets_[v],v);
+
+        std::sort(visit.begin(),visit.end());
+
+        // heavy edge matching
+        std::vector<size_t> match(n,n);
+        for(size_t i=0; i<n; ++i)
+        {
+            size_t v = visit[i].second;
+            if(match[v] != n)
+                continue;
+
+            size_t best = v;
+            double best_weight = -1.0;
+            for(size_t j=fine.offsets_[v]; j<fine.offsets_[v+1]; ++j)
+            {
+                size_t u = fine.adjacency_[j];
+                if(u == v || match[u] != n || fine.weights_[v]+fine.weights_[u] > max_weight)
+                    continue;
+
+                double ew = fine.edge_weights_[j];
+                if(ew > best_weight || (ew == best_weight && fine.weights_[u] < fine.weights_[best]))
+                {
+                    best = u;
+                    best_weight = ew;
+                }
+            }
+
+            match[v] = best;
+            match[best] = v;
+        }
+
+        // coarse vertices
+        fine.coarse_ = std::vector<size_t>(n);
+        std::vector<size_t> representative;
+        for(size_t v=0; v<n; ++v)
+        {
+            if(v <= match[v])
+            {
+                fine.coarse_[v] = representative.size();
+                fine.coarse_[match[v]] = representative.size();
+                representative.push_back(v);
+            }
+        }
+
+        size_t nc = representative.size();
+        if(double(nc) > 0.95*double(n))
+        {
+            // not worth it
+            fine.coarse_.clear();
+            return false;
+        }
+
+        // coarse graph (parallel edges are merged)
+        coarse.weights_ = std::vector<double>(nc,0.0);
+        coarse.offsets_ = std::vector<size_t>(nc+1,0);
+        coarse.adjacency_.clear();
+        coarse.edge_weights_.clear();
+        coarse.adjacency_.reserve(fine.adjacency_.size());
+        coarse.edge_weights_.reserve(fine.adjacency_.size());
+
+        std::vector<size_t> slot(nc,std::numeric_limits<size_t>::max());
+        for(size_t c=0; c<nc; ++c)
+        {
+            size_t start = coarse.adjacency_.size();
+            size_t members[2] = {representative[c],match[representative[c]]};
+            size_t num_members = (members[0] == members[1]) ? 1 : 2;
+
+            for(size_t m=0; m<num_members; ++m)
+            {
+                size_t v = members[m];
+                coarse.weights_[c] += fine.weights_[v];
+
+                for(size_t j=fine.offsets_[v]; j<fine.offsets_[v+1]; ++j)
+                {
+                    size_t cu = fine.coarse_[fine.adjacency_[j]];
+                    if(cu == c)
+                        continue;
+
+                    if(slot[cu] == std::numeric_limits<size_t>::max() || slot[cu] < start)
+                    {
+                        slot[cu] = coarse.adjacency_.size();
+                        coarse.adjacency_.push_back(cu);
+                        coarse.edge_weights_.push_back(fine.edge_weights_[j]);
+                    }
+                    else
+                    {
+                        coarse.edge_weights_[slot[cu]] += fine.edge_weights_[j];
+                    }
+                }
+            }
+
+            coarse.offsets_[c+1] = coarse.adjacency_.size();
+        }
+
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+    void ViewGraph::initialPartition(const PartitionLevel& level, const unsigned int num_parts,
+                                     std::vector<unsigned int>& parts) const
+    {
+        size_t n = level.size();
+        parts = std::vector<unsigned int>(n,num_parts-1);
+
+        // seeds in BFS order (next seed is close to the previous partition)
+        std::vector<std::pair<size_t,size_t> > by_degree(n);
+        for(size_t v=0; v<n; ++v)
+            by_degree[v] = std::pair<size_t,size_t>(level.offsets_[v+1]-level.offsets_[v],v);
+
+        std::sort(by_degree.begin(),by_degree.end());
+
+        std::vector<size_t> seeds;
+        seeds.reserve(n);
+        std::vector<bool> queued(n,false);
+        for(size_t i=0; i<n; ++i)
+        {
+            size_t root = by_degree[i].second;
+            if(queued[root])
+                continue;
+
+            size_t head = seeds.size();
+            seeds.push_back(root);
+            queued[root] = true;
+            while(head < seeds.size())
+            {
+                size_t u = seeds[head];
+                ++head;
+
+                for(size_t j=level.offsets_[u]; j<level.offsets_[u+1]; ++j)
+                {
+                    size_t w = level.adjacency_[j];
+                    if(!queued[w])
+                    {
+                        queued[w] = true;
+                        seeds.push_back(w);
+                    }
+                }
+            }
+        }
+
+        double remaining = 0.0;
+        for(size_t v=0; v<n; ++v)
+            remaining += level.weights_[v];
+
+        // greedy graph growing (strongest connected vertex first)
+        std::vector<bool> assigned(n,false);
+        std::vector<double> gain(n,0.0);
+        std::vector<size_t> touched;
+        size_t next_seed = 0;
+        for(unsigned int p=0; p+1<num_parts; ++p)
+        {
+            double target = remaining/double(num_parts-p);
+            double part_weight = 0.0;
+            std::priority_queue<std::pair<double,size_t> > frontier;
+
+            while(part_weight < target)
+            {
+                size_t v = n;
+                while(!frontier.empty())
+                {
+                    std::pair<double,size_t> top = frontier.top();
+                    frontier.pop();
+
+                    // skip outdated entries
+                    if(!assigned[top.second] && top.first >= gain[top.second])
+                    {
+                        v = top.second;
+                        break;
+                    }
+                }
+
+                if(v == n)
+                {
+                    // empty frontier -> new seed
+                    while(next_seed < n && assigned[seeds[next_seed]])
+                        ++next_seed;
+
+                    if(next_seed == n)
+                        break;
+
+                    v = seeds[next_seed];
+                }
+
+                // stop if the partition gets closer to the target without v
+                if(part_weight > 0.0 && part_weight+level.weights_[v]-target > target-part_weight)
+                    break;
+
+                assigned[v] = true;
+                parts[v] = p;
+                part_weight += level.weights_[v];
+
+                for(size_t j=level.offsets_[v]; j<level.offsets_[v+1]; ++j)
+                {
+                    size_t u = level.adjacency_[j];
+                    if(assigned[u])
+                        continue;
+
+                    if(gain[u] == 0.0)
+                        touched.push_back(u);
+
+                    gain[u] += level.edge_weights_[j];
+                    frontier.push(std::pair<double,size_t>(gain[u],u));
+                }
+            }
+
+            remaining -= part_weight;
+
+            // reset gains
+            for(size_t i=0; i<touched.size(); ++i)
+                gain[touched[i]] = 0.0;
+
+            touched.clear();
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    void ViewGraph::refine(const PartitionLevel& level, const unsigned int num_parts,
+                           const double max_part_weight, std::vector<unsigned int>& parts) const
+    {
+        size_t n = level.size();
+
+        std::vector<double> part_weights(num_parts,0.0);
+        for(size_t v=0; v<n; ++v)
+            part_weights[parts[v]] += level.weights_[v];
+
+        std::vector<double> connectivity(num_parts,0.0);
+        std::vector<unsigned int> touched;
+        for(unsigned int pass=0; pass<10; ++pass)
+        {
+            size_t moved = 0;
+            for(size_t v=0; v<n; ++v)
+            {
+                unsigned int from = parts[v];
+                double w = level.weights_[v];
+
+                // connectivity to adjacent partitions
+                touched.clear();
+                for(size_t j=level.offsets_[v]; j<level.offsets_[v+1]; ++j)
+                {
+                    unsigned int p = parts[level.adjacency_[j]];
+                    if(connectivity[p] == 0.0)
+                        touched.push_back(p);
+
+                    connectivity[p] += level.edge_weights_[j];
+                }
+
+                double internal = connectivity[from];
+                bool overweight = (part_weights[from] > max_part_weight);
+
+                // best move (overweight partitions accept negative gains)
+                unsigned int best = from;
+                double best_gain = overweight ? -std::numeric_limits<double>::max() : 0.0;
+                for(size_t i=0; i<touched.size(); ++i)
+                {
+                    unsigned int p = touched[i];
+                    if(p == from || part_weights[p]+w > max_part_weight)
+                        continue;
+
+                    double gain = connectivity[p]-internal;
+                    if(gain > best_gain ||
+                            (gain == best_gain && part_weights[p]+w < part_weights[from] &&
+                             (best == from || part_weights[p] < part_weights[best])))
+                    {
+                        best = p;
+                        best_gain = gain;
+                    }
+                }
+
+                if(overweight && best == from)
+                {
+                    // no adjacent partition -> lightest one
+                    unsigned int lightest = 0;
+                    for(unsigned int p=1; p<num_parts; ++p)
+                    {
+                        if(part_weights[p] < part_weights[lightest])
+                            lightest = p;
+                    }
+
+                    if(lightest != from && part_weights[lightest]+w <= max_part_weight)
+                        best = lightest;
+                }
+
+                for(size_t i=0; i<touched.size(); ++i)
+                    connectivity[touched[i]] = 0.0;
+
+                if(best != from)
+                {
+                    parts[v] = best;
+                    part_weights[from] -= w;
+                    part_weights[best] += w;
+                    ++moved;
+                }
+            }
+
+            if(moved == 0)
+                break;
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    size_t ViewGraph::peripheralNode(const size_t start, const std::vector<bool>& done,
+                                     std::vector<bool>& visited) const
+    {
+        // George-Liu pseudo-peripheral node search
+        size_t root = start;
+        std::vector<size_t> last_level;
+        size_t ecc = bfsLevels(root,done,visited,last_level);
+
+        while(true)
+        {
+            // view with minimal degree in the last level
+            size_t candidate = root;
+            size_t min_degree = 0;
+            for(size_t i=0; i<last_level.size(); ++i)
+            {
+                if(candidate == root || degree(last_level[i]) < min_degree)
+                {
+                    candidate = last_level[i];
+                    min_degree = degree(candidate);
+                }
+            }
+
+            if(candidate == root)
+                return root;
+
+            std::vector<size_t> candidate_level;
+            size_t candidate_ecc = bfsLevels(candidate,done,visited,candidate_level);
+
+            if(candidate_ecc <= ecc)
+                return root;
+
+            root = candidate;
+            ecc = candidate_ecc;
+            last_level = candidate_level;
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    size_t ViewGraph::bfsLevels(const size_t root, const std::vector<bool>& done,
+                                std::vector<bool>& visited,
+                                std::vector<size_t>& last_level) const
+    {
+        std::vector<size_t> current(1,root);
+        std::vector<size_t> upcoming;
+        std::vector<size_t> touched(1,root);
+        visited[root] = true;
+
+        size_t depth = 0;
+        last_level = current;
+        while(!current.empty())
+        {
+            upcoming.clear();
+            for(size_t i=0; i<current.size(); ++i)
+            {
+                size_t u = current[i];
+                for(size_t j=offsets_[u]; j<offsets_[u+1]; ++j)
+                {
+                    size_t w = adjacency_[j];
+                    if(!done[w] && !visited[w])
+                    {
+                        visited[w] = true;
+                        upcoming.push_back(w);
+                        touched.push_back(w);
+                    }
+                }
+            }
+
+            if(!upcoming.empty())
+            {
+                ++depth;
+                last_level = upcoming;
+            }
+
+            current.swap(upcoming);
+        }
+
+        // reset scratch memory (only this component)
+        for(size_t i=0; i<touched.size(); ++i)
+            visited[touched[i]] = false;
+
+        return depth;
+    }
+}
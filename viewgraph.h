@@ -0,0 +1,99 @@
+#ifndef I3D_LINE3D_PP_VIEWGRAPH_H_
+#define I3D_LINE3D_PP_VIEWGRAPH_H_
+
+/*
+ * Line3D++ - Line-based Multi View Stereo
+ * Copyright (C) 2015  Manuel Hofer
+
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// std
+#include <map>
+#include <set>
+#include <vector>
+#include <algorithm>
+
+/**
+ * Line3D++ - ViewGraph
+ * ====================
+ * Undirected graph over the visual
+ * neighbors (images that are matched
+ * with each other). Used to schedule
+ * and distribute the per-view processing.
+ * ====================
+ */
+
+namespace L3DPP
+{
+    class ViewGraph
+    {
+    public:
+        // graph from visual neighbor map (symmetrized)
+        ViewGraph(const std::map<unsigned int,std::set<unsigned int> >& neighbors);
+
+        // bandwidth reducing traversal (reverse Cuthill-McKee),
+        // returns the camIDs in processing order
+        std::vector<unsigned int> orderRCM() const;
+
+        // multilevel k-way partitioning (heavy edge matching, greedy
+        // growing, boundary refinement): balances the view weights
+        // (camID -> weight, default 1) within the given imbalance and
+        // minimizes the number of view pairs between partitions,
+        // returns camID -> partition
+        std::map<unsigned int,unsigned int> partition(const unsigned int num_parts,
+                                                      const std::map<unsigned int,double>& weights,
+                                                      const double imbalance=1.05) const;
+
+        // data access
+        size_t num_views() const {return camIDs_.size();}
+        size_t num_edges() const {return adjacency_.size()/2;}
+        unsigned int camID(const size_t v) const {return camIDs_[v];}
+        size_t degree(const size_t v) const {return offsets_[v+1]-offsets_[v];}
+
+    private:
+        // graph on one level of the multilevel partitioning
+        struct PartitionLevel
+        {
+            std::vector<size_t> offsets_;
+            std::vector<size_t> adjacency_;
+            std::vector<double> edge_weights_;
+            std::vector<double> weights_;
+            // vertex -> vertex on the next (coarser) level
+            std::vector<size_t> coarse_;
+
+            size_t size() const {return weights_.size();}
+        };
+
+        // heavy edge matching, returns false if the graph does not shrink
+        bool coarsen(PartitionLevel& fine, PartitionLevel& coarse,
+                     const double max_weight) const;
+
+        // greedy graph growing on the coarsest level
+        void initialPartition(const PartitionLevel& level, const unsigned int num_parts,
+                              std::vector<unsigned int>& parts) const;
+
+        // greedy boundary refinement (moves with positive gain, rebalancing)
+        void refine(const PartitionLevel& level, const unsigned int num_parts,
+                    const double max_part_weight, std::vector<unsigned int>& parts) const;
+
+        // pseudo-peripheral start node for a component
+        size_t peripheralNode(const size_t start, const std::vector<bool>& done,
+                              std::vector<bool>& visited) const;
+
+        // BFS level structure, returns the eccentricity of 'root'
+        // ('visited' is scratch memory, all false on entry and exit)
+        size_t bfsLevels(const size_t root, const std::vector<bool>& done,
+                         std::vector<bool>& visited,
+                         std::vector<size_t>& last_level) const;
+
+        // graph in CSR format (local IDs)
+        std::vector<unsigned int> camIDs_;
+        std::vector<size_t> offsets_;
+        std::vector<size_t> adjacency_;
+    };
+}
+
+#endif //I3D_LINE3D_PP_VIEWGRAPH_H_